@@ -91,6 +91,15 @@ void LogProxy::QueryState()
   return;
 }
 
+void LogProxy::QueryWriteStats()
+{
+  scoped_lock_t lock(mPc->mMutex);
+
+  if (0 != playerc_log_get_write_stats(mDevice))
+    throw PlayerError("LogProxy::QueryWriteStats()", "error querying writer");
+  return;
+}
+
 void
 LogProxy::SetState(int aState)
 {
@@ -140,6 +149,24 @@ LogProxy::Rewind()
   return;
 }
 
+void
+LogProxy::SetReadTime(double aTime)
+{
+  scoped_lock_t lock(mPc->mMutex);
+  if (0 != playerc_log_set_read_time(mDevice,aTime))
+    throw PlayerError("LogProxy::SetReadTime()", "error setting time");
+  return;
+}
+
+void
+LogProxy::SetReadSpeed(double aSpeed)
+{
+  scoped_lock_t lock(mPc->mMutex);
+  if (0 != playerc_log_set_read_speed(mDevice,aSpeed))
+    throw PlayerError("LogProxy::SetReadSpeed()", "error setting speed");
+  return;
+}
+
 void
 LogProxy::SetFilename(const std::string aFilename)
 {
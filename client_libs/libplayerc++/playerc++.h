@@ -1599,6 +1599,26 @@ class PLAYERCC_EXPORT LogProxy : public ClientProxy
     /// Query the server for type and state info.
     void QueryState();
 
+    /// Bytes written to the log so far. Call QueryWriteStats() to fill it.
+    int64_t GetBytesWritten() const
+      { return GetVar(mDevice->write_stats.bytes_written); };
+
+    /// Recent write rate [bytes/s]. Call QueryWriteStats() to fill it.
+    double GetWriteRate() const { return GetVar(mDevice->write_stats.rate); };
+
+    /// Messages dropped because the disk was too far behind. Call
+    /// QueryWriteStats() to fill it.
+    uint32_t GetRecordsDropped() const
+      { return GetVar(mDevice->write_stats.records_dropped); };
+
+    /// Fraction of the write buffers waiting for the disk. Call
+    /// QueryWriteStats() to fill it.
+    double GetWriteBacklog() const
+      { return GetVar(mDevice->write_stats.backlog); };
+
+    /// Query a log writer for how well the disk is keeping up.
+    void QueryWriteStats();
+
     /// Start/stop (1/0) reading from or writing to the log file.
     /// If the type of interface (reader/writer) is unknown, a query package is sent first.
     void SetState(int aState);
@@ -1612,6 +1632,13 @@ class PLAYERCC_EXPORT LogProxy : public ClientProxy
     /// Rewind the log file.
     void Rewind();
 
+    /// Jump to the first message logged at or after the given time [s].
+    void SetReadTime(double aTime);
+
+    /// Set the playback speed; 1 is real time, and 0 as fast as the
+    /// clients take the data.
+    void SetReadSpeed(double aSpeed);
+
     /// Set the name of the logfile to write to.
     void SetFilename(const std::string aFilename);
 };
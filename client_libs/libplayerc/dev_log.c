@@ -106,6 +106,24 @@ int playerc_log_get_state(playerc_log_t* device)
   return(0);
 }
 
+// Get writer statistics; the result is written into the proxy
+int playerc_log_get_write_stats(playerc_log_t* device)
+{
+  player_log_write_stats_t *req;
+
+  if(playerc_client_request(device->info.client, 
+                            &device->info,
+                            PLAYER_LOG_REQ_GET_WRITE_STATS,
+                            NULL, (void**)&req) < 0)
+  {
+    PLAYERC_ERR("failed to get writer statistics");
+    return(-1);
+  }
+  device->write_stats = *req;
+  player_log_write_stats_t_free(req);
+  return(0);
+}
+
 // Start/stop logging
 int playerc_log_set_write_state(playerc_log_t* device, int state)
 {
@@ -153,6 +171,40 @@ int playerc_log_set_read_rewind(playerc_log_t* device)
   return(0);
 }
 
+// Jump to a time in the log
+int playerc_log_set_read_time(playerc_log_t* device, double time)
+{
+  player_log_set_read_time_t req;
+
+  req.time = time;
+
+  if(playerc_client_request(device->info.client, 
+                            &device->info, PLAYER_LOG_REQ_SET_READ_TIME,
+                            &req, NULL) < 0)
+  {
+    PLAYERC_ERR("failed to set playback time");
+    return(-1);
+  }
+  return(0);
+}
+
+// Set playback speed
+int playerc_log_set_read_speed(playerc_log_t* device, double speed)
+{
+  player_log_set_read_speed_t req;
+
+  req.speed = speed;
+
+  if(playerc_client_request(device->info.client, 
+                            &device->info, PLAYER_LOG_REQ_SET_READ_SPEED,
+                            &req, NULL) < 0)
+  {
+    PLAYERC_ERR("failed to set playback speed");
+    return(-1);
+  }
+  return(0);
+}
+
 // Change filename 
 int playerc_log_set_filename(playerc_log_t* device, const char* fname)
 {
@@ -2483,6 +2483,10 @@ typedef struct
   /** Is logging/playback enabled? Call playerc_log_get_state() to
       fill it. */
   int state;
+
+  /** How well the disk is keeping up with logging. Call
+      playerc_log_get_write_stats() to fill it. */
+  player_log_write_stats_t write_stats;
 } playerc_log_t;
 
 
@@ -2507,6 +2511,13 @@ PLAYERC_EXPORT int playerc_log_set_read_state(playerc_log_t* device, int state);
 /** @brief Rewind playback */
 PLAYERC_EXPORT int playerc_log_set_read_rewind(playerc_log_t* device);
 
+/** @brief Jump to the first message logged at or after time [s] */
+PLAYERC_EXPORT int playerc_log_set_read_time(playerc_log_t* device, double time);
+
+/** @brief Set playback speed; 1 is real time, and 0 as fast as the
+    clients take the data */
+PLAYERC_EXPORT int playerc_log_set_read_speed(playerc_log_t* device, double speed);
+
 /** @brief Get logging/playback state.
 
 The result is written into the proxy.
@@ -2514,6 +2525,13 @@ The result is written into the proxy.
 */
 PLAYERC_EXPORT int playerc_log_get_state(playerc_log_t* device);
 
+/** @brief Get the writer statistics of a log device that writes.
+
+The result is written into the proxy.
+
+*/
+PLAYERC_EXPORT int playerc_log_get_write_stats(playerc_log_t* device);
+
 /** @brief Change name of log file to write to. */
 PLAYERC_EXPORT int playerc_log_set_filename(playerc_log_t* device, const char* fname);
 
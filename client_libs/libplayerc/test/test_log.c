@@ -76,6 +76,22 @@ int test_log(playerc_client_t *client, int index)
     }
     PASS();
 
+    TEST("jumping to the start of the log");
+    if(playerc_log_set_read_time(device, 0.0) != 0)
+    {
+      FAIL();
+      return -1;
+    }
+    PASS();
+
+    TEST("setting playback speed");
+    if(playerc_log_set_read_speed(device, 1.0) != 0)
+    {
+      FAIL();
+      return -1;
+    }
+    PASS();
+
     TEST("starting playback");
     if(playerc_log_set_read_state(device,1) != 0)
     {
@@ -119,6 +135,14 @@ int test_log(playerc_client_t *client, int index)
       return -1;
     }
     PASS();
+
+    TEST("getting writer statistics");
+    if(playerc_log_get_write_stats(device) != 0)
+    {
+      FAIL();
+      return -1;
+    }
+    PASS();
   }
   else
   {
@@ -57,6 +57,7 @@ CHECK_INCLUDE_FILES (strings.h HAVE_STRINGS_H)
 CHECK_INCLUDE_FILES (dns_sd.h HAVE_DNS_SD)
 CHECK_INCLUDE_FILES (sys/filio.h HAVE_SYS_FILIO_H)
 CHECK_INCLUDE_FILES (ieeefp.h HAVE_IEEEFP_H)
+CHECK_INCLUDE_FILES (sys/epoll.h HAVE_SYS_EPOLL_H)
 IF (HAVE_DNS_SD)
     CHECK_LIBRARY_EXISTS (dns_sd DNSServiceRefDeallocate "${PLAYER_EXTRA_LIB_DIRS}" HAVE_DNS_SD)
 ENDIF (HAVE_DNS_SD)
@@ -133,6 +134,25 @@ ELSE (PLAYER_OS_QNX OR PLAYER_OS_OSX)
     ENDIF (HAVE_LIBRT AND HAVE_CLOCK_GETTIME_FUNC)
 ENDIF(PLAYER_OS_QNX OR PLAYER_OS_OSX)
 
+# Sleeping until an absolute time on the monotonic clock
+IF (HAVE_LIBRT)
+    SET (CMAKE_REQUIRED_LIBRARIES rt)
+ENDIF (HAVE_LIBRT)
+CHECK_FUNCTION_EXISTS (clock_nanosleep HAVE_CLOCK_NANOSLEEP)
+SET (CMAKE_REQUIRED_LIBRARIES)
+
+# stdio streams onto user functions, for writing logs from another thread
+CHECK_FUNCTION_EXISTS (fopencookie HAVE_FOPENCOOKIE)
+CHECK_FUNCTION_EXISTS (funopen HAVE_FUNOPEN)
+CHECK_FUNCTION_EXISTS (fdatasync HAVE_FDATASYNC)
+
+# GCC-style atomic builtins, used for lock-free reference counts and free lists
+INCLUDE (CheckCSourceCompiles)
+SET (CHECK_SYNC_BUILTINS_SOURCE_CODE "int main () { long v = 0; void *p = 0;
+__sync_fetch_and_add (&v, 1); __sync_bool_compare_and_swap (&p, 0, &v);
+__sync_lock_test_and_set (&p, 0); __sync_synchronize (); return 0; }")
+CHECK_C_SOURCE_COMPILES ("${CHECK_SYNC_BUILTINS_SOURCE_CODE}" HAVE_SYNC_BUILTINS)
+
 # Geos check
 CHECK_LIBRARY_EXISTS (geos_c GEOSGeomFromWKB_buf "${PLAYER_EXTRA_LIB_DIRS}" HAVE_GEOS)
 
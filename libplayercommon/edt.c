@@ -0,0 +1,271 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/***************************************************************************
+ * Desc: Exact Euclidean distance transform, after Felzenszwalb and
+ *       Huttenlocher, "Distance Transforms of Sampled Functions".  The
+ *       first pass finds the distance to the nearest feature in each
+ *       column; the second takes, for each row, the lower envelope of
+ *       the parabolas rooted at the column distances.
+ * CVS: $Id$
+ **************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined (WIN32)
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include "edt.h"
+
+// One thread's share of the transform: a range of columns for the first
+// pass and a range of rows for the second, with workspace for one row.
+typedef struct
+{
+  const uint8_t *features;
+  int width, height;
+  uint32_t *dist2;
+  int x0, x1, y0, y1;
+
+  uint32_t *g;
+  int *v;
+  double *z;
+
+  pthread_t thread;
+  int started;
+
+} edt_job_t;
+
+
+// Distance along each column, in cells, to the nearest feature in the
+// column.  The columns are swept a row at a time, to keep to the order of
+// the grid in memory.
+static void *edt_columns(void *arg)
+{
+  edt_job_t *job = (edt_job_t*) arg;
+  int i, j, w;
+  uint32_t *row, *prev;
+  const uint8_t *f;
+
+  w = job->width;
+
+  for (j = 0; j < job->height; j++)
+  {
+    row = job->dist2 + (size_t) j * w;
+    prev = row - w;
+    f = job->features + (size_t) j * w;
+    for (i = job->x0; i < job->x1; i++)
+    {
+      if (f[i])
+        row[i] = 0;
+      else if (j > 0 && prev[i] != PLAYER_EDT_NONE)
+        row[i] = prev[i] + 1;
+      else
+        row[i] = PLAYER_EDT_NONE;
+    }
+  }
+
+  for (j = job->height - 2; j >= 0; j--)
+  {
+    row = job->dist2 + (size_t) j * w;
+    prev = row + w;
+    for (i = job->x0; i < job->x1; i++)
+    {
+      if (prev[i] != PLAYER_EDT_NONE && prev[i] + 1 < row[i])
+        row[i] = prev[i] + 1;
+    }
+  }
+  return NULL;
+}
+
+
+// Squared distance to the nearest feature, from the column distances of
+// one row
+static void edt_row(edt_job_t *job, uint32_t *row)
+{
+  int i, k, q;
+  double s, fq;
+  uint64_t d;
+  uint32_t *g;
+  int *v;
+  double *z;
+
+  g = job->g;
+  v = job->v;
+  z = job->z;
+  memcpy(g, row, job->width * sizeof(g[0]));
+
+  // Lower envelope of the parabolas (x - q)^2 + g[q]^2; columns with no
+  // feature contribute nothing
+  k = -1;
+  for (q = 0; q < job->width; q++)
+  {
+    if (g[q] == PLAYER_EDT_NONE)
+      continue;
+    fq = (double) g[q] * g[q] + (double) q * q;
+    if (k < 0)
+    {
+      k = 0;
+      v[0] = q;
+      z[0] = -HUGE_VAL;
+      z[1] = +HUGE_VAL;
+      continue;
+    }
+    while (1)
+    {
+      s = (fq - ((double) g[v[k]] * g[v[k]] + (double) v[k] * v[k])) /
+        (2.0 * (q - v[k]));
+      if (s > z[k])
+        break;
+      k--;
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = +HUGE_VAL;
+  }
+
+  if (k < 0)
+  {
+    for (i = 0; i < job->width; i++)
+      row[i] = PLAYER_EDT_NONE;
+    return;
+  }
+
+  k = 0;
+  for (i = 0; i < job->width; i++)
+  {
+    while (z[k + 1] < i)
+      k++;
+    d = (uint64_t) (i - v[k]) * (i - v[k]) + (uint64_t) g[v[k]] * g[v[k]];
+    row[i] = d < PLAYER_EDT_NONE ? (uint32_t) d : PLAYER_EDT_NONE - 1;
+  }
+  return;
+}
+
+
+// Squared distances for one thread's rows
+static void *edt_rows(void *arg)
+{
+  int j;
+  edt_job_t *job = (edt_job_t*) arg;
+
+  for (j = job->y0; j < job->y1; j++)
+    edt_row(job, job->dist2 + (size_t) j * job->width);
+  return NULL;
+}
+
+
+// Run one pass over all the jobs, the first in the calling thread.  Jobs
+// for which a thread cannot be started are run in the calling thread too.
+static void edt_pass(edt_job_t *jobs, int threads, void *(*fn)(void*))
+{
+  int t;
+
+  for (t = 1; t < threads; t++)
+    jobs[t].started = (pthread_create(&jobs[t].thread, NULL, fn, jobs + t) == 0);
+  (*fn)(jobs);
+  for (t = 1; t < threads; t++)
+  {
+    if (jobs[t].started)
+      pthread_join(jobs[t].thread, NULL);
+    else
+      (*fn)(jobs + t);
+  }
+  return;
+}
+
+
+// Number of processors
+static int edt_processors(void)
+{
+#if defined (WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int) info.dwNumberOfProcessors;
+#elif defined (_SC_NPROCESSORS_ONLN)
+  long n;
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+#else
+  return 1;
+#endif
+}
+
+
+// Squared Euclidean distance transform
+int player_edt(const uint8_t *features, int width, int height,
+               int threads, uint32_t *dist2)
+{
+  int t, ret;
+  edt_job_t *jobs;
+
+  if (width <= 0 || height <= 0)
+    return 0;
+
+  if (threads <= 0)
+    threads = edt_processors();
+  if (threads > width)
+    threads = width;
+  if (threads > height)
+    threads = height;
+
+  if ((jobs = calloc(threads, sizeof(edt_job_t))) == NULL)
+    return -1;
+
+  ret = 0;
+  for (t = 0; t < threads; t++)
+  {
+    jobs[t].features = features;
+    jobs[t].width = width;
+    jobs[t].height = height;
+    jobs[t].dist2 = dist2;
+    jobs[t].x0 = (int) ((int64_t) width * t / threads);
+    jobs[t].x1 = (int) ((int64_t) width * (t + 1) / threads);
+    jobs[t].y0 = (int) ((int64_t) height * t / threads);
+    jobs[t].y1 = (int) ((int64_t) height * (t + 1) / threads);
+    jobs[t].g = malloc(width * sizeof(uint32_t));
+    jobs[t].v = malloc(width * sizeof(int));
+    jobs[t].z = malloc((width + 1) * sizeof(double));
+    if (!jobs[t].g || !jobs[t].v || !jobs[t].z)
+      ret = -1;
+  }
+
+  // Every column must be done before any row is started
+  if (ret == 0)
+  {
+    edt_pass(jobs, threads, edt_columns);
+    edt_pass(jobs, threads, edt_rows);
+  }
+
+  for (t = 0; t < threads; t++)
+  {
+    free(jobs[t].g);
+    free(jobs[t].v);
+    free(jobs[t].z);
+  }
+  free(jobs);
+  return ret;
+}
@@ -0,0 +1,76 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/***************************************************************************
+ * Desc: Exact Euclidean distance transform for occupancy grids
+ * CVS: $Id$
+ **************************************************************************/
+
+#ifndef PLAYER_EDT_H
+#define PLAYER_EDT_H
+
+#include <stdint.h>
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCOMMON_EXPORT
+  #elif defined (playercommon_EXPORTS)
+    #define PLAYERCOMMON_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCOMMON_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCOMMON_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @ingroup libplayercommon
+ @{ */
+
+/// Value of the distance transform for cells with no feature cell at all
+#define PLAYER_EDT_NONE UINT32_MAX
+
+/** @brief Squared Euclidean distance transform.
+
+For each cell of a row-major grid of width x height cells, computes the
+squared distance, in cells, to the nearest cell for which features[] is
+non-zero; PLAYER_EDT_NONE if there are no feature cells.  The result is
+exact, and takes time linear in the number of cells whatever the
+distances.  Squared distances are integers, so callers that scale them
+get the same values as from sqrt(di*di + dj*dj).
+
+Columns and then rows are processed independently, and are split over
+the given number of threads; 0 means one per processor.
+
+Returns 0 on success, -1 if the workspace could not be allocated. */
+PLAYERCOMMON_EXPORT int player_edt(const uint8_t *features, int width, int height,
+                                   int threads, uint32_t *dist2);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
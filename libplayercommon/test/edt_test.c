@@ -0,0 +1,126 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Distance transform tests.  Compares player_edt() with a brute
+ *       force search on random and edge-case grids, for several thread
+ *       counts.
+ * Usage: edt_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercommon/edt.h>
+#include <libplayercommon/test/test.h>
+
+// Squared distance to the nearest feature, by looking at every feature
+static uint32_t brute(const uint8_t *f, int w, int h, int x, int y)
+{
+  int i, j;
+  uint32_t d, best;
+
+  best = PLAYER_EDT_NONE;
+  for (j = 0; j < h; j++)
+    for (i = 0; i < w; i++)
+      if (f[j * w + i])
+      {
+        d = (i - x) * (i - x) + (j - y) * (j - y);
+        if (d < best)
+          best = d;
+      }
+  return best;
+}
+
+// Run the transform with each thread count and compare with brute force
+static int compare(const uint8_t *f, int w, int h)
+{
+  int t, x, y, ok;
+  uint32_t *d;
+  int threads[] = {1, 2, 3, 7};
+
+  ok = 1;
+  d = malloc(w * h * sizeof(uint32_t));
+  for (t = 0; t < 4; t++)
+  {
+    memset(d, 0xa5, w * h * sizeof(uint32_t));
+    ok = ok && player_edt(f, w, h, threads[t], d) == 0;
+    for (y = 0; y < h && ok; y++)
+      for (x = 0; x < w && ok; x++)
+        ok = (d[y * w + x] == brute(f, w, h, x, y));
+  }
+  free(d);
+  return ok;
+}
+
+int main(int argc, char ** argv)
+{
+  int i, n, ok;
+  uint8_t *f;
+
+  srand(1);
+  f = malloc(97 * 61);
+
+  TEST("random sparse features");
+  {
+    ok = 1;
+    for (n = 0; n < 5; n++)
+    {
+      for (i = 0; i < 97 * 61; i++)
+        f[i] = (rand() % 200 == 0);
+      ok = ok && compare(f, 97, 61);
+    }
+    check(ok);
+  }
+
+  TEST("random dense features");
+  {
+    for (i = 0; i < 97 * 61; i++)
+      f[i] = (rand() % 3 == 0);
+    check(compare(f, 97, 61));
+  }
+
+  TEST("single feature in a corner");
+  {
+    memset(f, 0, 97 * 61);
+    f[97 * 61 - 1] = 1;
+    check(compare(f, 97, 61));
+  }
+
+  TEST("no features");
+  {
+    memset(f, 0, 97 * 61);
+    check(compare(f, 97, 61));
+  }
+
+  TEST("single row and single column");
+  {
+    memset(f, 0, 97);
+    f[40] = 1;
+    ok = compare(f, 97, 1) && compare(f, 1, 97);
+    check(ok);
+  }
+
+  free(f);
+
+  return test_result();
+}
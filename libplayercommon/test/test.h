@@ -0,0 +1,60 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/***************************************************************************
+ * Desc: Checks for the unit tests of the libraries and drivers.  Each
+ *       test names itself with TEST() and passes or fails with check();
+ *       main() returns test_result().  Include this in one file of each
+ *       test program.
+ **************************************************************************/
+
+#ifndef PLAYERCOMMON_TEST_H
+#define PLAYERCOMMON_TEST_H
+
+#include <stdio.h>
+
+// Message macros
+#define TEST(msg) (1 ? printf(msg " ... "), fflush(stdout) : 0)
+#define PASS() (1 ? printf("pass\n"), fflush(stdout) : 0)
+#define FAIL() (1 ? printf("\033[41mfail\033[0m\n"), fflush(stdout) : 0)
+
+static int failures = 0;
+
+// Pass or fail the test named last
+static void check(int ok)
+{
+  if (ok)
+    PASS();
+  else
+  {
+    FAIL();
+    failures++;
+  }
+}
+
+// Report any failures; the exit status for main()
+static int test_result(void)
+{
+  if (failures)
+    printf("%d test(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/***************************************************************************
+ * Desc: Tiled map file tests.  Writes a random grid, reads it back
+ *       through the tiles of every level, and compares the result with
+ *       the grid and with a pyramid built cell by cell.
+ * Usage: tiledmap_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libplayercommon/tiledmap.h>
+#include <libplayercommon/test/test.h>
+
+#define FILENAME "tiledmap_test.map"
+
+// Cell (i, j) of a grid, unknown off the grid
+static int8_t cell(const int8_t *cells, int w, int h, int i, int j)
+{
+  if (i < 0 || i >= w || j < 0 || j >= h)
+    return 0;
+  return cells[j * w + i];
+}
+
+// Cell (i, j) of level k, from the cells of level 0 under it
+static int8_t coarse(const int8_t *cells, int w, int h, int k, int i, int j)
+{
+  int di, dj, occ, unknown, n;
+  int8_t c;
+
+  n = 1 << k;
+  occ = unknown = 0;
+  for (dj = 0; dj < n && j * n + dj < h; dj++)
+  {
+    for (di = 0; di < n && i * n + di < w; di++)
+    {
+      c = cell(cells, w, h, i * n + di, j * n + dj);
+      occ |= (c > 0);
+      unknown |= (c == 0);
+    }
+  }
+  return occ ? 1 : (unknown ? 0 : -1);
+}
+
+
+// Overwrite a number in the header of the test file
+static int patch_u32(long offset, uint32_t value)
+{
+  FILE *file;
+  int ret;
+
+  if (!(file = fopen(FILENAME, "r+b")))
+    return -1;
+  ret = fseek(file, offset, SEEK_SET) == 0 &&
+    fwrite(&value, sizeof(value), 1, file) == 1 ? 0 : -1;
+  fclose(file);
+  return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+  int i, j, k, n, w, h, lw, lh, ok, col, row, bw, bh;
+  int8_t *cells, *block;
+  double origin[3] = {-12.5, 3.0, 0.0};
+  player_tiledmap_t *map, *again;
+  FILE *file;
+
+  w = 1000;
+  h = 700;
+  srand(1);
+  cells = malloc(w * h);
+  for (i = 0; i < w * h; i++)
+    cells[i] = rand() % 20 == 0 ? 1 : (rand() % 10 == 0 ? 0 : -1);
+  block = malloc((w + 64) * (h + 64));
+
+  TEST("write");
+  check(player_tiledmap_write(FILENAME, cells, w, h, 0.05, origin, 64) == 0);
+
+  TEST("open");
+  map = player_tiledmap_open(FILENAME);
+  check(map != NULL);
+  if (!map)
+    return 1;
+
+  TEST("levels halve down to one tile");
+  ok = map->tile_size == 64 && map->level_count == 5 &&
+    map->origin[0] == origin[0] && map->origin[1] == origin[1];
+  lw = w;
+  lh = h;
+  for (k = 0; k < (int) map->level_count; k++)
+  {
+    ok = ok && (int) map->levels[k].width == lw && (int) map->levels[k].height == lh &&
+      map->levels[k].scale == 0.05 * (1 << k);
+    lw = (lw + 1) / 2;
+    lh = (lh + 1) / 2;
+  }
+  ok = ok && map->levels[4].width <= 64 && map->levels[4].height <= 64;
+  check(ok);
+
+  TEST("full resolution, with a border off the map");
+  player_tiledmap_read(map, 0, -7, -5, w + 20, h + 9, block);
+  ok = 1;
+  for (j = 0; j < h + 9; j++)
+    for (i = 0; i < w + 20; i++)
+      ok = ok && block[j * (w + 20) + i] == cell(cells, w, h, i - 7, j - 5);
+  check(ok);
+
+  TEST("coarse levels");
+  ok = 1;
+  for (k = 1; k < (int) map->level_count; k++)
+  {
+    lw = map->levels[k].width;
+    lh = map->levels[k].height;
+    player_tiledmap_read(map, k, 0, 0, lw, lh, block);
+    for (j = 0; j < lh; j++)
+      for (i = 0; i < lw; i++)
+        ok = ok && block[j * lw + i] == coarse(cells, w, h, k, i, j);
+  }
+  check(ok);
+
+  TEST("random blocks");
+  ok = 1;
+  for (n = 0; n < 200; n++)
+  {
+    k = rand() % map->level_count;
+    col = rand() % (map->levels[k].width + 40) - 20;
+    row = rand() % (map->levels[k].height + 40) - 20;
+    bw = rand() % 150 + 1;
+    bh = rand() % 150 + 1;
+    player_tiledmap_read(map, k, col, row, bw, bh, block);
+    for (j = 0; j < bh; j++)
+    {
+      for (i = 0; i < bw; i++)
+      {
+        if (col + i < 0 || col + i >= (int) map->levels[k].width ||
+            row + j < 0 || row + j >= (int) map->levels[k].height)
+          ok = ok && block[j * bw + i] == 0;
+        else
+          ok = ok && block[j * bw + i] == coarse(cells, w, h, k, col + i, row + j);
+      }
+    }
+  }
+  check(ok);
+
+  TEST("second open shares the mapping");
+  again = player_tiledmap_open(FILENAME);
+  check(again == map && map->refs == 2);
+  player_tiledmap_close(again);
+  player_tiledmap_close(map);
+
+  // The header: tile size at byte 16, then level 0's width, height,
+  // tiles across and tiles up from byte 56
+  TEST("oversized tiles are rejected");
+  check(patch_u32(16, 0x10000000) == 0 &&
+        player_tiledmap_open(FILENAME) == NULL);
+
+  TEST("dimensions that would overflow are rejected");
+  player_tiledmap_write(FILENAME, cells, w, h, 0.05, origin, 64);
+  check(patch_u32(56, 0xffffffff) == 0 && patch_u32(64, 0xffffffff) == 0 &&
+        player_tiledmap_open(FILENAME) == NULL);
+
+  TEST("truncated file is rejected");
+  player_tiledmap_write(FILENAME, cells, w, h, 0.05, origin, 64);
+  file = fopen(FILENAME, "r+b");
+  fseek(file, 0, SEEK_END);
+  n = ftell(file);
+  fclose(file);
+  if (truncate(FILENAME, n - 4096) != 0)
+    perror("truncate");
+  map = player_tiledmap_open(FILENAME);
+  check(map == NULL);
+
+  TEST("other files are rejected");
+  file = fopen(FILENAME, "wb");
+  for (i = 0; i < 8192; i++)
+    fputc('P', file);
+  fclose(file);
+  map = player_tiledmap_open(FILENAME);
+  check(map == NULL);
+
+  remove(FILENAME);
+  free(cells);
+  free(block);
+
+  return test_result();
+}
@@ -0,0 +1,474 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/***************************************************************************
+ * Desc: Tiled, multi-resolution occupancy grid files.  The file is a
+ *       one-page header followed by the tiles of each level in turn.
+ * CVS: $Id$
+ **************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined (WIN32)
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+#endif
+
+#include "error.h"
+#include "tiledmap.h"
+
+#define TILEDMAP_MAGIC "PLYRTMAP"
+#define TILEDMAP_BYTE_ORDER 0x01020304
+#define TILEDMAP_VERSION 1
+
+// Size of the header, and the alignment of the tiles
+#define TILEDMAP_PAGE 4096
+
+// Largest tile side the reader takes; with the widths and heights held to
+// what an int holds, no level's size can overflow
+#define TILEDMAP_MAX_TILE_SIZE 65536
+
+// The header, as written
+typedef struct
+{
+  char magic[8];
+  uint32_t byte_order;
+  uint32_t version;
+  uint32_t tile_size;
+  uint32_t level_count;
+  double scale;
+  double origin[3];
+  struct
+  {
+    uint32_t width, height;
+    uint32_t tiles_x, tiles_y;
+    uint64_t offset;
+  } levels[PLAYER_TILEDMAP_MAX_LEVELS];
+} tiledmap_header_t;
+
+// Maps open in this process
+static player_tiledmap_t *tiledmap_open_list = NULL;
+static pthread_mutex_t tiledmap_open_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Halve the resolution of a grid.  A cell is occupied if any of the cells
+// under it is, else unknown if any is, else free.
+static int8_t *tiledmap_halve(const int8_t *cells, int width, int height,
+                              int *new_width, int *new_height)
+{
+  int i, j, di, dj, occ, unknown;
+  int8_t c, *halved;
+
+  *new_width = (width + 1) / 2;
+  *new_height = (height + 1) / 2;
+  if ((halved = malloc((size_t) *new_width * *new_height)) == NULL)
+    return NULL;
+
+  for (j = 0; j < *new_height; j++)
+  {
+    for (i = 0; i < *new_width; i++)
+    {
+      occ = unknown = 0;
+      for (dj = 0; dj < 2 && 2 * j + dj < height; dj++)
+      {
+        for (di = 0; di < 2 && 2 * i + di < width; di++)
+        {
+          c = cells[(size_t) (2 * j + dj) * width + 2 * i + di];
+          occ |= (c > 0);
+          unknown |= (c == 0);
+        }
+      }
+      halved[(size_t) j * *new_width + i] = occ ? +1 : (unknown ? 0 : -1);
+    }
+  }
+  return halved;
+}
+
+
+// Write out the tiles of one level
+static int tiledmap_write_level(FILE *file, const int8_t *cells, int width, int height,
+                                int tile_size, int8_t *tile)
+{
+  int tx, ty, tj, n, i, j;
+
+  for (ty = 0; ty * tile_size < height; ty++)
+  {
+    for (tx = 0; tx * tile_size < width; tx++)
+    {
+      memset(tile, 0, (size_t) tile_size * tile_size);
+      n = width - tx * tile_size;
+      if (n > tile_size)
+        n = tile_size;
+      for (tj = 0; tj < tile_size; tj++)
+      {
+        i = tx * tile_size;
+        j = ty * tile_size + tj;
+        if (j >= height)
+          break;
+        memcpy(tile + (size_t) tj * tile_size, cells + (size_t) j * width + i, n);
+      }
+      if (fwrite(tile, 1, (size_t) tile_size * tile_size, file) != (size_t) tile_size * tile_size)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+
+// Write a tiled map file
+int player_tiledmap_write(const char *filename, const int8_t *cells,
+                          int width, int height, double scale,
+                          const double origin[3], int tile_size)
+{
+  int k, ret;
+  int widths[PLAYER_TILEDMAP_MAX_LEVELS], heights[PLAYER_TILEDMAP_MAX_LEVELS];
+  const int8_t *levels[PLAYER_TILEDMAP_MAX_LEVELS];
+  int8_t *tile;
+  char page[TILEDMAP_PAGE];
+  tiledmap_header_t *header;
+  uint64_t offset;
+  FILE *file;
+
+  if (width <= 0 || height <= 0 || tile_size <= 0 || tile_size % 64 != 0 ||
+      tile_size > TILEDMAP_MAX_TILE_SIZE)
+  {
+    PLAYER_ERROR3("invalid tiled map size %dx%d, tile size %d", width, height, tile_size);
+    return -1;
+  }
+
+  // Build the pyramid, up to the level that fits in a tile
+  memset(page, 0, sizeof(page));
+  header = (tiledmap_header_t*) page;
+  memcpy(header->magic, TILEDMAP_MAGIC, sizeof(header->magic));
+  header->byte_order = TILEDMAP_BYTE_ORDER;
+  header->version = TILEDMAP_VERSION;
+  header->tile_size = tile_size;
+  header->scale = scale;
+  memcpy(header->origin, origin, sizeof(header->origin));
+
+  ret = 0;
+  levels[0] = cells;
+  widths[0] = width;
+  heights[0] = height;
+  offset = TILEDMAP_PAGE;
+  for (k = 0; ; k++)
+  {
+    header->levels[k].width = widths[k];
+    header->levels[k].height = heights[k];
+    header->levels[k].tiles_x = (widths[k] + tile_size - 1) / tile_size;
+    header->levels[k].tiles_y = (heights[k] + tile_size - 1) / tile_size;
+    header->levels[k].offset = offset;
+    offset += (uint64_t) header->levels[k].tiles_x * header->levels[k].tiles_y *
+      tile_size * tile_size;
+    header->level_count = k + 1;
+
+    if ((widths[k] <= tile_size && heights[k] <= tile_size) ||
+        k + 1 == PLAYER_TILEDMAP_MAX_LEVELS)
+      break;
+    if (!(levels[k + 1] = tiledmap_halve(levels[k], widths[k], heights[k],
+                                         widths + k + 1, heights + k + 1)))
+    {
+      ret = -1;
+      break;
+    }
+  }
+
+  tile = malloc((size_t) tile_size * tile_size);
+  if (ret == 0 && tile == NULL)
+    ret = -1;
+  if (ret < 0)
+    PLAYER_ERROR("out of memory writing tiled map");
+
+  if (ret == 0)
+  {
+    if ((file = fopen(filename, "wb")) == NULL)
+    {
+      PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+      ret = -1;
+    }
+    else
+    {
+      if (fwrite(page, 1, sizeof(page), file) != sizeof(page))
+        ret = -1;
+      for (k = 0; ret == 0 && k < (int) header->level_count; k++)
+        ret = tiledmap_write_level(file, levels[k], widths[k], heights[k], tile_size, tile);
+      if (fclose(file) != 0)
+        ret = -1;
+      if (ret < 0)
+        PLAYER_ERROR2("error writing [%s]: %s", filename, strerror(errno));
+    }
+  }
+
+  free(tile);
+  for (k = 1; k < (int) header->level_count; k++)
+    free((int8_t*) levels[k]);
+  return ret;
+}
+
+
+// Check the header against the length of the file, and fill in the map
+static int tiledmap_parse(player_tiledmap_t *map, const char *filename)
+{
+  uint32_t k;
+  uint64_t size;
+  const tiledmap_header_t *header;
+
+  header = (const tiledmap_header_t*) map->base;
+  if (map->length < TILEDMAP_PAGE ||
+      memcmp(header->magic, TILEDMAP_MAGIC, sizeof(header->magic)) != 0)
+  {
+    PLAYER_ERROR1("[%s] is not a tiled map file", filename);
+    return -1;
+  }
+  if (header->byte_order != TILEDMAP_BYTE_ORDER)
+  {
+    PLAYER_ERROR1("[%s] was written on a host of the other byte order", filename);
+    return -1;
+  }
+  if (header->version != TILEDMAP_VERSION)
+  {
+    PLAYER_ERROR2("[%s] is tiled map version %u; only version 1 is supported",
+                  filename, header->version);
+    return -1;
+  }
+  if (header->tile_size == 0 || header->tile_size > TILEDMAP_MAX_TILE_SIZE ||
+      header->level_count == 0 ||
+      header->level_count > PLAYER_TILEDMAP_MAX_LEVELS)
+  {
+    PLAYER_ERROR1("[%s] has an invalid header", filename);
+    return -1;
+  }
+
+  map->tile_size = header->tile_size;
+  map->level_count = header->level_count;
+  memcpy(map->origin, header->origin, sizeof(map->origin));
+  for (k = 0; k < header->level_count; k++)
+  {
+    // Check the dimensions before multiplying them out: each side fits
+    // an int, and is covered by exactly as many tiles as it needs
+    if (header->levels[k].width == 0 || header->levels[k].height == 0 ||
+        header->levels[k].width > INT_MAX || header->levels[k].height > INT_MAX ||
+        header->levels[k].tiles_x != (uint32_t) (((uint64_t) header->levels[k].width +
+                                                  header->tile_size - 1) / header->tile_size) ||
+        header->levels[k].tiles_y != (uint32_t) (((uint64_t) header->levels[k].height +
+                                                  header->tile_size - 1) / header->tile_size))
+    {
+      PLAYER_ERROR2("[%s] has invalid dimensions at level %u", filename, k);
+      return -1;
+    }
+    size = (uint64_t) header->levels[k].tiles_x * header->levels[k].tiles_y *
+      header->tile_size * header->tile_size;
+    if (header->levels[k].offset > map->length ||
+        size > map->length - header->levels[k].offset)
+    {
+      PLAYER_ERROR2("[%s] is truncated or corrupt at level %u", filename, k);
+      return -1;
+    }
+    map->levels[k].width = header->levels[k].width;
+    map->levels[k].height = header->levels[k].height;
+    map->levels[k].tiles_x = header->levels[k].tiles_x;
+    map->levels[k].tiles_y = header->levels[k].tiles_y;
+    map->levels[k].scale = header->scale * (1 << k);
+    map->levels[k].tiles = (const int8_t*) map->base + header->levels[k].offset;
+  }
+  return 0;
+}
+
+
+// Map the file into memory.  Where there is no mmap, read it.
+static int tiledmap_map(player_tiledmap_t *map, const char *filename, size_t length)
+{
+#if defined (WIN32)
+  FILE *file;
+
+  if ((file = fopen(filename, "rb")) == NULL ||
+      (map->base = malloc(length)) == NULL ||
+      fread(map->base, 1, length, file) != length)
+  {
+    PLAYER_ERROR2("unable to read [%s]: %s", filename, strerror(errno));
+    if (file)
+      fclose(file);
+    free(map->base);
+    return -1;
+  }
+  fclose(file);
+#else
+  int fd;
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return -1;
+  }
+  map->base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map->base == MAP_FAILED)
+  {
+    PLAYER_ERROR2("unable to map [%s]: %s", filename, strerror(errno));
+    return -1;
+  }
+#endif
+  map->length = length;
+  return 0;
+}
+
+
+static void tiledmap_unmap(player_tiledmap_t *map)
+{
+#if defined (WIN32)
+  free(map->base);
+#else
+  munmap(map->base, map->length);
+#endif
+}
+
+
+// Open a tiled map file, or share it if it is already open
+player_tiledmap_t *player_tiledmap_open(const char *filename)
+{
+  struct stat st;
+  player_tiledmap_t *map;
+
+  if (stat(filename, &st) != 0)
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return NULL;
+  }
+
+  // Windows has no inode numbers to tell files apart by, so there each
+  // open reads its own copy
+  pthread_mutex_lock(&tiledmap_open_lock);
+  map = NULL;
+#if !defined (WIN32)
+  for (map = tiledmap_open_list; map; map = map->next)
+  {
+    if (map->dev == (uint64_t) st.st_dev && map->ino == (uint64_t) st.st_ino)
+      break;
+  }
+#endif
+  if (map)
+    map->refs++;
+  else if ((map = calloc(1, sizeof(player_tiledmap_t))) != NULL)
+  {
+    map->dev = st.st_dev;
+    map->ino = st.st_ino;
+    if (tiledmap_map(map, filename, (size_t) st.st_size) != 0)
+    {
+      free(map);
+      map = NULL;
+    }
+    else if (tiledmap_parse(map, filename) != 0)
+    {
+      tiledmap_unmap(map);
+      free(map);
+      map = NULL;
+    }
+    else
+    {
+      map->refs = 1;
+      map->next = tiledmap_open_list;
+      tiledmap_open_list = map;
+    }
+  }
+  pthread_mutex_unlock(&tiledmap_open_lock);
+  return map;
+}
+
+
+// Close a tiled map file; the last close unmaps it
+void player_tiledmap_close(player_tiledmap_t *map)
+{
+  player_tiledmap_t **p;
+
+  pthread_mutex_lock(&tiledmap_open_lock);
+  if (--map->refs == 0)
+  {
+    for (p = &tiledmap_open_list; *p != map; p = &(*p)->next);
+    *p = map->next;
+    tiledmap_unmap(map);
+    free(map);
+  }
+  pthread_mutex_unlock(&tiledmap_open_lock);
+}
+
+
+// The cells of a tile
+const int8_t *player_tiledmap_tile(const player_tiledmap_t *map, int level, int tx, int ty)
+{
+  const player_tiledmap_level_t *l;
+
+  l = map->levels + level;
+  return l->tiles + ((size_t) ty * l->tiles_x + tx) * map->tile_size * map->tile_size;
+}
+
+
+// Copy a block of a level, a row of tiles at a time
+void player_tiledmap_read(const player_tiledmap_t *map, int level,
+                          int col, int row, int width, int height, int8_t *cells)
+{
+  int r, i, n, size;
+  const player_tiledmap_level_t *l;
+  const int8_t *tile;
+  int8_t *out;
+
+  l = map->levels + level;
+  size = map->tile_size;
+  for (r = 0; r < height; r++)
+  {
+    out = cells + (size_t) r * width;
+    if (row + r < 0 || row + r >= (int) l->height)
+    {
+      memset(out, 0, width);
+      continue;
+    }
+    for (i = col; i < col + width; i += n)
+    {
+      if (i < 0)
+      {
+        n = (col + width < 0 ? col + width : 0) - i;
+        memset(out + (i - col), 0, n);
+      }
+      else if (i >= (int) l->width)
+      {
+        n = col + width - i;
+        memset(out + (i - col), 0, n);
+      }
+      else
+      {
+        // The rest of this tile's row, up to the end of the block or level
+        n = size - i % size;
+        if (n > col + width - i)
+          n = col + width - i;
+        if (n > (int) l->width - i)
+          n = l->width - i;
+        tile = player_tiledmap_tile(map, level, i / size, (row + r) / size);
+        memcpy(out + (i - col), tile + (size_t) ((row + r) % size) * size + i % size, n);
+      }
+    }
+  }
+}
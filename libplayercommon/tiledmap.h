@@ -0,0 +1,151 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/***************************************************************************
+ * Desc: Tiled, multi-resolution occupancy grid files
+ * CVS: $Id$
+ **************************************************************************/
+
+#ifndef PLAYER_TILEDMAP_H
+#define PLAYER_TILEDMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCOMMON_EXPORT
+  #elif defined (playercommon_EXPORTS)
+    #define PLAYERCOMMON_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCOMMON_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCOMMON_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @ingroup libplayercommon
+ @{ */
+
+/** @brief Tiled map files
+
+A tiled map file holds an occupancy grid (-1 free, 0 unknown, +1
+occupied, as in the @ref interface_map interface) cut into square tiles,
+together with a pyramid of coarser levels.  Each level has half the
+resolution of the one below it; a cell is occupied if any of the four
+cells under it is, else unknown if any is, else free.  The top level fits
+in one tile.
+
+Tiles are stored whole, one after the other in row-major order, starting
+on page boundaries, and the cells within a tile are row-major with row 0
+at the bottom of the map.  The file is mapped into memory rather than
+read, so only the tiles that are used are ever loaded, and the pages are
+shared by everything that maps the file.
+
+Files are written in the byte order of the host, and cannot be read on a
+host of the other byte order. */
+
+/// Levels in the pyramid, at most
+#define PLAYER_TILEDMAP_MAX_LEVELS 16
+
+/// Default size of the side of a tile [cells]
+#define PLAYER_TILEDMAP_DEFAULT_TILE_SIZE 256
+
+/// One level of a tiled map
+typedef struct
+{
+  /// Size of the level [cells]
+  uint32_t width, height;
+  /// Number of tiles across and up the level
+  uint32_t tiles_x, tiles_y;
+  /// Size of a cell [m]
+  double scale;
+  /// The tiles
+  const int8_t *tiles;
+} player_tiledmap_level_t;
+
+/// An open tiled map file
+typedef struct player_tiledmap
+{
+  /// Size of the side of a tile [cells]
+  uint32_t tile_size;
+  /// Number of levels; level 0 is the full resolution
+  uint32_t level_count;
+  /// The levels
+  player_tiledmap_level_t levels[PLAYER_TILEDMAP_MAX_LEVELS];
+  /// The real-world pose of cell (0,0) [m, m, rad]
+  double origin[3];
+
+  // The mapping, and how many times it has been opened
+  void *base;
+  size_t length;
+  int refs;
+  uint64_t dev, ino;
+  struct player_tiledmap *next;
+} player_tiledmap_t;
+
+/** @brief Write a tiled map file.
+
+cells[] is the full resolution grid, width x height cells, row-major with
+row 0 at the bottom; the coarser levels are computed from it.  tile_size
+must be a multiple of 64, so that every tile is a whole number of pages.
+
+Returns 0 on success, -1 on error. */
+PLAYERCOMMON_EXPORT int player_tiledmap_write(const char *filename,
+                                              const int8_t *cells,
+                                              int width, int height,
+                                              double scale, const double origin[3],
+                                              int tile_size);
+
+/** @brief Open a tiled map file.
+
+Opening a file that is already open in this process returns the same
+map, so its pages are shared; each open must be matched by a close.
+
+Returns NULL on error. */
+PLAYERCOMMON_EXPORT player_tiledmap_t *player_tiledmap_open(const char *filename);
+
+/// Close a tiled map file
+PLAYERCOMMON_EXPORT void player_tiledmap_close(player_tiledmap_t *map);
+
+/// The cells of a tile, tile_size x tile_size of them, row-major
+PLAYERCOMMON_EXPORT const int8_t *player_tiledmap_tile(const player_tiledmap_t *map,
+                                                       int level, int tx, int ty);
+
+/** @brief Copy a block of a level.
+
+Copies the width x height cells with lower-left corner at (col, row)
+into cells[], row-major.  Cells off the level are unknown (0). */
+PLAYERCOMMON_EXPORT void player_tiledmap_read(const player_tiledmap_t *map, int level,
+                                              int col, int row, int width, int height,
+                                              int8_t *cells);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1749,12 +1749,23 @@ uint32_t ConfigFile::ReadColor(int section, const char *name, uint32_t value)
 // If the filename is entered as a relative path, we prepend
 // the world files path to it.
 const char *ConfigFile::ReadFilename(int section, const char *name, const char *value)
+{
+  return ReadTupleFilename(section, name, 0, value);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Read a file name from a tuple; made absolute as for ReadFilename.
+const char *ConfigFile::ReadTupleFilename(int section, const char *name,
+                                          int index, const char *value)
 {
   int field = GetField(section, name);
   if (field < 0)
     return value;
 
-  const char *filename = GetFieldValue(field, 0);
+  const char *filename = GetFieldValue(field, index);
+  if (!filename)
+    return value;
 
   if( filename[0] == '/' || filename[0] == '~' )
     return filename;
@@ -1772,7 +1783,7 @@ const char *ConfigFile::ReadFilename(int section, const char *name, const char *
     strcat( fullpath, filename );
     assert(strlen(fullpath) + 1 < MAX_FILENAME_SIZE);
 
-    SetFieldValue(field, 0, fullpath);
+    SetFieldValue(field, index, fullpath);
 
     free(fullpath);
     free(tmp);
@@ -1798,13 +1809,13 @@ const char *ConfigFile::ReadFilename(int section, const char *name, const char *
     strcat( fullpath, filename );
     assert(strlen(fullpath) + 1 < MAX_FILENAME_SIZE);
 
-    SetFieldValue(field, 0, fullpath);
+    SetFieldValue(field, index, fullpath);
 
     free(fullpath);
     free(tmp);
   }
 
-  filename = GetFieldValue(field, 0);
+  filename = GetFieldValue(field, index);
   assert(filename[0] == '/' || filename[0] == '~');
 
   return filename;
@@ -2268,6 +2279,21 @@ ConfigFile::ParseDriver(int section)
   if (driver)
     driver->alwayson = this->ReadInt(section, "alwayson", driver->alwayson) ? true : false;
 
+  // Storage for the driver's incoming queue, if not the server default
+  const char *backend = this->ReadString(section, "queue_backend", NULL);
+  if (backend != NULL)
+  {
+    if (strcmp(backend, "pool") == 0)
+      driver->InQueue->SetBackend(PLAYER_MSGQUEUE_BACKEND_POOL);
+    else if (strcmp(backend, "list") == 0)
+      driver->InQueue->SetBackend(PLAYER_MSGQUEUE_BACKEND_LIST);
+    else
+    {
+      PLAYER_ERROR2("unknown queue_backend \"%s\" for driver \"%s\"", backend, drivername);
+      return false;
+    }
+  }
+
   return true;
 }
 
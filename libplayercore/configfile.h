@@ -358,6 +358,20 @@ class PLAYERCORE_EXPORT ConfigFile
                                       const char *name,
                                       int index, 
                                       const char *value);
+
+  /// @brief Read a filename from a tuple field
+  ///
+  /// Always returns an absolute path, as for ReadFilename().
+  ///
+  /// @param section Section to read.
+  /// @param name Field name
+  /// @param index Tuple index (zero-based)
+  /// @param value Default value if the field is not present in the file.
+  /// @returns Returns the tuple element value.
+  public: const char *ReadTupleFilename(int section,
+                                        const char *name,
+                                        int index,
+                                        const char *value);
   
   // Write a string to a tuple
   private: void WriteTupleString(int section, 
@@ -65,6 +65,7 @@
 // Constructor
 Device::Device(player_devaddr_t addr, Driver *device) :
 	next(NULL),
+	hash_next(NULL),
 	addr(addr),
 	driver(device)
 {
@@ -126,26 +127,37 @@ Device::Subscribe(QueuePointer &sub_queue)
   // add the subscriber's queue to the list
   this->queues[i] = sub_queue;
 
+  // Don't hold the lock while the driver sets up; clients on other threads
+  // may be subscribing too, and the driver may publish from Setup().
+  Unlock();
+
   if(this->driver)
   {
     // first try the new version which passes the queue in
     retval = this->driver->Subscribe(sub_queue, this->addr);
-    if (retval < 0)
+    if(retval == 1)
+      retval = this->driver->Subscribe(this->addr);
+    else if(retval > 0)
+      retval = 0;
+    if(retval != 0)
     {
       // remove the subscriber's queue, since the subscription failed
-      this->queues[i] = QueuePointer();
-      Unlock();
-      return(retval);
-    }
-    else if(retval == 1 && (retval = this->driver->Subscribe(this->addr)))
-    {
-      // remove the subscriber's queue, since the subscription failed
-      this->queues[i] = QueuePointer();
+      Lock();
+      for(i=0;i<this->len_queues;i++)
+      {
+        if(this->queues[i] == sub_queue)
+        {
+          this->queues[i] = QueuePointer();
+          break;
+        }
+      }
       Unlock();
       return(retval);
     }
+    // the server loop polls while such drivers are subscribed
+    if(this->driver->alwaysupdate)
+      deviceTable->CountAlwaysUpdate(1);
   }
-  Unlock();
 
   return(0);
 }
@@ -167,6 +179,8 @@ Device::Unsubscribe(QueuePointer &sub_queue)
     {
       return(retval);
     }
+    if(this->driver->alwaysupdate)
+      deviceTable->CountAlwaysUpdate(-1);
   }
   Lock();
   // look for the given queue
@@ -183,6 +197,31 @@ Device::Unsubscribe(QueuePointer &sub_queue)
   return(-1);
 }
 
+double
+Device::GetBacklog(uint8_t type, uint8_t subtype)
+{
+  player_msghdr_t hdr;
+  double fill, backlog;
+
+  memset(&hdr,0,sizeof(hdr));
+  hdr.addr = this->addr;
+  hdr.type = type;
+  hdr.subtype = subtype;
+
+  backlog = 0.0;
+  Lock();
+  for(size_t i=0;i<this->len_queues;i++)
+  {
+    if(this->queues[i] == NULL)
+      continue;
+    fill = this->queues[i]->GetBacklog(&hdr);
+    if(fill > backlog)
+      backlog = fill;
+  }
+  Unlock();
+  return(backlog);
+}
+
 void
 Device::PutMsg(QueuePointer &resp_queue,
                player_msghdr_t* hdr,
@@ -319,18 +358,19 @@ Device::TimedRequest(QueuePointer &resp_queue,
     
     for(;;)
     {
-      // We don't lock here, on the assumption that the caller is also the only
-      // thread that can make changes to the device table.
-      for(Device* dev = deviceTable->GetFirstDevice();
+      // Other threads may be adding devices meanwhile
+      Device* last;
+      for(Device* dev = deviceTable->GetFirstDevice(&last);
           dev;
-          dev = deviceTable->GetNextDevice(dev))
+          dev = deviceTable->GetNextDevice(dev, last))
       {
         Driver* dri = dev->driver;
         // don't update the requester
         if(!dri || dev->InQueue == resp_queue)
           continue;
-        if(((dri->HasSubscriptions()) || dri->alwayson))
-          dri->Update();
+        // a driver another thread is updating is left to it, so that two
+        // threads waiting on requests cannot wait on each other
+        dri->UpdateIfReady(false);
       }
 
       // Wait until the message arrives in the response queue
@@ -93,6 +93,18 @@ class PLAYERCORE_EXPORT Device
     /// @returns 0 on success, non-zero otherwise.
     int Unsubscribe(QueuePointer &sub_queue);
 
+    /// @brief How close a message would come to being lost by the
+    /// subscribers, were it published now.
+    ///
+    /// @param type : Message type
+    /// @param subtype : Message subtype
+    ///
+    /// @returns The greatest MessageQueue::GetBacklog() of the subscribed
+    /// queues (0 if there are none).  Drivers that can produce data as
+    /// fast as they like, such as @ref driver_readlog, use this to keep
+    /// pace with their clients.
+    double GetBacklog(uint8_t type, uint8_t subtype);
+
     /// @brief Send a message to this device.
     ///
     /// This method is the basic way of sending a message to a device.  The
@@ -217,6 +229,9 @@ class PLAYERCORE_EXPORT Device
     /// Next entry in the device table (this is a linked-list)
     Device* next;
 
+    /// Next entry in the same device table hash bucket
+    Device* hash_next;
+
     /// Address for this device
     player_devaddr_t addr;
 
@@ -237,6 +252,9 @@ class PLAYERCORE_EXPORT Device
     Driver* driver;
 
   private:
+    // Driver::Publish() locks us while walking the subscribed queues
+    friend class Driver;
+
     /** @brief Mutex used to lock access, via Lock() and Unlock(), to
     device internals, like the list of subscribed queues. */
     pthread_mutex_t accessMutex;
@@ -44,6 +44,7 @@
  */
 #include <string.h> // for strncpy(3)
 #include <stdlib.h> // for atoi(3)
+#include <assert.h>
 
 #include <libplayercommon/playercommon.h>
 #include <libplayerinterface/interface_util.h>
@@ -54,12 +55,32 @@
   #define strdup _strdup
 #endif
 
+// initial number of hash buckets; must be a power of two
+#define DEVICETABLE_MIN_BUCKETS 64
+
+// Hash a device address.  Hosts 0 and LOCALHOST_ADDR hash alike, because
+// Device::MatchDeviceAddress treats them as the same host.
+static unsigned int
+devicetable_hash(player_devaddr_t addr)
+{
+  uint32_t host = (addr.host == 0) ? LOCALHOST_ADDR : addr.host;
+  uint32_t h = host * 2654435761U;
+  h = (h ^ addr.robot) * 2654435761U;
+  h = (h ^ ((uint32_t)addr.interf << 16) ^ addr.index) * 2654435761U;
+  return(h ^ (h >> 16));
+}
+
 // initialize the table
 DeviceTable::DeviceTable()
 {
   this->numdevices = 0;
   this->head = NULL;
+  this->tail = NULL;
+  this->num_buckets = DEVICETABLE_MIN_BUCKETS;
+  this->buckets = (Device**)calloc(this->num_buckets, sizeof(Device*));
+  assert(this->buckets);
   pthread_mutex_init(&this->mutex,NULL);
+  this->num_alwaysupdate = 0;
   this->remote_driver_fn = NULL;
   this->remote_driver_arg = NULL;
 }
@@ -83,31 +104,70 @@ DeviceTable::~DeviceTable()
     numdevices--;
     thisentry = tmpentry;
   }
+  head = tail = NULL;
+  free(buckets);
+  buckets = NULL;
   pthread_mutex_unlock(&mutex);
 
   // destroy the mutex.
   pthread_mutex_destroy(&mutex);
 }
 
+Device*
+DeviceTable::FindDevice(player_devaddr_t addr)
+{
+  Device* thisentry;
+  for(thisentry = this->buckets[devicetable_hash(addr) & (this->num_buckets-1)];
+      thisentry; thisentry = thisentry->hash_next)
+  {
+    if(Device::MatchDeviceAddress(thisentry->addr, addr))
+      break;
+  }
+  return(thisentry);
+}
+
+void
+DeviceTable::IndexDevice(Device* dev)
+{
+  // Keep the load factor at or below 1 by doubling the bucket array and
+  // rehashing from the ordered list.
+  if(this->numdevices >= (int)this->num_buckets)
+  {
+    unsigned int len = this->num_buckets * 2;
+    Device** newbuckets = (Device**)calloc(len, sizeof(Device*));
+    if(newbuckets)
+    {
+      free(this->buckets);
+      this->buckets = newbuckets;
+      this->num_buckets = len;
+      for(Device* entry = this->head; entry; entry = entry->next)
+      {
+        if(entry == dev)
+          continue;
+        unsigned int b = devicetable_hash(entry->addr) & (len-1);
+        entry->hash_next = this->buckets[b];
+        this->buckets[b] = entry;
+      }
+    }
+  }
+
+  unsigned int b = devicetable_hash(dev->addr) & (this->num_buckets-1);
+  dev->hash_next = this->buckets[b];
+  this->buckets[b] = dev;
+}
+
 // this is the 'base' AddDevice method, which sets all the fields
 Device*
 DeviceTable::AddDevice(player_devaddr_t addr,
                        Driver* driver, bool havelock)
 {
   Device* thisentry;
-  Device* preventry;
 
   if(!havelock)
     pthread_mutex_lock(&mutex);
 
   // Check for duplicate entries (not allowed)
-  for(thisentry = head,preventry=NULL; thisentry;
-      preventry=thisentry, thisentry=thisentry->next)
-  {
-    if(Device::MatchDeviceAddress(thisentry->addr, addr))
-      break;
-  }
-  if(thisentry)
+  if(this->FindDevice(addr))
   {
     PLAYER_ERROR4("duplicate device addr %X:%d:%s:%d",
                   addr.host, addr.robot,
@@ -121,10 +181,12 @@ DeviceTable::AddDevice(player_devaddr_t addr,
   // Create a new device entry
   thisentry = new Device(addr, driver);
   thisentry->next = NULL;
-  if(preventry)
-    preventry->next = thisentry;
+  if(tail)
+    tail->next = thisentry;
   else
     head = thisentry;
+  tail = thisentry;
+  this->IndexDevice(thisentry);
   numdevices++;
 
   if(!havelock)
@@ -142,11 +204,7 @@ DeviceTable::GetDevice(player_devaddr_t addr, bool lookup_remote)
 
   Device* thisentry;
   pthread_mutex_lock(&mutex);
-  for(thisentry=head;thisentry;thisentry=thisentry->next)
-  {
-    if(Device::MatchDeviceAddress(thisentry->addr, addr))
-      break;
-  }
+  thisentry = this->FindDevice(addr);
 
   // If we didn't find the device, give the application's remote device
   // handler a try
@@ -155,19 +213,13 @@ DeviceTable::GetDevice(player_devaddr_t addr, bool lookup_remote)
     Driver* rdriver = (*this->remote_driver_fn)(addr,this->remote_driver_arg);
     if(rdriver != NULL)
     {
-      if(this->AddDevice(addr, rdriver, true) == NULL)
+      if((thisentry = this->AddDevice(addr, rdriver, true)) == NULL)
       {
         PLAYER_ERROR("failed to add remote device");
         delete rdriver;
       }
       else
       {
-        for(thisentry=head;thisentry;thisentry=thisentry->next)
-        {
-          if(Device::MatchDeviceAddress(thisentry->addr, addr))
-            break;
-        }
-        assert(thisentry);
         strncpy(thisentry->drivername, "remote",
                 sizeof(thisentry->drivername));
       }
@@ -236,6 +288,17 @@ DeviceTable::GetDevice(const char* str_addr,
   return(this->GetDevice(addr,lookup_remote));
 }
 
+Device*
+DeviceTable::GetFirstDevice(Device** last)
+{
+  Device* first;
+  pthread_mutex_lock(&mutex);
+  first = this->head;
+  *last = this->tail;
+  pthread_mutex_unlock(&mutex);
+  return(first);
+}
+
 // Call Update() on each driver with non-zero subscriptions
 //
 // NOTE: this will call Update() once for each subscribed interface to a
@@ -244,26 +307,49 @@ void
 DeviceTable::UpdateDevices()
 {
   Device* thisentry;
+  Device* last;
   Driver* dri;
 
-  // We don't lock here, on the assumption that the caller is also the only
-  // thread that can make changes to the device table.
-  for(thisentry=head;thisentry;thisentry=thisentry->next)
+  // Clients on I/O threads may be adding devices meanwhile
+  for(thisentry=this->GetFirstDevice(&last);thisentry;
+      thisentry=this->GetNextDevice(thisentry,last))
   {
     dri = thisentry->driver;
-    if((dri->HasSubscriptions()) || dri->alwayson)
-      dri->Update();
+    if(!(dri->HasSubscriptions()) && !dri->alwayson)
+      continue;
+    // Drivers with several interfaces have an entry for each; once the
+    // first has drained the queue the others are skipped.
+    if(dri->alwaysupdate || !dri->InQueue->Empty())
+      dri->UpdateIfReady();
   }
 }
 
+bool
+DeviceTable::HaveAlwaysUpdateDrivers()
+{
+  bool have;
+  pthread_mutex_lock(&mutex);
+  have = (this->num_alwaysupdate > 0);
+  pthread_mutex_unlock(&mutex);
+  return(have);
+}
+
+void
+DeviceTable::CountAlwaysUpdate(int change)
+{
+  pthread_mutex_lock(&mutex);
+  this->num_alwaysupdate += change;
+  pthread_mutex_unlock(&mutex);
+}
+
 int
 DeviceTable::StartAlwaysonDrivers()
 {
   Device* thisentry;
+  Device* last;
 
-  // We don't lock here, on the assumption that the caller is also the only
-  // thread that can make changes to the device table.
-  for(thisentry=head;thisentry;thisentry=thisentry->next)
+  for(thisentry=this->GetFirstDevice(&last);thisentry;
+      thisentry=this->GetNextDevice(thisentry,last))
   {
     if(thisentry->driver->alwayson)
     {
@@ -283,10 +369,10 @@ int
 DeviceTable::StopAlwaysonDrivers()
 {
   Device* thisentry;
+  Device* last;
 
-  // We don't lock here, on the assumption that the caller is also the only
-  // thread that can make changes to the device table.
-  for(thisentry=head;thisentry;thisentry=thisentry->next)
+  for(thisentry=this->GetFirstDevice(&last);thisentry;
+      thisentry=this->GetNextDevice(thisentry,last))
   {
     if(thisentry->driver->alwayson)
     {
@@ -69,11 +69,28 @@ typedef Driver* (*remote_driver_fn_t) (player_devaddr_t addr, void* arg);
 class PLAYERCORE_EXPORT DeviceTable
 {
   private:
-    // we'll keep the device info here.
+    // we'll keep the device info here, in the order the devices were
+    // added.
     Device* head;
+    Device* tail;
     int numdevices;
     pthread_mutex_t mutex;
 
+    // Number of subscriptions to drivers marked 'alwaysupdate'
+    int num_alwaysupdate;
+
+    // Hash index over the same devices, chained through Device::hash_next.
+    // The number of buckets is always a power of two and grows with the
+    // table, so lookups stay O(1).
+    Device** buckets;
+    unsigned int num_buckets;
+
+    // Find a device in the hash index; the caller must hold the mutex.
+    Device* FindDevice(player_devaddr_t addr);
+    // Add a device to the hash index, growing it if needed; the caller
+    // must hold the mutex.
+    void IndexDevice(Device* dev);
+
     // A factory creation function that the application can set (via
     // AddRemoteDevice).  It will be called when GetDevice fails to find a
     // device in the deviceTable
@@ -107,13 +124,30 @@ class PLAYERCORE_EXPORT DeviceTable
     // Get the next device entry.
     Device *GetNextDevice(Device *entry) {return entry->next;}
 
+    // Get the first device entry, and the last one there is now, for
+    // walking the table while other threads may add devices.  Devices are
+    // only ever appended, so the entries up to the last stay as they are.
+    Device *GetFirstDevice(Device **last);
+
+    // Get the next device entry, up to the last one.
+    Device *GetNextDevice(Device *entry, Device *last)
+      {return (entry == last) ? NULL : entry->next;}
+
     // Return the number of devices
     int Size() {return(numdevices);}
 
-    // Call ProcessMessages() on each non-threaded driver with non-zero
-    // subscriptions
+    // Call Update() on each driver with non-zero subscriptions that has
+    // messages waiting or is marked 'alwaysupdate'
     void UpdateDevices();
 
+    // Check whether any driver with non-zero subscriptions is marked
+    // 'alwaysupdate', i.e. whether the server loop has to keep polling.
+    bool HaveAlwaysUpdateDrivers();
+
+    // Add to the count of subscriptions to drivers marked 'alwaysupdate';
+    // Device calls this as it subscribes (1) and unsubscribes (-1).
+    void CountAlwaysUpdate(int change);
+
     // Subscribe to each device whose driver is marked 'alwayson'.  Returns
     // 0 on success, -1 on error (at least one driver failed to start).
     //
@@ -74,6 +74,8 @@ Driver::Driver(ConfigFile *cf, int section,
                int interf) : InQueue(overwrite_cmds, queue_maxlen)
 {
   this->error = 0;
+  // the server loop updates us when messages arrive
+  this->InQueue->SetWakeWatcher(fileWatcher);
 
   // Look for our default device id
   if(cf->ReadDeviceAddr(&this->device_addr, section, "provides",
@@ -86,7 +88,9 @@ Driver::Driver(ConfigFile *cf, int section,
 
   this->subscriptions = 0;
   this->entries = 0;
+  this->num_cached_devices = 0;
   this->alwayson = false;
+  this->alwaysupdate = false;
 
   // Create an interface
   if(this->AddInterface(this->device_addr) != 0)
@@ -97,6 +101,7 @@ Driver::Driver(ConfigFile *cf, int section,
 
   pthread_mutex_init(&this->accessMutex,NULL);
   pthread_mutex_init(&this->subscriptionMutex,NULL);
+  this->InitUpdateMutex();
 }
 
 // this is the other constructor, used by multi-interface drivers.
@@ -109,27 +114,51 @@ Driver::Driver(ConfigFile *cf, int section,
 
   this->subscriptions = 0;
   this->alwayson = false;
+  this->alwaysupdate = false;
   this->entries = 0;
+  this->num_cached_devices = 0;
+  this->InQueue->SetWakeWatcher(fileWatcher);
 
   pthread_mutex_init(&this->accessMutex,NULL);
   pthread_mutex_init(&this->subscriptionMutex,NULL);
+  this->InitUpdateMutex();
 }
 
 // destructor, to free up allocated queue.
 Driver::~Driver()
 {
+  pthread_mutex_destroy(&this->updateMutex);
+}
+
+void Driver::InitUpdateMutex()
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&this->updateMutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+  this->setups = 0;
 }
 
 // Add an interface
 int
 Driver::AddInterface(player_devaddr_t addr)
 {
+  Device* dev;
+
   // Add ourself to the device table
-  if(deviceTable->AddDevice(addr, this) == NULL)
+  if((dev = deviceTable->AddDevice(addr, this)) == NULL)
   {
     PLAYER_ERROR("failed to add interface");
     return -1;
   }
+  // Remember the entry for Publish; interfaces beyond the cache size are
+  // looked up in the device table instead.
+  if(this->num_cached_devices < PLAYER_DRIVER_MAX_CACHED_DEVICES)
+  {
+    this->cached_devices[this->num_cached_devices] = dev;
+    this->num_cached_devices++;
+  }
   return 0;
 }
 
@@ -168,22 +197,33 @@ void
 Driver::Publish(player_msghdr_t* hdr,
                 void* src, bool copy)
 {
-  Device* dev;
+  Device* dev = NULL;
+
+  // Interfaces we provide are resolved from our own cache; anything else
+  // (e.g. devices added on behalf of a remote driver) goes to the table.
+  for(int i=0;i<this->num_cached_devices;i++)
+  {
+    if(Device::MatchDeviceAddress(this->cached_devices[i]->addr, hdr->addr))
+    {
+      dev = this->cached_devices[i];
+      break;
+    }
+  }
 
-  // lock here, because we're accessing our device's queue list
-  this->Lock();
   // push onto each queue subscribed to the given device
-  if(!(dev = deviceTable->GetDevice(hdr->addr,false)))
+  if(!dev && !(dev = deviceTable->GetDevice(hdr->addr,false)))
   {
     // This is generally ok, because a driver might call Publish on all
     // of its possible interfaces, even though some have not been
     // requested.
     //
     //PLAYER_ERROR2("tried to publish message via non-existent device %d:%d", hdr->addr.interf, hdr->addr.index);
-    this->Unlock();
     return;
   }
   Message msg(*hdr,src,InQueue,copy);
+  // lock the device, because we're accessing its queue list, which
+  // clients may be changing from other threads
+  dev->Lock();
   for(size_t i=0;i<dev->len_queues;i++)
   {
     if(dev->queues[i] != NULL)
@@ -196,7 +236,7 @@ Driver::Publish(player_msghdr_t* hdr,
       }
     }
   }
-  this->Unlock();
+  dev->Unlock();
 }
 
 void
@@ -276,6 +316,39 @@ void Driver::SubscriptionUnlock()
   pthread_mutex_unlock(&subscriptionMutex);
 }
 
+void Driver::BeginSetup()
+{
+  pthread_mutex_lock(&updateMutex);
+  this->setups++;
+  pthread_mutex_unlock(&updateMutex);
+}
+
+void Driver::EndSetup()
+{
+  pthread_mutex_lock(&updateMutex);
+  this->setups--;
+  pthread_mutex_unlock(&updateMutex);
+  // Messages may have come while Update() was held off
+  if(!this->InQueue->Empty())
+    this->InQueue->DataAvailable();
+}
+
+bool Driver::UpdateIfReady(bool wait)
+{
+  bool updated = false;
+  if(wait)
+    pthread_mutex_lock(&updateMutex);
+  else if(pthread_mutex_trylock(&updateMutex) != 0)
+    return(false);
+  if(!this->setups && (this->HasSubscriptions() || this->alwayson))
+  {
+    this->Update();
+    updated = true;
+  }
+  pthread_mutex_unlock(&updateMutex);
+  return(updated);
+}
+
 bool Driver::HasSubscriptions()
 {
 	return subscriptions > 0;
@@ -284,7 +357,17 @@ bool Driver::HasSubscriptions()
 int Driver::Subscribe(player_devaddr_t addr)
 {
   int setupResult;
+  bool setting_up = false;
   SubscriptionLock();
+  // Setup() must not run alongside Update().  Wait for that without
+  // holding the count, which those subscribing from Update() may need.
+  while(subscriptions == 0 && !setting_up)
+  {
+    SubscriptionUnlock();
+    this->BeginSetup();
+    setting_up = true;
+    SubscriptionLock();
+  }
   if(subscriptions == 0)
   {
     setupResult = Setup();
@@ -297,13 +380,24 @@ int Driver::Subscribe(player_devaddr_t addr)
     setupResult = 0;
   }
   SubscriptionUnlock();
+  if(setting_up)
+    this->EndSetup();
   return(setupResult);
 }
 
 int Driver::Unsubscribe(player_devaddr_t addr)
 {
   int shutdownResult;
+  bool shutting_down = false;
   SubscriptionLock();
+  // As for Setup(), keep Shutdown() apart from Update()
+  while(subscriptions == 1 && !shutting_down)
+  {
+    SubscriptionUnlock();
+    this->BeginSetup();
+    shutting_down = true;
+    SubscriptionLock();
+  }
   if(subscriptions == 0)
     shutdownResult = -1;
   else if ( subscriptions == 1)
@@ -317,6 +411,8 @@ int Driver::Unsubscribe(player_devaddr_t addr)
     shutdownResult = 0;
   }
   SubscriptionUnlock();
+  if(shutting_down)
+    this->EndSetup();
   return( shutdownResult );
 }
 
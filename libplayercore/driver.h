@@ -95,8 +95,14 @@ capability.
   }
 
 
+/** Number of provided interfaces for which a driver caches the resolved
+    device table entry; see Driver::Publish. */
+#define PLAYER_DRIVER_MAX_CACHED_DEVICES 32
+
 // Forward declarations
 class ConfigFile;
+class Device;
+class MapGrid;
 
 /**
 @brief Base class for all drivers.
@@ -116,9 +122,28 @@ class PLAYERCORE_EXPORT Driver
 
     /** @brief Number of subscriptions to this driver. */
 	int subscriptions;
+
+    /** @brief Device table entries for the interfaces added through
+    AddInterface, so that Publish can find them without a table lookup.
+    Entries are only ever appended, and devices are not removed from the
+    table while the driver exists, so the array is read without locking. */
+    Device* cached_devices[PLAYER_DRIVER_MAX_CACHED_DEVICES];
+    /** @brief Number of valid entries in @p cached_devices. */
+    volatile int num_cached_devices;
   public:
     bool HasSubscriptions();
 
+    /** @brief Call Update() if the driver is subscribed (or always on)
+    and is not being set up or shut down.
+
+    Clients may subscribe from I/O threads other than the server thread,
+    so Setup() and Shutdown() may be running on another thread; they are
+    never run alongside Update().  If @p wait is false, nor does this wait
+    for another thread that is updating the driver.
+
+    @returns true if Update() was called. */
+    bool UpdateIfReady(bool wait = true);
+
   protected:
 
     /** @brief Add an interface.
@@ -168,6 +193,19 @@ class PLAYERCORE_EXPORT Driver
     pthread_mutex_t accessMutex;
     /** @brief Mutex used to protect the subscription count for the driver. */
     pthread_mutex_t subscriptionMutex;
+    /** @brief Mutex held while Update() runs, and guarding @p setups.
+    It is recursive, as Update() may subscribe to the driver's own
+    devices. */
+    pthread_mutex_t updateMutex;
+    /** @brief Number of Setup() and Shutdown() calls running.  No lock
+    is held while they run, so that they can subscribe to other drivers
+    that are being updated meanwhile. */
+    int setups;
+    void InitUpdateMutex(void);
+    /** @brief Wait for any Update() to finish, then keep it from running
+    until EndSetup(). */
+    void BeginSetup(void);
+    void EndSetup(void);
   protected:
     /** @brief Lock access between the server and driver threads. In particular used
      * to procect the drivers thread pointer */
@@ -281,6 +319,14 @@ class PLAYERCORE_EXPORT Driver
     to reflect that setting). */
     bool alwayson;
 
+    /** @brief Always update flag.
+
+    The server loop only calls Update() on a driver when messages are
+    waiting on its InQueue.  Drivers whose Update() does other work, such
+    as polling a device or other queues, should set this flag so that
+    Update() is called on every pass of the server loop instead. */
+    bool alwaysupdate;
+
     /** @brief Queue for all incoming messages for this driver */
     QueuePointer InQueue;
 
@@ -458,6 +504,17 @@ class PLAYERCORE_EXPORT Driver
     virtual bool RegisterProperty(Property *property, 
                                   ConfigFile* cf, 
                                   int section);
+
+    /** @brief Share a map grid.
+
+    Map drivers that hold their whole grid in memory should reimplement
+    this to return a new reference to the grid behind the map interface
+    @p addr, so that other drivers in the server can use it in place of
+    fetching it in tiles; see MapGrid::Fetch().  It may be called from
+    any thread, while the caller is subscribed to @p addr.
+
+    @returns A new reference to the grid, or NULL if it is not shared. */
+    virtual MapGrid * GetMapGrid(player_devaddr_t /*addr*/) {return NULL;};
 };
 
 typedef enum player_thread_state
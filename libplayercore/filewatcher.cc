@@ -26,6 +26,8 @@
  *      Author: tcollett
  */
 
+#include <config.h>
+
 #include <libplayercommon/playercommon.h>
 
 
@@ -35,12 +37,21 @@
 #include <assert.h>
 #include <math.h>
 #include <string.h>
+#include <errno.h>
 #if defined (WIN32)
   #include <windows.h>
 #else
   #include <sys/time.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+#endif
+#if HAVE_SYS_EPOLL_H
+  #include <sys/epoll.h>
 #endif
 
+// Most events collected by one epoll_wait() call
+#define FILEWATCHER_MAX_EVENTS 64
+
 FileWatcher::FileWatcher()
 {
 	WatchedFilesArraySize = INITIAL_WATCHED_FILES_ARRAY_SIZE;
@@ -48,11 +59,52 @@ FileWatcher::FileWatcher()
 	WatchedFiles = reinterpret_cast<struct fd_driver_pair *> (calloc(WatchedFilesArraySize,sizeof(WatchedFiles[0])));
 	assert(WatchedFiles);
 	pthread_mutex_init(&this->lock,NULL);
+	pthread_mutex_init(&this->wakeLock,NULL);
 
+	EpollFd = -1;
+	WakeupPipe[0] = WakeupPipe[1] = -1;
+	WakeupPending = false;
+#if !defined (WIN32)
+	if (pipe(WakeupPipe) == 0)
+	{
+		fcntl(WakeupPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(WakeupPipe[1], F_SETFL, O_NONBLOCK);
+	}
+	else
+	{
+		PLAYER_WARN1("failed to create file watcher wakeup pipe: %s", strerror(errno));
+		WakeupPipe[0] = WakeupPipe[1] = -1;
+	}
+#endif
+#if HAVE_SYS_EPOLL_H
+	EpollFd = epoll_create(INITIAL_WATCHED_FILES_ARRAY_SIZE);
+	if (EpollFd < 0)
+	{
+		PLAYER_WARN1("epoll_create failed, falling back to select: %s", strerror(errno));
+	}
+	else if (WakeupPipe[0] >= 0)
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = WakeupPipe[0];
+		epoll_ctl(EpollFd, EPOLL_CTL_ADD, WakeupPipe[0], &ev);
+	}
+#endif
 }
 
 FileWatcher::~FileWatcher()
 {
+#if !defined (WIN32)
+	if (EpollFd >= 0)
+		close(EpollFd);
+	if (WakeupPipe[0] >= 0)
+	{
+		close(WakeupPipe[0]);
+		close(WakeupPipe[1]);
+	}
+#endif
+	pthread_mutex_destroy(&this->wakeLock);
 	free(WatchedFiles);
 }
 
@@ -66,17 +118,130 @@ void FileWatcher::Unlock()
   pthread_mutex_unlock(&lock);
 }
 
+void FileWatcher::Wakeup()
+{
+#if !defined (WIN32)
+	pthread_mutex_lock(&wakeLock);
+	if (!WakeupPending && WakeupPipe[1] >= 0)
+	{
+		char c = 0;
+		if (write(WakeupPipe[1], &c, 1) == 1)
+			WakeupPending = true;
+	}
+	pthread_mutex_unlock(&wakeLock);
+#endif
+}
+
+void FileWatcher::DrainWakeup()
+{
+#if !defined (WIN32)
+	char buf[16];
+	pthread_mutex_lock(&wakeLock);
+	while (read(WakeupPipe[0], buf, sizeof(buf)) > 0)
+		;
+	WakeupPending = false;
+	pthread_mutex_unlock(&wakeLock);
+#endif
+}
+
+// Called with the lock held
+void FileWatcher::UpdateEpoll(int fd)
+{
+#if HAVE_SYS_EPOLL_H
+	if (EpollFd < 0)
+		return;
+
+	// the kernel only allows one registration per descriptor, so watch for
+	// the union of all entries on this fd
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	for (unsigned int ii = 0; ii < WatchedFilesArrayCount; ++ii)
+	{
+		if (WatchedFiles[ii].fd == fd)
+		{
+			if (WatchedFiles[ii].Read)
+				ev.events |= EPOLLIN;
+			if (WatchedFiles[ii].Write)
+				ev.events |= EPOLLOUT;
+			if (WatchedFiles[ii].Except)
+				ev.events |= EPOLLPRI;
+		}
+	}
+
+	if (ev.events == 0)
+	{
+		// may already be gone if the descriptor was closed first
+		epoll_ctl(EpollFd, EPOLL_CTL_DEL, fd, &ev);
+	}
+	else if (epoll_ctl(EpollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+	{
+		if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+			PLAYER_ERROR2("failed to watch file descriptor %d: %s", fd, strerror(errno));
+	}
+#endif
+}
+
 
 int FileWatcher::Wait(double Timeout)
 {
 	Lock();
-	if (WatchedFilesArrayCount == 0)
+	if (WatchedFilesArrayCount == 0 && WakeupPipe[0] < 0)
 	{
 		PLAYER_ERROR("File watcher wait called with no files to watch");
 		Unlock();
 		return 0;
 	}
 
+#if HAVE_SYS_EPOLL_H
+	if (EpollFd >= 0)
+	{
+		Unlock();
+
+		struct epoll_event events[FILEWATCHER_MAX_EVENTS];
+		int ret = epoll_wait(EpollFd, events, FILEWATCHER_MAX_EVENTS,
+				static_cast<int> (ceil(Timeout * 1e3)));
+		if (ret < 0)
+		{
+			// dont print a warning if we are ctrl+c'd
+			if (errno != EINTR)
+				PLAYER_ERROR2("epoll_wait failed in File Watcher: %d %s",errno,strerror(errno));
+			return ret;
+		}
+
+		Lock();
+		int queueless_count = 0;
+		for (int jj = 0; jj < ret; ++jj)
+		{
+			int fd = events[jj].data.fd;
+			uint32_t e = events[jj].events;
+			if (fd == WakeupPipe[0])
+			{
+				DrainWakeup();
+				continue;
+			}
+			for (unsigned int ii = 0; ii < WatchedFilesArrayCount; ++ii)
+			{
+				if (WatchedFiles[ii].fd != fd)
+					continue;
+				// errors and hangups show up as readable, as with select()
+				if ((WatchedFiles[ii].Read && (e & (EPOLLIN | EPOLLERR | EPOLLHUP))) ||
+						(WatchedFiles[ii].Write && (e & (EPOLLOUT | EPOLLERR))) ||
+						(WatchedFiles[ii].Except && (e & EPOLLPRI)))
+				{
+					QueuePointer &q = WatchedFiles[ii].queue;
+					if (q != NULL)
+						q->DataAvailable();
+					else
+						queueless_count++;
+				}
+			}
+		}
+		Unlock();
+		return queueless_count;
+	}
+#endif
+
 	// intialise our FD sets for the select call
 	fd_set ReadFds,WriteFds,ExceptFds;
 	FD_ZERO(&ReadFds);
@@ -99,6 +264,12 @@ int FileWatcher::Wait(double Timeout)
 				FD_SET(WatchedFiles[ii].fd,&ExceptFds);
 		}
 	}
+	if (WakeupPipe[0] >= 0)
+	{
+		FD_SET(WakeupPipe[0],&ReadFds);
+		if (WakeupPipe[0] > maxfd)
+			maxfd = WakeupPipe[0];
+	}
 
 	struct timeval t;
 	t.tv_sec = static_cast<int> (floor(Timeout));
@@ -123,6 +294,12 @@ int FileWatcher::Wait(double Timeout)
 		return 0;
 	}
 
+	if (WakeupPipe[0] >= 0 && FD_ISSET(WakeupPipe[0],&ReadFds))
+	{
+		DrainWakeup();
+		ret--;
+	}
+
 	Lock();
 
 	int queueless_count = 0;
@@ -201,6 +378,7 @@ int FileWatcher::AddFileWatch(int fd, QueuePointer & queue, bool WatchRead, bool
 	next_entry->Read = WatchRead;
 	next_entry->Write = WatchWrite;
 	next_entry->Except = WatchExcept;
+	UpdateEpoll(fd);
 
 	Unlock();
 	return 0;
@@ -226,6 +404,7 @@ int FileWatcher::RemoveFileWatch(int fd, QueuePointer &queue, bool WatchRead, bo
 				WatchedFiles[ii].Except == WatchExcept)
 		{
 			WatchedFiles[ii].fd = -1;
+			UpdateEpoll(fd);
 			Unlock();
 			return 0;
 		}
@@ -74,11 +74,31 @@ public:
 	int AddFileWatch(int fd, bool WatchRead = true, bool WatchWrite = false, bool WatchExcept = true);
 	int RemoveFileWatch(int fd, bool WatchRead = true, bool WatchWrite = false, bool WatchExcept = true);
 
+	/** @brief Make a current or the next call to Wait() return early.
+
+	Safe to call from any thread.  Repeated calls before the waiting thread
+	wakes up are coalesced. */
+	void Wakeup();
+
 private:
 	struct fd_driver_pair * WatchedFiles;
 	size_t WatchedFilesArraySize;
 	size_t WatchedFilesArrayCount;
 
+	/// epoll instance holding the watched descriptors, or -1 to use select()
+	int EpollFd;
+	/// Self pipe used by Wakeup(); the read end is always watched
+	int WakeupPipe[2];
+	/// Set while a wakeup byte is sitting in the pipe
+	bool WakeupPending;
+	/// Protects @p WakeupPending and the pipe
+	pthread_mutex_t wakeLock;
+
+	/// Bring the epoll registration for fd in line with the watch list
+	void UpdateEpoll(int fd);
+	/// Empty the wakeup pipe
+	void DrainWakeup();
+
     /** @brief Lock access to watcher internals. */
     virtual void Lock(void);
     /** @brief Unlock access to watcher internals. */
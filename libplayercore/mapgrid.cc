@@ -0,0 +1,167 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * $Id$
+ *
+ * A shared, read-only occupancy grid, for handing a map from one driver
+ * to another in the same server without copying it tile by tile.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <libplayercommon/playercommon.h>
+#include <libplayercore/driver.h>
+#include <libplayercore/device.h>
+#include <libplayercore/mapgrid.h>
+
+// Size of the tiles requested from map drivers that do not share their
+// grids
+#define MAPGRID_TILE_SIZE 640
+
+MapGrid::MapGrid(const player_map_info_t & info, int8_t * cells) :
+  info(info),
+  cells(cells),
+  refs(1)
+{
+  pthread_mutex_init(&this->lock, NULL);
+}
+
+MapGrid::~MapGrid()
+{
+  delete [] this->cells;
+  pthread_mutex_destroy(&this->lock);
+}
+
+MapGrid *
+MapGrid::Ref()
+{
+  pthread_mutex_lock(&this->lock);
+  this->refs++;
+  pthread_mutex_unlock(&this->lock);
+  return(this);
+}
+
+void
+MapGrid::Unref()
+{
+  int refs;
+
+  pthread_mutex_lock(&this->lock);
+  refs = --this->refs;
+  pthread_mutex_unlock(&this->lock);
+  if(refs == 0)
+    delete this;
+}
+
+MapGrid *
+MapGrid::Fetch(Device * mapdev, QueuePointer & resp_queue, bool threaded)
+{
+  MapGrid * grid;
+  Message * msg;
+  player_map_info_t info;
+  player_map_data_t data_req;
+  player_map_data_t * mapdata;
+  int8_t * cells;
+  unsigned int j, oi, oj, si, sj;
+
+  // In the same server, and sharing?
+  if(mapdev->driver && (grid = mapdev->driver->GetMapGrid(mapdev->addr)))
+    return(grid);
+
+  // No; fetch the info and the cells
+  if(!(msg = mapdev->Request(resp_queue,
+                             PLAYER_MSGTYPE_REQ,
+                             PLAYER_MAP_REQ_GET_INFO,
+                             NULL, 0, NULL, threaded)))
+  {
+    PLAYER_ERROR("failed to get map info");
+    return(NULL);
+  }
+  info = *(player_map_info_t*)msg->GetPayload();
+  delete msg;
+
+  cells = new int8_t[info.width * info.height];
+
+  memset(&data_req, 0, sizeof(data_req));
+  oi = oj = 0;
+  while((oi < info.width) && (oj < info.height))
+  {
+    si = MIN(MAPGRID_TILE_SIZE, info.width - oi);
+    sj = MIN(MAPGRID_TILE_SIZE, info.height - oj);
+
+    data_req.col = oi;
+    data_req.row = oj;
+    data_req.width = si;
+    data_req.height = sj;
+
+    if(!(msg = mapdev->Request(resp_queue,
+                               PLAYER_MSGTYPE_REQ,
+                               PLAYER_MAP_REQ_GET_DATA,
+                               (void*)&data_req, 0, NULL, threaded)))
+    {
+      PLAYER_ERROR("failed to get map data");
+      delete [] cells;
+      return(NULL);
+    }
+
+    mapdata = (player_map_data_t*)msg->GetPayload();
+    if(mapdata->data_count < si * sj)
+    {
+      PLAYER_ERROR2("got less map data than expected (%u != %u)",
+                    mapdata->data_count, si * sj);
+      delete msg;
+      delete [] cells;
+      return(NULL);
+    }
+    for(j = 0; j < sj; j++)
+      memcpy(cells + (oj + j) * info.width + oi, mapdata->data + j * si, si);
+    delete msg;
+
+    oi += si;
+    if(oi >= info.width)
+    {
+      oi = 0;
+      oj += sj;
+    }
+  }
+
+  return(new MapGrid(info, cells));
+}
@@ -0,0 +1,126 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * $Id$
+ *
+ * A shared, read-only occupancy grid, for handing a map from one driver
+ * to another in the same server without copying it tile by tile.
+ */
+
+#ifndef _MAPGRID_H
+#define _MAPGRID_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCORE_EXPORT
+  #elif defined (playercore_EXPORTS)
+    #define PLAYERCORE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCORE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCORE_EXPORT
+#endif
+
+#include <pthread.h>
+
+#include <libplayerinterface/player.h>
+#include <libplayercore/message.h>
+
+class Device;
+
+/**
+@brief A reference counted, read-only occupancy grid.
+
+A map driver that holds its whole grid in memory can wrap it in a
+MapGrid and return it from Driver::GetMapGrid().  Drivers in the same
+server then share the one grid, instead of each fetching a copy with
+PLAYER_MAP_REQ_GET_DATA requests.  The grid never changes once made; a
+driver with a new map makes a new MapGrid.
+
+Use MapGrid::Fetch() to get the grid of a map device.  It falls back to
+fetching the map in tiles when the device is remote or its driver does
+not share its grid, so callers need only the one code path.
+*/
+class PLAYERCORE_EXPORT MapGrid
+{
+  public:
+    /** @brief Wrap a grid.
+
+    The grid takes ownership of @p cells, which must have been allocated
+    with new[], and holds one reference, for the caller.
+
+    @param info Size, scale and origin of the grid
+    @param cells width x height cells, row-major from (0,0) */
+    MapGrid(const player_map_info_t & info, int8_t * cells);
+
+    /** @brief Add a reference.  @returns this */
+    MapGrid * Ref();
+
+    /** @brief Drop a reference; the grid is deleted with the last one. */
+    void Unref();
+
+    /** @brief Get the grid of a map device.
+
+    The caller must be subscribed to @p mapdev.  If the device's driver
+    shares its grid, that is returned; otherwise the map info and cells
+    are requested over @p resp_queue, as with Device::Request().
+
+    @returns A new reference, which the caller must Unref(), or NULL on
+    error. */
+    static MapGrid * Fetch(Device * mapdev,
+                           QueuePointer & resp_queue,
+                           bool threaded = false);
+
+    /// Size, scale and origin of the grid
+    const player_map_info_t info;
+
+    /// The cells: -1 free, 0 unknown, +1 occupied
+    const int8_t * const cells;
+
+  private:
+    // Only Unref() deletes a grid
+    ~MapGrid();
+
+    int refs;
+    pthread_mutex_t lock;
+};
+
+#endif
@@ -43,12 +43,17 @@
  * Author: Toby Collett - Jan 2005
  */
 
+#include <config.h>
+
 #include <pthread.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <math.h>
 #include <time.h>
+#include <new>
 
 #include <libplayerinterface/player.h>
 #include <libplayercommon/playercommon.h>
@@ -56,8 +61,207 @@
 #include <libplayerinterface/playerxdr.h>
 
 #include <libplayercore/message.h>
+#include <libplayercore/filewatcher.h>
 #include <replace/replace.h>
 
+////////////////////////////////////////////////////////////////////////////////
+// Atomic helpers.  Without compiler support these fall back to a single
+// global mutex, which is correct but no faster than the old code.
+#if HAVE_SYNC_BUILTINS
+static inline long atomic_add(long * value, long delta)
+{
+  return __sync_add_and_fetch(value, delta);
+}
+
+static inline bool atomic_cas_ptr(void * volatile * ptr, void * oldval, void * newval)
+{
+  return __sync_bool_compare_and_swap(ptr, oldval, newval);
+}
+
+static inline void * atomic_swap_ptr(void * volatile * ptr, void * newval)
+{
+  // __sync_lock_test_and_set is only an acquire barrier
+  __sync_synchronize();
+  return __sync_lock_test_and_set(ptr, newval);
+}
+#else
+static pthread_mutex_t atomic_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline long atomic_add(long * value, long delta)
+{
+  pthread_mutex_lock(&atomic_lock);
+  long result = (*value += delta);
+  pthread_mutex_unlock(&atomic_lock);
+  return result;
+}
+
+static inline bool atomic_cas_ptr(void * volatile * ptr, void * oldval, void * newval)
+{
+  bool result = false;
+  pthread_mutex_lock(&atomic_lock);
+  if (*ptr == oldval)
+  {
+    *ptr = newval;
+    result = true;
+  }
+  pthread_mutex_unlock(&atomic_lock);
+  return result;
+}
+
+static inline void * atomic_swap_ptr(void * volatile * ptr, void * newval)
+{
+  pthread_mutex_lock(&atomic_lock);
+  void * result = *ptr;
+  *ptr = newval;
+  pthread_mutex_unlock(&atomic_lock);
+  return result;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Message storage.  Every Message allocated with new is preceded by a
+// MessageSlotHeader recording the pool it came from (NULL for the heap), so
+// that delete can hand pooled messages back to their queue.
+union MessageSlotHeader
+{
+  struct
+  {
+    MessageSlotPool * pool;
+    struct MessageSlot * next;
+  } s;
+  // keep the message that follows suitably aligned
+  double align[2];
+};
+
+struct MessageSlot
+{
+  MessageSlotHeader header;
+  union
+  {
+    char bytes[sizeof(Message)];
+    double align;
+    void * alignp;
+  } storage;
+  MessageQueueElement element;
+};
+
+/** Slots for the messages of one queue.  Slots are only taken by the owning
+ * queue, with its lock held; they are given back lock-free from whatever
+ * thread deletes the message, which may outlive the queue.  The pool is
+ * therefore reference counted: one reference for the queue and one for every
+ * slot in use. */
+class MessageSlotPool
+{
+  public:
+    MessageSlotPool(size_t _limit) : chunks(NULL), capacity(0), limit(_limit),
+                                     free(NULL), returned(NULL), refs(1)
+    {
+      if (this->limit < 1)
+        this->limit = 1;
+    }
+
+    ~MessageSlotPool()
+    {
+      while (this->chunks)
+      {
+        Chunk * next = this->chunks->next;
+        delete [] this->chunks->slots;
+        delete this->chunks;
+        this->chunks = next;
+      }
+    }
+
+    /// Take a free slot, or NULL if the pool is exhausted.  Caller must
+    /// hold the owning queue's lock.
+    MessageSlot * Acquire()
+    {
+      if (!this->free)
+        this->free = (MessageSlot*)atomic_swap_ptr(&this->returned, NULL);
+      if (!this->free && this->capacity < this->limit)
+        this->Grow();
+      if (!this->free)
+        return NULL;
+      MessageSlot * slot = this->free;
+      this->free = slot->header.s.next;
+      atomic_add(&this->refs, 1);
+      return slot;
+    }
+
+    /// Give a slot back; safe from any thread.
+    void Release(MessageSlot * slot)
+    {
+      void * head;
+      do
+      {
+        head = this->returned;
+        slot->header.s.next = (MessageSlot*)head;
+      } while (!atomic_cas_ptr(&this->returned, head, slot));
+      this->DecRef();
+    }
+
+    /// Drop a reference, deleting the pool when the last one goes.
+    void DecRef()
+    {
+      if (atomic_add(&this->refs, -1) == 0)
+        delete this;
+    }
+
+  private:
+    struct Chunk
+    {
+      MessageSlot * slots;
+      Chunk * next;
+    };
+
+    /// Add another chunk of slots, doubling capacity up to the limit.
+    void Grow()
+    {
+      size_t count = this->capacity ? this->capacity : PLAYER_MSGQUEUE_POOL_CHUNK;
+      if (count > this->limit - this->capacity)
+        count = this->limit - this->capacity;
+      Chunk * chunk = new Chunk;
+      chunk->slots = new MessageSlot[count];
+      chunk->next = this->chunks;
+      this->chunks = chunk;
+      for (size_t i = 0; i < count; i++)
+      {
+        chunk->slots[i].header.s.pool = this;
+        chunk->slots[i].header.s.next = (i + 1 < count) ? &chunk->slots[i + 1] : this->free;
+        chunk->slots[i].element.pooled = true;
+      }
+      this->free = chunk->slots;
+      this->capacity += count;
+    }
+
+    Chunk * chunks;
+    size_t capacity, limit;
+    /// Slots private to the owning queue.
+    MessageSlot * free;
+    /// Slots given back by other threads, collected in one swap.
+    void * volatile returned;
+    long refs;
+};
+
+void * Message::operator new(size_t size)
+{
+  MessageSlotHeader * header = (MessageSlotHeader*)malloc(sizeof(MessageSlotHeader) + size);
+  if (header == NULL)
+    throw std::bad_alloc();
+  header->s.pool = NULL;
+  return header + 1;
+}
+
+void Message::operator delete(void * ptr)
+{
+  if (ptr == NULL)
+    return;
+  MessageSlotHeader * header = ((MessageSlotHeader*)ptr) - 1;
+  if (header->s.pool)
+    header->s.pool->Release((MessageSlot*)header);
+  else
+    free(header);
+}
+
 Message::Message(const struct player_msghdr & aHeader,
                   void * data,
                   bool copy)
@@ -73,21 +277,14 @@ Message::Message(const struct player_msghdr & aHeader,
   CreateMessage(aHeader, data, copy);
 }
 
-Message::Message(const Message & rhs)
+Message::Message(const Message & rhs) : Queue(rhs.Queue)
 {
-  assert(rhs.Lock);
-  pthread_mutex_lock(rhs.Lock);
-
-  assert(rhs.RefCount);
-  assert(*(rhs.RefCount));
-  Lock = rhs.Lock;
+  assert(rhs.Shared);
+  assert(rhs.Shared->RefCount > 0);
+  Shared = rhs.Shared;
+  atomic_add(&Shared->RefCount, 1);
   Data = rhs.Data;
   Header = rhs.Header;
-  Queue = rhs.Queue;
-  RefCount = rhs.RefCount;
-  (*RefCount)++;
-
-  pthread_mutex_unlock(rhs.Lock);
 }
 
 Message::~Message()
@@ -99,12 +296,11 @@ void Message::CreateMessage(const struct player_msghdr & aHeader,
                   void * data,
                   bool copy)
 {
-  this->Lock = new pthread_mutex_t;
-  assert(this->Lock);
-  pthread_mutex_init(this->Lock,NULL);
-  this->RefCount = new unsigned int;
-  assert(this->RefCount);
-  *this->RefCount = 1;
+  this->Shared = new SharedData;
+  assert(this->Shared);
+  this->Shared->RefCount = 1;
+  this->Shared->Data = NULL;
+  this->Shared->Encoded = NULL;
 
   // copy the header and then the data into out message data buffer
   memcpy(&this->Header,&aHeader,sizeof(struct player_msghdr));
@@ -115,18 +311,17 @@ void Message::CreateMessage(const struct player_msghdr & aHeader,
     return;
   }
   // Force header size to be same as data size
-  player_sizeof_fn_t sizeoffunc;
-  if((sizeoffunc = playerxdr_get_sizeoffunc(Header.addr.interf, Header.type, Header.subtype)) != NULL)
+  playerxdr_function_t* ftrow = playerxdr_get_ftrow(Header.addr.interf, Header.type, Header.subtype);
+  if(ftrow && ftrow->sizeoffunc)
   {
-    Header.size = (*sizeoffunc)(data);
+    Header.size = (*ftrow->sizeoffunc)(data);
   }
 
   if (copy)
   {
-    player_clone_fn_t clonefunc = NULL;
-    if((clonefunc = playerxdr_get_clonefunc(Header.addr.interf, Header.type, Header.subtype)) != NULL)
+    if(ftrow && ftrow->clonefunc)
     {
-      if ((this->Data = (uint8_t*)(*clonefunc)(data)) == NULL)
+      if ((this->Data = (uint8_t*)(*ftrow->clonefunc)(data)) == NULL)
       {
         PLAYER_ERROR3 ("failed to clone message %s: %s, %d", interf_to_str (Header.addr.interf), msgtype_to_str (Header.type), Header.subtype);
       }
@@ -141,6 +336,7 @@ void Message::CreateMessage(const struct player_msghdr & aHeader,
   {
     this->Data = (uint8_t*)data;
   }
+  this->Shared->Data = this->Data;
 }
 
 bool
@@ -157,35 +353,92 @@ Message::Compare(Message &other)
 void
 Message::DecRef()
 {
-  pthread_mutex_lock(Lock);
-  (*RefCount)--;
-  assert((*RefCount) >= 0);
-  if((*RefCount)==0)
+  if (Shared == NULL)
+    return;
+  long refs = atomic_add(&Shared->RefCount, -1);
+  assert(refs >= 0);
+  if(refs == 0)
   {
-    if (Data)
-      playerxdr_free_message (Data, Header.addr.interf, Header.type, Header.subtype);
-    Data = NULL;
-    delete RefCount;
-    RefCount = NULL;
-    pthread_mutex_unlock(Lock);
-    pthread_mutex_destroy(Lock);
-    delete Lock;
-    Lock = NULL;
+    if (Shared->Data)
+      playerxdr_free_message (Shared->Data, Header.addr.interf, Header.type, Header.subtype);
+    Encoding * encoded = (Encoding*)Shared->Encoded;
+    if (encoded)
+    {
+      free(encoded->Data);
+      delete encoded;
+    }
+    delete Shared;
   }
-  else
-    pthread_mutex_unlock(Lock);
+  Shared = NULL;
+  Data = NULL;
+}
+
+long
+Message::GetRefCount()
+{
+  assert(Shared);
+  return Shared->RefCount;
+}
+
+const uint8_t *
+Message::GetEncoding(size_t * len)
+{
+  assert(Shared);
+  Encoding * encoded = (Encoding*)Shared->Encoded;
+  if (encoded == NULL)
+    return NULL;
+  *len = encoded->Length;
+  return encoded->Data;
+}
+
+const uint8_t *
+Message::SetEncoding(uint8_t * buf, size_t len)
+{
+  assert(Shared);
+  Encoding * encoded = new Encoding;
+  encoded->Length = len;
+  encoded->Data = buf;
+  if (!atomic_cas_ptr(&Shared->Encoded, NULL, encoded))
+  {
+    // someone beat us to it; use theirs
+    free(buf);
+    delete encoded;
+    encoded = (Encoding*)Shared->Encoded;
+  }
+  return encoded->Data;
 }
 
 MessageQueueElement::MessageQueueElement()
 {
   msg = NULL;
   prev = next = NULL;
+  sig_prev = sig_next = NULL;
+  pooled = false;
+}
+
+// Number of entries in a queue's replace decision cache (a power of two)
+#define MSGQUEUE_REPLACE_CACHE_SIZE 64
+// Bounds on the number of signature index buckets
+#define MSGQUEUE_MIN_SIG_BUCKETS 16
+#define MSGQUEUE_MAX_SIG_BUCKETS 256
+
+// Hash a message signature, as compared by Message::Compare()
+static inline size_t
+msgqueue_sig_hash(const player_msghdr_t* hdr)
+{
+  uint32_t h = hdr->addr.host * 2654435761U;
+  h = (h ^ hdr->addr.robot) * 2654435761U;
+  h = (h ^ ((uint32_t)hdr->addr.interf << 16) ^ hdr->addr.index) * 2654435761U;
+  h = (h ^ ((uint32_t)hdr->type << 8) ^ hdr->subtype) * 2654435761U;
+  return(h ^ (h >> 16));
 }
 
 MessageQueueElement::~MessageQueueElement()
 {
 }
 
+MessageQueueBackend MessageQueue::DefaultBackend = PLAYER_MSGQUEUE_BACKEND_LIST;
+
 MessageQueue::MessageQueue(bool _Replace, size_t _Maxlen)
 {
   this->Replace = _Replace;
@@ -198,10 +451,18 @@ MessageQueue::MessageQueue(bool _Replace, size_t _Maxlen)
   this->ClearFilter();
   this->filter_on = false;
   this->replaceRules = NULL;
+  this->replaceCache = NULL;
+  this->sig_buckets = NULL;
+  this->sig_num_buckets = 0;
   this->pull = false;
   this->data_requested = false;
   this->data_delivered = false;
+  this->wake_watcher = NULL;
   this->drop_count = 0;
+  this->backend = PLAYER_MSGQUEUE_BACKEND_LIST;
+  this->pool = NULL;
+  this->RefCount = 0;
+  this->SetBackend(DefaultBackend);
 }
 
 MessageQueue::~MessageQueue()
@@ -210,11 +471,13 @@ MessageQueue::~MessageQueue()
   MessageQueueElement *e, *n;
   for(e = this->head; e;)
   {
-    delete e->msg;
     n = e->next;
-    delete e;
+    this->DeleteElement(e);
     e = n;
   }
+  // messages that have been popped but not yet deleted keep the pool alive
+  if (this->pool)
+    this->pool->DecRef();
 
   // clear the list of replacement rules
   MessageReplaceRule* tmp;
@@ -225,24 +488,85 @@ MessageQueue::~MessageQueue()
     delete curr;
     curr = tmp;
   }
+  delete [] this->replaceCache;
+  delete [] this->sig_buckets;
 
   pthread_mutex_destroy(&this->lock);
   pthread_mutex_destroy(&this->condMutex);
   pthread_cond_destroy(&this->cond);
 }
 
+void
+MessageQueue::SetDefaultBackend(MessageQueueBackend _backend)
+{
+  DefaultBackend = _backend;
+}
+
+MessageQueueBackend
+MessageQueue::GetDefaultBackend(void)
+{
+  return DefaultBackend;
+}
+
+void
+MessageQueue::SetBackend(MessageQueueBackend _backend)
+{
+  this->Lock();
+  if (_backend == PLAYER_MSGQUEUE_BACKEND_POOL && !this->pool)
+    this->pool = new MessageSlotPool(this->Maxlen);
+  this->backend = _backend;
+  this->Unlock();
+}
+
+MessageQueueElement*
+MessageQueue::NewElement(Message& msg)
+{
+  if (this->backend == PLAYER_MSGQUEUE_BACKEND_POOL)
+  {
+    MessageSlot * slot = this->pool->Acquire();
+    if (slot)
+    {
+      MessageQueueElement* newelt = &slot->element;
+      newelt->msg = ::new (slot->storage.bytes) Message(msg);
+      newelt->prev = newelt->next = NULL;
+      newelt->sig_prev = newelt->sig_next = NULL;
+      return newelt;
+    }
+    // pool exhausted (requests and replies are let through beyond Maxlen);
+    // fall through to the heap
+  }
+  MessageQueueElement* newelt = new MessageQueueElement();
+  newelt->msg = new Message(msg);
+  return newelt;
+}
+
+void
+MessageQueue::DeleteElement(MessageQueueElement* el)
+{
+  // a pooled element lives in the same slot as its message, so it must not
+  // be touched once the message has been deleted
+  bool pooled = el->pooled;
+  delete el->msg;
+  if (!pooled)
+    delete el;
+}
+
 /// @brief Add a replacement rule to the list
 void
 MessageQueue::AddReplaceRule(int _host, int _robot, int _interf, int _index,
                              int _type, int _subtype, int _replace)
 {
   MessageReplaceRule* curr;
+  this->Lock();
+  // cached decisions may no longer hold
+  this->ClearReplaceCache();
   for(curr=this->replaceRules;curr;curr=curr->next)
   {
     // Check for an existing rule with the same criteria; replace if found
     if (curr->Equivalent (_host, _robot, _interf, _index, _type, _subtype))
     {
       curr->replace = _replace;
+      this->Unlock();
       return;
     }
 	if (curr->next == NULL)
@@ -265,6 +589,7 @@ MessageQueue::AddReplaceRule(int _host, int _robot, int _interf, int _index,
     if (!curr->next)
       PLAYER_ERROR ("memory allocation failure; could not add new replace rule");
   }
+  this->Unlock();
 }
 
 /// @brief Add a replacement rule to the list
@@ -276,6 +601,119 @@ MessageQueue::AddReplaceRule(const player_devaddr_t &device,
                         _type, _subtype, _replace);
 }
 
+void
+MessageQueue::SetReplace(bool _Replace)
+{
+  this->Lock();
+  this->Replace = _Replace;
+  this->ClearReplaceCache();
+  this->Unlock();
+}
+
+void
+MessageQueue::ClearReplaceCache(void)
+{
+  if(this->replaceCache)
+  {
+    for(int i=0;i<MSGQUEUE_REPLACE_CACHE_SIZE;i++)
+      this->replaceCache[i].valid = false;
+  }
+}
+
+int
+MessageQueue::CachedCheckReplace(player_msghdr_t* hdr)
+{
+  // Without rules the decision depends only on the type and the Replace
+  // flag, which is as cheap as a cache lookup.  Unknown types are not
+  // cached, so that each one is still reported.
+  if(!this->replaceRules ||
+     ((hdr->type != PLAYER_MSGTYPE_DATA) && (hdr->type != PLAYER_MSGTYPE_CMD) &&
+      (hdr->type != PLAYER_MSGTYPE_REQ) && (hdr->type != PLAYER_MSGTYPE_RESP_ACK) &&
+      (hdr->type != PLAYER_MSGTYPE_RESP_NACK)))
+    return(this->CheckReplace(hdr));
+
+  if(!this->replaceCache)
+  {
+    this->replaceCache = new ReplaceCacheEntry[MSGQUEUE_REPLACE_CACHE_SIZE];
+    for(int i=0;i<MSGQUEUE_REPLACE_CACHE_SIZE;i++)
+      this->replaceCache[i].valid = false;
+  }
+
+  ReplaceCacheEntry* entry =
+          this->replaceCache + (msgqueue_sig_hash(hdr) & (MSGQUEUE_REPLACE_CACHE_SIZE-1));
+  if(!entry->valid ||
+     !Message::MatchMessage(hdr, entry->type, entry->subtype, entry->addr))
+  {
+    entry->addr = hdr->addr;
+    entry->type = hdr->type;
+    entry->subtype = hdr->subtype;
+    entry->replace = this->CheckReplace(hdr);
+    entry->valid = true;
+  }
+  return(entry->replace);
+}
+
+void
+MessageQueue::BuildSignatureIndex(void)
+{
+  size_t len = MSGQUEUE_MIN_SIG_BUCKETS;
+  while((len < this->Maxlen) && (len < MSGQUEUE_MAX_SIG_BUCKETS))
+    len *= 2;
+  this->sig_buckets = new MessageQueueElement*[len];
+  memset(this->sig_buckets, 0, len*sizeof(MessageQueueElement*));
+  this->sig_num_buckets = len;
+
+  // walk from the head so that the newest element ends up first
+  for(MessageQueueElement* el = this->head; el; el = el->next)
+    this->IndexElement(el, true);
+}
+
+void
+MessageQueue::IndexElement(MessageQueueElement* el, bool newest)
+{
+  MessageQueueElement** bucket =
+          this->sig_buckets + (msgqueue_sig_hash(el->msg->GetHeader()) & (this->sig_num_buckets-1));
+  if(newest || !*bucket)
+  {
+    el->sig_prev = NULL;
+    el->sig_next = *bucket;
+    if(*bucket)
+      (*bucket)->sig_prev = el;
+    *bucket = el;
+  }
+  else
+  {
+    // PushFront; the oldest element goes at the end of the chain
+    MessageQueueElement* last;
+    for(last = *bucket; last->sig_next; last = last->sig_next);
+    last->sig_next = el;
+    el->sig_prev = last;
+    el->sig_next = NULL;
+  }
+}
+
+MessageQueueElement*
+MessageQueue::FindSignature(Message& msg)
+{
+  return(this->FindSignature(msg.GetHeader()));
+}
+
+MessageQueueElement*
+MessageQueue::FindSignature(const player_msghdr_t* hdr)
+{
+  if(!this->sig_buckets)
+    this->BuildSignatureIndex();
+  for(MessageQueueElement* el =
+          this->sig_buckets[msgqueue_sig_hash(hdr) & (this->sig_num_buckets-1)];
+      el; el = el->sig_next)
+  {
+    if(Message::MatchMessage(el->msg->GetHeader(), hdr->type, hdr->subtype,
+                             hdr->addr))
+      return(el);
+  }
+  return(NULL);
+}
+
 int
 MessageQueue::CheckReplace(player_msghdr_t* hdr)
 {
@@ -398,6 +836,22 @@ MessageQueue::GetLength(void)
   return(len);
 }
 
+double
+MessageQueue::GetBacklog(player_msghdr_t* hdr)
+{
+  double backlog;
+  this->Lock();
+  if(this->CachedCheckReplace(hdr) == PLAYER_PLAYER_MSG_REPLACE_RULE_REPLACE &&
+     this->FindSignature(hdr))
+    backlog = 1.0;
+  else if(this->Maxlen > 0)
+    backlog = (double)this->Length / this->Maxlen;
+  else
+    backlog = 0.0;
+  this->Unlock();
+  return(backlog);
+}
+
 void
 MessageQueue::ClearFilter(void)
 {
@@ -414,6 +868,8 @@ MessageQueue::DataAvailable(void)
   pthread_mutex_lock(&this->condMutex);
   pthread_cond_broadcast(&this->cond);
   pthread_mutex_unlock(&this->condMutex);
+  if(this->wake_watcher)
+    this->wake_watcher->Wakeup();
 }
 
 /// @brief Set the data_requested flag
@@ -437,8 +893,7 @@ MessageQueue::PushFront(Message & msg, bool haveLock)
 {
   if(!haveLock)
     this->Lock();
-  MessageQueueElement* newelt = new MessageQueueElement();
-  newelt->msg = new Message(msg);
+  MessageQueueElement* newelt = this->NewElement(msg);
   if(!this->tail)
   {
     this->head = this->tail = newelt;
@@ -451,6 +906,8 @@ MessageQueue::PushFront(Message & msg, bool haveLock)
     this->head->prev = newelt;
     this->head = newelt;
   }
+  if(this->sig_buckets)
+    this->IndexElement(newelt, false);
   this->Length++;
   if(!haveLock)
     this->Unlock();
@@ -465,8 +922,7 @@ MessageQueue::PushBack(Message & msg, bool haveLock)
 {
   if(!haveLock)
     this->Lock();
-  MessageQueueElement* newelt = new MessageQueueElement();
-  newelt->msg = new Message(msg);
+  MessageQueueElement* newelt = this->NewElement(msg);
   if(!this->tail)
   {
     this->head = this->tail = newelt;
@@ -479,6 +935,8 @@ MessageQueue::PushBack(Message & msg, bool haveLock)
     newelt->next = NULL;
     this->tail = newelt;
   }
+  if(this->sig_buckets)
+    this->IndexElement(newelt, true);
   this->Length++;
   if(!haveLock)
     this->Unlock();
@@ -489,11 +947,10 @@ MessageQueue::Push(Message & msg)
 {
   player_msghdr_t* hdr;
 
-  assert(*msg.RefCount);
   this->Lock();
   hdr = msg.GetHeader();
   // Should we try to replace an older message of the same signature?
-  int replaceOp = this->CheckReplace(hdr);
+  int replaceOp = this->CachedCheckReplace(hdr);
   // if our queue is over size discard any data or command packets
   // if we discard requests or replies this will potentially lock up the client so we will let those through
   if (PLAYER_PLAYER_MSG_REPLACE_RULE_IGNORE == replaceOp)
@@ -512,17 +969,11 @@ MessageQueue::Push(Message & msg)
   }
   else if (replaceOp == PLAYER_PLAYER_MSG_REPLACE_RULE_REPLACE)
   {
-    for(MessageQueueElement* el = this->tail;
-        el != NULL;
-        el = el->prev)
+    MessageQueueElement* el = this->FindSignature(msg);
+    if(el)
     {
-      if(el->msg->Compare(msg))
-      {
-        this->Remove(el);
-        delete el->msg;
-        delete el;
-        break;
-      }
+      this->Remove(el);
+      this->DeleteElement(el);
     }
   }
 
@@ -571,9 +1022,11 @@ MessageQueue::Pop()
          (el->msg->GetHeader()->type == PLAYER_MSGTYPE_DATA))
         this->data_delivered = true;
       this->Remove(el);
-      Unlock();
       Message* retmsg = el->msg;
-      delete el;
+      // a pooled element is released along with its message
+      if(!el->pooled)
+        delete el;
+      Unlock();
       return(retmsg);
     }
   }
@@ -624,29 +1077,31 @@ MessageQueue::Remove(MessageQueueElement* el)
     el->next->prev = el->prev;
   else
     this->tail = el->prev;
+  if(this->sig_buckets)
+  {
+    if(el->sig_prev)
+      el->sig_prev->sig_next = el->sig_next;
+    else
+      this->sig_buckets[msgqueue_sig_hash(el->msg->GetHeader()) & (this->sig_num_buckets-1)] = el->sig_next;
+    if(el->sig_next)
+      el->sig_next->sig_prev = el->sig_prev;
+    el->sig_prev = el->sig_next = NULL;
+  }
   this->Length--;
 }
 
 /// Create a null pointer
 QueuePointer::QueuePointer()
 {
-  Lock = NULL;
-  RefCount = NULL;
   Queue = NULL;
 }
 
 /// Create an empty message queue and an auto pointer to it.
 QueuePointer::QueuePointer(bool _Replace, size_t _Maxlen)
 {
-  this->Lock = new pthread_mutex_t;
-  assert(this->Lock);
-  pthread_mutex_init(this->Lock,NULL);
   this->Queue = new MessageQueue(_Replace, _Maxlen);
   assert(this->Queue);
-
-  this->RefCount = new unsigned int;
-  assert(this->RefCount);
-  *this->RefCount = 1;
+  this->Queue->RefCount = 1;
 }
 
 /// Destroy our reference to the message queue.
@@ -659,49 +1114,27 @@ QueuePointer::~QueuePointer()
 /// Create a new reference to a message queue
 QueuePointer::QueuePointer(const QueuePointer & rhs)
 {
-  if (rhs.Queue == NULL)
-  {
-    Lock = NULL;
-    RefCount = NULL;
-    Queue = NULL;
-  }
-  else
+  Queue = rhs.Queue;
+  if (Queue != NULL)
   {
-    assert(rhs.Lock);
-    pthread_mutex_lock(rhs.Lock);
-
-    assert(rhs.Queue);
-    assert(rhs.RefCount);
-    assert(*(rhs.RefCount));
-    Lock = rhs.Lock;
-    Queue = rhs.Queue;
-    RefCount = rhs.RefCount;
-    (*RefCount)++;
-    pthread_mutex_unlock(Lock);
+    assert(Queue->RefCount > 0);
+    atomic_add(&Queue->RefCount, 1);
   }
 }
 
 /// assign reference to our message queue
 QueuePointer & QueuePointer::operator = (const QueuePointer & rhs)
 {
-  // first remove our current reference
+  // take the new reference before dropping the old one, in case they are
+  // the same queue
+  MessageQueue * q = rhs.Queue;
+  if (q != NULL)
+  {
+    assert(q->RefCount > 0);
+    atomic_add(&q->RefCount, 1);
+  }
   DecRef();
-
-  if (rhs.Queue == NULL)
-  	return *this;
-
-  // then copy the rhs
-  assert(rhs.Lock);
-  pthread_mutex_lock(rhs.Lock);
-
-  assert(rhs.Queue);
-  assert(rhs.RefCount);
-  assert(*(rhs.RefCount));
-  Lock = rhs.Lock;
-  Queue = rhs.Queue;
-  RefCount = rhs.RefCount;
-  (*RefCount)++;
-  pthread_mutex_unlock(Lock);
+  Queue = q;
   return *this;
 }
 
@@ -754,25 +1187,9 @@ void QueuePointer::DecRef()
   if (Queue == NULL)
     return;
 
-  pthread_mutex_lock(Lock);
-  (*RefCount)--;
-  assert((*RefCount) >= 0);
-  if((*RefCount)==0)
-  {
+  long refs = atomic_add(&Queue->RefCount, -1);
+  assert(refs >= 0);
+  if (refs == 0)
     delete Queue;
-    Queue = NULL;
-    delete RefCount;
-    RefCount = NULL;
-    pthread_mutex_unlock(Lock);
-    pthread_mutex_destroy(Lock);
-    delete Lock;
-    Lock = NULL;
-  }
-  else
-  {
-    Queue = NULL;
-    RefCount = NULL;
-    pthread_mutex_unlock(Lock);
-    Lock = NULL;
-  }
+  Queue = NULL;
 }
@@ -63,12 +63,29 @@
 #include <libplayerinterface/player.h>
 
 class MessageQueue;
+class MessageSlotPool;
+class FileWatcher;
+
+/** @brief Storage used for the elements of a MessageQueue.
+
+See MessageQueue::SetBackend() and MessageQueue::SetDefaultBackend(). */
+typedef enum
+{
+  /// Every queued message is a separately allocated list element (default).
+  PLAYER_MSGQUEUE_BACKEND_LIST,
+  /// Queued messages are placed in preallocated slots that are recycled
+  /// without going through the allocator.
+  PLAYER_MSGQUEUE_BACKEND_POOL
+} MessageQueueBackend;
 
 /** @brief An autopointer for the message queue
 
 Using an autopointer allows the queue to be released by the client and still exist 
 until no drivers have messages relating to the queue still pending.
 
+The reference count is kept in the queue itself and updated atomically, so
+copying a QueuePointer costs no allocation and no locking.
+
 **/
 class PLAYERCORE_EXPORT QueuePointer
 {
@@ -105,12 +122,6 @@ class PLAYERCORE_EXPORT QueuePointer
 
     /// The queue we are pointing to
     MessageQueue * Queue;
-
-    /// Reference count.
-    unsigned int * RefCount;
-
-    /// Used to lock access to refcount.
-    pthread_mutex_t * Lock;
 };
 
 
@@ -121,6 +132,10 @@ All Player messages are transferred between drivers as pointers to Message
 objects.  These objects are reference-counted so that messages can be
 delivered to multiple recipients with minimal memory overhead.
 
+Copies of a message share a single block holding the reference count and
+the payload pointer.  Copying a message (e.g., onto each subscriber's queue)
+is an atomic increment; only the first construction allocates.
+
 Messages are not usually manipulated directly in driver code.  The details
 of allocating, filling, parsing, and deleting Message objects are handled
 by the Driver and MessageQueue classes.
@@ -151,6 +166,12 @@ class PLAYERCORE_EXPORT Message
     /// Destroy message, dec ref counts and delete data if ref count == 0
     ~Message();
 
+    /// Allocate a message from the heap; storage is tagged so that
+    /// operator delete can tell heap messages from queue slot messages.
+    static void * operator new(size_t size);
+    /// Release a message, returning it to its queue slot pool if it has one.
+    static void operator delete(void * ptr);
+
     /** @brief Helper for message processing.
 
     Returns true if @p hdr matches the supplied @p type, @p subtype,
@@ -192,24 +213,53 @@ class PLAYERCORE_EXPORT Message
     bool Compare(Message &other);
     /// Decrement ref count
     void DecRef();
+    /// Number of copies of this message currently alive.
+    long GetRefCount();
+
+    /** @brief Get the cached wire encoding of the payload.
+    Transports store the encoded payload with SetEncoding() the first time
+    a message is sent so that other copies of the message, bound for other
+    clients, do not have to be encoded again.  Returns NULL if nothing has
+    been stored yet, otherwise sets @p len to the encoded length. */
+    const uint8_t * GetEncoding(size_t * len);
+    /** @brief Store the wire encoding of the payload.
+    The message takes ownership of @p buf, which must have been allocated
+    with malloc().  If another thread stored an encoding first, @p buf is
+    freed and the existing encoding is returned instead. */
+    const uint8_t * SetEncoding(uint8_t * buf, size_t len);
 
     /// queue to which any response to this message should be directed
     QueuePointer Queue;
 
-    /// Reference count.
-    unsigned int * RefCount;
-
   private:
     void CreateMessage(const struct player_msghdr & Header,
             void* data,
             bool copy = true);
-	  
+
+    /// Payload encoding cached by a transport.
+    struct Encoding
+    {
+      size_t Length;
+      uint8_t * Data;
+    };
+
+    /// State shared by all copies of a message.
+    struct SharedData
+    {
+      /// Reference count, updated atomically.
+      long RefCount;
+      /// Pointer to the message data, freed with the last reference.
+      uint8_t * Data;
+      /// Cached wire encoding, set at most once.
+      void * volatile Encoded;
+    };
+
     /// message header
     player_msghdr_t Header;
-    /// Pointer to the message data.
+    /// Pointer to the message data (same as Shared->Data).
     uint8_t * Data;
-    /// Used to lock access to Data.
-    pthread_mutex_t * Lock;
+    /// Reference count and payload shared with other copies.
+    SharedData * Shared;
 };
 
 /**
@@ -226,12 +276,18 @@ class PLAYERCORE_EXPORT MessageQueueElement
     /// The message stored in this queue element.
     Message* msg;
   private:
+    /// True if this element (and its message) live in a MessageSlotPool slot.
+    bool pooled;
     /// Pointer to previous queue element.
     MessageQueueElement * prev;
     /// Pointer to next queue element.
     MessageQueueElement * next;
+    /// Neighbours in the queue's signature index bucket (newest first).
+    MessageQueueElement * sig_prev;
+    MessageQueueElement * sig_next;
 
     friend class MessageQueue;
+    friend class MessageSlotPool;
 };
 
 /** We keep a singly-linked list of (addr,type,subtype,replace) tuples.
@@ -366,7 +422,7 @@ class PLAYERCORE_EXPORT MessageQueue
     /** Set the @p Replace flag, which governs whether data and command
     messages of the same subtype from the same device are replaced in
     the queue. */
-    void SetReplace(bool _Replace) { this->Replace = _Replace; };
+    void SetReplace(bool _Replace);
     /** Add a replacement rule to the list.  The first 6 arguments
      * determine the signature that a message will have to match in order
      * for this rule to be applied.  If an incoming message matches this
@@ -404,14 +460,41 @@ class PLAYERCORE_EXPORT MessageQueue
                    int type, int subtype);
     /** Set the @p pull flag */
     void SetPull (bool _pull) { this->pull = _pull; }
+    /** Set the @p wake_watcher.  When set, DataAvailable() also wakes a
+    thread blocked in its FileWatcher::Wait().  Used for queues serviced
+    by a loop around a file watcher, such as client queues and the queues
+    of non-threaded drivers.  NULL (the default) disables it. */
+    void SetWakeWatcher (FileWatcher* _watcher) { this->wake_watcher = _watcher; }
 
     /// @brief Get current length of queue, in elements.
     size_t GetLength(void);
 
+    /** @brief How close a message with header @p hdr would come to being
+    lost, were it pushed now: the length of the queue as a fraction of the
+    length at which data and commands are dropped, or 1 if the message
+    would replace one that is still queued. */
+    double GetBacklog(player_msghdr_t* hdr);
+
     /// @brief Set the data_requested flag
     void SetDataRequested(bool d, bool haveLock);
 
+    /** @brief Select the storage used for newly queued messages.
+    Messages already in the queue are not moved. */
+    void SetBackend(MessageQueueBackend _backend);
+    /// @brief Get the storage used for newly queued messages.
+    MessageQueueBackend GetBackend(void) { return this->backend; }
+    /** @brief Set the backend used by queues created after this call.
+    The server sets this from its command line; individual drivers can
+    override it with the "queue_backend" configuration file option. */
+    static void SetDefaultBackend(MessageQueueBackend _backend);
+    /// @brief Get the backend used by newly created queues.
+    static MessageQueueBackend GetDefaultBackend(void);
+
   private:
+    /// @brief Create a queue element holding a new reference to @p msg.
+    MessageQueueElement* NewElement(Message& msg);
+    /// @brief Destroy an element's message and, if heap allocated, the element.
+    void DeleteElement(MessageQueueElement* el);
     /// @brief Lock the mutex associated with this queue.
     void Lock() {pthread_mutex_lock(&lock);};
     /// @brief Unlock the mutex associated with this queue.
@@ -419,6 +502,21 @@ class PLAYERCORE_EXPORT MessageQueue
     /** Remove element @p el from the queue, and rearrange pointers
     appropriately. */
     void Remove(MessageQueueElement* el);
+    /// @brief CheckReplace(), answered from replaceCache when possible.
+    /// Called with the queue locked.
+    int CachedCheckReplace(player_msghdr_t* hdr);
+    /// @brief Drop all cached replace decisions.
+    void ClearReplaceCache(void);
+    /// @brief Build the signature index from the current contents.
+    void BuildSignatureIndex(void);
+    /// @brief Enter @p el in the signature index, as the newest (@p newest
+    /// true) or the oldest element of its signature.
+    void IndexElement(MessageQueueElement* el, bool newest);
+    /// @brief Find the newest queued message with the same signature as
+    /// @p msg, via the signature index.
+    MessageQueueElement* FindSignature(Message& msg);
+    /// @brief Find the newest queued message with header @p hdr's signature.
+    MessageQueueElement* FindSignature(const player_msghdr_t* hdr);
     /// @brief Head of the queue.
     MessageQueueElement* head;
     /// @brief Tail of the queue.
@@ -429,6 +527,23 @@ class PLAYERCORE_EXPORT MessageQueue
     size_t Maxlen;
     /// @brief Singly-linked list of replacement rules
     MessageReplaceRule* replaceRules;
+    /// @brief Replace decisions by message signature, direct mapped.
+    /// Only used while replaceRules is non-empty; allocated on demand.
+    struct ReplaceCacheEntry
+    {
+      bool valid;
+      player_devaddr_t addr;
+      uint8_t type, subtype;
+      int replace;
+    };
+    ReplaceCacheEntry* replaceCache;
+    /// @brief Hash index from message signature (addr, type, subtype) to the
+    /// queued elements, chained through MessageQueueElement::sig_next.  It
+    /// is built the first time a message is replaced, and kept up to date
+    /// from then on; queues that never replace do not pay for it.
+    MessageQueueElement** sig_buckets;
+    /// @brief Number of buckets in sig_buckets (a power of two).
+    size_t sig_num_buckets;
     /// @brief When a (data or command) message doesn't match a rule in
     /// replaceRules, should we replace it?
     bool Replace;
@@ -452,8 +567,20 @@ class PLAYERCORE_EXPORT MessageQueue
     bool data_requested;
     /// @brief Flag that data was sent (in PULL mode)
     bool data_delivered;
+    /// @brief File watcher to wake when data becomes available
+    FileWatcher* wake_watcher;
     /// @brief Count of the number of messages discarded due to queue overflow.
-    bool drop_count;
+    uint32_t drop_count;
+    /// @brief Storage used for new elements.
+    MessageQueueBackend backend;
+    /// @brief Slot pool used when backend is PLAYER_MSGQUEUE_BACKEND_POOL.
+    MessageSlotPool* pool;
+    /// @brief Backend given to newly created queues.
+    static MessageQueueBackend DefaultBackend;
+    /// @brief Number of QueuePointers referring to this queue.
+    long RefCount;
+
+    friend class QueuePointer;
 };
 
 
@@ -54,8 +54,10 @@
 #include <libplayercore/drivertable.h>
 #include <libplayercore/filewatcher.h>
 #include <libplayercore/globals.h>
+#include <libplayercore/mapgrid.h>
 #include <libplayercore/message.h>
 #include <libplayercore/playertime.h>
+#include <libplayercore/posehistory.h>
 #include <libplayercore/wallclocktime.h>
 #include <libplayercore/property.h>
 #include <playerconfig.h>
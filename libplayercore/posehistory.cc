@@ -0,0 +1,383 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * $Id$
+ *
+ * A shared history of the poses reported by a position device, for
+ * stamping sensor data with the pose at which it was taken.
+ */
+
+#include <config.h>
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libplayercommon/playercommon.h>
+#include <libplayercore/device.h>
+#include <libplayercore/posehistory.h>
+
+// All the histories in the server
+static PoseHistory * posehistory_list = NULL;
+static pthread_mutex_t posehistory_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// computes the signed minimum difference between the two angles.
+static double
+angle_diff(double a, double b)
+{
+  double d1, d2;
+  a = NORMALIZE(a);
+  b = NORMALIZE(b);
+  d1 = a-b;
+  d2 = 2*M_PI - fabs(d1);
+  if(d1 > 0)
+    d2 *= -1.0;
+  if(fabs(d1) < fabs(d2))
+    return(d1);
+  else
+    return(d2);
+}
+
+PoseHistory::PoseHistory(player_devaddr_t addr, int size) :
+  addr(addr),
+  size(size),
+  first(0),
+  count(0),
+  seq(0),
+  refs(1),
+  next(NULL)
+{
+  this->times = new double[size];
+  this->poses = new player_pose2d_t[size];
+  pthread_mutex_init(&this->lock, NULL);
+}
+
+PoseHistory::~PoseHistory()
+{
+  delete [] this->times;
+  delete [] this->poses;
+  pthread_mutex_destroy(&this->lock);
+}
+
+PoseHistory *
+PoseHistory::Get(player_devaddr_t addr, int size)
+{
+  PoseHistory * history;
+
+  if(size < 2)
+    size = 2;
+
+  pthread_mutex_lock(&posehistory_list_lock);
+  for(history = posehistory_list; history; history = history->next)
+  {
+    if(Device::MatchDeviceAddress(history->addr, addr))
+    {
+      history->refs++;
+      break;
+    }
+  }
+  if(!history)
+  {
+    history = new PoseHistory(addr, size);
+    history->next = posehistory_list;
+    posehistory_list = history;
+  }
+  pthread_mutex_unlock(&posehistory_list_lock);
+  return(history);
+}
+
+PoseHistory *
+PoseHistory::Ref()
+{
+  pthread_mutex_lock(&posehistory_list_lock);
+  this->refs++;
+  pthread_mutex_unlock(&posehistory_list_lock);
+  return(this);
+}
+
+void
+PoseHistory::Unref()
+{
+  PoseHistory ** p;
+
+  pthread_mutex_lock(&posehistory_list_lock);
+  if(--this->refs > 0)
+  {
+    pthread_mutex_unlock(&posehistory_list_lock);
+    return;
+  }
+  for(p = &posehistory_list; *p; p = &(*p)->next)
+  {
+    if(*p == this)
+    {
+      *p = this->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&posehistory_list_lock);
+  delete this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The ring is a sequence lock.  Writers take the mutex, which orders the
+// drivers pushing poses, and make the sequence odd while they change the
+// ring; readers take no lock, but copy what they need and try again if
+// the sequence was odd or has changed meanwhile.  Without the atomic
+// builtins, readers take the mutex as well.
+#if HAVE_SYNC_BUILTINS
+static inline unsigned int
+seq_read_begin(volatile unsigned int * seq)
+{
+  unsigned int s;
+
+  while((s = *seq) & 1)
+    ;
+  __sync_synchronize();
+  return(s);
+}
+
+static inline bool
+seq_read_retry(volatile unsigned int * seq, unsigned int s)
+{
+  __sync_synchronize();
+  return(*seq != s);
+}
+
+static inline void
+seq_write(volatile unsigned int * seq)
+{
+  __sync_synchronize();
+  (*seq)++;
+  __sync_synchronize();
+}
+#endif
+
+void
+PoseHistory::Push(double time, const player_pose2d_t & pose)
+{
+  int i;
+
+  pthread_mutex_lock(&this->lock);
+  if(this->count > 0 &&
+     time <= this->times[(this->first + this->count - 1) % this->size])
+  {
+    pthread_mutex_unlock(&this->lock);
+    return;
+  }
+#if HAVE_SYNC_BUILTINS
+  seq_write(&this->seq);
+#endif
+  if(this->count < this->size)
+    i = (this->first + this->count++) % this->size;
+  else
+  {
+    i = this->first;
+    this->first = (this->first + 1) % this->size;
+  }
+  this->times[i] = time;
+  this->poses[i] = pose;
+#if HAVE_SYNC_BUILTINS
+  seq_write(&this->seq);
+#endif
+  pthread_mutex_unlock(&this->lock);
+}
+
+int
+PoseHistory::Lookup(double time, player_pose2d_t * pose)
+{
+  int ret;
+#if HAVE_SYNC_BUILTINS
+  unsigned int s;
+  player_pose2d_t p;
+
+  do
+  {
+    s = seq_read_begin(&this->seq);
+    ret = this->Find(time, &p);
+  } while(seq_read_retry(&this->seq, s));
+  if(ret == POSEHISTORY_OK || ret == POSEHISTORY_EARLIER)
+    *pose = p;
+#else
+  pthread_mutex_lock(&this->lock);
+  ret = this->Find(time, pose);
+  pthread_mutex_unlock(&this->lock);
+#endif
+  return(ret);
+}
+
+int
+PoseHistory::Find(double time, player_pose2d_t * pose)
+{
+  int first, count, lo, hi, mid, i, j;
+  double t;
+
+  // A reader may see the ring half changed; keep to it, and the sequence
+  // check will have the lookup done again
+  first = this->first;
+  count = this->count;
+  if(count <= 0 || count > this->size || first < 0 || first >= this->size)
+    return(POSEHISTORY_EMPTY);
+  if(time > this->times[(first + count - 1) % this->size])
+    return(POSEHISTORY_LATER);
+  if(time < this->times[first])
+  {
+    *pose = this->poses[first];
+    return(POSEHISTORY_EARLIER);
+  }
+
+  // Find the last pose at or before the time; the one after it is after
+  // the time
+  lo = 0;
+  hi = count - 1;
+  while(lo < hi)
+  {
+    mid = (lo + hi + 1) / 2;
+    if(this->times[(first + mid) % this->size] <= time)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  i = (first + lo) % this->size;
+  if(lo == count - 1)
+  {
+    *pose = this->poses[i];
+    return(POSEHISTORY_OK);
+  }
+  j = (i + 1) % this->size;
+
+  // Interpolate between them
+  t = (time - this->times[i]) / (this->times[j] - this->times[i]);
+  pose->px = this->poses[i].px + t * (this->poses[j].px - this->poses[i].px);
+  pose->py = this->poses[i].py + t * (this->poses[j].py - this->poses[i].py);
+  pose->pa = NORMALIZE(this->poses[i].pa +
+                       t * angle_diff(this->poses[j].pa, this->poses[i].pa));
+  return(POSEHISTORY_OK);
+}
+
+int
+PoseHistory::Extrapolate(double time, player_pose2d_t * pose)
+{
+  int ret;
+  player_pose2d_t p;
+#if HAVE_SYNC_BUILTINS
+  unsigned int s;
+
+  do
+  {
+    s = seq_read_begin(&this->seq);
+    ret = this->Before(time, &p);
+  } while(seq_read_retry(&this->seq, s));
+#else
+  pthread_mutex_lock(&this->lock);
+  ret = this->Before(time, &p);
+  pthread_mutex_unlock(&this->lock);
+#endif
+  if(ret == POSEHISTORY_OK)
+    *pose = p;
+  return(ret);
+}
+
+int
+PoseHistory::Before(double time, player_pose2d_t * pose)
+{
+  int first, count, j;
+  double t;
+
+  first = this->first;
+  count = this->count;
+  if(count < 2 || count > this->size || first < 0 || first >= this->size)
+    return(POSEHISTORY_EMPTY);
+  if(time >= this->times[first])
+    return(POSEHISTORY_LATER);
+  j = (first + 1) % this->size;
+  if(this->times[j] <= this->times[first])
+    return(POSEHISTORY_EMPTY);
+  t = (time - this->times[first]) / (this->times[j] - this->times[first]);
+  pose->px = this->poses[first].px +
+    t * (this->poses[j].px - this->poses[first].px);
+  pose->py = this->poses[first].py +
+    t * (this->poses[j].py - this->poses[first].py);
+  pose->pa = NORMALIZE(this->poses[first].pa +
+                       t * angle_diff(this->poses[j].pa,
+                                      this->poses[first].pa));
+  return(POSEHISTORY_OK);
+}
+
+int
+PoseHistory::Latest(double * time, player_pose2d_t * pose)
+{
+  int ret;
+  double t;
+  player_pose2d_t p;
+#if HAVE_SYNC_BUILTINS
+  unsigned int s;
+
+  do
+  {
+    s = seq_read_begin(&this->seq);
+    ret = this->Newest(&t, &p);
+  } while(seq_read_retry(&this->seq, s));
+#else
+  pthread_mutex_lock(&this->lock);
+  ret = this->Newest(&t, &p);
+  pthread_mutex_unlock(&this->lock);
+#endif
+  if(ret == POSEHISTORY_OK)
+  {
+    *time = t;
+    *pose = p;
+  }
+  return(ret);
+}
+
+int
+PoseHistory::Newest(double * time, player_pose2d_t * pose)
+{
+  int first, count, i;
+
+  first = this->first;
+  count = this->count;
+  if(count <= 0 || count > this->size || first < 0 || first >= this->size)
+    return(POSEHISTORY_EMPTY);
+  i = (first + count - 1) % this->size;
+  *time = this->times[i];
+  *pose = this->poses[i];
+  return(POSEHISTORY_OK);
+}
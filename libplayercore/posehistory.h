@@ -0,0 +1,163 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/********************************************************************
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ ********************************************************************/
+
+/*
+ * $Id$
+ *
+ * A shared history of the poses reported by a position device, for
+ * stamping sensor data with the pose at which it was taken.
+ */
+
+#ifndef _POSEHISTORY_H
+#define _POSEHISTORY_H
+
+#if defined (WIN32)
+  #if defined (PLAYER_STATIC)
+    #define PLAYERCORE_EXPORT
+  #elif defined (playercore_EXPORTS)
+    #define PLAYERCORE_EXPORT    __declspec (dllexport)
+  #else
+    #define PLAYERCORE_EXPORT    __declspec (dllimport)
+  #endif
+#else
+  #define PLAYERCORE_EXPORT
+#endif
+
+#include <pthread.h>
+
+#include <libplayerinterface/player.h>
+
+/// Lookup() results: the pose was interpolated between two in the history
+#define POSEHISTORY_OK 0
+/// Lookup() results: the time is before the oldest pose; that pose is given
+#define POSEHISTORY_EARLIER 1
+/// Lookup() results: the time is after the newest pose, so there is no
+/// pose for it yet
+#define POSEHISTORY_LATER 2
+/// Lookup() results: there are no poses
+#define POSEHISTORY_EMPTY -1
+
+/**
+@brief A time-indexed history of the poses of a position device.
+
+The last few poses reported by a position device are kept in a ring,
+oldest first, and the pose at any time within the ring is found by a
+binary search and linear interpolation.  A driver that stamps sensor
+data with poses can then stamp each piece of data as it arrives, as long
+as the poses either side of it have been seen, instead of holding the
+data until the next pose comes in.
+
+The history of each position device is shared by all the drivers in the
+server that use it; get it with PoseHistory::Get().  Each driver pushes
+the poses it receives; a pose no newer than the newest in the history is
+ignored, so the same pose pushed by several drivers is only kept once.
+*/
+class PLAYERCORE_EXPORT PoseHistory
+{
+  public:
+    /** @brief Get the history of a position device.
+
+    The history is made if there is not one already, with room for
+    @p size poses; otherwise the existing one is returned, whatever its
+    size.
+
+    @returns A new reference, which the caller must Unref(). */
+    static PoseHistory * Get(player_devaddr_t addr, int size);
+
+    /** @brief Add a reference.  @returns this */
+    PoseHistory * Ref();
+
+    /** @brief Drop a reference; the history is deleted with the last one. */
+    void Unref();
+
+    /** @brief Add the pose at @p time, dropping the oldest if full.
+
+    Poses must come in time order; one no newer than the newest is
+    ignored. */
+    void Push(double time, const player_pose2d_t & pose);
+
+    /** @brief Find the pose at @p time.
+
+    @returns POSEHISTORY_OK with the interpolated pose,
+    POSEHISTORY_EARLIER with the oldest pose, or POSEHISTORY_LATER or
+    POSEHISTORY_EMPTY, leaving @p pose unchanged. */
+    int Lookup(double time, player_pose2d_t * pose);
+
+    /** @brief Find the pose at @p time, before the oldest pose, by
+    extending the line through the oldest two.
+
+    @returns POSEHISTORY_OK with the extrapolated pose, POSEHISTORY_LATER
+    if the time is not before the oldest pose, or POSEHISTORY_EMPTY if
+    there are fewer than two poses, leaving @p pose unchanged. */
+    int Extrapolate(double time, player_pose2d_t * pose);
+
+    /** @brief Get the newest pose and its time.
+
+    @returns POSEHISTORY_OK, or POSEHISTORY_EMPTY if there are no poses. */
+    int Latest(double * time, player_pose2d_t * pose);
+
+    /// The position device
+    const player_devaddr_t addr;
+
+  private:
+    // Only Get() makes, and only Unref() deletes, a history
+    PoseHistory(player_devaddr_t addr, int size);
+    ~PoseHistory();
+
+    // Look up, extrapolate and get the newest pose, without locking
+    int Find(double time, player_pose2d_t * pose);
+    int Before(double time, player_pose2d_t * pose);
+    int Newest(double * time, player_pose2d_t * pose);
+
+    // The ring: count poses, the oldest at first.  Pushes take the lock;
+    // lookups check the sequence, which is odd while the ring changes.
+    int size;
+    volatile int first, count;
+    double * times;
+    player_pose2d_t * poses;
+    pthread_mutex_t lock;
+    volatile unsigned int seq;
+
+    // References, and the next history of the list of them all; both
+    // are guarded by the lock on the list
+    int refs;
+    PoseHistory * next;
+};
+
+#endif
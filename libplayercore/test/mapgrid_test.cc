@@ -0,0 +1,160 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Shared map grid tests.  Fetches the grid of a map driver that
+ *       shares it and of one that only answers tile requests, and checks
+ *       that the cells match and that the shared grid outlives its driver.
+ * Usage: mapgrid_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayercommon/test/test.h>
+
+// A map driver serving a fixed grid, which it may or may not share
+class TestMap : public Driver
+{
+  public:
+    TestMap(int index, bool share, unsigned int width, unsigned int height)
+      : Driver(NULL, -1), share(share), grid(NULL), requests(0)
+    {
+      memset(&this->addr, 0, sizeof(this->addr));
+      this->addr.interf = PLAYER_MAP_CODE;
+      this->addr.index = index;
+      this->AddInterface(this->addr);
+
+      memset(&this->info, 0, sizeof(this->info));
+      this->info.scale = 0.05;
+      this->info.width = width;
+      this->info.height = height;
+      this->info.origin.px = -1.0;
+      this->info.origin.py = 2.0;
+    }
+
+    int Setup()
+    {
+      int8_t * cells = new int8_t[this->info.width * this->info.height];
+      for (unsigned int i = 0; i < this->info.width * this->info.height; i++)
+        cells[i] = (int8_t) ((i * 7 + i / this->info.width) % 3) - 1;
+      this->grid = new MapGrid(this->info, cells);
+      return 0;
+    }
+
+    int Shutdown()
+    {
+      this->grid->Unref();
+      this->grid = NULL;
+      return 0;
+    }
+
+    MapGrid * GetMapGrid(player_devaddr_t /*addr*/)
+    {
+      return this->share && this->grid ? this->grid->Ref() : NULL;
+    }
+
+    int ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr, void * data)
+    {
+      if (Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ, PLAYER_MAP_REQ_GET_INFO, this->addr))
+      {
+        this->requests++;
+        this->Publish(this->addr, resp_queue, PLAYER_MSGTYPE_RESP_ACK,
+                      PLAYER_MAP_REQ_GET_INFO, &this->info, sizeof(this->info), NULL);
+        return 0;
+      }
+      if (Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ, PLAYER_MAP_REQ_GET_DATA, this->addr))
+      {
+        player_map_data_t * req = (player_map_data_t *) data;
+        player_map_data_t resp = *req;
+        this->requests++;
+        resp.data_count = req->width * req->height;
+        resp.data = new int8_t[resp.data_count];
+        for (unsigned int j = 0; j < req->height; j++)
+          memcpy(resp.data + j * req->width,
+                 this->grid->cells + (req->row + j) * this->info.width + req->col,
+                 req->width);
+        this->Publish(this->addr, resp_queue, PLAYER_MSGTYPE_RESP_ACK,
+                      PLAYER_MAP_REQ_GET_DATA, &resp);
+        delete [] resp.data;
+        return 0;
+      }
+      return -1;
+    }
+
+    player_devaddr_t addr;
+    player_map_info_t info;
+    bool share;
+    MapGrid * grid;
+    int requests;
+};
+
+static bool same_info(const player_map_info_t & a, const player_map_info_t & b)
+{
+  return a.scale == b.scale && a.width == b.width && a.height == b.height &&
+    a.origin.px == b.origin.px && a.origin.py == b.origin.py;
+}
+
+int main(int argc, char ** argv)
+{
+  playerxdr_ftable_init();
+  ErrorInit(1, NULL);
+  player_globals_init();
+
+  QueuePointer queue(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  TestMap * shared = new TestMap(0, true, 1500, 900);
+  TestMap * tiled = new TestMap(1, false, 1500, 900);
+  Device * shared_dev = deviceTable->GetDevice(shared->addr);
+  Device * tiled_dev = deviceTable->GetDevice(tiled->addr);
+
+  shared_dev->Subscribe(queue);
+  tiled_dev->Subscribe(queue);
+
+  TEST("shared grid is handed over without requests");
+  MapGrid * a = MapGrid::Fetch(shared_dev, queue);
+  check(a == shared->grid && shared->requests == 0);
+
+  TEST("unshared grid is fetched in tiles");
+  MapGrid * b = MapGrid::Fetch(tiled_dev, queue);
+  // one info request, and 3 x 2 tiles of at most 640 x 640
+  check(b != NULL && b != tiled->grid && tiled->requests == 7);
+
+  TEST("both grids have the map's info and cells");
+  check(a && b && same_info(a->info, shared->info) && same_info(b->info, tiled->info) &&
+        memcmp(a->cells, shared->grid->cells, 1500 * 900) == 0 &&
+        memcmp(b->cells, tiled->grid->cells, 1500 * 900) == 0);
+
+  TEST("shared grid outlives its driver's shutdown");
+  shared_dev->Unsubscribe(queue);
+  tiled_dev->Unsubscribe(queue);
+  bool ok = shared->grid == NULL && a && b && memcmp(a->cells, b->cells, 1500 * 900) == 0;
+  check(ok);
+
+  if (a)
+    a->Unref();
+  if (b)
+    b->Unref();
+
+  return test_result();
+}
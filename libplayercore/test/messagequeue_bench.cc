@@ -0,0 +1,119 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Message queue micro-benchmark.  One producer publishes position2d
+ *       data to a set of queues, each drained by its own consumer thread,
+ *       once per queue backend.
+ * Usage: messagequeue_bench [queues] [messages]
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+
+struct consumer_t
+{
+  QueuePointer queue;
+  volatile bool done;
+  pthread_t thread;
+};
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void * consume(void * arg)
+{
+  consumer_t * c = (consumer_t*)arg;
+  for (;;)
+  {
+    Message * msg = c->queue->Pop();
+    if (msg)
+    {
+      delete msg;
+      continue;
+    }
+    if (c->done)
+      break;
+    c->queue->Wait(0.001);
+  }
+  return NULL;
+}
+
+static double run(MessageQueueBackend backend, int numqueues, int nummsgs)
+{
+  MessageQueue::SetDefaultBackend(backend);
+  consumer_t * consumers = new consumer_t[numqueues];
+  for (int i = 0; i < numqueues; i++)
+  {
+    consumers[i].queue = QueuePointer(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+    consumers[i].done = false;
+    pthread_create(&consumers[i].thread, NULL, consume, &consumers[i]);
+  }
+
+  player_msghdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.addr.interf = PLAYER_POSITION2D_CODE;
+  hdr.type = PLAYER_MSGTYPE_DATA;
+  hdr.subtype = PLAYER_POSITION2D_DATA_STATE;
+  player_position2d_data_t data;
+  memset(&data, 0, sizeof(data));
+
+  double start = now();
+  for (int n = 0; n < nummsgs; n++)
+  {
+    data.pos.px = n;
+    Message msg(hdr, &data);
+    for (int i = 0; i < numqueues; i++)
+      consumers[i].queue->Push(msg);
+  }
+  for (int i = 0; i < numqueues; i++)
+  {
+    consumers[i].done = true;
+    consumers[i].queue->DataAvailable();
+    pthread_join(consumers[i].thread, NULL);
+  }
+  double elapsed = now() - start;
+  delete [] consumers;
+  return (double)nummsgs * numqueues / elapsed;
+}
+
+int main(int argc, char ** argv)
+{
+  int numqueues = argc > 1 ? atoi(argv[1]) : 30;
+  int nummsgs = argc > 2 ? atoi(argv[2]) : 100000;
+
+  playerxdr_ftable_init();
+  ErrorInit(1, NULL);
+
+  printf("%d queues, %d messages per queue\n", numqueues, nummsgs);
+  printf("list: %12.0f pushes/s\n", run(PLAYER_MSGQUEUE_BACKEND_LIST, numqueues, nummsgs));
+  printf("pool: %12.0f pushes/s\n", run(PLAYER_MSGQUEUE_BACKEND_POOL, numqueues, nummsgs));
+  return 0;
+}
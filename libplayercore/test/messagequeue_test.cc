@@ -0,0 +1,234 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Message queue replacement tests.  Checks the replace, ignore and
+ *       accept rules of MessageQueue::Push, for each queue backend.
+ * Usage: messagequeue_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayercommon/test/test.h>
+
+// Push a position2d message with the given index, type, subtype and value.
+// The value is the first field (pos.px or pose.px) of every payload used
+// here; the buffer is large enough for any of them.
+static void push(QueuePointer & q, int index, uint8_t type, uint8_t subtype, double value)
+{
+  player_msghdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.addr.interf = PLAYER_POSITION2D_CODE;
+  hdr.addr.index = index;
+  hdr.type = type;
+  hdr.subtype = subtype;
+  double payload[32];
+  memset(payload, 0, sizeof(payload));
+  payload[0] = value;
+  Message msg(hdr, payload);
+  q->Push(msg);
+}
+
+static void push_data(QueuePointer & q, int index, double value)
+{
+  push(q, index, PLAYER_MSGTYPE_DATA, PLAYER_POSITION2D_DATA_STATE, value);
+}
+
+// Pop everything and compare the payload values with the expected ones.
+static bool drain(QueuePointer & q, const double * expected, int count)
+{
+  bool ok = true;
+  int n = 0;
+  Message * msg;
+  while ((msg = q->Pop()) != NULL)
+  {
+    double value = *(double*)msg->GetPayload();
+    if (n >= count || value != expected[n])
+      ok = false;
+    n++;
+    delete msg;
+  }
+  return ok && n == count;
+}
+
+static void run(MessageQueueBackend backend)
+{
+  MessageQueue::SetDefaultBackend(backend);
+
+  TEST("accept by default when replace is off");
+  {
+    QueuePointer q(false, 32);
+    push_data(q, 0, 1);
+    push_data(q, 0, 2);
+    push_data(q, 0, 3);
+    double expected[] = {1, 2, 3};
+    check(drain(q, expected, 3));
+  }
+
+  TEST("replace data of the same signature");
+  {
+    QueuePointer q(true, 32);
+    push_data(q, 0, 1);
+    push_data(q, 1, 2);
+    push_data(q, 0, 3);
+    push(q, 0, PLAYER_MSGTYPE_DATA, PLAYER_POSITION2D_DATA_GEOM, 4);
+    push_data(q, 1, 5);
+    double expected[] = {3, 4, 5};
+    check(drain(q, expected, 3));
+  }
+
+  TEST("never replace requests by default");
+  {
+    QueuePointer q(true, 32);
+    push(q, 0, PLAYER_MSGTYPE_REQ, PLAYER_POSITION2D_REQ_GET_GEOM, 1);
+    push(q, 0, PLAYER_MSGTYPE_REQ, PLAYER_POSITION2D_REQ_GET_GEOM, 2);
+    double expected[] = {1, 2};
+    check(drain(q, expected, 2));
+  }
+
+  TEST("ignore rule drops messages");
+  {
+    QueuePointer q(false, 32);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 1, PLAYER_MSGTYPE_DATA, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_IGNORE);
+    push_data(q, 0, 1);
+    push_data(q, 1, 2);
+    push_data(q, 0, 3);
+    double expected[] = {1, 3};
+    check(drain(q, expected, 2));
+  }
+
+  TEST("rules override the replace flag");
+  {
+    QueuePointer q(true, 32);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 1, -1, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_ACCEPT);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 0,
+                      PLAYER_MSGTYPE_REQ, PLAYER_POSITION2D_REQ_GET_GEOM,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_REPLACE);
+    push_data(q, 1, 1);
+    push_data(q, 1, 2);
+    push(q, 0, PLAYER_MSGTYPE_REQ, PLAYER_POSITION2D_REQ_GET_GEOM, 3);
+    push(q, 0, PLAYER_MSGTYPE_REQ, PLAYER_POSITION2D_REQ_GET_GEOM, 4);
+    push_data(q, 2, 5);
+    push_data(q, 2, 6);
+    double expected[] = {1, 2, 4, 6};
+    check(drain(q, expected, 4));
+  }
+
+  TEST("changing a rule takes effect immediately");
+  {
+    QueuePointer q(false, 32);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 0, -1, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_REPLACE);
+    push_data(q, 0, 1);
+    push_data(q, 0, 2);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 0, -1, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_ACCEPT);
+    push_data(q, 0, 3);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 0, -1, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_IGNORE);
+    push_data(q, 0, 4);
+    double expected[] = {2, 3};
+    check(drain(q, expected, 2));
+  }
+
+  TEST("changing the replace flag takes effect immediately");
+  {
+    QueuePointer q(false, 32);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 5, -1, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_IGNORE);
+    push_data(q, 0, 1);
+    push_data(q, 0, 2);
+    q->SetReplace(true);
+    push_data(q, 0, 3);
+    double expected[] = {1, 3};
+    check(drain(q, expected, 2));
+  }
+
+  TEST("replace the newest of several queued duplicates");
+  {
+    QueuePointer q(false, 32);
+    push_data(q, 0, 1);
+    push_data(q, 1, 2);
+    push_data(q, 0, 3);
+    q->SetReplace(true);
+    push_data(q, 0, 4);
+    push_data(q, 0, 5);
+    double expected[] = {1, 2, 5};
+    check(drain(q, expected, 3));
+  }
+
+  TEST("replace after pops and front pushes");
+  {
+    QueuePointer q(true, 32);
+    push_data(q, 0, 1);
+    push_data(q, 1, 2);
+    delete q->Pop();
+    push_data(q, 0, 3);
+    push_data(q, 1, 4);
+    player_msghdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.addr.interf = PLAYER_POSITION2D_CODE;
+    hdr.addr.index = 2;
+    hdr.type = PLAYER_MSGTYPE_DATA;
+    hdr.subtype = PLAYER_POSITION2D_DATA_STATE;
+    player_position2d_data_t data;
+    memset(&data, 0, sizeof(data));
+    data.pos.px = 5;
+    Message front(hdr, &data);
+    q->PushFront(front, false);
+    push_data(q, 2, 6);
+    push_data(q, 0, 7);
+    double expected[] = {4, 6, 7};
+    check(drain(q, expected, 3));
+  }
+
+  TEST("replace when the queue is full, drop otherwise");
+  {
+    QueuePointer q(false, 2);
+    q->AddReplaceRule(-1, -1, PLAYER_POSITION2D_CODE, 0, -1, -1,
+                      PLAYER_PLAYER_MSG_REPLACE_RULE_REPLACE);
+    push_data(q, 0, 1);
+    push_data(q, 1, 2);
+    push_data(q, 1, 3);
+    push_data(q, 0, 4);
+    double expected[] = {2, 4};
+    check(drain(q, expected, 2));
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  playerxdr_ftable_init();
+  ErrorInit(1, NULL);
+
+  printf("list backend:\n");
+  run(PLAYER_MSGQUEUE_BACKEND_LIST);
+  printf("pool backend:\n");
+  run(PLAYER_MSGQUEUE_BACKEND_POOL);
+
+  return test_result();
+}
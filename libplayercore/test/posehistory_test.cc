@@ -0,0 +1,173 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Pose history tests.  Checks interpolation, the ends of the
+ *       history, wrapping round the ring, sharing between users and
+ *       lookups while another thread pushes.
+ * Usage: posehistory_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayercommon/test/test.h>
+
+static player_pose2d_t pose(double px, double py, double pa)
+{
+  player_pose2d_t p;
+  p.px = px;
+  p.py = py;
+  p.pa = pa;
+  return p;
+}
+
+static bool near(const player_pose2d_t & a, const player_pose2d_t & b)
+{
+  return fabs(a.px - b.px) < 1e-9 && fabs(a.py - b.py) < 1e-9 &&
+    fabs(a.pa - b.pa) < 1e-9;
+}
+
+// Push poses at x = t while the main thread looks them up
+#define PUSHES 200000
+
+static void * pusher(void * arg)
+{
+  PoseHistory * history = (PoseHistory *) arg;
+  int i;
+
+  for (i = 1; i <= PUSHES; i++)
+    history->Push(i, pose(i, 2 * i, 0));
+  return NULL;
+}
+
+int main()
+{
+  player_devaddr_t addr, other;
+  PoseHistory * history, * shared;
+  player_pose2d_t p;
+  double t;
+  int i;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.interf = PLAYER_POSITION2D_CODE;
+  other = addr;
+  other.index = 1;
+
+  history = PoseHistory::Get(addr, 4);
+
+  TEST("empty history");
+  check(history->Lookup(1.0, &p) == POSEHISTORY_EMPTY &&
+        history->Latest(&t, &p) == POSEHISTORY_EMPTY);
+
+  history->Push(1.0, pose(0, 0, 0));
+  history->Push(2.0, pose(2, 4, 1));
+
+  TEST("interpolating between poses");
+  check(history->Lookup(1.25, &p) == POSEHISTORY_OK &&
+        near(p, pose(0.5, 1, 0.25)));
+
+  TEST("exactly on a pose");
+  check(history->Lookup(2.0, &p) == POSEHISTORY_OK && near(p, pose(2, 4, 1)) &&
+        history->Lookup(1.0, &p) == POSEHISTORY_OK && near(p, pose(0, 0, 0)));
+
+  TEST("before the oldest pose");
+  check(history->Lookup(0.5, &p) == POSEHISTORY_EARLIER &&
+        near(p, pose(0, 0, 0)));
+
+  TEST("extrapolating before the oldest pose");
+  check(history->Extrapolate(0.5, &p) == POSEHISTORY_OK &&
+        near(p, pose(-1, -2, -0.5)) &&
+        history->Extrapolate(1.5, &p) == POSEHISTORY_LATER);
+
+  TEST("after the newest pose");
+  p = pose(9, 9, 9);
+  check(history->Lookup(2.5, &p) == POSEHISTORY_LATER && near(p, pose(9, 9, 9)));
+
+  TEST("interpolating across +/-pi");
+  history->Push(3.0, pose(2, 4, M_PI - 0.1));
+  history->Push(4.0, pose(2, 4, -M_PI + 0.1));
+  check(history->Lookup(3.5, &p) == POSEHISTORY_OK &&
+        (fabs(fabs(p.pa) - M_PI) < 1e-9));
+
+  TEST("ignoring poses no newer than the newest");
+  history->Push(4.0, pose(7, 7, 7));
+  history->Push(3.5, pose(7, 7, 7));
+  check(history->Latest(&t, &p) == POSEHISTORY_OK && t == 4.0 &&
+        near(p, pose(2, 4, -M_PI + 0.1)));
+
+  TEST("dropping the oldest poses when full");
+  for (i = 5; i <= 10; i++)
+    history->Push(i, pose(i, 0, 0));
+  check(history->Lookup(6.5, &p) == POSEHISTORY_EARLIER &&
+        near(p, pose(7, 0, 0)) &&
+        history->Lookup(9.75, &p) == POSEHISTORY_OK &&
+        near(p, pose(9.75, 0, 0)));
+
+  TEST("sharing the history of a device");
+  shared = PoseHistory::Get(addr, 100);
+  check(shared == history &&
+        shared->Latest(&t, &p) == POSEHISTORY_OK && t == 10.0);
+  shared->Unref();
+
+  TEST("separate histories for separate devices");
+  shared = PoseHistory::Get(other, 4);
+  check(shared != history &&
+        shared->Latest(&t, &p) == POSEHISTORY_EMPTY);
+  shared->Unref();
+
+  TEST("a new history once the last user is gone");
+  history->Unref();
+  history = PoseHistory::Get(addr, 4);
+  check(history->Latest(&t, &p) == POSEHISTORY_EMPTY);
+
+  TEST("no extrapolating from a single pose");
+  history->Push(1.0, pose(0, 0, 0));
+  check(history->Extrapolate(0.5, &p) == POSEHISTORY_EMPTY);
+  history->Unref();
+
+  TEST("lookups while another thread pushes");
+  pthread_t thread;
+  bool ok = true;
+  int result;
+  history = PoseHistory::Get(addr, 16);
+  t = 0;
+  pthread_create(&thread, NULL, pusher, history);
+  do
+  {
+    if (history->Latest(&t, &p) != POSEHISTORY_OK)
+      continue;
+    ok = ok && p.px == t && p.py == 2 * t;
+    result = history->Lookup(t - 7.25, &p);
+    ok = ok && (result == POSEHISTORY_EARLIER ||
+                (result == POSEHISTORY_OK && near(p, pose(t - 7.25,
+                                                          2 * (t - 7.25), 0))));
+  } while (t < PUSHES);
+  pthread_join(thread, NULL);
+  check(ok);
+  history->Unref();
+
+  return test_result();
+}
@@ -0,0 +1,93 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Message fan-out micro-benchmark.  Publishes a 1081 beam ranger
+ *       scan to 1, 8 and 64 queues, the way Driver::Publish does, and
+ *       reports the cost per publish including draining the queues.
+ * Usage: publish_bench [iterations]
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static double run(MessageQueueBackend backend, int numqueues, int iterations)
+{
+  MessageQueue::SetDefaultBackend(backend);
+  QueuePointer owner(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  QueuePointer * queues = new QueuePointer[numqueues];
+  for (int i = 0; i < numqueues; i++)
+    queues[i] = QueuePointer(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+
+  player_msghdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.addr.interf = PLAYER_RANGER_CODE;
+  hdr.type = PLAYER_MSGTYPE_DATA;
+  hdr.subtype = PLAYER_RANGER_DATA_RANGE;
+  player_ranger_data_range_t data;
+  double ranges[1081];
+  for (int i = 0; i < 1081; i++)
+    ranges[i] = i * 0.01;
+  data.ranges_count = 1081;
+  data.ranges = ranges;
+
+  double start = now();
+  for (int n = 0; n < iterations; n++)
+  {
+    {
+      Message msg(hdr, &data, owner);
+      for (int i = 0; i < numqueues; i++)
+        queues[i]->Push(msg);
+    }
+    for (int i = 0; i < numqueues; i++)
+      delete queues[i]->Pop();
+  }
+  double elapsed = now() - start;
+  delete [] queues;
+  return elapsed * 1e9 / iterations;
+}
+
+int main(int argc, char ** argv)
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  int counts[] = {1, 8, 64};
+
+  playerxdr_ftable_init();
+  ErrorInit(1, NULL);
+
+  printf("queues   list ns/publish   pool ns/publish\n");
+  for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    printf("%6d %17.0f %17.0f\n", counts[i],
+           run(PLAYER_MSGQUEUE_BACKEND_LIST, counts[i], iterations),
+           run(PLAYER_MSGQUEUE_BACKEND_POOL, counts[i], iterations));
+  return 0;
+}
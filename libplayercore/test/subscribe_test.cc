@@ -0,0 +1,288 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: Subscription tests.  Two client threads, as with "player -t 2",
+ *       subscribe to a non-threaded driver A whose Setup() subscribes to
+ *       another non-threaded driver B, while the server thread updates B
+ *       and B's Update() makes requests of A.  Checks that this does not
+ *       deadlock and that Setup() and Shutdown() never run alongside
+ *       Update().
+ * Usage: subscribe_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayercommon/test/test.h>
+
+#define TEST_HOST 16777343
+#define TEST_ROBOT 6665
+#define WORKERS 2
+#define ROUNDS 200
+
+static pthread_mutex_t request_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Number of workers unsubscribing from A, during which B makes no requests
+static int pausers;
+static volatile bool done;
+static Device *adev, *bdev;
+
+// A non-threaded driver that counts any Setup() or Shutdown() running
+// alongside its Update()
+class TestDriver : public Driver
+{
+  public:
+    TestDriver(int index) : Driver(NULL, 0, false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN)
+    {
+      memset(&this->addr, 0, sizeof(this->addr));
+      this->addr.host = TEST_HOST;
+      this->addr.robot = TEST_ROBOT;
+      this->addr.interf = PLAYER_POSITION2D_CODE;
+      this->addr.index = index;
+      pthread_mutex_init(&this->mutex, NULL);
+      this->setting_up = this->updating = this->overlaps = 0;
+      this->setups = this->shutdowns = 0;
+      if(this->AddInterface(this->addr) != 0)
+        this->SetError(-1);
+    }
+
+    virtual void Update()
+    {
+      this->Enter(false);
+      this->ProcessMessages();
+      this->Poll();
+      this->Leave(false);
+    }
+
+    int SettingUp()
+    {
+      pthread_mutex_lock(&this->mutex);
+      int n = this->setting_up;
+      pthread_mutex_unlock(&this->mutex);
+      return n;
+    }
+
+    player_devaddr_t addr;
+    int overlaps, setups, shutdowns;
+
+  protected:
+    virtual void Poll() {}
+
+    void Enter(bool setup)
+    {
+      pthread_mutex_lock(&this->mutex);
+      if(setup ? this->updating : this->setting_up)
+        this->overlaps++;
+      if(setup)
+        this->setting_up++;
+      else
+        this->updating++;
+      pthread_mutex_unlock(&this->mutex);
+    }
+
+    void Leave(bool setup)
+    {
+      pthread_mutex_lock(&this->mutex);
+      if(setup)
+        this->setting_up--;
+      else
+        this->updating--;
+      pthread_mutex_unlock(&this->mutex);
+    }
+
+    pthread_mutex_t mutex;
+    int setting_up, updating;
+};
+
+// The driver at the end of the chain; its Update() asks A to reset its
+// odometry while A is subscribed or being set up
+class ChainEnd : public TestDriver
+{
+  public:
+    ChainEnd() : TestDriver(1), requests(0), replies(0), during_setup(0)
+    {
+      this->alwaysupdate = true;
+    }
+
+    int requests, replies, during_setup;
+
+  protected:
+    virtual void Poll();
+};
+
+// The driver that subscribes to B while it is set up
+class ChainStart : public TestDriver
+{
+  public:
+    ChainStart() : TestDriver(0), active(false) {}
+
+    virtual int Setup()
+    {
+      this->Enter(true);
+      pthread_mutex_lock(&request_mutex);
+      this->active = true;
+      pthread_mutex_unlock(&request_mutex);
+      int ret = bdev->Subscribe(this->InQueue);
+      // Give B's Update() time to make a request meanwhile
+      usleep(2000);
+      this->setups++;
+      this->Leave(true);
+      return ret;
+    }
+
+    virtual int Shutdown()
+    {
+      this->Enter(true);
+      pthread_mutex_lock(&request_mutex);
+      this->active = false;
+      pthread_mutex_unlock(&request_mutex);
+      int ret = bdev->Unsubscribe(this->InQueue);
+      this->shutdowns++;
+      this->Leave(true);
+      return ret;
+    }
+
+    virtual int ProcessMessage(QueuePointer &resp_queue,
+                               player_msghdr *hdr, void *data)
+    {
+      if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ,
+                               PLAYER_POSITION2D_REQ_RESET_ODOM, this->addr))
+      {
+        this->Publish(this->addr, resp_queue, PLAYER_MSGTYPE_RESP_ACK,
+                      PLAYER_POSITION2D_REQ_RESET_ODOM);
+        return 0;
+      }
+      return -1;
+    }
+
+    bool active;
+};
+
+static ChainStart *a;
+static ChainEnd *b;
+
+void ChainEnd::Poll()
+{
+  // Hold the lock across the request, so that no worker shuts A down
+  // while it waits for the answer
+  pthread_mutex_lock(&request_mutex);
+  if(a->active && !pausers)
+  {
+    if(a->SettingUp())
+      this->during_setup++;
+    this->requests++;
+    Message *msg = adev->Request(this->InQueue, PLAYER_MSGTYPE_REQ,
+                                 PLAYER_POSITION2D_REQ_RESET_ODOM,
+                                 NULL, 0, NULL, false);
+    if(msg)
+    {
+      this->replies++;
+      delete msg;
+    }
+  }
+  pthread_mutex_unlock(&request_mutex);
+}
+
+// The server thread
+static void *server(void *)
+{
+  while(!done)
+    deviceTable->UpdateDevices();
+  return NULL;
+}
+
+// A client I/O thread, subscribing to A and unsubscribing again
+static void *worker(void *)
+{
+  QueuePointer queue(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  for(int i = 0; i < ROUNDS; i++)
+  {
+    adev->Subscribe(queue);
+    usleep(rand() % 1000);
+    pthread_mutex_lock(&request_mutex);
+    pausers++;
+    pthread_mutex_unlock(&request_mutex);
+    adev->Unsubscribe(queue);
+    pthread_mutex_lock(&request_mutex);
+    pausers--;
+    pthread_mutex_unlock(&request_mutex);
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  pthread_t server_thread, worker_threads[WORKERS];
+  int i;
+
+  playerxdr_ftable_init();
+  itable_init();
+  ErrorInit(0, NULL);
+  player_globals_init();
+
+  a = new ChainStart();
+  b = new ChainEnd();
+  TEST("make the drivers");
+  check(a->GetError() == 0 && b->GetError() == 0);
+  if(a->GetError() != 0 || b->GetError() != 0)
+    return test_result();
+  adev = deviceTable->GetDevice(a->addr, false);
+  bdev = deviceTable->GetDevice(b->addr, false);
+
+  // Keep B subscribed throughout, as a client would
+  QueuePointer queue(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  bdev->Subscribe(queue);
+
+  // Give up on a deadlock, rather than hang the tests
+  alarm(60);
+
+  TEST("subscribe chained drivers from two threads while updating");
+  pthread_create(&server_thread, NULL, server, NULL);
+  for(i = 0; i < WORKERS; i++)
+    pthread_create(&worker_threads[i], NULL, worker, NULL);
+  for(i = 0; i < WORKERS; i++)
+    pthread_join(worker_threads[i], NULL);
+  done = true;
+  pthread_join(server_thread, NULL);
+  check(b->requests > 0 && b->replies == b->requests);
+
+  TEST("request of a driver while it is set up");
+  check(b->during_setup > 0);
+
+  TEST("never set up or shut down a driver while it updates");
+  check(a->overlaps == 0 && b->overlaps == 0);
+
+  TEST("shut down after the last unsubscribe");
+  check(!a->HasSubscriptions() && a->setups > 0 &&
+        a->setups == a->shutdowns);
+
+  TEST("poll only while an alwaysupdate driver is subscribed");
+  bool polling = deviceTable->HaveAlwaysUpdateDrivers();
+  bdev->Unsubscribe(queue);
+  check(polling && !deviceTable->HaveAlwaysUpdateDrivers());
+
+  return test_result();
+}
@@ -82,6 +82,8 @@ ThreadedDriver::ThreadedDriver(ConfigFile *cf, int section, bool overwrite_cmds,
 	ThreadState(PLAYER_THREAD_STATE_STOPPED)
 {
 	memset (&driverthread, 0, sizeof (driverthread));
+	// our own thread services the queue, not the server loop
+	InQueue->SetWakeWatcher(NULL);
 }
 
 // this is the other constructor, used by multi-interface drivers.
@@ -90,6 +92,8 @@ ThreadedDriver::ThreadedDriver(ConfigFile *cf, int section, bool overwrite_cmds,
 	ThreadState(PLAYER_THREAD_STATE_STOPPED)
 {
 	memset (&driverthread, 0, sizeof (driverthread));
+	// our own thread services the queue, not the server loop
+	InQueue->SetWakeWatcher(NULL);
 }
 
 // destructor, to free up allocated queue.
@@ -129,10 +129,103 @@ static playerxdr_function_t init_ftable[] =
 static playerxdr_function_t* ftable=NULL;
 static int ftable_len=0;
 
+// Number of message types covered by the lookup index.  Messages with a
+// larger type are still found, by searching ftable.
+#define PLAYERXDR_FTINDEX_NUM_TYPES 8
+
+// Dense lookup index over ftable.  For every interface code there is one
+// row per message type, indexed by subtype; each slot holds the position
+// of the matching ftable entry plus one, or 0 if there is none.  Rows are
+// only as long as the largest subtype registered for them.
+typedef struct
+{
+  int* slots[PLAYERXDR_FTINDEX_NUM_TYPES];
+  int len[PLAYERXDR_FTINDEX_NUM_TYPES];
+} playerxdr_ftindex_t;
+
+static playerxdr_ftindex_t* ftindex=NULL;
+static int ftindex_len=0;
+
+// Enter ftable[pos] in the index.  If an entry with the same signature is
+// already indexed, the earlier one wins, as it would in a scan of ftable.
+static void
+playerxdr_ftindex_add(int pos)
+{
+  playerxdr_function_t* f = ftable + pos;
+  playerxdr_ftindex_t* row;
+
+  if(f->type >= PLAYERXDR_FTINDEX_NUM_TYPES)
+    return;
+
+  if(f->interf >= ftindex_len)
+  {
+    ftindex = (playerxdr_ftindex_t*)realloc(ftindex,
+                                            (f->interf+1)*
+                                            sizeof(playerxdr_ftindex_t));
+    assert(ftindex);
+    memset(ftindex + ftindex_len, 0,
+           (f->interf+1-ftindex_len)*sizeof(playerxdr_ftindex_t));
+    ftindex_len = f->interf+1;
+  }
+
+  row = ftindex + f->interf;
+  if(f->subtype >= row->len[f->type])
+  {
+    row->slots[f->type] = (int*)realloc(row->slots[f->type],
+                                        (f->subtype+1)*sizeof(int));
+    assert(row->slots[f->type]);
+    memset(row->slots[f->type] + row->len[f->type], 0,
+           (f->subtype+1-row->len[f->type])*sizeof(int));
+    row->len[f->type] = f->subtype+1;
+  }
+
+  if(!row->slots[f->type][f->subtype])
+    row->slots[f->type][f->subtype] = pos+1;
+}
+
+// Look up the ftable position (plus one) registered for exactly this
+// signature, or 0.
+static int
+playerxdr_ftindex_get(uint16_t interf, uint8_t type, uint8_t subtype)
+{
+  if((interf >= ftindex_len) || (type >= PLAYERXDR_FTINDEX_NUM_TYPES) ||
+     (subtype >= ftindex[interf].len[type]))
+    return(0);
+  return(ftindex[interf].slots[type][subtype]);
+}
+
+// Find the entry for a signature, matching universal (interface 0)
+// entries for any interface.  When both a universal and an interface
+// specific entry exist, the one registered first is returned.
+static playerxdr_function_t*
+playerxdr_ftable_find(uint16_t interf, uint8_t type, uint8_t subtype)
+{
+  int i, u;
+
+  if(type >= PLAYERXDR_FTINDEX_NUM_TYPES)
+  {
+    for(i=0;i<ftable_len;i++)
+    {
+      if((ftable[i].interf == interf || ftable[i].interf == 0) &&
+         ftable[i].type == type &&
+         ftable[i].subtype == subtype)
+        return(ftable + i);
+    }
+    return(NULL);
+  }
+
+  i = playerxdr_ftindex_get(interf, type, subtype);
+  u = interf ? playerxdr_ftindex_get(0, type, subtype) : 0;
+  if(u && (!i || (u < i)))
+    i = u;
+  return(i ? ftable + i - 1 : NULL);
+}
+
 void
 playerxdr_ftable_init()
 {
   playerxdr_function_t* f;
+  int i;
 
   // if for some reason this method gets called more than once just ignore the call
   if (ftable)
@@ -147,6 +240,9 @@ playerxdr_ftable_init()
   assert(ftable);
 
   memcpy(ftable,init_ftable,ftable_len*sizeof(playerxdr_function_t));
+
+  for(i=0;i<ftable_len;i++)
+    playerxdr_ftindex_add(i);
 }
 
 int
@@ -164,7 +260,8 @@ playerxdr_ftable_add(playerxdr_function_t f, int replace)
     {
       // Yes; replace (it's clearly inefficient to iterate through the
       // table again to find the entry to replace, but the table is pretty
-      // small and this doesn't happen very often)
+      // small and this doesn't happen very often).  The entry keeps its
+      // position, so the index stays valid.
       int i;
       playerxdr_function_t* curr;
 
@@ -195,6 +292,7 @@ playerxdr_ftable_add(playerxdr_function_t f, int replace)
                                              sizeof(playerxdr_function_t)));
     assert(ftable);
     ftable[ftable_len++] = f;
+    playerxdr_ftindex_add(ftable_len-1);
     return(0);
   }
 }
@@ -218,38 +316,17 @@ playerxdr_ftable_add_multi(playerxdr_function_t *flist, int replace)
 playerxdr_function_t*
 playerxdr_get_ftrow(uint16_t interf, uint8_t type, uint8_t subtype)
 {
-  playerxdr_function_t* curr=NULL;
-  int i;
+  playerxdr_function_t* curr;
 
   if(!ftable_len)
     return(NULL);
 
-  for(i=0;i<ftable_len;i++)
-  {
-    curr = ftable + i;
-    // Make sure the interface and subtype match exactly.
-    // match anyway if interface = 0 (universal data types)
-
-    if((curr->interf == interf || curr->interf == 0) &&
-      curr->type == type &&
-      curr->subtype == subtype)
-      return(curr);
-  }
+  if((curr = playerxdr_ftable_find(interf, type, subtype)) != NULL)
+    return(curr);
 
   // The supplied type can be RESP_ACK if the registered type is REQ.
   if (type == PLAYER_MSGTYPE_RESP_ACK || type == PLAYER_MSGTYPE_RESP_NACK)
-    type = PLAYER_MSGTYPE_REQ;
-
-  for(i=0;i<ftable_len;i++)
-  {
-    curr = ftable + i;
-    // Make sure the interface and subtype match exactly.
-    // match anyway if interface = 0 (universal data types)
-    if((curr->interf == interf || curr->interf == 0) &&
-      curr->type == type &&
-      curr->subtype == subtype)
-      return(curr);
-  }
+    return(playerxdr_ftable_find(interf, PLAYER_MSGTYPE_REQ, subtype));
 
   return(NULL);
 }
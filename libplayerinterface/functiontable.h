@@ -128,6 +128,25 @@ PLAYERXDR_EXPORT player_free_fn_t playerxdr_get_freefunc(uint16_t interf, uint8_
 PLAYERXDR_EXPORT player_sizeof_fn_t playerxdr_get_sizeoffunc(uint16_t interf, uint8_t type,
                                     uint8_t subtype);
 
+/** @brief Look up all the functions for a given message signature at once.
+ *
+ * The table is indexed directly by interface, type and subtype, so this is
+ * a constant time lookup; prefer it over several playerxdr_get_* calls when
+ * more than one function is needed for the same message.
+ *
+ * @param interf : The interface
+ * @param type : The message type
+ * @param subtype : The message subtype
+ *
+ * @returns A pointer to the table entry, or NULL if one cannot be found.
+ * The entry is owned by the table, which is reallocated as entries are
+ * added: the pointer is only good until the next call to
+ * playerxdr_ftable_add() or playerxdr_ftable_add_multi().  Copy the
+ * entry to keep it any longer.
+ */
+PLAYERXDR_EXPORT playerxdr_function_t* playerxdr_get_ftrow(uint16_t interf, uint8_t type,
+                                    uint8_t subtype);
+
 /** @brief Add an entry to the function table.
  *
  * @param f : the message signature and function to add
@@ -74,6 +74,8 @@
 #define PLAYER_MAX_DEVICES             4096
 /** Default maximum length for a message queue */
 #define PLAYER_MSGQUEUE_DEFAULT_MAXLEN 1024
+/** Number of message slots first allocated by a pooled message queue */
+#define PLAYER_MSGQUEUE_POOL_CHUNK 32
 /** String that is spit back as a banner on connection */
 #define PLAYER_IDENT_STRING    "Player v."
 /** Length of string that is spit back as a banner on connection */
@@ -0,0 +1,129 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: XDR function table micro-benchmark.  Looks up every registered
+ *       message signature of every interface through playerxdr_get_ftrow,
+ *       and through a linear scan of the same entries for comparison.
+ * Usage: functiontable_bench [rounds]
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <libplayerinterface/player.h>
+#include <libplayerinterface/playerxdr.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayerinterface/interface_util.h>
+
+typedef struct
+{
+  uint16_t interf;
+  uint8_t type;
+  uint8_t subtype;
+} signature_t;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// The lookup as it was done before the table was indexed.
+static playerxdr_function_t * linear_find(playerxdr_function_t * rows, int numrows,
+                                          uint16_t interf, uint8_t type, uint8_t subtype)
+{
+  int i;
+  for (i = 0; i < numrows; i++)
+  {
+    if ((rows[i].interf == interf || rows[i].interf == 0) &&
+        rows[i].type == type && rows[i].subtype == subtype)
+      return rows + i;
+  }
+  return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+  signature_t * sigs = NULL;
+  playerxdr_function_t * rows = NULL;
+  int numsigs = 0, numrows = 0, numinterfs = 0;
+  player_interface_t iface;
+  int interf, type, subtype, i, r;
+  double start, indexed, linear;
+  void * volatile sink = NULL;
+
+  playerxdr_ftable_init();
+  itable_init();
+
+  // Collect every signature that resolves, for all interfaces.  Universal
+  // messages are counted once per interface, as they are used.
+  for (interf = 1; interf < 256; interf++)
+  {
+    if (lookup_interface_code(interf, &iface) != 0)
+      continue;
+    numinterfs++;
+    for (type = PLAYER_MSGTYPE_DATA; type <= PLAYER_MSGTYPE_RESP_NACK; type++)
+    {
+      for (subtype = 0; subtype < 256; subtype++)
+      {
+        playerxdr_function_t * row = playerxdr_get_ftrow(interf, type, subtype);
+        if (!row || row->type != type)
+          continue;
+        sigs = (signature_t *)realloc(sigs, (numsigs + 1) * sizeof(signature_t));
+        sigs[numsigs].interf = interf;
+        sigs[numsigs].type = type;
+        sigs[numsigs].subtype = subtype;
+        numsigs++;
+        if (row->interf == interf || numinterfs == 1)
+        {
+          rows = (playerxdr_function_t *)realloc(rows, (numrows + 1) * sizeof(playerxdr_function_t));
+          rows[numrows++] = *row;
+        }
+      }
+    }
+  }
+
+  start = now();
+  for (r = 0; r < rounds; r++)
+    for (i = 0; i < numsigs; i++)
+      sink = playerxdr_get_ftrow(sigs[i].interf, sigs[i].type, sigs[i].subtype);
+  indexed = now() - start;
+
+  start = now();
+  for (r = 0; r < rounds; r++)
+    for (i = 0; i < numsigs; i++)
+      sink = linear_find(rows, numrows, sigs[i].interf, sigs[i].type, sigs[i].subtype);
+  linear = now() - start;
+
+  printf("%d interfaces, %d table entries, %d signatures, %d rounds\n",
+         numinterfs, numrows, numsigs, rounds);
+  printf("indexed: %8.1f ns/lookup\n", indexed * 1e9 / ((double)rounds * numsigs));
+  printf("linear:  %8.1f ns/lookup\n", linear * 1e9 / ((double)rounds * numsigs));
+
+  (void)sink;
+  free(sigs);
+  free(rows);
+  return 0;
+}
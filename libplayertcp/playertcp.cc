@@ -44,6 +44,7 @@
 #else
   #include <unistd.h>
   #include <errno.h>
+  #include <sys/uio.h>
 #endif
 #include <stdlib.h>
 #include <assert.h>
@@ -79,6 +80,20 @@ typedef struct playertcp_listener
   int port;
 } playertcp_listener_t;
 
+/** @brief A piece of pending output for a connection */
+typedef struct playertcp_chunk
+{
+  /** Message whose cached encoding this chunk points at, or NULL if the
+   * chunk lives in the connection's write buffer */
+  Message* msg;
+  /** Start of the cached encoding (only valid when @p msg is set) */
+  const char* data;
+  /** Offset into the write buffer (only valid when @p msg is NULL) */
+  size_t offset;
+  /** Length of the chunk */
+  size_t len;
+} playertcp_chunk_t;
+
 /** @brief A TCP Connection */
 typedef struct playertcp_conn
 {
@@ -105,16 +120,32 @@ typedef struct playertcp_conn
   char* readbuffer;
   /** Total size of @p readbuffer */
   int readbuffersize;
-  /** How much of @p readbuffer is currently in use (i.e., holding a
-    partial message) */
+  /** Offset of the first byte in @p readbuffer that has not been parsed
+    yet.  Parsed messages are skipped by advancing this offset; the
+    remaining bytes are only moved to the front when room is needed. */
+  int readbufferstart;
+  /** End of the data in @p readbuffer (i.e., received bytes are held in
+    [readbufferstart, readbufferlen)) */
   int readbufferlen;
   /** Buffer in which to store partial outgoint messages */
   char* writebuffer;
   /** Total size of @p writebuffer */
   int writebuffersize;
-  /** How much of @p writebuffer is currently in use (i.e., holding a
-    partial message) */
+  /** How much of @p writebuffer is currently in use (i.e., holding
+    encoded messages that have not been fully sent) */
   int writebufferlen;
+  /** Pending output, in the order it will be sent */
+  playertcp_chunk_t chunks[PLAYERTCP_MAX_CHUNKS];
+  /** Number of entries in @p chunks */
+  int num_chunks;
+  /** Index of the first chunk not yet fully sent */
+  int first_chunk;
+  /** How much of the first unsent chunk has already been sent */
+  size_t chunk_sent;
+  /** Is @p fd being watched for writability? */
+  int write_watch;
+  /** Outgoing traffic counters */
+  playertcp_stats_t stats;
   /** Linked list of devices to which we are subscribed */
   Device** dev_subs;
   size_t num_dev_subs;
@@ -124,6 +155,21 @@ typedef struct playertcp_conn
   int* kill_flag;
 } playertcp_conn_t;
 
+// Release the messages referenced by a client's unsent chunks.
+static void
+playertcp_release_chunks(playertcp_conn_t* client)
+{
+  for(int i=client->first_chunk;i<client->num_chunks;i++)
+  {
+    if(client->chunks[i].msg)
+      delete client->chunks[i].msg;
+  }
+  client->num_chunks = 0;
+  client->first_chunk = 0;
+  client->chunk_sent = 0;
+  client->writebufferlen = 0;
+}
+
 void
 PlayerTCP::InitGlobals(void)
 {
@@ -133,6 +179,21 @@ PlayerTCP::InitGlobals(void)
 }
 
 PlayerTCP::PlayerTCP()
+{
+  this->Init(fileWatcher);
+  deviceTable->AddRemoteDriverFn(TCPRemoteDriver::TCPRemoteDriver_Init,this);
+}
+
+// Constructor for I/O worker shards.  Shards have their own file watcher,
+// and leave remote device lookups to the listening instance.
+PlayerTCP::PlayerTCP(PlayerTCP* parent)
+{
+  this->Init(new FileWatcher());
+  this->host = parent->host;
+}
+
+void
+PlayerTCP::Init(FileWatcher* _watcher)
 {
 #if defined (WIN32)
   // Initialise Windows sockets API (this can safely be done as many times as we like)
@@ -167,11 +228,15 @@ PlayerTCP::PlayerTCP()
     this->host = 0;
   }
 
-  deviceTable->AddRemoteDriverFn(TCPRemoteDriver::TCPRemoteDriver_Init,this);
+  this->watcher = _watcher;
+  this->num_workers = 0;
+  this->workers = NULL;
+  this->worker_quit = 0;
 }
 
 PlayerTCP::~PlayerTCP()
 {
+  this->StopWorkers();
   for(int i=0;i<this->num_clients;i++)
     this->Close(i);
   free(this->clients);
@@ -179,6 +244,8 @@ PlayerTCP::~PlayerTCP()
   free(this->listeners);
   free(this->listen_ufds);
   free(this->decode_readbuffer);
+  if(this->watcher != fileWatcher)
+    delete this->watcher;
 
 #if defined (WIN32)
   // Clean up the Windows sockets API (this can safely be done as many times as we like)
@@ -219,7 +286,7 @@ PlayerTCP::Listen(int* ports, int num_ports, int* new_ports)
     this->listen_ufds[i].events = POLLIN;
 
     // set up for later use by global file watcher
-    fileWatcher->AddFileWatch(this->listeners[i].fd);
+    this->watcher->AddFileWatch(this->listeners[i].fd);
   }
 
   return(0);
@@ -264,10 +331,11 @@ PlayerTCP::AddClient(struct sockaddr_in* cliaddr,
   unsigned char data[PLAYER_IDENT_STRLEN];
 
   int j = this->num_clients;
-  // Do we need to allocate another spot?
+  // Do we need to allocate more spots?  Double the lists, so that many
+  // clients connecting do not each copy them.
   if(j == this->size_clients)
   {
-    this->size_clients++;
+    this->size_clients = this->size_clients ? 2 * this->size_clients : 8;
     this->clients = (playertcp_conn_t*)realloc(this->clients,
                                                this->size_clients *
                                                sizeof(playertcp_conn_t));
@@ -297,16 +365,19 @@ PlayerTCP::AddClient(struct sockaddr_in* cliaddr,
   this->client_ufds[j].events = POLLIN;
 
   // set up for later use by global file watcher
-  fileWatcher->AddFileWatch(this->client_ufds[j].fd);
+  this->watcher->AddFileWatch(this->client_ufds[j].fd);
 
   // Create an outgoing queue for this client
   this->clients[j].queue = queue;
+  // Wake the server loop as soon as there is something to send
+  this->clients[j].queue->SetWakeWatcher(this->watcher);
 
   // Create a buffer to hold incoming messages
   this->clients[j].readbuffersize = PLAYERTCP_READBUFFER_SIZE;
   this->clients[j].readbuffer =
           (char*)calloc(1,this->clients[j].readbuffersize);
   assert(this->clients[j].readbuffer);
+  this->clients[j].readbufferstart = 0;
   this->clients[j].readbufferlen = 0;
 
   // Create a buffer to hold outgoing messages
@@ -315,6 +386,10 @@ PlayerTCP::AddClient(struct sockaddr_in* cliaddr,
           (char*)calloc(1,this->clients[j].writebuffersize);
   assert(this->clients[j].writebuffer);
   this->clients[j].writebufferlen = 0;
+  this->clients[j].num_chunks = 0;
+  this->clients[j].first_chunk = 0;
+  this->clients[j].chunk_sent = 0;
+  this->clients[j].write_watch = 0;
 
   this->num_clients++;
 
@@ -433,10 +508,32 @@ PlayerTCP::Accept(int timeout)
       }
 #endif
 
-      this->AddClient(&cliaddr,
-                      this->host,
-                      this->listeners[i].port,
-                      newsock, true, NULL, false);
+      if(this->num_workers)
+      {
+        // Hand the connection to the least loaded worker; each count is
+        // read under its shard's lock, as the shard's thread changes it
+        PlayerTCP* shard = NULL;
+        int load = 0;
+        for(int j=0;j<this->num_workers;j++)
+        {
+          this->workers[j]->Lock();
+          int n = this->workers[j]->num_clients;
+          this->workers[j]->Unlock();
+          if(!shard || n < load)
+          {
+            shard = this->workers[j];
+            load = n;
+          }
+        }
+        shard->AddClient(&cliaddr, this->host, this->listeners[i].port,
+                         newsock, true, NULL, false);
+        shard->watcher->Wakeup();
+      }
+      else
+        this->AddClient(&cliaddr,
+                        this->host,
+                        this->listeners[i].port,
+                        newsock, true, NULL, false);
 
       num_accepts--;
     }
@@ -462,7 +559,9 @@ PlayerTCP::Close(int cli)
     }
   }
   free(this->clients[cli].dev_subs);
-  fileWatcher->RemoveFileWatch(this->clients[cli].fd);
+  this->watcher->RemoveFileWatch(this->clients[cli].fd);
+  if(this->clients[cli].write_watch)
+    this->watcher->RemoveFileWatch(this->clients[cli].fd, false, true, false);
 #if defined (WIN32)
   if (closesocket (this->clients[cli].fd) != 0)
     STRERROR (PLAYER_WARN1, "closesocket() failed: %s");
@@ -471,9 +570,18 @@ PlayerTCP::Close(int cli)
     STRERROR (PLAYER_WARN1, "close() failed: %s");
 #endif
 
+  PLAYER_MSG4(2, "client %d: sent %llu messages, %llu bytes in %llu send calls",
+              cli, (unsigned long long)this->clients[cli].stats.messages,
+              (unsigned long long)this->clients[cli].stats.bytes,
+              (unsigned long long)this->clients[cli].stats.sends);
+  PLAYER_MSG3(2, "client %d: received %llu bytes, copied %llu bytes",
+              cli, (unsigned long long)this->clients[cli].stats.recv_bytes,
+              (unsigned long long)this->clients[cli].stats.recv_copied);
+
   this->clients[cli].fd = -1;
   this->clients[cli].valid = 0;
   this->clients[cli].queue = QueuePointer();
+  playertcp_release_chunks(this->clients + cli);
   free(this->clients[cli].readbuffer);
   free(this->clients[cli].writebuffer);
   if(this->clients[cli].kill_flag)
@@ -574,28 +682,28 @@ PlayerTCP::DeleteClients()
     }
   }*/
 
-  this->num_clients -= num_deleted;
-
-  // Remove the resulting blank from both lists
-  for(int i=0,j=0; i<this->size_clients; i++)
+  // Fill each blank with the last client, rather than shifting down all
+  // those after it; the order of the clients does not matter.  Entries
+  // are moved bytewise, so that the queue references move with them.
+  for(int i=0; i<this->num_clients; )
   {
-    if(this->clients[j].del)
+    if(!this->clients[i].del)
     {
-      memmove(this->clients + j,
-              this->clients + j + 1,
-              (this->size_clients - j - 1) * sizeof(playertcp_conn_t));
-      memmove(this->client_ufds + j,
-              this->client_ufds + j + 1,
-              (this->size_clients - j - 1) * sizeof(struct pollfd));
+      i++;
+      continue;
     }
-    else
-      j++;
+    int last = --this->num_clients;
+    if(i != last)
+    {
+      memcpy(this->clients + i, this->clients + last,
+             sizeof(playertcp_conn_t));
+      memcpy(this->client_ufds + i, this->client_ufds + last,
+             sizeof(struct pollfd));
+    }
+    memset(this->clients + last, 0, sizeof(playertcp_conn_t));
+    memset(this->client_ufds + last, 0, sizeof(struct pollfd));
   }
   assert(this->num_clients <= this->size_clients);
-  memset(this->clients + this->num_clients, 0,
-         (this->size_clients - this->num_clients) * sizeof(playertcp_conn_t));
-  memset(this->client_ufds + this->num_clients, 0,
-         (this->size_clients - this->num_clients) * sizeof(struct pollfd));
 }
 
 void
@@ -629,209 +737,352 @@ PlayerTCP::Listening(int port)
   return(false);
 }
 
-int
-PlayerTCP::WriteClient(int cli)
+// Append a chunk to the client's pending output.  Chunks that point into the
+// write buffer are merged with a preceding buffer chunk when contiguous.
+static void
+playertcp_add_chunk(playertcp_conn_t* client, Message* msg,
+                    const char* data, size_t offset, size_t len)
+{
+  assert(client->num_chunks < PLAYERTCP_MAX_CHUNKS);
+  if(!msg && (client->num_chunks > client->first_chunk))
+  {
+    playertcp_chunk_t* last = client->chunks + client->num_chunks - 1;
+    if(!last->msg && (last->offset + last->len == offset))
+    {
+      last->len += len;
+      return;
+    }
+  }
+  playertcp_chunk_t* chunk = client->chunks + client->num_chunks++;
+  chunk->msg = msg;
+  chunk->data = data;
+  chunk->offset = offset;
+  chunk->len = len;
+}
+
+// Encode one message onto the end of the client's pending output.  Takes
+// ownership of msg.  Returns 0 on success, -1 if the message was dropped.
+static int
+playertcp_encode(playertcp_conn_t* client, Message* msg)
 {
-  int numwritten;
-  playertcp_conn_t* client;
-  Message* msg;
   player_pack_fn_t packfunc;
   player_msghdr_t hdr;
   void* payload;
   int encode_msglen;
+  char* dst;
 
 #if HAVE_Z
   player_map_data_t* zipped_data=NULL;
 #endif
 
-  client = this->clients + cli;
-  for(;;)
+  // Note that we make a COPY of the header.  This is so that we can
+  // edit the size field before sending it out, without affecting other
+  // instances of the message on other queues.
+  hdr = *msg->GetHeader();
+  payload = msg->GetPayload();
+
+  // If this message has already been encoded for another client, send
+  // those bytes straight from the cache instead of packing (and
+  // compressing) it again.
+  const uint8_t* encoded = NULL;
+  size_t encodedlen = 0;
+  if(payload)
+    encoded = msg->GetEncoding(&encodedlen);
+
+  // Make sure there's room in the buffer for the encoded messsage.
+  // 4 times the message (including dynamic data) is a safe upper bound
+  size_t maxsize = PLAYERXDR_MSGHDR_SIZE;
+  if(!encoded)
+    maxsize += 4 * msg->GetDataSize();
+  if(maxsize > PLAYERXDR_MAX_MESSAGE_SIZE)
   {
-    // try to send any bytes leftover from last time.
-    if(client->writebufferlen)
-    {
-      numwritten = send(client->fd,
-                         client->writebuffer,
-                         MIN(client->writebufferlen,
-                             PLAYERTCP_WRITEBUFFER_SIZE), 0);
+    PLAYER_WARN1("allocating maximum %d bytes to outgoing message buffer",
+                 PLAYERXDR_MAX_MESSAGE_SIZE);
+    maxsize = PLAYERXDR_MAX_MESSAGE_SIZE;
+  }
+  if(client->writebufferlen + maxsize > (size_t)(client->writebuffersize))
+  {
+    // Get at least twice as much space.  There is no need to clear it;
+    // only the encoded bytes are ever sent.
+    client->writebuffersize = MAX((size_t)(client->writebuffersize * 2),
+                                  client->writebufferlen + maxsize);
+    client->writebuffer = (char*)realloc(client->writebuffer,
+                                         client->writebuffersize);
+    assert(client->writebuffer);
+  }
+  dst = client->writebuffer + client->writebufferlen;
 
+  if(encoded)
+    encode_msglen = encodedlen;
+  else
+  {
+    encode_msglen = 0;
 
-      if(numwritten < 0)
-      {
-        if(ErrNo == ERRNO_EAGAIN)
-        {
-          // buffers are full
-          return(0);
-        }
-        else
-        {
-#if defined (WIN32)
-          LPVOID buffer = NULL;
-          FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL,
-                        ErrNo, 0, reinterpret_cast<LPTSTR> (&buffer), 0, NULL);
-          PLAYER_MSG1(2, "send() failed: %s", reinterpret_cast<LPTSTR> (buffer));
-          LocalFree(buffer);
-#else
-          PLAYER_MSG1(2,"send() failed: %s", strerror(ErrNo));
-#endif
-          return(-1);
-        }
-      }
-      else if(numwritten == 0)
+    // HACK: special handling for map data to compress it before sending
+    // them out over the network.
+    if((hdr.addr.interf == PLAYER_MAP_CODE) &&
+       (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
+       (hdr.subtype == PLAYER_MAP_REQ_GET_DATA))
+    {
+#if HAVE_Z
+      player_map_data_t* raw_data = (player_map_data_t*)payload;
+      zipped_data = (player_map_data_t*)calloc(1,sizeof(player_map_data_t));
+      assert(zipped_data);
+
+      // copy the metadata
+      *zipped_data = *raw_data;
+      uLongf count = compressBound(raw_data->data_count);
+      zipped_data->data = (int8_t*)malloc(count);
+
+      // compress the tile
+      int ret;
+      ret = compress((Bytef*)zipped_data->data,&count,
+                       (const Bytef*)raw_data->data, raw_data->data_count);
+      if((ret != Z_OK) && (ret != Z_STREAM_END))
       {
-        PLAYER_MSG0(2,"wrote zero bytes");
+        PLAYER_ERROR("failed to compress map data");
+        free(zipped_data->data);
+        free(zipped_data);
+        delete msg;
         return(-1);
       }
 
-      memmove(client->writebuffer, client->writebuffer + numwritten,
-              client->writebufferlen - numwritten);
-      client->writebufferlen -= numwritten;
+      zipped_data->data_count = count;
+
+      // swap the payload pointer to point at the zipped version
+      payload = (void*)zipped_data;
+#else
+      PLAYER_WARN("not compressing map data, because zlib was not found at compile time");
+#endif
     }
-    // try to pop a pending message
-    else if((msg = client->queue->Pop()))
+
+    if (payload)
     {
-      // Note that we make a COPY of the header.  This is so that we can
-      // edit the size field before sending it out, without affecting other
-      // instances of the message on other queues.
-      hdr = *msg->GetHeader();
-      payload = msg->GetPayload();
-
-      // Make sure there's room in the buffer for the encoded messsage.
-      // 4 times the message (including dynamic data) is a safe upper bound
-      size_t maxsize = PLAYERXDR_MSGHDR_SIZE + (4 * msg->GetDataSize());
-      if(maxsize > (size_t)(client->writebuffersize))
+      // Locate the appropriate packing function
+      if(!(packfunc = playerxdr_get_packfunc(hdr.addr.interf,
+                                             hdr.type, hdr.subtype)))
       {
-        // Get at least twice as much space
-        client->writebuffersize = MAX((size_t)(client->writebuffersize * 2),
-                                        maxsize);
-        // Did we hit the limit (or overflow and become negative)?
-        if((client->writebuffersize >= PLAYERXDR_MAX_MESSAGE_SIZE) ||
-           (client->writebuffersize < 0))
-        {
-          PLAYER_WARN1("allocating maximum %d bytes to outgoing message buffer",
-                         PLAYERXDR_MAX_MESSAGE_SIZE);
-          client->writebuffersize = PLAYERXDR_MAX_MESSAGE_SIZE;
-        }
-        client->writebuffer = (char*)realloc(client->writebuffer,
-                                               client->writebuffersize);
-        assert(client->writebuffer);
-        memset(client->writebuffer, 0, client->writebuffersize);
+        // TODO: Allow the user to register a callback to handle unsupported messages
+        PLAYER_WARN4("skipping message from %s:%u with unsupported type %s:%u",
+                         interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
       }
-
-      // HACK: special handling for map data to compress it before sending
-      // them out over the network.
-      if((hdr.addr.interf == PLAYER_MAP_CODE) &&
-         (hdr.type == PLAYER_MSGTYPE_RESP_ACK) &&
-         (hdr.subtype == PLAYER_MAP_REQ_GET_DATA))
+      else
       {
-#if HAVE_Z
-        player_map_data_t* raw_data = (player_map_data_t*)payload;
-        zipped_data = (player_map_data_t*)calloc(1,sizeof(player_map_data_t));
-        assert(zipped_data);
-
-        // copy the metadata
-        *zipped_data = *raw_data;
-        uLongf count = compressBound(raw_data->data_count);
-        zipped_data->data = (int8_t*)malloc(count);
-
-        // compress the tile
-        int ret;
-        ret = compress((Bytef*)zipped_data->data,&count,
-                         (const Bytef*)raw_data->data, raw_data->data_count);
-        if((ret != Z_OK) && (ret != Z_STREAM_END))
+        // Encode the body first
+        if((encode_msglen =
+            (*packfunc)(dst + PLAYERXDR_MSGHDR_SIZE,
+                      maxsize - PLAYERXDR_MSGHDR_SIZE,
+                      payload, PLAYERXDR_ENCODE)) < 0)
         {
-          PLAYER_ERROR("failed to compress map data");
-          free(zipped_data);
-          client->writebufferlen = 0;
+          PLAYER_WARN4("encoding failed on message from %s:%u with type %s:%u",
+                     interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
+#if HAVE_Z
+          if(zipped_data)
+          {
+            free(zipped_data->data);
+            free(zipped_data);
+          }
+#endif
           delete msg;
-          return(0);
+          return(-1);
         }
+      }
+    }
+
+#if HAVE_Z
+    if(zipped_data)
+    {
+      free(zipped_data->data);
+      free(zipped_data);
+      zipped_data=NULL;
+    }
+#endif
+
+    // Cache the encoding if other clients are holding copies of this
+    // message.
+    if((encode_msglen > 0) && (msg->GetRefCount() > 1))
+    {
+      uint8_t* cached = (uint8_t*)malloc(encode_msglen);
+      assert(cached);
+      memcpy(cached, dst + PLAYERXDR_MSGHDR_SIZE, encode_msglen);
+      msg->SetEncoding(cached, encode_msglen);
+    }
+  }
 
-        zipped_data->data_count = count;
+  // Rewrite the size in the header with the length of the encoded
+  // body, then encode the header.
+  hdr.size = encode_msglen;
+  if(player_msghdr_pack(dst, PLAYERXDR_MSGHDR_SIZE, &hdr,
+                        PLAYERXDR_ENCODE) < 0)
+  {
+    PLAYER_ERROR("failed to encode msg header");
+    delete msg;
+    return(-1);
+  }
+
+  if(encoded)
+  {
+    // The header goes from the write buffer, the body straight from the
+    // shared cache; the chunk holds our reference to the message until the
+    // body has been sent.
+    playertcp_add_chunk(client, NULL, NULL, client->writebufferlen,
+                        PLAYERXDR_MSGHDR_SIZE);
+    client->writebufferlen += PLAYERXDR_MSGHDR_SIZE;
+    playertcp_add_chunk(client, msg, (const char*)encoded, 0, encodedlen);
+  }
+  else
+  {
+    playertcp_add_chunk(client, NULL, NULL, client->writebufferlen,
+                        PLAYERXDR_MSGHDR_SIZE + hdr.size);
+    client->writebufferlen += PLAYERXDR_MSGHDR_SIZE + hdr.size;
+    delete msg;
+  }
+  client->stats.messages++;
+  return(0);
+}
+
+// Send as much of the client's pending output as the socket will take,
+// gathering all pending chunks into a single call.  Returns 1 if everything
+// was sent, 0 if the socket would block and -1 on error.
+static int
+playertcp_flush(playertcp_conn_t* client)
+{
+  int numwritten;
 
-        // swap the payload pointer to point at the zipped version
-        payload = (void*)zipped_data;
+  while(client->first_chunk < client->num_chunks)
+  {
+#if defined (WIN32)
+    playertcp_chunk_t* chunk = client->chunks + client->first_chunk;
+    const char* base = chunk->msg ? chunk->data :
+                                    client->writebuffer + chunk->offset;
+    numwritten = send(client->fd, base + client->chunk_sent,
+                      chunk->len - client->chunk_sent, 0);
 #else
-        PLAYER_WARN("not compressing map data, because zlib was not found at compile time");
+    struct iovec iov[PLAYERTCP_MAX_CHUNKS];
+    struct msghdr mh;
+    int niov = 0;
+    for(int i=client->first_chunk;i<client->num_chunks;i++,niov++)
+    {
+      playertcp_chunk_t* chunk = client->chunks + i;
+      const char* base = chunk->msg ? chunk->data :
+                                      client->writebuffer + chunk->offset;
+      size_t skip = (i == client->first_chunk) ? client->chunk_sent : 0;
+      iov[niov].iov_base = (void*)(base + skip);
+      iov[niov].iov_len = chunk->len - skip;
+    }
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = niov;
+    numwritten = sendmsg(client->fd, &mh, 0);
 #endif
-      }
 
-      if (payload)
+    if(numwritten < 0)
+    {
+      if(ErrNo == ERRNO_EAGAIN)
       {
-        // Locate the appropriate packing function
-        if(!(packfunc = playerxdr_get_packfunc(hdr.addr.interf,
-                                               hdr.type, hdr.subtype)))
-        {
-          // TODO: Allow the user to register a callback to handle unsupported messages
-          PLAYER_WARN4("skipping message from %s:%u with unsupported type %s:%u",
-                           interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
-        }
-        else
-        {
-          // Encode the body first
-          if((encode_msglen =
-              (*packfunc)(client->writebuffer + PLAYERXDR_MSGHDR_SIZE,
-                        maxsize - PLAYERXDR_MSGHDR_SIZE,
-                        payload, PLAYERXDR_ENCODE)) < 0)
-          {
-            PLAYER_WARN4("encoding failed on message from %s:%u with type %s:%u",
-                       interf_to_str(hdr.addr.interf), hdr.addr.index, msgtype_to_str(hdr.type), hdr.subtype);
-#if HAVE_Z
-            if(zipped_data)
-            {
-              free(zipped_data->data);
-              free(zipped_data);
-              zipped_data=NULL;
-            }
-#endif
-            client->writebufferlen = 0;
-            delete msg;
-            return(0);
-          }
-        }
+        // buffers are full
+        return(0);
       }
       else
       {
-        encode_msglen = 0;
+#if defined (WIN32)
+        LPVOID buffer = NULL;
+        FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL,
+                      ErrNo, 0, reinterpret_cast<LPTSTR> (&buffer), 0, NULL);
+        PLAYER_MSG1(2, "send() failed: %s", reinterpret_cast<LPTSTR> (buffer));
+        LocalFree(buffer);
+#else
+        PLAYER_MSG1(2,"send() failed: %s", strerror(ErrNo));
+#endif
+        return(-1);
       }
-      // Rewrite the size in the header with the length of the encoded
-      // body, then encode the header.
-      hdr.size = encode_msglen;
-      if((encode_msglen = player_msghdr_pack(client->writebuffer,
-                   PLAYERXDR_MSGHDR_SIZE, &hdr,
-                   PLAYERXDR_ENCODE)) < 0)
+    }
+    else if(numwritten == 0)
+    {
+      PLAYER_MSG0(2,"wrote zero bytes");
+      return(-1);
+    }
+
+    client->stats.sends++;
+    client->stats.bytes += numwritten;
+
+    // Step past whatever went out, releasing messages whose cached
+    // encodings have been sent in full.
+    size_t left = numwritten;
+    while(left)
+    {
+      playertcp_chunk_t* chunk = client->chunks + client->first_chunk;
+      size_t remaining = chunk->len - client->chunk_sent;
+      if(left < remaining)
       {
-        PLAYER_ERROR("failed to encode msg header");
-#if HAVE_Z
-        if(zipped_data)
-        {
-          free(zipped_data->data);
-          free(zipped_data);
-          zipped_data=NULL;
-        }
-#endif
-        client->writebufferlen = 0;
-        delete msg;
-        return(0);
+        client->chunk_sent += left;
+        break;
       }
+      left -= remaining;
+      if(chunk->msg)
+        delete chunk->msg;
+      client->first_chunk++;
+      client->chunk_sent = 0;
+    }
+  }
 
-      client->writebufferlen = PLAYERXDR_MSGHDR_SIZE + hdr.size;
+  client->num_chunks = 0;
+  client->first_chunk = 0;
+  client->chunk_sent = 0;
+  client->writebufferlen = 0;
+  return(1);
+}
 
-      delete msg;
-#if HAVE_Z
-      if(zipped_data)
+int
+PlayerTCP::WriteClient(int cli)
+{
+  playertcp_conn_t* client;
+  Message* msg;
+  int ret;
+
+  client = this->clients + cli;
+  for(;;)
+  {
+    // try to send any bytes leftover from last time.
+    if(client->num_chunks)
+    {
+      ret = playertcp_flush(client);
+      // While the socket is full, have the file watcher tell us when it
+      // drains rather than retrying on every pass of the server loop.
+      if((ret == 0) && !client->write_watch)
       {
-        free(zipped_data->data);
-        free(zipped_data);
-        zipped_data=NULL;
+        this->watcher->AddFileWatch(client->fd, false, true, false);
+        client->write_watch = 1;
       }
-#endif
+      else if((ret != 0) && client->write_watch)
+      {
+        this->watcher->RemoveFileWatch(client->fd, false, true, false);
+        client->write_watch = 0;
+      }
+      if(ret <= 0)
+        return(ret);
     }
-    else
+
+    // Encode a batch of pending messages, to be sent together
+    while((client->num_chunks + 2 <= PLAYERTCP_MAX_CHUNKS) &&
+          (client->writebufferlen < PLAYERTCP_WRITEBUFFER_SIZE) &&
+          (msg = client->queue->Pop()))
+      playertcp_encode(client, msg);
+
+    if(!client->num_chunks)
       return(0);
   }
 }
 
+int
+PlayerTCP::GetClientStats(int cli, playertcp_stats_t* stats)
+{
+  if((cli < 0) || (cli >= this->num_clients))
+    return(-1);
+  *stats = this->clients[cli].stats;
+  return(0);
+}
+
 int
 PlayerTCP::Write(bool have_lock)
 {
@@ -847,6 +1098,9 @@ PlayerTCP::Write(bool have_lock)
 
   for(int i=0;i<this->num_clients;i++)
   {
+    // Only clients with something to send
+    if(!this->clients[i].num_chunks && this->clients[i].queue->Empty())
+      continue;
     if(this->WriteClient(i) < 0)
     {
       PLAYER_WARN1("failed to write to client %d\n", i);
@@ -886,6 +1140,20 @@ PlayerTCP::ReadClient(int cli)
   // Read until there's nothing left to read.
   for(;;)
   {
+    // Before growing the buffer, reclaim the space taken by messages that
+    // have already been parsed.  This moves at most one partial message.
+    if(((client->readbuffersize - client->readbufferlen) <
+        PLAYERTCP_READBUFFER_SIZE) && (client->readbufferstart > 0))
+    {
+      int pending = client->readbufferlen - client->readbufferstart;
+      memmove(client->readbuffer,
+              client->readbuffer + client->readbufferstart,
+              pending);
+      client->stats.recv_copied += pending;
+      client->readbufferstart = 0;
+      client->readbufferlen = pending;
+    }
+
     // Might we need more room to assemble the current partial message?
     if((client->readbuffersize - client->readbufferlen) <
        PLAYERTCP_READBUFFER_SIZE)
@@ -947,7 +1215,10 @@ PlayerTCP::ReadClient(int cli)
       return(-1);
     }
     else
+    {
       client->readbufferlen += numread;
+      client->stats.recv_bytes += numread;
+    }
   }
 
   // Try to parse the data received so far
@@ -961,6 +1232,7 @@ PlayerTCP::ParseBuffer(int cli)
   player_msghdr_t hdr;
   playertcp_conn_t* client=NULL;
   player_pack_fn_t packfunc=NULL;
+  char* readbuffer;
   int msglen=0;
   int decode_msglen=0;
   Device* device=NULL;
@@ -972,11 +1244,12 @@ PlayerTCP::ParseBuffer(int cli)
   for(;;)
   {
     // Do we have enough bytes to read the header?
-    if(client->readbufferlen < PLAYERXDR_MSGHDR_SIZE)
+    if((client->readbufferlen - client->readbufferstart) < PLAYERXDR_MSGHDR_SIZE)
       return;
+    readbuffer = client->readbuffer + client->readbufferstart;
 
     // Try to read the header
-    if(player_msghdr_pack(client->readbuffer,
+    if(player_msghdr_pack(readbuffer,
                           PLAYERXDR_MSGHDR_SIZE,
                           &hdr, PLAYERXDR_DECODE) < 0)
     {
@@ -995,7 +1268,7 @@ PlayerTCP::ParseBuffer(int cli)
     }
 
     // Is it all here yet?
-    if(msglen > client->readbufferlen)
+    if(msglen > (client->readbufferlen - client->readbufferstart))
       return;
 
     // Using TCP, the host and robot (port) information is in the connection
@@ -1028,10 +1301,11 @@ PlayerTCP::ParseBuffer(int cli)
         if( packfunc )
         {
           decode_msglen =
-            (*packfunc)(client->readbuffer + PLAYERXDR_MSGHDR_SIZE,
+            (*packfunc)(readbuffer + PLAYERXDR_MSGHDR_SIZE,
 			msglen - PLAYERXDR_MSGHDR_SIZE,
 			(void*)this->decode_readbuffer,
 			PLAYERXDR_DECODE);
+          client->stats.recv_copied += msglen - PLAYERXDR_MSGHDR_SIZE;
         }
         else // no packing function? this had better be an empty message
         {
@@ -1051,10 +1325,13 @@ PlayerTCP::ParseBuffer(int cli)
           // update the message size and send it off
           hdr.size = decode_msglen;
           void * msg_data = hdr.size? this->decode_readbuffer: NULL;
+          // Set if the decoded payload was handed over to the message
+          bool adopted = false;
           if(hdr.addr.interf == PLAYER_PLAYER_CODE)
           {
             Message* msg = new Message(hdr, msg_data, client->queue);
             assert(msg);
+            client->stats.recv_copied += msg->GetDataSize();
             this->HandlePlayerMessage(cli, msg);
             delete msg;
 
@@ -1106,23 +1383,36 @@ PlayerTCP::ParseBuffer(int cli)
 #endif
             }
             else
-              device->PutMsg(client->queue, &hdr, msg_data);
+            {
+              // The decoder allocated all the dynamic data afresh, so the
+              // message can take ownership of it.  Only the fixed part of
+              // the structure is copied out of the decode buffer.
+              void * payload = NULL;
+              if(decode_msglen > 0)
+              {
+                payload = malloc(decode_msglen);
+                assert(payload);
+                memcpy(payload, this->decode_readbuffer, decode_msglen);
+                client->stats.recv_copied += decode_msglen;
+              }
+              device->PutMsg(client->queue, &hdr, payload, false);
+              adopted = true;
+            }
           }
           // Need to ensure that the copy of any dynamic data made during unpacking
           // is cleaned up (putting message bodies into a Message class, as with PutMsg,
           // makes another copy of this data that will be cleaned up when that Message
           // class destructs).
-          if (decode_msglen > 0)
+          if (!adopted && (decode_msglen > 0))
             playerxdr_cleanup_message(this->decode_readbuffer, hdr.addr.interf, hdr.type, hdr.subtype);
         }
       }
     }
 
     // Move past the processed message
-    memmove(client->readbuffer,
-            client->readbuffer + msglen,
-            client->readbufferlen - msglen);
-    client->readbufferlen -= msglen;
+    client->readbufferstart += msglen;
+    if(client->readbufferstart == client->readbufferlen)
+      client->readbufferstart = client->readbufferlen = 0;
   }
 }
 
@@ -1443,3 +1733,62 @@ PlayerTCP::Unlock()
 {
   pthread_mutex_unlock(&clients_mutex);
 }
+
+int
+PlayerTCP::StartWorkers(int num)
+{
+  assert(!this->num_workers);
+  if(num <= 0)
+    return(0);
+
+  this->workers = (PlayerTCP**)calloc(num, sizeof(PlayerTCP*));
+  assert(this->workers);
+  for(int i=0;i<num;i++)
+  {
+    PlayerTCP* shard = new PlayerTCP(this);
+    if(pthread_create(&shard->thread, NULL, PlayerTCP::WorkerMain, shard) != 0)
+    {
+      PLAYER_ERROR("failed to create TCP I/O worker thread");
+      delete shard;
+      this->StopWorkers();
+      return(-1);
+    }
+    this->workers[this->num_workers++] = shard;
+  }
+  PLAYER_MSG1(1, "serving TCP clients from %d I/O worker threads", num);
+  return(0);
+}
+
+void
+PlayerTCP::StopWorkers()
+{
+  for(int i=0;i<this->num_workers;i++)
+  {
+    this->workers[i]->worker_quit = 1;
+    this->workers[i]->watcher->Wakeup();
+    pthread_join(this->workers[i]->thread, NULL);
+    delete this->workers[i];
+  }
+  free(this->workers);
+  this->workers = NULL;
+  this->num_workers = 0;
+}
+
+// Loop run by each I/O worker: the same read/write cycle as the server
+// loop, for the clients in this shard only.
+void*
+PlayerTCP::WorkerMain(void* arg)
+{
+  PlayerTCP* shard = reinterpret_cast<PlayerTCP*>(arg);
+
+  while(!shard->worker_quit)
+  {
+    if(shard->watcher->Wait(1.0) < 0)
+      continue;
+    if(shard->Read(0, false) < 0)
+      PLAYER_ERROR("failed while reading from TCP clients");
+    if(shard->Write(false) < 0)
+      PLAYER_ERROR("failed while writing to TCP clients");
+  }
+  return(NULL);
+}
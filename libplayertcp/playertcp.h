@@ -129,8 +129,30 @@ message.
     calloc() and realloc() write buffers in multiples of this size. */
 #define PLAYERTCP_WRITEBUFFER_SIZE 65536
 
+/** Most pieces of outgoing data (encoded messages, or headers and cached
+    bodies) that are gathered into a single send call. */
+#define PLAYERTCP_MAX_CHUNKS 64
+
+/** @brief Traffic counters for a client connection */
+typedef struct playertcp_stats
+{
+  /** Number of send calls made */
+  uint64_t sends;
+  /** Number of bytes sent */
+  uint64_t bytes;
+  /** Number of messages encoded for sending */
+  uint64_t messages;
+  /** Number of bytes received */
+  uint64_t recv_bytes;
+  /** Number of bytes copied while turning received data into messages:
+      decoding, moving unparsed data within the read buffer and copying
+      decoded payloads */
+  uint64_t recv_copied;
+} playertcp_stats_t;
+
 // Forward declarations
 struct pollfd;
+class FileWatcher;
 
 struct playertcp_listener;
 struct playertcp_conn;
@@ -154,6 +176,20 @@ class PLAYERTCP_EXPORT PlayerTCP
     /** Total size of @p decode_readbuffer */
     int decode_readbuffersize;
 
+    /** File watcher on which this instance's sockets are waited for */
+    FileWatcher* watcher;
+    /** I/O worker shards, each serving a share of the clients from its
+        own thread */
+    PlayerTCP** workers;
+    /** Number of entries in @p workers */
+    int num_workers;
+    /** Set to make a worker shard's thread exit */
+    volatile int worker_quit;
+
+    PlayerTCP(PlayerTCP* parent);
+    void Init(FileWatcher* _watcher);
+    static void* WorkerMain(void* arg);
+
   public:
     PlayerTCP();
     ~PlayerTCP();
@@ -190,12 +226,26 @@ class PLAYERTCP_EXPORT PlayerTCP
     int Read(int timeout, bool have_lock);
     int Write(bool have_lock);
     int WriteClient(int cli);
+    /** Get the traffic counters for client @p cli.  Returns 0 on
+        success, -1 if there is no such client. */
+    int GetClientStats(int cli, playertcp_stats_t* stats);
     void DeleteClients();
     void ParseBuffer(int cli);
     int HandlePlayerMessage(int cli, Message* msg);
     void DeleteClient(QueuePointer &q, bool have_lock);
     bool Listening(int port);
     uint32_t GetHost() {return host;};
+
+    /** Start @p num I/O worker threads.  Each owns a shard of the client
+        connections, with its own file watcher, buffers and lock, and does
+        all reading, parsing and writing for them.  New connections
+        accepted by this instance are handed to the least loaded worker.
+        Returns 0 on success, -1 on failure. */
+    int StartWorkers(int num);
+    /** Stop the I/O worker threads, closing their connections. */
+    void StopWorkers();
+    /** Number of running I/O worker threads. */
+    int GetNumWorkers() {return num_workers;};
 };
 
 /** @} */
@@ -245,6 +245,8 @@ PlayerUDP::AddClient(struct sockaddr_in* cliaddr,
   // Create an outgoing queue for this client
   this->clients[j].queue =
           QueuePointer(0,PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  // Wake the server loop as soon as there is something to send
+  this->clients[j].queue->SetWakeWatcher(fileWatcher);
 
   // Create a buffer to hold incoming messages
   this->clients[j].readbuffersize = PLAYERUDP_READBUFFER_SIZE;
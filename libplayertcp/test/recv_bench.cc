@@ -0,0 +1,181 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+/***************************************************************************
+ * Desc: TCP receive path benchmark.  A thread streams opaque commands of
+ *       a given size into a PlayerTCP client connection over a socket
+ *       pair; the server side is read in-process and the commands are
+ *       drained from the receiving driver's queue.  Reports throughput
+ *       and the bytes copied per received byte.
+ * Usage: recv_bench [megabytes per size]
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/playerxdr.h>
+#include <libplayertcp/playertcp.h>
+
+#define BENCH_PORT 6665
+
+// Accepts any message on its interface.
+class SinkDriver : public Driver
+{
+  public:
+    SinkDriver(player_devaddr_t addr) :
+      Driver(NULL, 0, false, 100000)
+    {
+      this->AddInterface(addr);
+    }
+    int ProcessMessage(QueuePointer & resp_queue, player_msghdr * hdr, void * data)
+    {
+      return 0;
+    }
+};
+
+struct writer_t
+{
+  int fd;
+  char * buf;
+  size_t len;
+  int count;
+};
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void * write_messages(void * arg)
+{
+  writer_t * w = (writer_t*)arg;
+  for (int i = 0; i < w->count; i++)
+  {
+    size_t off = 0;
+    while (off < w->len)
+    {
+      ssize_t n = write(w->fd, w->buf + off, w->len - off);
+      if (n <= 0)
+        return NULL;
+      off += n;
+    }
+  }
+  return NULL;
+}
+
+static void run(PlayerTCP & ptcp, SinkDriver & sink, player_devaddr_t addr,
+                size_t size, int megabytes)
+{
+  // Encode one opaque command of the given payload size
+  player_opaque_data_t data;
+  data.data_count = size;
+  data.data = (uint8_t*)calloc(1, size);
+  size_t buflen = PLAYERXDR_MSGHDR_SIZE + size + 64;
+  char * buf = (char*)malloc(buflen);
+  int len = player_opaque_data_pack(buf + PLAYERXDR_MSGHDR_SIZE,
+                                    buflen - PLAYERXDR_MSGHDR_SIZE,
+                                    &data, PLAYERXDR_ENCODE);
+  player_msghdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.addr = addr;
+  hdr.type = PLAYER_MSGTYPE_CMD;
+  hdr.subtype = PLAYER_OPAQUE_CMD_DATA;
+  hdr.size = len;
+  player_msghdr_pack(buf, PLAYERXDR_MSGHDR_SIZE, &hdr, PLAYERXDR_ENCODE);
+  free(data.data);
+
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+  {
+    perror("socketpair");
+    exit(1);
+  }
+  fcntl(sv[0], F_SETFL, O_NONBLOCK);
+  ptcp.AddClient(NULL, addr.host, BENCH_PORT, sv[0], false, NULL, false);
+
+  writer_t w;
+  w.fd = sv[1];
+  w.buf = buf;
+  w.len = PLAYERXDR_MSGHDR_SIZE + len;
+  w.count = (int)(((double)megabytes * 1024 * 1024) / w.len) + 1;
+  pthread_t writer;
+
+  double start = now();
+  pthread_create(&writer, NULL, write_messages, &w);
+  int received = 0;
+  while (received < w.count)
+  {
+    ptcp.Read(10, false);
+    Message * msg;
+    while ((msg = sink.InQueue->Pop()) != NULL)
+    {
+      received++;
+      delete msg;
+    }
+  }
+  double elapsed = now() - start;
+  pthread_join(writer, NULL);
+
+  playertcp_stats_t stats;
+  ptcp.Lock();
+  ptcp.GetClientStats(0, &stats);
+  ptcp.Unlock();
+  printf("%9lu %8d %10.1f %14.2f\n", (unsigned long)size, received,
+         (double)stats.recv_bytes / elapsed / (1024 * 1024),
+         (double)stats.recv_copied / stats.recv_bytes);
+
+  // the server side is closed by PlayerTCP once it sees the hangup
+  close(sv[1]);
+  while (ptcp.Read(10, false) == 0 && ptcp.GetClientStats(0, &stats) == 0)
+    ;
+  free(buf);
+}
+
+int main(int argc, char ** argv)
+{
+  int megabytes = argc > 1 ? atoi(argv[1]) : 256;
+  size_t sizes[] = {64, 4096, 65536, 1048576};
+
+  PlayerTCP::InitGlobals();
+  PlayerTCP ptcp;
+
+  player_devaddr_t addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.host = ptcp.GetHost();
+  addr.robot = BENCH_PORT;
+  addr.interf = PLAYER_OPAQUE_CODE;
+  addr.index = 0;
+  SinkDriver sink(addr);
+
+  printf("%d MB per payload size\n", megabytes);
+  printf("  payload messages       MB/s  copied/byte\n");
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    run(ptcp, sink, addr, sizes[i], megabytes);
+  return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Configuration space of a laser scan, for a round robot.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "cspace.h"
+
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+// Slack on the bearings within which an obstacle can touch the robot, so
+// that rounding never leaves out a beam the full check would find [rad]
+#define CSPACE_MARGIN 1e-6
+
+// Deep enough for a tree over any int number of beams
+#define CSPACE_STACK 64
+
+
+// Free the arrays
+static void cspace_free_arrays(cspace_t *cspace)
+{
+  free(cspace->r);
+  free(cspace->b);
+  free(cspace->x);
+  free(cspace->y);
+  free(cspace->rr);
+  free(cspace->first);
+  free(cspace->last);
+  free(cspace->lo);
+  free(cspace->hi);
+  free(cspace->min_r);
+  free(cspace->reach);
+  return;
+}
+
+
+// Create working space
+cspace_t *cspace_alloc(void)
+{
+  return (cspace_t*) calloc(1, sizeof(cspace_t));
+}
+
+
+// Destroy working space
+void cspace_free(cspace_t *cspace)
+{
+  cspace_free_arrays(cspace);
+  free(cspace);
+  return;
+}
+
+
+// Number of leaves, rounded up to a power of two
+static int cspace_leaf_base(int count)
+{
+  int base;
+
+  for (base = 1; base * CSPACE_LEAF < count; base *= 2);
+  return base;
+}
+
+
+// Make room for a scan of count beams
+static int cspace_resize(cspace_t *cspace, int count)
+{
+  int nodes;
+
+  if (count <= cspace->size)
+    return 0;
+
+  cspace_free_arrays(cspace);
+
+  nodes = 2 * cspace_leaf_base(count);
+  cspace->size = count;
+  cspace->node_size = nodes;
+  cspace->r = (double*) malloc(count * sizeof(double));
+  cspace->b = (double*) malloc(count * sizeof(double));
+  cspace->x = (double*) malloc(count * sizeof(double));
+  cspace->y = (double*) malloc(count * sizeof(double));
+  cspace->rr = (double*) malloc(count * sizeof(double));
+  cspace->first = (int*) malloc(nodes * sizeof(int));
+  cspace->last = (int*) malloc(nodes * sizeof(int));
+  cspace->lo = (double*) malloc(nodes * sizeof(double));
+  cspace->hi = (double*) malloc(nodes * sizeof(double));
+  cspace->min_r = (double*) malloc(nodes * sizeof(double));
+  cspace->reach = (double*) malloc(nodes * sizeof(double));
+
+  if (cspace->r && cspace->b && cspace->x && cspace->y && cspace->rr &&
+      cspace->first && cspace->last && cspace->lo && cspace->hi &&
+      cspace->min_r && cspace->reach)
+    return 0;
+
+  cspace_free_arrays(cspace);
+  cspace->r = cspace->b = cspace->x = cspace->y = cspace->rr = NULL;
+  cspace->first = cspace->last = NULL;
+  cspace->lo = cspace->hi = cspace->min_r = cspace->reach = NULL;
+  cspace->size = cspace->node_size = 0;
+  return -1;
+}
+
+
+// Build the tree over the beams
+static void cspace_build(cspace_t *cspace, int count, double radius)
+{
+  int i, j, k, l, m, base;
+  double min_r;
+
+  base = cspace_leaf_base(count);
+  cspace->leaf_base = base;
+
+  // Leaves; those past the end of the scan are empty
+  for (j = 0; j < base; j++)
+  {
+    k = base + j;
+    cspace->first[k] = j * CSPACE_LEAF;
+    cspace->last[k] = j * CSPACE_LEAF + CSPACE_LEAF - 1;
+    if (cspace->last[k] >= count)
+      cspace->last[k] = count - 1;
+    if (cspace->first[k] > cspace->last[k])
+      continue;
+
+    min_r = HUGE_VAL;
+    for (i = cspace->first[k]; i <= cspace->last[k]; i++)
+    {
+      if (cspace->r[i] < min_r)
+        min_r = cspace->r[i];
+    }
+    cspace->min_r[k] = min_r;
+    cspace->lo[k] = cspace->b[cspace->first[k]];
+    cspace->hi[k] = cspace->b[cspace->last[k]];
+  }
+
+  // Inner nodes
+  for (k = base - 1; k >= 1; k--)
+  {
+    l = 2 * k;
+    m = 2 * k + 1;
+    cspace->first[k] = cspace->first[l];
+    cspace->last[k] = cspace->last[l];
+    if (cspace->first[l] > cspace->last[l])
+      continue;
+    cspace->min_r[k] = cspace->min_r[l];
+    cspace->lo[k] = cspace->lo[l];
+    cspace->hi[k] = cspace->hi[l];
+    if (cspace->first[m] > cspace->last[m])
+      continue;
+    cspace->last[k] = cspace->last[m];
+    if (cspace->min_r[m] < cspace->min_r[k])
+      cspace->min_r[k] = cspace->min_r[m];
+    cspace->hi[k] = cspace->hi[m];
+  }
+
+  // How far off its bearings a node's obstacles can reach.  An obstacle
+  // at range r is within the radius of a beam only if it is within
+  // asin(radius / r) of it, or anywhere ahead of it if r < radius.  One
+  // at zero range is nowhere and so touches every beam.
+  for (k = 1; k < 2 * base; k++)
+  {
+    if (cspace->first[k] > cspace->last[k])
+      continue;
+    if (cspace->lo[k] > cspace->hi[k])
+    {
+      min_r = cspace->lo[k];
+      cspace->lo[k] = cspace->hi[k];
+      cspace->hi[k] = min_r;
+    }
+    min_r = cspace->min_r[k];
+    if (min_r <= 0)
+      cspace->reach[k] = HUGE_VAL;
+    else if (min_r <= radius)
+      cspace->reach[k] = M_PI / 2 + CSPACE_MARGIN;
+    else
+      cspace->reach[k] = asin(radius / min_r) + CSPACE_MARGIN;
+  }
+  return;
+}
+
+
+// Angle from bearing b to the nearest bearing in [lo, hi], either way
+// round the circle
+static double cspace_gap(double b, double lo, double hi)
+{
+  int k;
+  double a, d, gap;
+
+  gap = HUGE_VAL;
+  for (k = -1; k <= 1; k++)
+  {
+    a = b + 2 * M_PI * k;
+    d = (a < lo) ? lo - a : ((a > hi) ? a - hi : 0);
+    if (d < gap)
+      gap = d;
+  }
+  return gap;
+}
+
+
+// Check beam n against the obstacles of beams i0 to i1, a leaf of the
+// tree, exactly as the all-pairs check does.  Returns the new range.
+static double cspace_leaf(const cspace_t *cspace, int n, int i0, int i1,
+                          double radius, int step, double max_r)
+{
+  int i;
+  double r, x, y, rr, s, dx, dy, d, h;
+  const double *rs, *xs, *ys;
+
+  r = cspace->r[n];
+  x = cspace->x[n];
+  y = cspace->y[n];
+  rr = cspace->rr[n];
+  rs = cspace->r;
+  xs = cspace->x;
+  ys = cspace->y;
+
+  for (i = i0 + (step - i0 % step) % step; i <= i1; i += step)
+  {
+    if (rs[i] - radius > max_r)
+      continue;
+
+    // Compute parametric point on ray that is nearest the obstacle.
+    s = (x * xs[i] + y * ys[i]) / rr;
+    if (s < 0 || s > 1)
+      continue;
+
+    // Compute distance from nearest point to obstacle.
+    dx = s * x - xs[i];
+    dy = s * y - ys[i];
+    d = sqrt(dx * dx + dy * dy);
+    if (d > radius)
+      continue;
+
+    // Compute the shortened range.
+    h = s * r - sqrt(radius * radius - d * d);
+    if (h < max_r)
+      max_r = h;
+  }
+  return max_r;
+}
+
+
+// Compute the configuration space of a scan
+int cspace_compute(cspace_t *cspace, const float *ranges, int count,
+                   float min_angle, float resolution,
+                   double radius, int step, float *out)
+{
+  int n, k, top;
+  int stack[CSPACE_STACK];
+  double r, b, max_r;
+
+  if (count <= 0)
+    return 0;
+  if (step < 1)
+    step = 1;
+  if (cspace_resize(cspace, count) != 0)
+    return -1;
+
+  // The bearings are worked out in single precision, as the laser
+  // interface's angles are
+  for (n = 0; n < count; n++)
+  {
+    r = ranges[n];
+    b = min_angle + resolution * (float) n;
+    cspace->r[n] = r;
+    cspace->b[n] = b;
+    cspace->x[n] = r * cos(b);
+    cspace->y[n] = r * sin(b);
+    cspace->rr[n] = cspace->x[n] * cspace->x[n] + cspace->y[n] * cspace->y[n];
+  }
+
+  cspace_build(cspace, count, radius);
+
+  for (n = 0; n < count; n++)
+  {
+    b = cspace->b[n];
+    max_r = cspace->r[n] - radius;
+
+    // Walk the tree in beam order, so that the obstacles are checked in
+    // the same order as the full check
+    top = 0;
+    stack[top++] = 1;
+    while (top > 0)
+    {
+      k = stack[--top];
+      if (cspace->first[k] > cspace->last[k])
+        continue;
+
+      // Every obstacle below is further than the range found so far...
+      if (cspace->min_r[k] - radius > max_r)
+        continue;
+      // ...or too far off the beam
+      if (cspace_gap(b, cspace->lo[k], cspace->hi[k]) > cspace->reach[k])
+        continue;
+
+      if (k >= cspace->leaf_base)
+        max_r = cspace_leaf(cspace, n, cspace->first[k], cspace->last[k],
+                            radius, step, max_r);
+      else
+      {
+        stack[top++] = 2 * k + 1;
+        stack[top++] = 2 * k;
+      }
+    }
+
+    // Clip negative ranges.
+    if (max_r < 0)
+      max_r = 0;
+    out[n] = (float) max_r;
+  }
+  return 0;
+}
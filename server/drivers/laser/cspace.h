@@ -0,0 +1,86 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Configuration space of a laser scan, for a round robot.
+// CVS: $Id$
+//
+// Each range is shortened to the distance the robot can travel along the
+// beam before it touches the point seen by any other beam.
+//
+// An obstacle at range r can only touch a robot of radius R on beams
+// within asin(R/r) of its own bearing, so far obstacles only need to be
+// checked against the few beams either side of them.  The beams are kept
+// in a binary tree, each node holding the nearest range below it; for
+// each beam the tree is walked in beam order, skipping nodes whose
+// obstacles are all out of reach, either too far off the beam or further
+// away than the range found so far.  The beams that are left are checked
+// exactly as before, in the same order, so the output is the same, bit
+// for bit, as checking every beam against every other.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef CSPACE_H
+#define CSPACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Beams in a leaf of the tree
+#define CSPACE_LEAF 16
+
+// Working space for computing configuration space scans
+typedef struct
+{
+  // Size of the arrays below [beams]
+  int size;
+
+  // Range, bearing, position and squared range of each beam
+  double *r, *b, *x, *y, *rr;
+
+  // The tree: node k has children 2k and 2k+1, and leaf j is node
+  // leaf_base + j.  For each node, the first and last beams below it,
+  // their bearings, the nearest range and the bearing either side of the
+  // node's own within which its obstacles can touch the robot.
+  int leaf_base, node_size;
+  int *first, *last;
+  double *lo, *hi, *min_r, *reach;
+} cspace_t;
+
+// Create and destroy working space
+cspace_t *cspace_alloc(void);
+void cspace_free(cspace_t *cspace);
+
+// Compute the configuration space of a scan of count ranges, starting at
+// bearing min_angle and resolution radians apart, for a robot of the
+// given radius.  Only every step'th beam is checked as an obstacle.
+// Writes count ranges to out[].  Returns 0 on success, -1 if out of
+// memory.
+int cspace_compute(cspace_t *cspace, const float *ranges, int count,
+                   float min_angle, float resolution,
+                   double radius, int step, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -108,6 +108,7 @@ driver
 #include <libplayercore/playercore.h>
 
 #include "lasertransform.h"
+#include "cspace.h"
 
 // Driver for computing the free c-space from a laser scan.
 class LaserCSpace : public LaserTransform
@@ -115,16 +116,13 @@ class LaserCSpace : public LaserTransform
   // Constructor
   public: LaserCSpace( ConfigFile* cf, int section);
 
+  // Destructor
+  public: virtual ~LaserCSpace();
+
   // Process laser data.  Returns non-zero if the laser data has been
   // updated.
   private: int UpdateLaser(player_laser_data_t * data);
 
-  // Pre-compute a bunch of stuff
-  private: void Precompute(player_laser_data_t* data);
-
-  // Compute the maximum free-space range for sample n.
-  private: double FreeRange(player_laser_data_t* data, int n);
-
 
   // Step size for subsampling the scan (saves CPU cycles)
   private: int sample_step;
@@ -132,8 +130,8 @@ class LaserCSpace : public LaserTransform
   // Robot radius.
   private: double radius;
 
-  // Lookup table for precomputations
-  private: double (*lu)[4];
+  // Working space for the c-space computation
+  private: cspace_t *cspace;
 
 };
 
@@ -161,15 +159,23 @@ LaserCSpace::LaserCSpace( ConfigFile* cf, int section)
   this->radius = cf->ReadLength(section, "radius", 0.50);
   this->sample_step = cf->ReadInt(section, "step", 1);
 
+  this->cspace = cspace_alloc();
+
   return;
 }
 
+
+////////////////////////////////////////////////////////////////////////////////
+// Destructor
+LaserCSpace::~LaserCSpace()
+{
+  cspace_free(this->cspace);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Process laser data.
 int LaserCSpace::UpdateLaser(player_laser_data_t * data)
 {
-  unsigned int i;
-
   // Construct the outgoing laser packet
   this->data.resolution = data->resolution;
   this->data.min_angle = data->min_angle;
@@ -177,108 +183,21 @@ int LaserCSpace::UpdateLaser(player_laser_data_t * data)
   this->data.max_range = data->max_range;
   this->data.ranges_count = data->ranges_count;
   this->data.ranges = new float [data->ranges_count];
-  this->lu = new double[data->ranges_count][4];
-
-  // Do some precomputations to save time
-  this->Precompute(data);
 
   // Generate the range estimate for each bearing.
-  for (i = 0; i < data->ranges_count; i++)
-    this->data.ranges[i]  = this->FreeRange(data,i);
+  if (cspace_compute(this->cspace, data->ranges, data->ranges_count,
+                     data->min_angle, data->resolution,
+                     this->radius, this->sample_step, this->data.ranges) != 0)
+  {
+    PLAYER_ERROR("out of memory computing c-space");
+    delete [] this->data.ranges;
+    return 0;
+  }
 
   this->Publish(this->device_addr,
                 PLAYER_MSGTYPE_DATA, PLAYER_LASER_DATA_SCAN,
                 (void*)&this->data);
   delete [] this->data.ranges;
-  delete [] this->lu;
 
   return 1;
 }
-
-
-////////////////////////////////////////////////////////////////////////////////
-// Pre-compute a bunch of stuff
-void LaserCSpace::Precompute(player_laser_data_t* data)
-{
-  unsigned int i;
-  double r, b, x, y;
-
-  for (i = 0; i < data->ranges_count; i++)
-  {
-    r = data->ranges[i];
-    b = data->min_angle + data->resolution * i;
-    x = r * cos(b);
-    y = r * sin(b);
-
-    this->lu[i][0] = r;
-    this->lu[i][1] = b;
-    this->lu[i][2] = x;
-    this->lu[i][3] = y;
-  }
-  return;
-}
-
-
-////////////////////////////////////////////////////////////////////////////////
-// Compute the maximum free-space range for sample n.
-double LaserCSpace::FreeRange(player_laser_data_t* data, int n)
-{
-  unsigned int i;
-  int step;
-  double r, b, x, y;
-  double r_, b_, x_, y_;
-  double s, nr, nx, ny, dx, dy;
-  double d, h;
-  double max_r;
-
-  // Step size for subsampling the scan (saves CPU cycles)
-  step = this->sample_step;
-
-  // Range and bearing of this reading.
-  r = this->lu[n][0];
-  b = this->lu[n][1];
-  x = this->lu[n][2];
-  y = this->lu[n][3];
-
-  max_r = r - this->radius;
-
-  // Look for intersections with obstacles.
-  for (i = 0; i < data->ranges_count; i += step)
-  {
-    r_ = this->lu[i][0];
-    if (r_ - this->radius > max_r)
-      continue;
-    b_ = this->lu[i][1];
-    x_ = this->lu[i][2];
-    y_ = this->lu[i][3];
-
-    // Compute parametric point on ray that is nearest the obstacle.
-    s = (x * x_ + y * y_) / (x * x + y * y);
-    if (s < 0 || s > 1)
-      continue;
-
-    // Compute the nearest point.
-    nr = s * r;
-    nx = s * x;
-    ny = s * y;
-
-    // Compute distance from nearest point to obstacle.
-    dx = nx - x_;
-    dy = ny - y_;
-    d = sqrt(dx * dx + dy * dy);
-
-    if (d > this->radius)
-      continue;
-
-    // Compute the shortened range.
-    h = nr - sqrt(this->radius * this->radius - d * d);
-    if (h < max_r)
-      max_r = h;
-  }
-
-  // Clip negative ranges.
-  if (max_r < 0)
-    max_r = 0;
-
-  return max_r;
-}
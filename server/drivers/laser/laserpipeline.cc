@@ -0,0 +1,726 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Driver for running a chain of laser filters in one pass
+// CVS: $Id$
+//
+// Theory of operation - the cutter, rescan and cspace filters are run
+// one after the other on each scan, inside the one driver.  The cutter
+// only narrows a view of the incoming scan; the rescan and cspace stages
+// write into two working buffers that are kept from scan to scan.  Only
+// the final scan, and any intermediate scans asked for, are published.
+//
+// Requires - Laser device.
+//
+///////////////////////////////////////////////////////////////////////////
+
+/** @ingroup drivers */
+/** @{ */
+/** @defgroup driver_laserpipeline laserpipeline
+ * @brief Chain of laser filters
+
+The laserpipeline driver runs a chain of laser filters on each scan: the
+same cut, rescan and C-space operations as the @ref driver_lasercutter,
+@ref driver_laserrescan and @ref driver_lasercspace drivers.  Chaining
+those drivers costs a copy of the scan, a trip through a message queue
+and a wakeup for each stage; the laserpipeline driver runs all of the
+stages at once, on working buffers that are reused from scan to scan,
+and only publishes the scans that are asked for.
+
+The stages are run in the order given by the "stages" option; each stage
+may appear once.  The last stage's scan is published on the laser
+interface with no key.  The scan after any other stage can also be
+published, on a laser interface keyed with the stage's name.
+
+The stages differ from the separate drivers in a few details:
+
+- cutter: the scan's min_angle and max_angle are the bearings of the
+  first and last beams kept, rather than the configured angles, so that
+  later stages see the true geometry of the scan.
+- rescan: the new beams are sampled at exactly the published resolution,
+  (max_angle - min_angle) / (scan_count - 1), and beams beyond the ends
+  of the source scan take the range of the end beam.
+- rescan and cspace drop the intensities, as their drivers do.
+
+@par Compile-time dependencies
+
+- none
+
+@par Provides
+
+- @ref interface_laser : output of the last stage
+- @ref interface_laser : with key "cutter", "rescan" or "cspace", the
+  output of that stage (optional)
+
+@par Requires
+
+- @ref interface_laser : raw laser data
+
+@par Configuration requests
+
+- PLAYER_LASER_REQ_GET_GEOM, and any other request, which is forwarded
+  to the underlying laser
+
+@par Configuration file options
+
+- stages (string tuple)
+  - Default: ["cutter" "rescan" "cspace"]
+  - The stages to run, in order
+- cutter_min_angle (float)
+  - Default: -pi/2
+  - Minimum angle kept by the cutter
+- cutter_max_angle (float)
+  - Default: pi/2
+  - Maximum angle kept by the cutter
+- rescan_min_angle (float)
+  - Default: -pi/2
+  - Minimum angle of the rescanned data
+- rescan_max_angle (float)
+  - Default: pi/2
+  - Maximum angle of the rescanned data
+- rescan_scan_count (int)
+  - Default: 181
+  - Number of beams from rescan_min_angle to rescan_max_angle
+- cspace_radius (length)
+  - Default: 0.5 m
+  - Radius of robot for which to make the C-space scan
+- cspace_step (integer)
+  - Default: 1
+  - Step size for subsampling the scan (saves CPU cycles)
+
+@par Example
+
+@verbatim
+driver
+(
+  name "hokuyo_aist"
+  provides ["laser:0"]
+)
+driver
+(
+  name "laserpipeline"
+  requires ["laser:0"]
+  # C-space scan on laser:1; the plain rescanned scan on laser:2
+  provides ["laser:1" "rescan:::laser:2"]
+  stages ["cutter" "rescan" "cspace"]
+  cutter_min_angle -100
+  cutter_max_angle 100
+  rescan_min_angle -90
+  rescan_max_angle 90
+  rescan_scan_count 181
+  cspace_radius 0.3
+)
+@endverbatim
+*/
+/** @} */
+
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <libplayercore/playercore.h>
+
+#include "cspace.h"
+
+#if defined (WIN32)
+  #define M_PI_2 (M_PI/2.0)
+#endif
+
+// Kinds of stage
+#define PIPELINE_CUTTER 0
+#define PIPELINE_RESCAN 1
+#define PIPELINE_CSPACE 2
+#define PIPELINE_STAGES 3
+
+static const char *pipeline_stage_names[PIPELINE_STAGES] =
+  {"cutter", "rescan", "cspace"};
+
+// Slack on the cutter's angles, for the rounding of a scan's float
+// angles, so that a beam on a limit is kept [rad]
+#define PIPELINE_ANGLE_SLACK 1e-5
+
+
+// Driver for running a chain of laser filters
+class LaserPipeline : public Driver
+{
+  // Constructor
+  public: LaserPipeline( ConfigFile* cf, int section);
+
+  // Destructor
+  public: virtual ~LaserPipeline();
+
+  // MessageHandler
+  public: virtual int ProcessMessage(QueuePointer & resp_queue,
+                                     player_msghdr * hdr,
+                                     void * data);
+
+  // Setup/shutdown routines.
+  public: virtual int Setup();
+  public: virtual int Shutdown();
+
+  // Run the stages on a scan
+  private: void UpdateLaser(player_laser_data_t * data);
+
+  // Make sure the working buffers hold count beams
+  private: void ReserveBuffers(unsigned int count);
+
+  // Pick the working buffer the scan is not using
+  private: float *FreeBuffer();
+
+  // The stages
+  private: void Cut();
+  private: void Rescan();
+  private: int CSpace();
+
+  // Work out which source beams each rescanned beam lies between
+  private: void BuildRescanTable();
+
+  // Laser stuff.
+  private: Device *laser_device;
+  private: player_devaddr_t laser_addr;
+
+  // Address a forwarded request was sent to
+  private: player_devaddr_t ret_addr;
+
+  // The stages, in order, and where each publishes (if it does)
+  private: int stage_count;
+  private: int stages[PIPELINE_STAGES];
+  private: bool stage_publish[PIPELINE_STAGES];
+  private: player_devaddr_t stage_addrs[PIPELINE_STAGES];
+
+  // Cutter settings
+  private: double cutter_min_angle, cutter_max_angle;
+
+  // Rescan settings
+  private: double rescan_min_angle, rescan_max_angle;
+  private: unsigned int rescan_count;
+
+  // For each rescanned beam, the source beam below it and how far it is
+  // towards the next one, for the source geometry given
+  private: unsigned int *rescan_index;
+  private: float *rescan_weight;
+  private: unsigned int rescan_src_count;
+  private: float rescan_src_min_angle, rescan_src_resolution;
+  private: bool rescan_warned;
+
+  // C-space settings and working space
+  private: double cspace_radius;
+  private: int cspace_step;
+  private: cspace_t *cspace;
+
+  // Working buffers, and their size [beams]
+  private: float *buffers[2];
+  private: unsigned int buffer_size;
+
+  // The scan as it passes through the stages; its ranges point into the
+  // incoming scan or a working buffer
+  private: player_laser_data_t scan;
+};
+
+
+// Initialization function
+Driver* LaserPipeline_Init( ConfigFile* cf, int section)
+{
+  return ((Driver*) (new LaserPipeline( cf, section)));
+}
+
+
+// a driver registration function
+void laserpipeline_Register(DriverTable* table)
+{
+  table->AddDriver("laserpipeline", LaserPipeline_Init);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Constructor
+LaserPipeline::LaserPipeline( ConfigFile* cf, int section)
+  : Driver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN)
+{
+  int i, j, k, count;
+  const char *name;
+  bool found;
+  player_devaddr_t addr;
+
+  this->laser_device = NULL;
+  this->stage_count = 0;
+  this->rescan_index = NULL;
+  this->rescan_weight = NULL;
+  this->rescan_src_count = 0;
+  this->rescan_src_min_angle = 0;
+  this->rescan_src_resolution = 0;
+  this->rescan_warned = false;
+  this->cspace = NULL;
+  this->buffers[0] = this->buffers[1] = NULL;
+  this->buffer_size = 0;
+  memset(&this->scan, 0, sizeof(this->scan));
+
+  // Must have an input laser
+  if (cf->ReadDeviceAddr(&this->laser_addr, section, "requires",
+                         PLAYER_LASER_CODE, -1, NULL) != 0)
+  {
+    PLAYER_ERROR("must require a laser device");
+    this->SetError(-1);
+    return;
+  }
+
+  // The stages
+  count = cf->GetTupleCount(section, "stages");
+  for (i = 0; i < (count > 0 ? count : PIPELINE_STAGES); i++)
+  {
+    if (count > 0)
+      name = cf->ReadTupleString(section, "stages", i, "");
+    else
+      name = pipeline_stage_names[i];
+    for (j = 0; j < PIPELINE_STAGES; j++)
+      if (strcmp(name, pipeline_stage_names[j]) == 0)
+        break;
+    if (j == PIPELINE_STAGES)
+    {
+      PLAYER_ERROR1("unknown stage [%s]", name);
+      this->SetError(-1);
+      return;
+    }
+    for (k = 0; k < this->stage_count; k++)
+    {
+      if (this->stages[k] == j)
+      {
+        PLAYER_ERROR1("stage [%s] appears more than once", name);
+        this->SetError(-1);
+        return;
+      }
+    }
+    this->stages[this->stage_count++] = j;
+  }
+
+  // Intermediate outputs are keyed with their stage's name
+  for (i = 0; i < this->stage_count; i++)
+  {
+    name = pipeline_stage_names[this->stages[i]];
+    this->stage_publish[i] =
+      (cf->ReadDeviceAddr(&this->stage_addrs[i], section, "provides",
+                          PLAYER_LASER_CODE, -1, name) == 0);
+  }
+
+  // The final output is the laser interface that is not keyed with a
+  // stage name
+  found = false;
+  count = cf->GetTupleCount(section, "provides");
+  for (i = 0; i < count && !found; i++)
+  {
+    if (cf->ReadDeviceAddr(&addr, section, "provides",
+                           PLAYER_LASER_CODE, i, NULL) != 0)
+      continue;
+    found = true;
+    for (j = 0; j < this->stage_count; j++)
+      if (this->stage_publish[j] &&
+          Device::MatchDeviceAddress(addr, this->stage_addrs[j]))
+        found = false;
+  }
+  if (found)
+  {
+    this->stage_publish[this->stage_count - 1] = true;
+    this->stage_addrs[this->stage_count - 1] = addr;
+  }
+  else if (!this->stage_publish[this->stage_count - 1])
+  {
+    PLAYER_ERROR("must provide a laser interface for the final output");
+    this->SetError(-1);
+    return;
+  }
+  this->device_addr = this->stage_addrs[this->stage_count - 1];
+
+  for (i = 0; i < this->stage_count; i++)
+  {
+    if (this->stage_publish[i] && this->AddInterface(this->stage_addrs[i]) != 0)
+    {
+      this->SetError(-1);
+      return;
+    }
+  }
+
+  // Settings.
+  this->cutter_min_angle = cf->ReadAngle(section, "cutter_min_angle", -M_PI_2);
+  this->cutter_max_angle = cf->ReadAngle(section, "cutter_max_angle", M_PI_2);
+  this->rescan_min_angle = cf->ReadAngle(section, "rescan_min_angle", -M_PI_2);
+  this->rescan_max_angle = cf->ReadAngle(section, "rescan_max_angle", M_PI_2);
+  count = cf->ReadInt(section, "rescan_scan_count", 181);
+  if (count < 2)
+  {
+    PLAYER_ERROR("rescan_scan_count must be at least 2");
+    this->SetError(-1);
+    return;
+  }
+  this->rescan_count = count;
+  this->cspace_radius = cf->ReadLength(section, "cspace_radius", 0.50);
+  this->cspace_step = cf->ReadInt(section, "cspace_step", 1);
+
+  this->rescan_index = new unsigned int[this->rescan_count];
+  this->rescan_weight = new float[this->rescan_count];
+  this->cspace = cspace_alloc();
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destructor
+LaserPipeline::~LaserPipeline()
+{
+  delete [] this->rescan_index;
+  delete [] this->rescan_weight;
+  delete [] this->buffers[0];
+  delete [] this->buffers[1];
+  if (this->cspace)
+    cspace_free(this->cspace);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Set up the device (called by server thread).
+int LaserPipeline::Setup()
+{
+  // Subscribe to the laser.
+  for (int i = 0; i < this->stage_count; i++)
+  {
+    if (this->stage_publish[i] &&
+        Device::MatchDeviceAddress(this->laser_addr, this->stage_addrs[i]))
+    {
+      PLAYER_ERROR("attempt to subscribe to self");
+      return(-1);
+    }
+  }
+  if(!(this->laser_device = deviceTable->GetDevice(this->laser_addr)))
+  {
+    PLAYER_ERROR("unable to locate suitable laser device");
+    return(-1);
+  }
+  if(this->laser_device->Subscribe(this->InQueue) != 0)
+  {
+    PLAYER_ERROR("unable to subscribe to laser device");
+    return(-1);
+  }
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Shutdown the device (called by server thread).
+int LaserPipeline::Shutdown()
+{
+  // Unsubscribe from devices.
+  this->laser_device->Unsubscribe(this->InQueue);
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Process an incoming message
+int LaserPipeline::ProcessMessage(QueuePointer & resp_queue,
+                                  player_msghdr * hdr,
+                                  void * data)
+{
+  // Handle new data from the laser
+  if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_DATA, PLAYER_LASER_DATA_SCAN,
+                           this->laser_addr))
+  {
+    assert(hdr->size != 0);
+    this->UpdateLaser(reinterpret_cast<player_laser_data_t *> (data));
+    return(0);
+  }
+
+  // Forward any request to the laser
+  for (int i = 0; i < this->stage_count; i++)
+  {
+    if(!this->stage_publish[i] ||
+       !Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ, -1,
+                              this->stage_addrs[i]))
+      continue;
+
+    // Forward the message
+    this->laser_device->PutMsg(this->InQueue, hdr, data);
+    // Store the return address for later use
+    this->ret_queue = resp_queue;
+    this->ret_addr = hdr->addr;
+    // Set the message filter to look for the response
+    this->InQueue->SetFilter(this->laser_addr.host,
+                             this->laser_addr.robot,
+                             this->laser_addr.interf,
+                             this->laser_addr.index,
+                             -1,
+                             hdr->subtype);
+    // No response now; it will come later after we hear back from the
+    // laser
+    return(0);
+  }
+
+  // Forward response (success or failure) from the laser
+  if((Message::MatchMessage(hdr, PLAYER_MSGTYPE_RESP_ACK,
+                            -1, this->laser_addr)) ||
+     (Message::MatchMessage(hdr, PLAYER_MSGTYPE_RESP_NACK,
+                            -1, this->laser_addr)))
+  {
+    // Copy in the address the request went to and forward the response
+    hdr->addr = this->ret_addr;
+    this->Publish(this->ret_queue, hdr, data);
+    // Clear the filter
+    this->InQueue->ClearFilter();
+
+    return(0);
+  }
+
+  return(-1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Run the stages on a scan
+void LaserPipeline::UpdateLaser(player_laser_data_t * data)
+{
+  int i;
+
+  this->ReserveBuffers(data->ranges_count > this->rescan_count ?
+                       data->ranges_count : this->rescan_count);
+
+  // Start with a view of the incoming scan
+  this->scan = *data;
+  if (this->scan.intensity_count > this->scan.ranges_count)
+    this->scan.intensity_count = this->scan.ranges_count;
+
+  for (i = 0; i < this->stage_count; i++)
+  {
+    switch (this->stages[i])
+    {
+      case PIPELINE_CUTTER:
+        this->Cut();
+        break;
+      case PIPELINE_RESCAN:
+        this->Rescan();
+        break;
+      case PIPELINE_CSPACE:
+        if (this->CSpace() != 0)
+        {
+          PLAYER_ERROR("out of memory computing c-space");
+          return;
+        }
+        break;
+    }
+
+    if (this->stage_publish[i])
+      this->Publish(this->stage_addrs[i],
+                    PLAYER_MSGTYPE_DATA, PLAYER_LASER_DATA_SCAN,
+                    (void*)&this->scan);
+  }
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Make sure the working buffers hold count beams
+void LaserPipeline::ReserveBuffers(unsigned int count)
+{
+  if (count <= this->buffer_size)
+    return;
+
+  delete [] this->buffers[0];
+  delete [] this->buffers[1];
+  this->buffers[0] = new float[count];
+  this->buffers[1] = new float[count];
+  this->buffer_size = count;
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Pick the working buffer the scan is not using
+float *LaserPipeline::FreeBuffer()
+{
+  if (this->scan.ranges == this->buffers[0])
+    return this->buffers[1];
+  return this->buffers[0];
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Keep only the beams between the cutter's angles.  Nothing is copied; the
+// scan is narrowed to the beams kept.
+void LaserPipeline::Cut()
+{
+  double a, res, first, last;
+  unsigned int i0, i1;
+
+  a = this->scan.min_angle;
+  res = this->scan.resolution;
+  if (this->scan.ranges_count == 0 || res <= 0)
+    return;
+
+  first = ceil((this->cutter_min_angle - PIPELINE_ANGLE_SLACK - a) / res);
+  last = floor((this->cutter_max_angle + PIPELINE_ANGLE_SLACK - a) / res);
+  if (first < 0)
+    first = 0;
+  if (last > this->scan.ranges_count - 1.0)
+    last = this->scan.ranges_count - 1.0;
+
+  if (first > last)
+  {
+    this->scan.ranges_count = 0;
+    this->scan.intensity_count = 0;
+    return;
+  }
+
+  i0 = (unsigned int) first;
+  i1 = (unsigned int) last;
+  this->scan.ranges += i0;
+  this->scan.ranges_count = i1 - i0 + 1;
+  if (this->scan.intensity_count > i0)
+  {
+    this->scan.intensity += i0;
+    this->scan.intensity_count -= i0;
+    if (this->scan.intensity_count > this->scan.ranges_count)
+      this->scan.intensity_count = this->scan.ranges_count;
+  }
+  else
+    this->scan.intensity_count = 0;
+  this->scan.min_angle = static_cast<float> (a + i0 * res);
+  this->scan.max_angle = static_cast<float> (a + i1 * res);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Work out which source beams each rescanned beam lies between.  This only
+// changes with the geometry of the source scan, so it is kept from scan to
+// scan.
+void LaserPipeline::BuildRescanTable()
+{
+  unsigned int i, n;
+  double res, t;
+
+  n = this->scan.ranges_count;
+  if (n == this->rescan_src_count &&
+      this->scan.min_angle == this->rescan_src_min_angle &&
+      this->scan.resolution == this->rescan_src_resolution)
+    return;
+
+  if ((this->scan.min_angle > this->rescan_min_angle ||
+       this->scan.min_angle + (n - 1.0) * this->scan.resolution <
+       this->rescan_max_angle) && !this->rescan_warned)
+  {
+    this->rescan_warned = true;
+    PLAYER_WARN("Parts of the interpolated laser configuration lie outside of the source laser range");
+  }
+
+  this->rescan_src_count = n;
+  this->rescan_src_min_angle = this->scan.min_angle;
+  this->rescan_src_resolution = this->scan.resolution;
+
+  res = (this->rescan_max_angle - this->rescan_min_angle) /
+    (this->rescan_count - 1.0);
+  for (i = 0; i < this->rescan_count; i++)
+  {
+    // Fractional index of the new beam in the source scan
+    t = (this->rescan_min_angle + i * res - this->scan.min_angle) /
+      this->scan.resolution;
+
+    // Beyond the ends, take the end beam
+    if (!(t > 0))
+    {
+      this->rescan_index[i] = 0;
+      this->rescan_weight[i] = 0;
+    }
+    else if (t >= n - 1.0)
+    {
+      this->rescan_index[i] = n - 2;
+      this->rescan_weight[i] = 1;
+    }
+    else
+    {
+      this->rescan_index[i] = (unsigned int) t;
+      this->rescan_weight[i] = static_cast<float> (t - floor(t));
+    }
+  }
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Interpolate the scan onto the new geometry
+void LaserPipeline::Rescan()
+{
+  unsigned int i, n;
+  float *out;
+  const float *in;
+  const unsigned int *index;
+  const float *weight;
+
+  n = this->scan.ranges_count;
+  out = this->FreeBuffer();
+  in = this->scan.ranges;
+
+  if (n == 1)
+  {
+    for (i = 0; i < this->rescan_count; i++)
+      out[i] = in[0];
+  }
+  else if (n > 1)
+  {
+    this->BuildRescanTable();
+
+    // One straight pass over the table, with no branches
+    index = this->rescan_index;
+    weight = this->rescan_weight;
+    for (i = 0; i < this->rescan_count; i++)
+      out[i] = in[index[i]] + (in[index[i] + 1] - in[index[i]]) * weight[i];
+  }
+
+  this->scan.resolution = static_cast<float>
+    ((this->rescan_max_angle - this->rescan_min_angle) /
+     (this->rescan_count - 1.0));
+  this->scan.min_angle = static_cast<float> (this->rescan_min_angle);
+  this->scan.max_angle = static_cast<float> (this->rescan_max_angle);
+  this->scan.ranges_count = n > 0 ? this->rescan_count : 0;
+  this->scan.ranges = out;
+  this->scan.intensity_count = 0;
+  this->scan.intensity = NULL;
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Shorten each range to the free configuration space
+int LaserPipeline::CSpace()
+{
+  float *out;
+
+  out = this->FreeBuffer();
+  if (cspace_compute(this->cspace, this->scan.ranges, this->scan.ranges_count,
+                     this->scan.min_angle, this->scan.resolution,
+                     this->cspace_radius, this->cspace_step, out) != 0)
+    return -1;
+
+  this->scan.ranges = out;
+  this->scan.intensity_count = 0;
+  this->scan.intensity = NULL;
+  return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: C-space benchmark.  Casts scans of 181 to 2161 beams in a room
+ *       with pillars and people, and times cspace_compute() against the
+ *       all-pairs check that lasercspace used to do.  Checks that the two
+ *       give the same ranges, bit for bit.
+ * Usage: laser_cspace_bench [scans [radius]]
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../cspace.h"
+
+// Round things in the room: pillars and people
+#define BENCH_CIRCLES 12
+
+// Longest range the laser reports [m]
+#define BENCH_MAX_RANGE 30.0
+
+typedef struct
+{
+  double x, y, r;
+} circle_t;
+
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static double uniform(double lo, double hi)
+{
+  return lo + (hi - lo) * rand() / RAND_MAX;
+}
+
+
+// The all-pairs check, as lasercspace did it
+static void reference(const float *ranges, int count, float min_angle,
+                      float resolution, double radius, int step, float *out)
+{
+  int i, n;
+  double (*lu)[4];
+  double r, b, x, y, r_, x_, y_, s, nr, nx, ny, dx, dy, d, h, max_r;
+
+  lu = malloc(count * sizeof(lu[0]));
+  for (i = 0; i < count; i++)
+  {
+    r = ranges[i];
+    b = min_angle + resolution * (unsigned int) i;
+    lu[i][0] = r;
+    lu[i][1] = b;
+    lu[i][2] = r * cos(b);
+    lu[i][3] = r * sin(b);
+  }
+
+  for (n = 0; n < count; n++)
+  {
+    r = lu[n][0];
+    x = lu[n][2];
+    y = lu[n][3];
+    max_r = r - radius;
+    for (i = 0; i < count; i += step)
+    {
+      r_ = lu[i][0];
+      if (r_ - radius > max_r)
+        continue;
+      x_ = lu[i][2];
+      y_ = lu[i][3];
+      s = (x * x_ + y * y_) / (x * x + y * y);
+      if (s < 0 || s > 1)
+        continue;
+      nr = s * r;
+      nx = s * x;
+      ny = s * y;
+      dx = nx - x_;
+      dy = ny - y_;
+      d = sqrt(dx * dx + dy * dy);
+      if (d > radius)
+        continue;
+      h = nr - sqrt(radius * radius - d * d);
+      if (h < max_r)
+        max_r = h;
+    }
+    if (max_r < 0)
+      max_r = 0;
+    out[n] = (float) max_r;
+  }
+  free(lu);
+  return;
+}
+
+
+// Cast a scan from (px, py) in a 10 x 7 m room with a doorway, so some
+// beams go out to the maximum range.  If dropouts is set, a few beams
+// drop out to zero.
+static void cast(float *ranges, int count, float min_angle, float resolution,
+                 double px, double py, const circle_t *circles, int dropouts)
+{
+  int i, k;
+  double b, c, s, t, best, ox, oy, q, disc;
+
+  for (i = 0; i < count; i++)
+  {
+    b = min_angle + resolution * i;
+    c = cos(b);
+    s = sin(b);
+    best = BENCH_MAX_RANGE;
+
+    // Walls
+    if (c > 0 && (t = (10.0 - px) / c) < best && fabs(py + t * s - 5.0) > 0.5)
+      best = t;
+    if (c < 0 && (t = -px / c) < best)
+      best = t;
+    if (s > 0 && (t = (7.0 - py) / s) < best)
+      best = t;
+    if (s < 0 && (t = -py / s) < best)
+      best = t;
+
+    // Pillars and people
+    for (k = 0; k < BENCH_CIRCLES; k++)
+    {
+      ox = circles[k].x - px;
+      oy = circles[k].y - py;
+      q = ox * c + oy * s;
+      disc = q * q - (ox * ox + oy * oy - circles[k].r * circles[k].r);
+      if (disc < 0)
+        continue;
+      t = q - sqrt(disc);
+      if (t > 0 && t < best)
+        best = t;
+    }
+
+    ranges[i] = (float) (best + uniform(-0.01, 0.01));
+    if (dropouts && rand() % 200 == 0)
+      ranges[i] = 0;
+  }
+  return;
+}
+
+
+// Time both on scans of count beams over fov radians.  Returns the
+// number of scans that differ.
+static int run(int count, double fov, int scans, double radius, int step,
+               int dropouts)
+{
+  int i, k, diffs;
+  float *ranges, *expect, *got, min_angle, resolution;
+  double start, t_ref, t_new;
+  circle_t circles[BENCH_CIRCLES];
+  cspace_t *cspace;
+
+  ranges = malloc(count * sizeof(float));
+  expect = malloc(count * sizeof(float));
+  got = malloc(count * sizeof(float));
+  cspace = cspace_alloc();
+  min_angle = (float) (-fov / 2);
+  resolution = (float) (fov / (count - 1));
+
+  diffs = 0;
+  t_ref = t_new = 0;
+  for (i = 0; i < scans; i++)
+  {
+    for (k = 0; k < BENCH_CIRCLES; k++)
+    {
+      circles[k].x = uniform(0.5, 9.5);
+      circles[k].y = uniform(0.5, 6.5);
+      circles[k].r = k < 4 ? 0.3 : 0.15;
+    }
+    cast(ranges, count, min_angle, resolution,
+         uniform(1.0, 3.0), uniform(1.0, 6.0), circles, dropouts);
+
+    start = now();
+    reference(ranges, count, min_angle, resolution, radius, step, expect);
+    t_ref += now() - start;
+
+    start = now();
+    cspace_compute(cspace, ranges, count, min_angle, resolution,
+                   radius, step, got);
+    t_new += now() - start;
+
+    if (memcmp(expect, got, count * sizeof(float)) != 0)
+    {
+      for (k = 0; k < count && expect[k] == got[k]; k++);
+      printf("%d beams, scan %d: beam %d is %.9g, not %.9g\n",
+             count, i, k, got[k], expect[k]);
+      diffs++;
+    }
+  }
+
+  printf("%6d %6.0f %5d %5s %12.3f %12.3f %9.1fx\n", count, fov * 180 / M_PI,
+         step, dropouts ? "yes" : "no",
+         t_ref * 1e3 / scans, t_new * 1e3 / scans, t_ref / t_new);
+
+  cspace_free(cspace);
+  free(ranges);
+  free(expect);
+  free(got);
+  return diffs;
+}
+
+
+int main(int argc, char **argv)
+{
+  int scans, diffs;
+  double radius;
+
+  scans = argc > 1 ? atoi(argv[1]) : 50;
+  radius = argc > 2 ? atof(argv[2]) : 0.5;
+
+  srand(1);
+  printf("robot radius %.2f m, %d scans each\n", radius, scans);
+  printf(" beams    fov  step zeros  all-pairs ms      tree ms   speedup\n");
+  diffs = 0;
+  diffs += run(181, M_PI, scans, radius, 1, 0);
+  diffs += run(541, 1.5 * M_PI, scans, radius, 1, 0);
+  diffs += run(1081, 1.5 * M_PI, scans, radius, 1, 0);
+  diffs += run(2161, 1.5 * M_PI, scans, radius, 1, 0);
+
+  // Subsampled, all the way round, and with zero ranges, which touch
+  // every beam
+  diffs += run(1081, 1.5 * M_PI, scans, radius, 3, 0);
+  diffs += run(720, 2 * M_PI * 719 / 720, scans, radius, 1, 0);
+  diffs += run(1081, 1.5 * M_PI, scans, radius, 1, 1);
+
+  printf("%d scans differ\n", diffs);
+  return diffs ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: Laser pipeline tests.  Feeds scans from a test laser through a
+ *       laserpipeline driver running the cutter, rescan and cspace
+ *       stages, and checks the scan published after each stage.
+ * Usage: laserpipeline_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayerinterface/interface_util.h>
+#include <libplayercommon/test/test.h>
+
+#define FILENAME "laserpipeline_test.cfg"
+
+// The source scan: 361 beams, half a degree apart
+#define SCAN_COUNT 361
+#define SCAN_RES (M_PI / 360)
+
+// The driver under test, from laserpipeline.cc
+Driver* LaserPipeline_Init(ConfigFile* cf, int section);
+
+// A laser that publishes the scans it is given
+class TestLaser : public Driver
+{
+  public:
+    TestLaser() : Driver(NULL, -1)
+    {
+      memset(&this->addr, 0, sizeof(this->addr));
+      this->addr.interf = PLAYER_LASER_CODE;
+      this->AddInterface(this->addr);
+    }
+
+    int Setup() { return 0; }
+    int Shutdown() { return 0; }
+
+    void Send(float * ranges)
+    {
+      player_laser_data_t scan;
+      memset(&scan, 0, sizeof(scan));
+      scan.min_angle = -M_PI / 2;
+      scan.max_angle = M_PI / 2;
+      scan.resolution = SCAN_RES;
+      scan.max_range = 8.0;
+      scan.ranges_count = SCAN_COUNT;
+      scan.ranges = ranges;
+      this->Publish(this->addr, PLAYER_MSGTYPE_DATA, PLAYER_LASER_DATA_SCAN,
+                    &scan);
+    }
+
+    player_devaddr_t addr;
+};
+
+static player_devaddr_t laser(int index)
+{
+  player_devaddr_t addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.interf = PLAYER_LASER_CODE;
+  addr.index = index;
+  return addr;
+}
+
+// Run the pipeline on a scan, and collect what each stage published
+static void run(TestLaser * source, Driver * pipeline, QueuePointer & queue,
+                float * ranges, Message * out[3])
+{
+  Message * msg;
+
+  out[0] = out[1] = out[2] = NULL;
+  source->Send(ranges);
+  pipeline->Update();
+  while ((msg = queue->Pop()) != NULL)
+  {
+    int i = msg->GetHeader()->addr.index - 1;
+    if (i >= 0 && i < 3 && !out[i] &&
+        msg->GetHeader()->type == PLAYER_MSGTYPE_DATA &&
+        msg->GetHeader()->subtype == PLAYER_LASER_DATA_SCAN)
+      out[i] = msg;
+    else
+      delete msg;
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  playerxdr_ftable_init();
+  itable_init();
+  ErrorInit(1, NULL);
+  player_globals_init();
+
+  // The cspace scan on laser:1, the cut scan on laser:2 and the rescanned
+  // scan on laser:3
+  FILE * file = fopen(FILENAME, "w");
+  fprintf(file,
+          "driver\n"
+          "(\n"
+          "  name \"laserpipeline\"\n"
+          "  requires [\"laser:0\"]\n"
+          "  provides [\"laser:1\" \"cutter:::laser:2\" \"rescan:::laser:3\"]\n"
+          "  stages [\"cutter\" \"rescan\" \"cspace\"]\n"
+          "  cutter_min_angle -60\n"
+          "  cutter_max_angle 60\n"
+          "  rescan_min_angle -50\n"
+          "  rescan_max_angle 50\n"
+          "  rescan_scan_count 101\n"
+          "  cspace_radius 0.5\n"
+          ")\n");
+  fclose(file);
+
+  ConfigFile cf;
+  TEST("load the configuration");
+  check(cf.Load(FILENAME));
+  remove(FILENAME);
+
+  TestLaser * source = new TestLaser();
+  Driver * pipeline = LaserPipeline_Init(&cf, 1);
+  TEST("make the driver");
+  check(pipeline->GetError() == 0);
+  if (pipeline->GetError() != 0)
+    return test_result();
+
+  QueuePointer queue(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  Device * devs[3];
+  for (int i = 0; i < 3; i++)
+  {
+    devs[i] = deviceTable->GetDevice(laser(i + 1));
+    devs[i]->Subscribe(queue);
+  }
+
+  // Ranges that grow along the scan, so that every beam can be told apart
+  float ranges[SCAN_COUNT];
+  for (int i = 0; i < SCAN_COUNT; i++)
+    ranges[i] = 2.0 + 0.001 * i;
+
+  Message * out[3];
+  run(source, pipeline, queue, ranges, out);
+
+  TEST("every stage publishes");
+  check(out[0] && out[1] && out[2]);
+  if (!out[0] || !out[1] || !out[2])
+    return test_result();
+
+  player_laser_data_t * cut = (player_laser_data_t *) out[1]->GetPayload();
+  player_laser_data_t * rescan = (player_laser_data_t *) out[2]->GetPayload();
+  player_laser_data_t * cspace = (player_laser_data_t *) out[0]->GetPayload();
+  bool ok;
+
+  TEST("cutter keeps the beams between its angles");
+  ok = cut->ranges_count == 241 &&
+    fabs(cut->min_angle + M_PI / 3) < 1e-5 &&
+    fabs(cut->max_angle - M_PI / 3) < 1e-5;
+  for (unsigned int i = 0; ok && i < cut->ranges_count; i++)
+    ok = cut->ranges[i] == ranges[i + 60];
+  check(ok);
+
+  TEST("rescan interpolates onto the new beams");
+  ok = rescan->ranges_count == 101 &&
+    fabs(rescan->min_angle + 50 * M_PI / 180) < 1e-5 &&
+    fabs(rescan->max_angle - 50 * M_PI / 180) < 1e-5 &&
+    fabs(rescan->resolution - M_PI / 180) < 1e-5;
+  for (unsigned int i = 0; ok && i < rescan->ranges_count; i++)
+  {
+    // Two source beams to the degree, from -90 degrees
+    double expect = 2.0 + 0.001 * (2.0 * i + 80);
+    ok = fabs(rescan->ranges[i] - expect) < 1e-4;
+  }
+  check(ok);
+
+  TEST("cspace works on the rescanned scan");
+  ok = cspace->ranges_count == rescan->ranges_count &&
+    cspace->min_angle == rescan->min_angle &&
+    cspace->resolution == rescan->resolution;
+  for (unsigned int i = 0; ok && i < cspace->ranges_count; i++)
+    ok = cspace->ranges[i] <= rescan->ranges[i] &&
+      cspace->ranges[i] >= rescan->ranges[0] - 0.5 - 1e-4;
+  check(ok);
+
+  for (int i = 0; i < 3; i++)
+    delete out[i];
+
+  // A round room: the robot can go to within its radius of the wall
+  for (int i = 0; i < SCAN_COUNT; i++)
+    ranges[i] = 3.0;
+  run(source, pipeline, queue, ranges, out);
+
+  TEST("cspace of a round room");
+  ok = out[0] != NULL;
+  if (out[0])
+  {
+    cspace = (player_laser_data_t *) out[0]->GetPayload();
+    ok = cspace->ranges_count == 101;
+    for (unsigned int i = 0; ok && i < cspace->ranges_count; i++)
+      ok = fabs(cspace->ranges[i] - 2.5) < 1e-4;
+  }
+  check(ok);
+
+  for (int i = 0; i < 3; i++)
+    delete out[i];
+
+  for (int i = 0; i < 3; i++)
+    devs[i]->Unsubscribe(queue);
+
+  return test_result();
+}
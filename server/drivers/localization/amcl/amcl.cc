@@ -154,6 +154,15 @@ The @p amcl driver requires the following interfaces, some of them named:
   - pf_z (float)
     - Default: 3
     - Control parameter for the particle set size.  See notes below.
+  - pf_threads (integer)
+    - Default: 1
+    - Number of threads used to apply the odometry and laser models to
+      the particles, and to compute the cluster statistics.
+  - pf_seed (integer)
+    - Default: 0
+    - Seed for the particle filter's random numbers.  For a given seed
+      and input, the filter produces the same estimates whatever the
+      number of threads.
   - init_pose (tuple: [length length angle])
     - Default: [0 0 0] (m m rad)
     - Initial pose estimate (mean value) for the robot.
@@ -186,6 +195,39 @@ The @p amcl driver requires the following interfaces, some of them named:
   - laser_range_bad (float)
     - Default 0.1
     - ???
+  - laser_model_type (string)
+    - Default: "beam"
+    - Sensor model used to weight the particles:
+      - "beam": compares each range with the range cast through the map
+        from the particle pose.
+      - "likelihood_field": scores the end-point of each beam by its
+        distance to the nearest occupied cell, using the same gaussian
+        (laser_range_var, laser_range_bad) over that distance.  Max-range
+        readings are ignored.  Much cheaper than ray casting, and more
+        robust to small pose errors.
+  - laser_likelihood_max_dist (length)
+    - Default: 2.0 m
+    - Distance up to which obstacles are searched for by the likelihood
+      field model.
+  - laser_range_table (integer)
+    - Default: 0
+    - Set to 1 to have the beam model look up pre-computed ranges
+      instead of ray casting.  The table holds one range per map cell per
+      discrete heading, i.e. width * height * laser_range_table_angles * 2
+      bytes, and takes a while to build on large maps; see
+      laser_range_table_cache.
+  - laser_range_table_angles (integer)
+    - Default: 360
+    - Number of discrete headings in the range table.
+  - laser_range_table_max_range (length)
+    - Default: 10.0 m
+    - Longest range stored in the range table; should be at least the
+      laser's maximum range plus 1 m.
+  - laser_range_table_cache (filename)
+    - Default: none
+    - File in which to keep the range table.  The table is mapped from
+      this file when it was built for the same map and settings, and
+      rebuilt and saved otherwise.
 - Debugging:
   - enable_gui (integer)
     - Default: 0
@@ -221,6 +263,8 @@ runs, but the following tips might be helpful:
   - Increasing the allowed error @p pf_err and reducing the quantile
     @p pf_z will lead to smaller particle sets and will hence increase
     driver speed.  This may also lead, however, to over-convergence.
+  - On multi-core machines, @p pf_threads spreads the work on large
+    particle sets over several cores.
 As a benchmark, this driver has been successfully deployed on a
 Pioneer2DX equipped with a SICK LMS200 and a 266MHz Mobile Pentium
 with 32Mb of RAM.
@@ -444,6 +488,8 @@ AdaptiveMCL::AdaptiveMCL( ConfigFile* cf, int section)
   // Adaptive filter parameters
   this->pf_err = cf->ReadFloat(section, "pf_err", 0.01);
   this->pf_z = cf->ReadFloat(section, "pf_z", 3);
+  this->pf_threads = cf->ReadInt(section, "pf_threads", 1);
+  this->pf_seed = cf->ReadInt(section, "pf_seed", 0);
 
   // Initial pose estimate
   this->pf_init_pose_mean = pf_vector_zero();
@@ -514,6 +560,10 @@ int AdaptiveMCL::MainSetup(void)
   this->pf = pf_alloc(this->pf_min_samples, this->pf_max_samples);
   this->pf->pop_err = this->pf_err;
   this->pf->pop_z = this->pf_z;
+  pf_set_seed(this->pf, this->pf_seed);
+  if (this->pf_threads > 1 &&
+      pf_set_threads(this->pf, this->pf_threads) != this->pf_threads)
+    PLAYER_WARN("updating the particle filter in a single thread");
 
   // Start sensors
   for (int i = 0; i < this->sensor_count; i++)
@@ -1148,7 +1198,6 @@ AdaptiveMCL::ProcessMessage(QueuePointer & resp_queue,
     double var;
     player_localize_get_particles_t resp;
     pf_sample_set_t *set;
-    pf_sample_t *sample;
     size_t i;
 
     pf_get_cep_stats(this->pf, &mean, &var);
@@ -1166,11 +1215,10 @@ AdaptiveMCL::ProcessMessage(QueuePointer & resp_queue,
     // TODO: pick representative particles
     for(i=0;i<resp.particles_count;i++)
     {
-      sample = set->samples + i;
-      resp.particles[i].pose.px = sample->pose.v[0];
-      resp.particles[i].pose.py = sample->pose.v[1];
-      resp.particles[i].pose.pa = sample->pose.v[2];
-      resp.particles[i].alpha = sample->weight;
+      resp.particles[i].pose.px = set->x[i];
+      resp.particles[i].pose.py = set->y[i];
+      resp.particles[i].pose.pa = set->theta[i];
+      resp.particles[i].alpha = set->weight[i];
     }
 
     this->Publish(this->localize_addr, resp_queue,
@@ -166,6 +166,7 @@ class AdaptiveMCL : public ThreadedDriver
   private: pf_t *pf;
   private: int pf_min_samples, pf_max_samples;
   private: double pf_err, pf_z;
+  private: int pf_threads, pf_seed;
 
   // Sensor data queue
   private: int q_size, q_start, q_len;
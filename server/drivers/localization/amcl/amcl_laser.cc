@@ -34,6 +34,7 @@
 #include <sys/types.h> // required by Darwin
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #if !defined (WIN32)
   #include <unistd.h>
 #endif
@@ -47,6 +48,9 @@ AMCLLaser::AMCLLaser(AdaptiveMCL & aAMCL, player_devaddr_t addr) : AMCLSensor(aA
 {
   this->laser_dev = NULL;
   this->laser_addr = addr;
+  this->map = NULL;
+  this->model = NULL;
+  this->range_table = NULL;
 
   return;
 }
@@ -65,6 +69,25 @@ int AMCLLaser::Load(ConfigFile* cf, int section)
   this->range_var = cf->ReadLength(section, "laser_range_var", 0.10);
   this->range_bad = cf->ReadFloat(section, "laser_range_bad", 0.10);
 
+  const char *model_type = cf->ReadString(section, "laser_model_type", "beam");
+  if (strcmp(model_type, "beam") == 0)
+    this->model_type = LASER_MODEL_BEAM;
+  else if (strcmp(model_type, "likelihood_field") == 0)
+    this->model_type = LASER_MODEL_LIKELIHOOD_FIELD;
+  else
+  {
+    PLAYER_ERROR1("unknown laser model type \"%s\"", model_type);
+    return -1;
+  }
+  this->likelihood_max_dist = cf->ReadLength(section, "laser_likelihood_max_dist", 2.0);
+
+  this->use_range_table = cf->ReadInt(section, "laser_range_table", 0);
+  this->range_table_angles = cf->ReadInt(section, "laser_range_table_angles", 360);
+  this->range_table_max_range = cf->ReadLength(section, "laser_range_table_max_range", 10.0);
+  this->range_table_cache = cf->ReadFilename(section, "laser_range_table_cache", NULL);
+  if (this->use_range_table && this->model_type != LASER_MODEL_BEAM)
+    PLAYER_WARN("laser_range_table only applies to the beam model; ignoring");
+
   this->time = 0.0;
 
   return 0;
@@ -92,6 +115,35 @@ int AMCLLaser::Setup(void)
     return(-1);
   }
 
+  if (this->model_type == LASER_MODEL_LIKELIHOOD_FIELD)
+  {
+    PLAYER_MSG1(2, "computing cspace distances up to %.3f m",
+                this->likelihood_max_dist);
+    map_update_cspace(this->map, this->likelihood_max_dist);
+  }
+  else if (this->use_range_table)
+  {
+    this->range_table = map_range_table_alloc(this->map,
+                                              this->range_table_angles,
+                                              this->range_table_max_range,
+                                              this->range_table_cache);
+    if (!this->range_table)
+    {
+      PLAYER_ERROR("failed to set up the laser range table");
+      return(-1);
+    }
+    this->range_table_warned = false;
+  }
+
+  this->model = laser_model_alloc(this->map, this->model_type, this->max_beams,
+                                  this->range_var, this->range_bad);
+  if (!this->model)
+  {
+    PLAYER_ERROR("invalid laser sensor model settings, or out of memory");
+    return(-1);
+  }
+  this->model->range_table = this->range_table;
+
   // Subscribe to the Laser device
   this->laser_dev = deviceTable->GetDevice(this->laser_addr);
   if (!this->laser_dev)
@@ -130,6 +182,7 @@ int AMCLLaser::Setup(void)
                 RTOD(this->laser_pose.v[2]));
     delete msg;
   }
+  this->model->laser_pose = this->laser_pose;
   return 0;
 }
 
@@ -155,100 +208,39 @@ AMCLLaser::SetupMap(void)
   this->map = map_alloc();
   PLAYER_MSG1(2, "AMCL loading map from map:%d...", this->map_addr.index);
 
-  // Fill in the map structure (I'm doing it here instead of in libmap,
-  // because libmap is written in C, so it'd be a pain to invoke the internal
-  // device API from there)
-
-  // first, get the map info
-  Message* msg;
-  if(!(msg = mapdev->Request(AMCL.InQueue,
-                             PLAYER_MSGTYPE_REQ,
-                             PLAYER_MAP_REQ_GET_INFO,
-                             NULL, 0, NULL)))
+  // Get the grid; the map driver shares it if it is in this server,
+  // otherwise it is fetched in tiles.  The grid carries the map info.
+  MapGrid* grid;
+  if(!(grid = MapGrid::Fetch(mapdev, AMCL.InQueue)))
   {
-    PLAYER_ERROR("failed to get map info");
+    PLAYER_ERROR("failed to get map");
     return(-1);
   }
 
   PLAYER_MSG1(2, "AMCL loading map from map:%d...Done", this->map_addr.index);
 
-  player_map_info_t* info = (player_map_info_t*)msg->GetPayload();
-
   // copy in the map info
-  this->map->origin_x = info->origin.px + (info->scale * info->width) / 2.0;
-  this->map->origin_y = info->origin.py + (info->scale * info->height) / 2.0;
-  this->map->scale = info->scale;
-  this->map->size_x = info->width;
-  this->map->size_y = info->height;
+  this->map->origin_x = grid->info.origin.px + (grid->info.scale * grid->info.width) / 2.0;
+  this->map->origin_y = grid->info.origin.py + (grid->info.scale * grid->info.height) / 2.0;
+  this->map->scale = grid->info.scale;
+  this->map->size_x = grid->info.width;
+  this->map->size_y = grid->info.height;
   this->map->data_range = 1;
 
-  delete msg;
-
   // allocate space for map cells
   this->map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) *
                                                   this->map->size_x *
                                                   this->map->size_y);
   assert(this->map->cells);
 
-  // now, get the map data
-  player_map_data_t* data_req;
-  int i,j;
-  int oi,oj;
-  int sx,sy;
-  int si,sj;
-
-  data_req = (player_map_data_t*) malloc(sizeof(player_map_data_t));
-  assert(data_req);
-
-  // Tile size, limit to sensible maximum of 640x640 tiles
-  sy = sx = 640;
-  oi=oj=0;
-  while((oi < this->map->size_x) && (oj < this->map->size_y))
+  // copy the map data; MAP_INDEX is row-major, as the grid is
+  for(int i = 0; i < this->map->size_x * this->map->size_y; i++)
   {
-    si = MIN(sx, this->map->size_x - oi);
-    sj = MIN(sy, this->map->size_y - oj);
-
-    data_req->col = oi;
-    data_req->row = oj;
-    data_req->width = si;
-    data_req->height = sj;
-    data_req->data_count = 0;
-
-    if(!(msg = mapdev->Request(AMCL.InQueue,
-                               PLAYER_MSGTYPE_REQ,
-                               PLAYER_MAP_REQ_GET_DATA,
-                               (void*)data_req,0,NULL)))
-    {
-      PLAYER_ERROR("failed to get map info");
-      free(data_req);
-      free(this->map->cells);
-      return(-1);
-    }
-
-    player_map_data_t* mapdata = (player_map_data_t*)msg->GetPayload();
-
-    // copy the map data
-    for(j=0;j<sj;j++)
-    {
-      for(i=0;i<si;i++)
-      {
-        this->map->cells[MAP_INDEX(this->map,oi+i,oj+j)].occ_state =
-                mapdata->data[j*si + i];
-        this->map->cells[MAP_INDEX(this->map,oi+i,oj+j)].occ_dist = 0;
-      }
-    }
-
-    delete msg;
-
-    oi += si;
-    if(oi >= this->map->size_x)
-    {
-      oi = 0;
-      oj += sj;
-    }
+    this->map->cells[i].occ_state = grid->cells[i];
+    this->map->cells[i].occ_dist = 0;
   }
 
-  free(data_req);
+  grid->Unref();
 
   // we're done with the map device now
   if(mapdev->Unsubscribe(AMCL.InQueue) != 0)
@@ -266,7 +258,12 @@ int AMCLLaser::Shutdown(void)
 {
   this->laser_dev->Unsubscribe(AMCL.InQueue);
   this->laser_dev = NULL;
+  laser_model_free(this->model);
+  this->model = NULL;
+  map_range_table_free(this->range_table);
+  this->range_table = NULL;
   map_free(this->map);
+  this->map = NULL;
 
   return 0;
 }
@@ -328,6 +325,15 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
   if (this->max_beams < 2)
     return false;
 
+  if (this->range_table && !this->range_table_warned &&
+      ndata->range_max + 1.0 > this->range_table->max_range)
+  {
+    PLAYER_WARN2("laser range table is limited to %.3f m; ranges up to %.3f m "
+                 "will be clipped", this->range_table->max_range,
+                 ndata->range_max + 1.0);
+    this->range_table_warned = true;
+  }
+
   // Apply the laser sensor model
   pf_update_sensor(pf, (pf_sensor_model_fn_t) SensorModel, data);
 
@@ -340,75 +346,11 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
 double AMCLLaser::SensorModel(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, c, pz;
-  double p;
-  double map_range;
-  double obs_range, obs_bearing;
-  double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
-
-  // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
-  {
-    sample = set->samples + j;
-    pose = sample->pose;
-
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose, pose);
-
-    p = 1.0;
-
-    step = (data->range_count - 1) / (self->max_beams - 1);
-    for (i = 0; i < data->range_count; i += step)
-    {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
-
-      // Compute the range according to the map
-      map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
-                                 pose.v[2] + obs_bearing, data->range_max + 1.0);
-
-      if (obs_range >= data->range_max && map_range >= data->range_max)
-      {
-        pz = 1.0;
-      }
-      else
-      {
-        // TODO: proper sensor model (using Kolmagorov?)
-        // Simple gaussian model
-        c = self->range_var;
-        z = obs_range - map_range;
-        pz = self->range_bad + (1 - self->range_bad) * exp(-(z * z) / (2 * c * c));
-      }
-
-      /*
-         if (obs->range >= 8.0 && map_range >= 8.0)
-         p *= 1.0;
-         else if (obs->range >= 8.0 && map_range < 8.0)
-         p *= self->range_bad;
-         else if (obs->range < 8.0 && map_range >= 8.0)
-         p *= self->range_bad;
-         else
-         p *= laser_sensor_prob(self, obs->range, map_range);
-       */
-
-      p *= pz;
-    }
-
-    //printf("%e\n", p);
-    //assert(p >= 0);
-
-    sample->weight *= p;
-    total_weight += sample->weight;
-  }
-
-  return(total_weight);
+  return laser_model_update(self->model, data->range_count, data->range_max,
+                            data->ranges, set);
 }
 
 
@@ -105,6 +105,21 @@ class AMCLLaser : public AMCLSensor
   // Probability of bad range readings
   private: double range_bad;
 
+  // Sensor model used to weight the samples
+  private: laser_model_type_t model_type;
+  private: laser_model_t *model;
+
+  // Cspace distance limit for the likelihood field model
+  private: double likelihood_max_dist;
+
+  // Pre-computed range table settings, for the beam model
+  private: int use_range_table;
+  private: int range_table_angles;
+  private: double range_table_max_range;
+  private: const char *range_table_cache;
+  private: map_range_table_t *range_table;
+  private: bool range_table_warned;
+
 #ifdef INCLUDE_RTKGUI
   // Setup the GUI
   private: virtual void SetupGUI(rtk_canvas_t *canvas, rtk_fig_t *robot_fig);
@@ -208,18 +208,9 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
 void
 AMCLOdom::ActionModel(AMCLOdom *self, pf_sample_set_t* set)
 {
-  int i;
-  pf_vector_t z;
-  pf_sample_t *sample;
-
-  // Compute the new sample poses
-  for (i = 0; i < set->sample_count; i++)
-  {
-    sample = set->samples + i;
-    z = pf_pdf_gaussian_sample(self->action_pdf);
-    sample->pose = pf_vector_coord_add(z, sample->pose);
-    sample->weight = 1.0 / set->sample_count;
-  }
+  // Compute the new sample poses.  The set may be a slice of the filter's
+  // samples, so leave the weights alone; they are uniform after resampling.
+  pf_sample_set_move(set, self->action_pdf);
 }
 
 
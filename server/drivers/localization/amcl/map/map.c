@@ -34,6 +34,8 @@
 #include <string.h>
 
 #include "map.h"
+#include <libplayercommon/playercommon.h>
+#include <libplayercommon/edt.h>
 
 
 // Create a new map
@@ -86,56 +88,69 @@ map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa)
 }
 
 
-// Update the cspace distance values
+// Update the cspace distance values.  The distance transform is exact, so
+// each cell gets the distance to its nearest occupied cell, as a search
+// of its neighbourhood would give, but in time linear in the map size.
 void map_update_cspace(map_t *map, double max_occ_dist)
 {
-  int i, j;
-  int ni, nj;
-  int s;
+  int i, n;
   double d;
-  map_cell_t *cell, *ncell;
+  uint8_t *occ;
+  uint32_t *dist2;
 
   map->max_occ_dist = max_occ_dist;
-  s = (int) ceil(map->max_occ_dist / map->scale);
+  n = map->size_x * map->size_y;
 
-  // Reset the distance values
-  for (j = 0; j < map->size_y; j++)
+  occ = malloc(n * sizeof(uint8_t));
+  dist2 = malloc(n * sizeof(uint32_t));
+  if (occ != NULL && dist2 != NULL)
   {
-    for (i = 0; i < map->size_x; i++)
-    {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      cell->occ_dist = map->max_occ_dist;
-    }
+    for (i = 0; i < n; i++)
+      occ[i] = (map->cells[i].occ_state == +1);
   }
 
-  // Find all the occupied cells and update their neighbours
-  for (j = 0; j < map->size_y; j++)
+  if (occ == NULL || dist2 == NULL ||
+      player_edt(occ, map->size_x, map->size_y, 0, dist2) != 0)
+  {
+    PLAYER_ERROR("unable to allocate the cspace distance transform");
+    for (i = 0; i < n; i++)
+      map->cells[i].occ_dist = map->max_occ_dist;
+  }
+  else
   {
-    for (i = 0; i < map->size_x; i++)
+    for (i = 0; i < n; i++)
     {
-      cell = map->cells + MAP_INDEX(map, i, j);
-      if (cell->occ_state != +1)
-        continue;
-          
-      cell->occ_dist = 0;
-
-      // Update adjacent cells
-      for (nj = -s; nj <= +s; nj++)
-      {
-        for (ni = -s; ni <= +s; ni++)
-        {
-          if (!MAP_VALID(map, i + ni, j + nj))
-            continue;
-
-          ncell = map->cells + MAP_INDEX(map, i + ni, j + nj);
-          d = map->scale * sqrt(ni * ni + nj * nj);
-
-          if (d < ncell->occ_dist)
-            ncell->occ_dist = d;
-        }
-      }
+      d = (dist2[i] == PLAYER_EDT_NONE ? map->max_occ_dist : map->scale * sqrt(dist2[i]));
+      map->cells[i].occ_dist = (d < map->max_occ_dist ? d : map->max_occ_dist);
     }
   }
-  
+
+  free(occ);
+  free(dist2);
   return;
 }
+
+
+// Compute a hash of the map geometry and occupancy (64-bit FNV-1a).  Only
+// the values that affect range readings are included.
+uint64_t map_hash(map_t *map)
+{
+  int i, n;
+  uint64_t h;
+  int64_t scale;
+  
+  h = 14695981039346656037ULL;
+#define MAP_HASH_MIX(v) (h = (h ^ (uint64_t) (v)) * 1099511628211ULL)
+
+  MAP_HASH_MIX(map->size_x);
+  MAP_HASH_MIX(map->size_y);
+  scale = (int64_t) floor(map->scale * 1e9 + 0.5);
+  MAP_HASH_MIX(scale);
+
+  n = map->size_x * map->size_y;
+  for (i = 0; i < n; i++)
+    MAP_HASH_MIX(map->cells[i].occ_state + 1);
+
+#undef MAP_HASH_MIX
+  return h;
+}
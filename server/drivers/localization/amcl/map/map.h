@@ -85,6 +85,32 @@ typedef struct
 } map_t;
 
 
+// Pre-computed ranges: one range per map cell per discrete heading.
+typedef struct
+{
+  // Map dimensions the table was built for (number of cells)
+  int size_x, size_y;
+
+  // Number of discrete headings over [0, 2pi)
+  int num_angles;
+
+  // Range limit used when building the table
+  double max_range;
+
+  // Range quantum (m)
+  double range_res;
+
+  // Quantized ranges, stored as [MAP_INDEX(map, i, j) * num_angles + k]
+  uint16_t *ranges;
+
+  // Backing storage; either a mapped cache file or malloc'ed memory
+  void *mem;
+  size_t mem_size;
+  int mapped;
+
+} map_range_table_t;
+
+
 
 /**************************************************************************
  * Basic map functions
@@ -108,6 +134,9 @@ int map_load_wifi(map_t *map, const char *filename, int index);
 // Update the cspace distances
 void map_update_cspace(map_t *map, double max_occ_dist);
 
+// Compute a hash of the map geometry and occupancy
+uint64_t map_hash(map_t *map);
+
 
 /**************************************************************************
  * Range functions
@@ -116,6 +145,20 @@ void map_update_cspace(map_t *map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t *map, double ox, double oy, double oa, double max_range);
 
+// Build the range table for the map, or load it from the given cache
+// file if that was built for the same map and settings.  The cache file
+// is (re)written when it does not match; pass NULL to build in memory only.
+map_range_table_t *map_range_table_alloc(map_t *map, int num_angles,
+                                         double max_range, const char *cache_file);
+
+// Destroy a range table
+void map_range_table_free(map_range_table_t *table);
+
+// Look up a single range reading in the table; the pose is snapped to
+// the nearest cell and heading.
+double map_range_table_lookup(map_t *map, map_range_table_t *table,
+                              double ox, double oy, double oa);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -0,0 +1,293 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+/**************************************************************************
+ * Desc: Pre-computed range table.  Holds the result of map_calc_range()
+ *       for every free cell and a fixed set of headings, so that the
+ *       beam sensor model can replace ray casting with a lookup.  The
+ *       table can be kept in a cache file, which is mapped read-only on
+ *       subsequent runs with the same map.
+ * CVS: $Id$
+**************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined (WIN32)
+  #include <unistd.h>
+  #include <sys/mman.h>
+#endif
+
+#include "map.h"
+#include <libplayercommon/playercommon.h>
+
+// Ranges are quantized to this fraction of a cell
+#define MAP_RANGE_TABLE_SUBCELLS 16
+
+#define MAP_RANGE_TABLE_MAGIC "AMCLRT1"
+
+// Cache file header; the quantized ranges follow immediately.
+typedef struct
+{
+  char magic[8];
+  uint64_t map_hash;
+  int32_t size_x, size_y;
+  int32_t num_angles, reserved;
+  double max_range;
+  double range_res;
+} map_range_table_header_t;
+
+
+// Fill in the table by ray casting from the center of every free cell.
+// Ranges from occupied, unknown and out-of-map cells are zero, as they
+// would be from map_calc_range().
+static void map_range_table_build(map_t *map, map_range_table_t *table)
+{
+  int i, j, k;
+  double ox, oy, r, q;
+  uint16_t *row;
+
+  for (j = 0; j < map->size_y; j++)
+  {
+    for (i = 0; i < map->size_x; i++)
+    {
+      row = table->ranges + (size_t) MAP_INDEX(map, i, j) * table->num_angles;
+      if (map->cells[MAP_INDEX(map, i, j)].occ_state >= 0)
+      {
+        memset(row, 0, table->num_angles * sizeof(row[0]));
+        continue;
+      }
+
+      ox = MAP_WXGX(map, i);
+      oy = MAP_WYGY(map, j);
+      for (k = 0; k < table->num_angles; k++)
+      {
+        r = map_calc_range(map, ox, oy, k * 2 * M_PI / table->num_angles,
+                           table->max_range);
+        q = floor(r / table->range_res + 0.5);
+        row[k] = (uint16_t) (q < 65535 ? q : 65535);
+      }
+    }
+  }
+  return;
+}
+
+
+// Map an existing cache file, if it matches the given header.
+static int map_range_table_load(map_range_table_t *table,
+                                map_range_table_header_t *header,
+                                size_t size, const char *filename)
+{
+#if !defined (WIN32)
+  int fd;
+  struct stat st;
+  void *mem;
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return -1;
+  if (fstat(fd, &st) < 0 || (size_t) st.st_size != size)
+  {
+    close(fd);
+    return -1;
+  }
+  mem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    return -1;
+  if (memcmp(mem, header, sizeof(*header)) != 0)
+  {
+    munmap(mem, size);
+    return -1;
+  }
+  table->mem = mem;
+  table->mapped = 1;
+#else
+  FILE *file;
+  void *mem;
+
+  if ((file = fopen(filename, "rb")) == NULL)
+    return -1;
+  if ((mem = malloc(size)) == NULL)
+  {
+    fclose(file);
+    return -1;
+  }
+  if (fread(mem, 1, size, file) != size ||
+      fgetc(file) != EOF ||
+      memcmp(mem, header, sizeof(*header)) != 0)
+  {
+    free(mem);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+  table->mem = mem;
+  table->mapped = 0;
+#endif
+  table->mem_size = size;
+  table->ranges = (uint16_t*) ((char*) table->mem + sizeof(*header));
+  return 0;
+}
+
+
+// Write the table to a cache file.  The file is written under a temporary
+// name and renamed, so that a concurrent reader never sees a partial table.
+static int map_range_table_save(map_range_table_t *table, const char *filename)
+{
+  FILE *file;
+  char *tmpname;
+  int ret;
+
+  if ((tmpname = malloc(strlen(filename) + 5)) == NULL)
+    return -1;
+  strcpy(tmpname, filename);
+  strcat(tmpname, ".tmp");
+
+  if ((file = fopen(tmpname, "wb")) == NULL)
+  {
+    PLAYER_WARN2("unable to write range table %s: %s", tmpname, strerror(errno));
+    free(tmpname);
+    return -1;
+  }
+  ret = fwrite(table->mem, 1, table->mem_size, file) == table->mem_size ? 0 : -1;
+  if (fclose(file) != 0)
+    ret = -1;
+#if defined (WIN32)
+  remove(filename);
+#endif
+  if (ret == 0 && rename(tmpname, filename) != 0)
+    ret = -1;
+  if (ret != 0)
+  {
+    PLAYER_WARN2("unable to write range table %s: %s", filename, strerror(errno));
+    remove(tmpname);
+  }
+  free(tmpname);
+  return ret;
+}
+
+
+// Build the range table, or load it from the cache file
+map_range_table_t *map_range_table_alloc(map_t *map, int num_angles,
+                                         double max_range, const char *cache_file)
+{
+  map_range_table_t *table;
+  map_range_table_header_t header;
+  size_t size;
+
+  if (num_angles <= 0 || max_range <= 0 || map->cells == NULL)
+    return NULL;
+
+  if ((table = calloc(1, sizeof(map_range_table_t))) == NULL)
+  {
+    PLAYER_ERROR("unable to allocate the range table");
+    return NULL;
+  }
+  table->size_x = map->size_x;
+  table->size_y = map->size_y;
+  table->num_angles = num_angles;
+  table->max_range = max_range;
+  table->range_res = map->scale / MAP_RANGE_TABLE_SUBCELLS;
+  if (max_range / table->range_res > 65535)
+    table->range_res = max_range / 65535;
+
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, MAP_RANGE_TABLE_MAGIC);
+  header.map_hash = map_hash(map);
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.num_angles = num_angles;
+  header.max_range = max_range;
+  header.range_res = table->range_res;
+
+  size = sizeof(header) +
+    (size_t) map->size_x * map->size_y * num_angles * sizeof(uint16_t);
+
+  if (cache_file && map_range_table_load(table, &header, size, cache_file) == 0)
+  {
+    PLAYER_MSG1(2, "loaded range table from %s", cache_file);
+    return table;
+  }
+
+  if ((table->mem = malloc(size)) == NULL)
+  {
+    PLAYER_ERROR1("unable to allocate %lu bytes for the range table",
+                  (unsigned long) size);
+    free(table);
+    return NULL;
+  }
+  table->mem_size = size;
+  table->mapped = 0;
+  memcpy(table->mem, &header, sizeof(header));
+  table->ranges = (uint16_t*) ((char*) table->mem + sizeof(header));
+
+  PLAYER_MSG3(2, "building range table (%dx%d cells, %d headings)...",
+              map->size_x, map->size_y, num_angles);
+  map_range_table_build(map, table);
+
+  if (cache_file && map_range_table_save(table, cache_file) == 0)
+    PLAYER_MSG1(2, "saved range table to %s", cache_file);
+
+  return table;
+}
+
+
+// Destroy a range table
+void map_range_table_free(map_range_table_t *table)
+{
+  if (table == NULL)
+    return;
+#if !defined (WIN32)
+  if (table->mapped)
+    munmap(table->mem, table->mem_size);
+  else
+#endif
+    free(table->mem);
+  free(table);
+  return;
+}
+
+
+// Look up a single range reading in the table
+double map_range_table_lookup(map_t *map, map_range_table_t *table,
+                              double ox, double oy, double oa)
+{
+  int i, j, k;
+
+  i = (int) MAP_GXWX(map, ox);
+  j = (int) MAP_GYWY(map, oy);
+  if (!MAP_VALID(map, i, j))
+    return 0.0;
+
+  k = (int) floor(oa * table->num_angles / (2 * M_PI) + 0.5) % table->num_angles;
+  if (k < 0)
+    k += table->num_angles;
+
+  return table->ranges[(size_t) MAP_INDEX(map, i, j) * table->num_angles + k] *
+    table->range_res;
+}
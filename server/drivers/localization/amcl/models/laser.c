@@ -28,13 +28,25 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#if defined (__SSE2__)
+  #include <emmintrin.h>
+#endif
 
 #include "laser.h"
 
 #define LASER_MAX_RANGES 401
 
-// Pre-compute the range sensor probabilities
-void laser_precompute(laser_t *self);
+// Resolution and extent of the sample set model probabilities, in steps
+// per standard deviation and standard deviations respectively
+#define LASER_MODEL_LUT_STEPS 100
+#define LASER_MODEL_LUT_SIGMAS 8
+
+// Samples scored at a time by the likelihood field model
+#define LASER_MODEL_CHUNK 64
+
+// Pre-compute the range sensor probabilities.  Returns -1 if out of
+// memory.
+int laser_precompute(laser_t *self);
 
 
 // Create an sensor model
@@ -42,7 +54,8 @@ laser_t *laser_alloc(map_t *map)
 {
   laser_t *self;
 
-  self = calloc(1, sizeof(laser_t));
+  if ((self = calloc(1, sizeof(laser_t))) == NULL)
+    return NULL;
 
   self->map = map;
   self->laser_pose = pf_vector_zero();
@@ -50,11 +63,15 @@ laser_t *laser_alloc(map_t *map)
   self->range_cov = 0.10 * 0.10;
   self->range_bad = 0.50;
 
-  laser_precompute(self);
-    
   self->range_count = 0;
   self->ranges = calloc(LASER_MAX_RANGES, sizeof(laser_range_t));
-  
+
+  if (self->ranges == NULL || laser_precompute(self) != 0)
+  {
+    laser_free(self);
+    return NULL;
+  }
+
   return self;
 }
 
@@ -95,7 +112,7 @@ void laser_add_range(laser_t *self, double range, double bearing)
 // We use a two-dimensional array over (model_range, obs_range).
 // currently, only the difference (obs_range - model_range) is significant,
 // so this is somewhat inefficient.
-void laser_precompute(laser_t *self)
+int laser_precompute(laser_t *self)
 {
   double max;
   double c, z, p;
@@ -107,7 +124,9 @@ void laser_precompute(laser_t *self)
   self->lut_res = 0.01;
   
   self->lut_size = (int) ceil(max / self->lut_res);
-  self->lut_probs = malloc(self->lut_size * self->lut_size * sizeof(self->lut_probs[0]));
+  self->lut_probs = malloc((size_t) self->lut_size * self->lut_size * sizeof(self->lut_probs[0]));
+  if (self->lut_probs == NULL)
+    return -1;
 
   for (i = 0; i < self->lut_size; i++)
   {
@@ -134,7 +153,7 @@ void laser_precompute(laser_t *self)
   // TODO
   // Put beyond-max-range probabilities at the boundary of the LUT
 
-  return;
+  return 0;
 }
 
 
@@ -199,3 +218,324 @@ double laser_sensor_model(laser_t *self, pf_vector_t pose)
   return p;
 }
 
+
+
+// Create a sample set model
+laser_model_t *laser_model_alloc(map_t *map, laser_model_type_t type,
+                                 int max_beams, double range_var, double range_bad)
+{
+  int i;
+  double z;
+  laser_model_t *self;
+
+  if (range_var <= 0)
+    return NULL;
+
+  if ((self = calloc(1, sizeof(laser_model_t))) == NULL)
+    return NULL;
+
+  self->type = type;
+  self->map = map;
+  self->range_table = NULL;
+  self->laser_pose = pf_vector_zero();
+  self->max_beams = max_beams;
+  self->range_var = range_var;
+  self->range_bad = range_bad;
+
+  // Simple gaussian model, tabulated over the absolute error; beyond the
+  // end of the table the probability is that of a bad range.
+  self->lut_res = range_var / LASER_MODEL_LUT_STEPS;
+  self->lut_size = LASER_MODEL_LUT_STEPS * LASER_MODEL_LUT_SIGMAS + 1;
+  if ((self->lut_probs = malloc(self->lut_size * sizeof(self->lut_probs[0]))) == NULL)
+  {
+    free(self);
+    return NULL;
+  }
+  for (i = 0; i < self->lut_size; i++)
+  {
+    z = i * self->lut_res;
+    self->lut_probs[i] = range_bad + (1 - range_bad) *
+      exp(-(z * z) / (2 * range_var * range_var));
+  }
+
+  return self;
+}
+
+
+// Free a sample set model
+void laser_model_free(laser_model_t *self)
+{
+  free(self->lut_probs);
+  free(self);
+  return;
+}
+
+
+// Probability of the given range (or distance) error
+static double laser_model_prob(laser_model_t *self, double z)
+{
+  int i;
+
+  i = (int) (fabs(z) / self->lut_res + 0.5);
+  if (i >= self->lut_size)
+    i = self->lut_size - 1;
+  return self->lut_probs[i];
+}
+
+
+// Compare each beam with the range cast through the map, or looked up
+// in the range table
+static double laser_model_beam(laser_model_t *self, int range_count, double range_max,
+                               double (*ranges)[2], int step, pf_sample_set_t *set)
+{
+  int i, j;
+  double p, pz;
+  double map_range;
+  double obs_range, obs_bearing;
+  double total_weight;
+  pf_vector_t pose;
+
+  total_weight = 0.0;
+
+  for (j = 0; j < set->sample_count; j++)
+  {
+    // Take account of the laser pose relative to the robot
+    pose = pf_vector_coord_add(self->laser_pose, pf_sample_get_pose(set, j));
+
+    p = 1.0;
+
+    for (i = 0; i < range_count; i += step)
+    {
+      obs_range = ranges[i][0];
+      obs_bearing = ranges[i][1];
+
+      // Compute the range according to the map
+      if (self->range_table)
+      {
+        map_range = map_range_table_lookup(self->map, self->range_table,
+                                           pose.v[0], pose.v[1], pose.v[2] + obs_bearing);
+        if (map_range > range_max + 1.0)
+          map_range = range_max + 1.0;
+      }
+      else
+        map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
+                                   pose.v[2] + obs_bearing, range_max + 1.0);
+
+      if (obs_range >= range_max && map_range >= range_max)
+        pz = 1.0;
+      else
+        pz = laser_model_prob(self, obs_range - map_range);
+
+      p *= pz;
+    }
+
+    set->weight[j] *= p;
+    total_weight += set->weight[j];
+  }
+
+  return total_weight;
+}
+
+
+// Find the map cells under [n] end-points; cells outside the map are -1.
+// Matches MAP_GXWX() and MAP_GYWY().
+static void laser_model_cells(map_t *map, int n, const double *x, const double *y,
+                              int *cells)
+{
+  int k, mi, mj;
+
+  k = 0;
+#if defined (__SSE2__)
+  {
+    __m128d ox, oy, scale, half, lo, hi, a, b;
+    __m128i ia, ib;
+    int gi[4];
+
+    ox = _mm_set1_pd(map->origin_x);
+    oy = _mm_set1_pd(map->origin_y);
+    scale = _mm_set1_pd(map->scale);
+    half = _mm_set1_pd(0.5);
+    lo = _mm_set1_pd(-1e9);
+    hi = _mm_set1_pd(1e9);
+
+    for (; k + 2 <= n; k += 2)
+    {
+      // Clamp first, so that the conversion cannot overflow; floor() is
+      // truncation, less one where that rounded up
+      a = _mm_add_pd(_mm_div_pd(_mm_sub_pd(_mm_loadu_pd(x + k), ox), scale), half);
+      b = _mm_add_pd(_mm_div_pd(_mm_sub_pd(_mm_loadu_pd(y + k), oy), scale), half);
+      a = _mm_max_pd(_mm_min_pd(a, hi), lo);
+      b = _mm_max_pd(_mm_min_pd(b, hi), lo);
+      ia = _mm_cvttpd_epi32(a);
+      ib = _mm_cvttpd_epi32(b);
+      ia = _mm_add_epi32(ia, _mm_shuffle_epi32(
+                           _mm_castpd_si128(_mm_cmpgt_pd(_mm_cvtepi32_pd(ia), a)),
+                           _MM_SHUFFLE(3, 3, 2, 0)));
+      ib = _mm_add_epi32(ib, _mm_shuffle_epi32(
+                           _mm_castpd_si128(_mm_cmpgt_pd(_mm_cvtepi32_pd(ib), b)),
+                           _MM_SHUFFLE(3, 3, 2, 0)));
+      _mm_storel_epi64((__m128i*) gi, ia);
+      _mm_storel_epi64((__m128i*) (gi + 2), ib);
+
+      mi = gi[0] + map->size_x / 2;
+      mj = gi[2] + map->size_y / 2;
+      cells[k + 0] = MAP_VALID(map, mi, mj) ? MAP_INDEX(map, mi, mj) : -1;
+      mi = gi[1] + map->size_x / 2;
+      mj = gi[3] + map->size_y / 2;
+      cells[k + 1] = MAP_VALID(map, mi, mj) ? MAP_INDEX(map, mi, mj) : -1;
+    }
+  }
+#endif
+  for (; k < n; k++)
+  {
+    mi = (int) MAP_GXWX(map, x[k]);
+    mj = (int) MAP_GYWY(map, y[k]);
+    cells[k] = MAP_VALID(map, mi, mj) ? MAP_INDEX(map, mi, mj) : -1;
+  }
+  return;
+}
+
+
+// Score the end-point of each beam by its distance to the nearest
+// occupied cell.  Max-range readings have no end-point and are skipped.
+// The samples are taken LASER_MODEL_CHUNK at a time, with the beams in
+// the outer loop, so that the end-point transform runs across samples.
+static double laser_model_likelihood_field(laser_model_t *self, int range_count,
+                                           double range_max, double (*ranges)[2],
+                                           int step, pf_sample_set_t *set)
+{
+  int i, j, k, m, n;
+  double lc, ls, d;
+  double total_weight;
+  double *bx, *by;
+  double px[LASER_MODEL_CHUNK], py[LASER_MODEL_CHUNK];
+  double ca[LASER_MODEL_CHUNK], sa[LASER_MODEL_CHUNK];
+  double ex[LASER_MODEL_CHUNK], ey[LASER_MODEL_CHUNK];
+  double p[LASER_MODEL_CHUNK];
+  int cells[LASER_MODEL_CHUNK];
+  map_t *map;
+
+  map = self->map;
+
+  // End-points in the laser frame
+  bx = malloc(((range_count + step - 1) / step) * sizeof(double));
+  by = malloc(((range_count + step - 1) / step) * sizeof(double));
+  if (bx == NULL || by == NULL)
+  {
+    // Out of memory; leave the weights alone, as with no ranges
+    free(bx);
+    free(by);
+    total_weight = 0.0;
+    for (j = 0; j < set->sample_count; j++)
+      total_weight += set->weight[j];
+    return total_weight;
+  }
+  n = 0;
+  for (i = 0; i < range_count; i += step)
+  {
+    if (ranges[i][0] >= range_max)
+      continue;
+    bx[n] = ranges[i][0] * cos(ranges[i][1]);
+    by[n] = ranges[i][0] * sin(ranges[i][1]);
+    n++;
+  }
+
+  total_weight = 0.0;
+
+  for (j = 0; j < set->sample_count; j += LASER_MODEL_CHUNK)
+  {
+    m = set->sample_count - j;
+    if (m > LASER_MODEL_CHUNK)
+      m = LASER_MODEL_CHUNK;
+
+    // Take account of the laser pose relative to the robot
+    for (k = 0; k < m; k++)
+    {
+      lc = cos(set->theta[j + k]);
+      ls = sin(set->theta[j + k]);
+      px[k] = set->x[j + k] + self->laser_pose.v[0] * lc - self->laser_pose.v[1] * ls;
+      py[k] = set->y[j + k] + self->laser_pose.v[0] * ls + self->laser_pose.v[1] * lc;
+      ca[k] = cos(set->theta[j + k] + self->laser_pose.v[2]);
+      sa[k] = sin(set->theta[j + k] + self->laser_pose.v[2]);
+      p[k] = 1.0;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      k = 0;
+#if defined (__SSE2__)
+      {
+        __m128d vbx, vby, c, s;
+
+        vbx = _mm_set1_pd(bx[i]);
+        vby = _mm_set1_pd(by[i]);
+        for (; k + 2 <= m; k += 2)
+        {
+          c = _mm_loadu_pd(ca + k);
+          s = _mm_loadu_pd(sa + k);
+          _mm_storeu_pd(ex + k, _mm_add_pd(_mm_loadu_pd(px + k),
+                                           _mm_sub_pd(_mm_mul_pd(c, vbx),
+                                                      _mm_mul_pd(s, vby))));
+          _mm_storeu_pd(ey + k, _mm_add_pd(_mm_loadu_pd(py + k),
+                                           _mm_add_pd(_mm_mul_pd(s, vbx),
+                                                      _mm_mul_pd(c, vby))));
+        }
+      }
+#endif
+      for (; k < m; k++)
+      {
+        ex[k] = px[k] + ca[k] * bx[i] - sa[k] * by[i];
+        ey[k] = py[k] + sa[k] * bx[i] + ca[k] * by[i];
+      }
+
+      laser_model_cells(map, m, ex, ey, cells);
+
+      for (k = 0; k < m; k++)
+      {
+        if (cells[k] >= 0)
+          d = map->cells[cells[k]].occ_dist;
+        else
+          d = map->max_occ_dist;
+        p[k] *= laser_model_prob(self, d);
+      }
+    }
+
+    for (k = 0; k < m; k++)
+    {
+      set->weight[j + k] *= p[k];
+      total_weight += set->weight[j + k];
+    }
+  }
+
+  free(bx);
+  free(by);
+
+  return total_weight;
+}
+
+
+// Weight the sample set with the given scan
+double laser_model_update(laser_model_t *self, int range_count, double range_max,
+                          double (*ranges)[2], pf_sample_set_t *set)
+{
+  int i, step;
+  double total_weight;
+
+  // Nothing to compare; leave the weights alone
+  if (self->max_beams < 2 || range_count < 1)
+  {
+    total_weight = 0.0;
+    for (i = 0; i < set->sample_count; i++)
+      total_weight += set->weight[i];
+    return total_weight;
+  }
+
+  step = (range_count - 1) / (self->max_beams - 1);
+  if (step < 1)
+    step = 1;
+
+  if (self->type == LASER_MODEL_LIKELIHOOD_FIELD)
+    return laser_model_likelihood_field(self, range_count, range_max, ranges, step, set);
+  else
+    return laser_model_beam(self, range_count, range_max, ranges, step, set);
+}
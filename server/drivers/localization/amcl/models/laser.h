@@ -74,6 +74,50 @@ typedef struct
 } laser_t;
 
 
+// Sensor models for weighting a sample set
+typedef enum
+{
+  // Compare observed ranges with ranges cast through the map
+  LASER_MODEL_BEAM,
+
+  // Score beam end-points by their distance to the nearest obstacle
+  LASER_MODEL_LIKELIHOOD_FIELD
+
+} laser_model_type_t;
+
+
+// Sample set model information
+typedef struct
+{
+  laser_model_type_t type;
+
+  // Pointer to the map; the likelihood field model requires the cspace
+  // distances to be up to date (see map_update_cspace())
+  map_t *map;
+
+  // Optional pre-computed ranges for the beam model
+  map_range_table_t *range_table;
+
+  // Laser pose relative to robot
+  pf_vector_t laser_pose;
+
+  // Max beams to consider
+  int max_beams;
+
+  // Standard deviation of the range (or end-point distance) error
+  double range_var;
+
+  // Probability of spurious range readings
+  double range_bad;
+
+  // Pre-computed probabilities, indexed by the absolute range error
+  int lut_size;
+  double lut_res;
+  double *lut_probs;
+
+} laser_model_t;
+
+
 // Create an sensor model
 laser_t *laser_alloc(map_t *map);
 
@@ -89,6 +133,18 @@ void laser_add_range(laser_t *sensor, double range, double bearing);
 // The sensor model function
 double laser_sensor_model(laser_t *sensor, pf_vector_t pose);
 
+// Create a sample set model
+laser_model_t *laser_model_alloc(map_t *map, laser_model_type_t type,
+                                 int max_beams, double range_var, double range_bad);
+
+// Free a sample set model
+void laser_model_free(laser_model_t *model);
+
+// Weight the sample set with the given scan of (range, bearing) tuples.
+// Returns the total weight of the set.
+double laser_model_update(laser_model_t *model, int range_count, double range_max,
+                          double (*ranges)[2], pf_sample_set_t *set);
+
 
 #ifdef __cplusplus
 }
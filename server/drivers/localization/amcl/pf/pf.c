@@ -31,12 +31,40 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#if defined (__SSE2__)
+  #include <emmintrin.h>
+#endif
+#if defined (WIN32)
+  #include <malloc.h>
+#endif
 
 #include <libplayercommon/playercommon.h>
 
 #include "pf.h"
 #include "pf_pdf.h"
 #include "pf_kdtree.h"
+#include "pf_pool.h"
+
+// Number of samples in each slice of the sample set.  Slices are the unit
+// of work for the threads, and each has its own random number generator,
+// so this must not depend on the thread count.  Slices of a set keep the
+// alignment of its arrays.
+#define PF_BLOCK_SIZE 128
+
+// Samples moved at a time by pf_sample_set_move()
+#define PF_MOVE_CHUNK 64
+
+// A sample set update, run one slice at a time
+typedef struct
+{
+  pf_t *pf;
+  pf_sample_set_t *set;
+  uint64_t update;
+  pf_action_model_fn_t action_fn;
+  pf_sensor_model_fn_t sensor_fn;
+  void *data;
+
+} pf_job_t;
 
 
 // Compute the required number of samples, given that there are k bins
@@ -46,6 +74,35 @@ static int pf_resample_limit(pf_t *pf, int k);
 // Re-compute the cluster statistics for a sample set
 static void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set);
 
+// Look up the cluster labels of one slice of samples
+static void pf_cluster_block(pf_job_t *job, int block);
+
+
+// Allocate an aligned array of doubles
+static double *pf_alloc_array(int count)
+{
+  void *mem;
+#if defined (WIN32)
+  mem = _aligned_malloc(count * sizeof(double), PF_SAMPLE_ALIGN);
+#else
+  if (posix_memalign(&mem, PF_SAMPLE_ALIGN, count * sizeof(double)) != 0)
+    mem = NULL;
+#endif
+  assert(mem);
+  return (double*) mem;
+}
+
+
+// Free an aligned array
+static void pf_free_array(double *array)
+{
+#if defined (WIN32)
+  _aligned_free(array);
+#else
+  free(array);
+#endif
+}
+
 
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples)
@@ -53,7 +110,6 @@ pf_t *pf_alloc(int min_samples, int max_samples)
   int i, j;
   pf_t *pf;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   
   pf = calloc(1, sizeof(pf_t));
 
@@ -74,15 +130,17 @@ pf_t *pf_alloc(int min_samples, int max_samples)
     set = pf->sets + j;
       
     set->sample_count = max_samples;
-    set->samples = calloc(max_samples, sizeof(pf_sample_t));
+    set->x = pf_alloc_array(max_samples);
+    set->y = pf_alloc_array(max_samples);
+    set->theta = pf_alloc_array(max_samples);
+    set->weight = pf_alloc_array(max_samples);
 
     for (i = 0; i < set->sample_count; i++)
     {
-      sample = set->samples + i;
-      sample->pose.v[0] = 0.0;
-      sample->pose.v[1] = 0.0;
-      sample->pose.v[2] = 0.0;
-      sample->weight = 1.0 / max_samples;
+      set->x[i] = 0.0;
+      set->y[i] = 0.0;
+      set->theta[i] = 0.0;
+      set->weight[i] = 1.0 / max_samples;
     }
 
     // HACK: is 3 times max_samples enough?
@@ -93,6 +151,13 @@ pf_t *pf_alloc(int min_samples, int max_samples)
     set->clusters = calloc(set->cluster_max_count, sizeof(pf_cluster_t));
   }
 
+  pf->thread_count = 1;
+  pf->pool = NULL;
+  pf_set_seed(pf, 0);
+
+  pf->cluster_labels = calloc(max_samples, sizeof(int));
+  pf->cluster_trig = calloc(2 * max_samples, sizeof(double));
+
   return pf;
 }
 
@@ -102,25 +167,281 @@ void pf_free(pf_t *pf)
 {
   int i;
   
+  pf_pool_free(pf->pool);
   for (i = 0; i < 2; i++)
   {
     free(pf->sets[i].clusters);
     pf_kdtree_free(pf->sets[i].kdtree);
-    free(pf->sets[i].samples);
+    pf_free_array(pf->sets[i].x);
+    pf_free_array(pf->sets[i].y);
+    pf_free_array(pf->sets[i].theta);
+    pf_free_array(pf->sets[i].weight);
   }
+  free(pf->cluster_labels);
+  free(pf->cluster_trig);
   free(pf);
   
   return;
 }
 
 
+// Set the number of threads used to update the sample set
+int pf_set_threads(pf_t *pf, int thread_count)
+{
+  pf_pool_free(pf->pool);
+  pf->pool = NULL;
+  pf->thread_count = 1;
+
+  if (thread_count > 1)
+  {
+    if ((pf->pool = pf_pool_alloc(thread_count)) != NULL)
+      pf->thread_count = thread_count;
+    else
+      PLAYER_WARN1("unable to start %d particle filter threads", thread_count);
+  }
+  return pf->thread_count;
+}
+
+
+// Seed the random number generators
+void pf_set_seed(pf_t *pf, uint64_t seed)
+{
+  pf->seed = seed;
+  pf->update_count = 0;
+  pf_rng_seed(&pf->rng, seed);
+  return;
+}
+
+
+// Get a slice of the sample set
+static void pf_block(pf_sample_set_t *set, int block, pf_sample_set_t *slice)
+{
+  *slice = *set;
+  slice->x = set->x + block * PF_BLOCK_SIZE;
+  slice->y = set->y + block * PF_BLOCK_SIZE;
+  slice->theta = set->theta + block * PF_BLOCK_SIZE;
+  slice->weight = set->weight + block * PF_BLOCK_SIZE;
+  slice->sample_count = set->sample_count - block * PF_BLOCK_SIZE;
+  if (slice->sample_count > PF_BLOCK_SIZE)
+    slice->sample_count = PF_BLOCK_SIZE;
+  return;
+}
+
+
+// Number of slices in the sample set
+static int pf_block_count(pf_sample_set_t *set)
+{
+  return (set->sample_count + PF_BLOCK_SIZE - 1) / PF_BLOCK_SIZE;
+}
+
+
+// Seed the generator for a slice in a given update
+static void pf_block_rng(pf_t *pf, uint64_t update, int block, pf_rng_t *rng)
+{
+  pf_rng_seed(rng, (pf->seed * 1000003ULL + update) * 1000003ULL + block);
+  return;
+}
+
+
+// Apply the action model to one slice
+static void pf_action_block(pf_job_t *job, int block)
+{
+  pf_sample_set_t slice;
+  pf_rng_t rng, *prev;
+
+  pf_block(job->set, block, &slice);
+  pf_block_rng(job->pf, job->update, block, &rng);
+
+  prev = pf_rng_get_current();
+  pf_rng_set_current(&rng);
+  (*job->action_fn) (job->data, &slice);
+  pf_rng_set_current(prev);
+  return;
+}
+
+
+// Apply the sensor model to one slice
+static void pf_sensor_block(pf_job_t *job, int block)
+{
+  pf_sample_set_t slice;
+  pf_rng_t rng, *prev;
+
+  pf_block(job->set, block, &slice);
+  pf_block_rng(job->pf, job->update, block, &rng);
+
+  prev = pf_rng_get_current();
+  pf_rng_set_current(&rng);
+  (*job->sensor_fn) (job->data, &slice);
+  pf_rng_set_current(prev);
+  return;
+}
+
+
+// Sum an array, in order
+static double pf_sum(const double *values, int n)
+{
+  int i;
+  double total;
+
+  total = 0;
+  i = 0;
+#if defined (__SSE2__)
+  {
+    __m128d acc;
+
+    acc = _mm_setzero_pd();
+    for (; i + 2 <= n; i += 2)
+      acc = _mm_add_pd(acc, _mm_loadu_pd(values + i));
+    total = _mm_cvtsd_f64(acc) + _mm_cvtsd_f64(_mm_unpackhi_pd(acc, acc));
+  }
+#endif
+  for (; i < n; i++)
+    total += values[i];
+  return total;
+}
+
+
+// Multiply an array by a constant
+static void pf_scale(double *values, int n, double k)
+{
+  int i;
+
+  i = 0;
+#if defined (__SSE2__)
+  {
+    __m128d kk;
+
+    kk = _mm_set1_pd(k);
+    for (; i + 2 <= n; i += 2)
+      _mm_storeu_pd(values + i, _mm_mul_pd(_mm_loadu_pd(values + i), kk));
+  }
+#endif
+  for (; i < n; i++)
+    values[i] *= k;
+  return;
+}
+
+
+// Get the pose of a sample
+pf_vector_t pf_sample_get_pose(pf_sample_set_t *set, int i)
+{
+  pf_vector_t pose;
+
+  pose.v[0] = set->x[i];
+  pose.v[1] = set->y[i];
+  pose.v[2] = set->theta[i];
+  return pose;
+}
+
+
+// Set the pose of a sample
+void pf_sample_put_pose(pf_sample_set_t *set, int i, pf_vector_t pose)
+{
+  set->x[i] = pose.v[0];
+  set->y[i] = pose.v[1];
+  set->theta[i] = pose.v[2];
+  return;
+}
+
+
+// Move each sample by a motion given in the sample's own frame.  Gives
+// the same results as pf_vector_coord_add(), but normalizes the heading
+// without a call to atan2().
+void pf_sample_set_coord_add(pf_sample_set_t *set, const double *dx,
+                             const double *dy, const double *da)
+{
+  int i, n;
+  double c[PF_MOVE_CHUNK], s[PF_MOVE_CHUNK];
+  double a;
+  double *x, *y, *theta;
+
+  for (n = 0; n < set->sample_count; n += PF_MOVE_CHUNK)
+  {
+    x = set->x + n;
+    y = set->y + n;
+    theta = set->theta + n;
+
+    // The trig functions have no vector form in libm, so do them first
+    // and leave the arithmetic as one tight loop
+    for (i = 0; i < PF_MOVE_CHUNK && n + i < set->sample_count; i++)
+    {
+      c[i] = cos(theta[i]);
+      s[i] = sin(theta[i]);
+    }
+
+    i = 0;
+#if defined (__SSE2__)
+    for (; i + 2 <= PF_MOVE_CHUNK && n + i + 2 <= set->sample_count; i += 2)
+    {
+      __m128d ddx, ddy, cc, ss;
+
+      ddx = _mm_loadu_pd(dx + n + i);
+      ddy = _mm_loadu_pd(dy + n + i);
+      cc = _mm_loadu_pd(c + i);
+      ss = _mm_loadu_pd(s + i);
+      _mm_storeu_pd(x + i, _mm_add_pd(_mm_loadu_pd(x + i),
+                                      _mm_sub_pd(_mm_mul_pd(ddx, cc),
+                                                 _mm_mul_pd(ddy, ss))));
+      _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i),
+                                      _mm_add_pd(_mm_mul_pd(ddx, ss),
+                                                 _mm_mul_pd(ddy, cc))));
+    }
+#endif
+    for (; i < PF_MOVE_CHUNK && n + i < set->sample_count; i++)
+    {
+      x[i] += dx[n + i] * c[i] - dy[n + i] * s[i];
+      y[i] += dx[n + i] * s[i] + dy[n + i] * c[i];
+    }
+
+    for (i = 0; i < PF_MOVE_CHUNK && n + i < set->sample_count; i++)
+    {
+      a = theta[i] + da[n + i];
+      if (a > M_PI || a <= -M_PI)
+      {
+        a = fmod(a + M_PI, 2 * M_PI);
+        a = (a <= 0 ? a + M_PI : a - M_PI);
+      }
+      theta[i] = a;
+    }
+  }
+  return;
+}
+
+
+// Move each sample by a motion drawn from the pdf, in the sample's own
+// frame
+void pf_sample_set_move(pf_sample_set_t *set, pf_pdf_gaussian_t *pdf)
+{
+  int n, m;
+  pf_sample_set_t chunk;
+  double dx[PF_MOVE_CHUNK], dy[PF_MOVE_CHUNK], da[PF_MOVE_CHUNK];
+
+  for (n = 0; n < set->sample_count; n += PF_MOVE_CHUNK)
+  {
+    m = set->sample_count - n;
+    if (m > PF_MOVE_CHUNK)
+      m = PF_MOVE_CHUNK;
+    pf_pdf_gaussian_sample_n(pdf, m, dx, dy, da);
+
+    chunk = *set;
+    chunk.sample_count = m;
+    chunk.x = set->x + n;
+    chunk.y = set->y + n;
+    chunk.theta = set->theta + n;
+    chunk.weight = set->weight + n;
+    pf_sample_set_coord_add(&chunk, dx, dy, da);
+  }
+  return;
+}
+
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   pf_pdf_gaussian_t *pdf;
+  pf_rng_t *prev;
   
   set = pf->sets + pf->current_set;
   
@@ -130,18 +451,20 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   set->sample_count = pf->max_samples;
 
   pdf = pf_pdf_gaussian_alloc(mean, cov);
+  prev = pf_rng_get_current();
+  pf_rng_set_current(&pf->rng);
     
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = pf_pdf_gaussian_sample(pdf);
+    set->weight[i] = 1.0 / pf->max_samples;
+    pf_sample_put_pose(set, i, pf_pdf_gaussian_sample(pdf));
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_kdtree_insert(set->kdtree, pf_sample_get_pose(set, i), set->weight[i]);
   }
 
+  pf_rng_set_current(prev);
   pf_pdf_gaussian_free(pdf);
     
   // Re-compute cluster statistics
@@ -156,7 +479,7 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
+  pf_rng_t *prev;
 
   set = pf->sets + pf->current_set;
 
@@ -165,17 +488,21 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 
   set->sample_count = pf->max_samples;
 
+  prev = pf_rng_get_current();
+  pf_rng_set_current(&pf->rng);
+
   // Compute the new sample poses
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-    sample->weight = 1.0 / pf->max_samples;
-    sample->pose = (*init_fn) (init_data);
+    set->weight[i] = 1.0 / pf->max_samples;
+    pf_sample_put_pose(set, i, (*init_fn) (init_data));
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_kdtree_insert(set->kdtree, pf_sample_get_pose(set, i), set->weight[i]);
   }
 
+  pf_rng_set_current(prev);
+
   // Re-compute cluster statistics
   pf_cluster_stats(pf, set);
   
@@ -187,10 +514,17 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_data)
 {
   pf_sample_set_t *set;
+  pf_job_t job;
 
   set = pf->sets + pf->current_set;
 
-  (*action_fn) (action_data, set);
+  job.pf = pf;
+  job.set = set;
+  job.update = pf->update_count++;
+  job.action_fn = action_fn;
+  job.sensor_fn = NULL;
+  job.data = action_data;
+  pf_pool_run(pf->pool, (pf_pool_fn_t) pf_action_block, &job, pf_block_count(set));
   
   return;
 }
@@ -201,22 +535,27 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 {
   int i;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   double total;
+  pf_job_t job;
 
   set = pf->sets + pf->current_set;
 
   // Compute the sample weights
-  total = (*sensor_fn) (sensor_data, set);
+  job.pf = pf;
+  job.set = set;
+  job.update = pf->update_count++;
+  job.action_fn = NULL;
+  job.sensor_fn = sensor_fn;
+  job.data = sensor_data;
+  pf_pool_run(pf->pool, (pf_pool_fn_t) pf_sensor_block, &job, pf_block_count(set));
+
+  // Sum in sample order, so that the total does not depend on the threads
+  total = pf_sum(set->weight, set->sample_count);
   
   if (total > 0.0)
   {
     // Normalize weights
-    for (i = 0; i < set->sample_count; i++)
-    {
-      sample = set->samples + i;
-      sample->weight /= total;
-    }
+    pf_scale(set->weight, set->sample_count, 1.0 / total);
   }
   else
   {
@@ -224,10 +563,7 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 
     // Handle zero total
     for (i = 0; i < set->sample_count; i++)
-    {
-      sample = set->samples + i;
-      sample->weight = 1.0 / set->sample_count;
-    }
+      set->weight[i] = 1.0 / set->sample_count;
   }
   
   return;
@@ -237,11 +573,10 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 // Resample the distribution
 void pf_update_resample(pf_t *pf)
 {
-  int i;
+  int i, j;
   double total;
   //double *randlist;
   pf_sample_set_t *set_a, *set_b;
-  pf_sample_t *sample_a, *sample_b;
   //pf_pdf_discrete_t *pdf;
 
   double r,c,U;
@@ -257,8 +592,8 @@ void pf_update_resample(pf_t *pf)
   randlist = calloc(set_a->sample_count, sizeof(double));
   for (i = 0; i < set_a->sample_count; i++)
   {
-    total += set_a->samples[i].weight;
-    randlist[i] = set_a->samples[i].weight;
+    total += set_a->weight[i];
+    randlist[i] = set_a->weight[i];
   }
   */
 
@@ -276,13 +611,8 @@ void pf_update_resample(pf_t *pf)
 
   // Low-variance resampler, taken from Probabilistic Robotics, p110
   count_inv = 1.0/set_a->sample_count;
-#if defined (WIN32)
-  // TODO: this isn't quite the same behaviour: drand48 returns uniformly-distributed values
-  r = ((double) rand() / (double) RAND_MAX) * count_inv;
-#else
-  r = drand48() * count_inv;
-#endif
-  c = set_a->samples[0].weight;
+  r = pf_rng_uniform(&pf->rng) * count_inv;
+  c = set_a->weight[0];
   i = 0;
   m = 0;
   while(set_b->sample_count < pf->max_samples)
@@ -295,36 +625,31 @@ void pf_update_resample(pf_t *pf)
       // number
       if(i >= set_a->sample_count)
       {
-#if defined (WIN32)
-        // TODO: this isn't quite the same behaviour: drand48 returns uniformly-distributed values
-        r = ((double) rand() / (double) RAND_MAX) * count_inv;
-#else
-        r = drand48() * count_inv;
-#endif
-        c = set_a->samples[0].weight;
+        r = pf_rng_uniform(&pf->rng) * count_inv;
+        c = set_a->weight[0];
         i = 0;
         m = 0;
         U = r + m * count_inv;
         continue;
       }
-      c += set_a->samples[i].weight;
+      c += set_a->weight[i];
     }
 
     //i = pf_pdf_discrete_sample(pdf);    
 
-    sample_a = set_a->samples + i;
-
-    //printf("%d %f\n", i, sample_a->weight);
-    assert(sample_a->weight > 0);
+    //printf("%d %f\n", i, set_a->weight[i]);
+    assert(set_a->weight[i] > 0);
 
     // Add sample to list
-    sample_b = set_b->samples + set_b->sample_count++;
-    sample_b->pose = sample_a->pose;
-    sample_b->weight = 1.0;
-    total += sample_b->weight;
+    j = set_b->sample_count++;
+    set_b->x[j] = set_a->x[i];
+    set_b->y[j] = set_a->y[i];
+    set_b->theta[j] = set_a->theta[i];
+    set_b->weight[j] = 1.0;
+    total += set_b->weight[j];
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    pf_kdtree_insert(set_b->kdtree, pf_sample_get_pose(set_b, j), set_b->weight[j]);
 
     //fprintf(stderr, "resample %d %d %d\n", set_b->sample_count, set_b->kdtree->leaf_count,
             //pf_resample_limit(pf, set_b->kdtree->leaf_count));
@@ -343,10 +668,7 @@ void pf_update_resample(pf_t *pf)
 
   // Normalize weights
   for (i = 0; i < set_b->sample_count; i++)
-  {
-    sample_b = set_b->samples + i;
-    sample_b->weight /= total;
-  }
+    set_b->weight[i] /= total;
 
   // Re-compute cluster statistics
   pf_cluster_stats(pf, set_b);
@@ -388,8 +710,9 @@ int pf_resample_limit(pf_t *pf, int k)
 void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
 {
   int i, j, k, c;
-  pf_sample_t *sample;
+  double w, v[2];
   pf_cluster_t *cluster;
+  pf_job_t job;
 
   // Cluster the samples
   pf_kdtree_cluster(set->kdtree);
@@ -412,15 +735,19 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
         cluster->c[j][k] = 0.0;
   }
   
-  // Compute cluster stats
+  // Look up the cluster labels, in parallel
+  job.pf = pf;
+  job.set = set;
+  pf_pool_run(pf->pool, (pf_pool_fn_t) pf_cluster_block, &job, pf_block_count(set));
+
+  // Compute cluster stats; the sums are taken in sample order, so that
+  // they do not depend on the threads
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-
-    //printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
+    //printf("%d %f %f %f\n", i, set->x[i], set->y[i], set->theta[i]);
 
     // Get the cluster label for this sample
-    c = pf_kdtree_get_cluster(set->kdtree, sample->pose);
+    c = pf->cluster_labels[i];
     assert(c >= 0);
     if (c >= set->cluster_max_count)
       continue;
@@ -429,19 +756,23 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
     
     cluster = set->clusters + c;
 
+    w = set->weight[i];
+    v[0] = set->x[i];
+    v[1] = set->y[i];
+
     cluster->count += 1;
-    cluster->weight += sample->weight;
+    cluster->weight += w;
 
     // Compute mean
-    cluster->m[0] += sample->weight * sample->pose.v[0];
-    cluster->m[1] += sample->weight * sample->pose.v[1];
-    cluster->m[2] += sample->weight * cos(sample->pose.v[2]);
-    cluster->m[3] += sample->weight * sin(sample->pose.v[2]);
+    cluster->m[0] += w * v[0];
+    cluster->m[1] += w * v[1];
+    cluster->m[2] += w * pf->cluster_trig[2 * i + 0];
+    cluster->m[3] += w * pf->cluster_trig[2 * i + 1];
 
     // Compute covariance in linear components
     for (j = 0; j < 2; j++)
       for (k = 0; k < 2; k++)
-        cluster->c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
+        cluster->c[j][k] += w * v[j] * v[k];
   }
 
   // Normalize
@@ -475,13 +806,36 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
 }
 
 
+// Look up the cluster labels of one slice of samples; the kdtree is only
+// read here.  The heading's sine and cosine are computed at the same time.
+static void pf_cluster_block(pf_job_t *job, int block)
+{
+  int i, n;
+  pf_sample_set_t *set;
+
+  set = job->set;
+  i = block * PF_BLOCK_SIZE;
+  n = i + PF_BLOCK_SIZE;
+  if (n > set->sample_count)
+    n = set->sample_count;
+
+  for (; i < n; i++)
+  {
+    job->pf->cluster_labels[i] = pf_kdtree_get_cluster(set->kdtree,
+                                                       pf_sample_get_pose(set, i));
+    job->pf->cluster_trig[2 * i + 0] = cos(set->theta[i]);
+    job->pf->cluster_trig[2 * i + 1] = sin(set->theta[i]);
+  }
+  return;
+}
+
+
 // Compute the CEP statistics (mean and variance).
 void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
 {
   int i;
   double mn, mx, my, mrr;
   pf_sample_set_t *set;
-  pf_sample_t *sample;
   
   set = pf->sets + pf->current_set;
 
@@ -492,13 +846,11 @@ void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
   
   for (i = 0; i < set->sample_count; i++)
   {
-    sample = set->samples + i;
-
-    mn += sample->weight;
-    mx += sample->weight * sample->pose.v[0];
-    my += sample->weight * sample->pose.v[1];
-    mrr += sample->weight * sample->pose.v[0] * sample->pose.v[0];
-    mrr += sample->weight * sample->pose.v[1] * sample->pose.v[1];
+    mn += set->weight[i];
+    mx += set->weight[i] * set->x[i];
+    my += set->weight[i] * set->y[i];
+    mrr += set->weight[i] * set->x[i] * set->x[i];
+    mrr += set->weight[i] * set->y[i] * set->y[i];
   }
 
   mean->v[0] = mx / mn;
@@ -33,6 +33,7 @@
 
 #include "pf_vector.h"
 #include "pf_kdtree.h"
+#include "pf_pdf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +41,7 @@ extern "C" {
 
 // Forward declarations
 struct _pf_t;
+struct _pf_pool_t;
 struct _rtk_fig_t;
 struct _pf_sample_set_t;
 
@@ -48,7 +50,10 @@ struct _pf_sample_set_t;
 typedef pf_vector_t (*pf_init_model_fn_t) (void *init_data);
 
 // Function prototype for the action model; generates a sample pose from
-// an appropriate distribution
+// an appropriate distribution.  The action and sensor models are applied
+// to consecutive slices of the sample set, possibly from several threads
+// at once; random numbers must be drawn with pf_ran_gaussian() or
+// pf_ran_uniform(), which use a generator private to each slice.
 typedef void (*pf_action_model_fn_t) (void *action_data, 
                                       struct _pf_sample_set_t* set);
 
@@ -58,18 +63,6 @@ typedef double (*pf_sensor_model_fn_t) (void *sensor_data,
                                         struct _pf_sample_set_t* set);
 
 
-// Information for a single sample
-typedef struct
-{
-  // Pose represented by this sample
-  pf_vector_t pose;
-
-  // Weight for this pose
-  double weight;
-  
-} pf_sample_t;
-
-
 // Information for a cluster of samples
 typedef struct
 {
@@ -89,12 +82,18 @@ typedef struct
 } pf_cluster_t;
 
 
-// Information for a set of samples
+// Alignment of the sample arrays, in bytes
+#define PF_SAMPLE_ALIGN 32
+
+// Information for a set of samples.  The samples are stored as one array
+// per component, each aligned to PF_SAMPLE_ALIGN bytes, so that the
+// models can work on several samples at a time.
 typedef struct _pf_sample_set_t
 {
-  // The samples
+  // The samples: pose (x[i], y[i], theta[i]) and weight[i] of sample i
   int sample_count;
-  pf_sample_t *samples;
+  double *x, *y, *theta;
+  double *weight;
 
   // A kdtree encoding the histogram
   pf_kdtree_t *kdtree;
@@ -120,6 +119,20 @@ typedef struct _pf_t
   int current_set;
   pf_sample_set_t sets[2];
 
+  // Threads used to update the sample set
+  int thread_count;
+  struct _pf_pool_t *pool;
+
+  // The filter's own random number generator, and the seed and update
+  // count from which the generators for each slice are derived
+  uint64_t seed;
+  uint64_t update_count;
+  pf_rng_t rng;
+
+  // Workspace for the cluster statistics
+  int *cluster_labels;
+  double *cluster_trig;
+
 } pf_t;
 
 
@@ -129,6 +142,14 @@ pf_t *pf_alloc(int min_samples, int max_samples);
 // Free an existing filter
 void pf_free(pf_t *pf);
 
+// Set the number of threads used to update the sample set.  Returns the
+// number of threads actually in use.
+int pf_set_threads(pf_t *pf, int thread_count);
+
+// Seed the filter's random number generators.  For a given seed, the
+// filter produces the same results whatever the number of threads.
+void pf_set_seed(pf_t *pf, uint64_t seed);
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov);
 
@@ -144,6 +165,21 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 // Resample the distribution
 void pf_update_resample(pf_t *pf);
 
+// Get the pose of a sample
+pf_vector_t pf_sample_get_pose(pf_sample_set_t *set, int i);
+
+// Set the pose of a sample
+void pf_sample_put_pose(pf_sample_set_t *set, int i, pf_vector_t pose);
+
+// Move each sample by a motion given in the sample's own frame; i.e.
+// pose[i] = pf_vector_coord_add((dx[i], dy[i], da[i]), pose[i]).
+void pf_sample_set_coord_add(pf_sample_set_t *set, const double *dx,
+                             const double *dy, const double *da);
+
+// Move each sample by a motion drawn from the pdf, in the sample's own
+// frame
+void pf_sample_set_move(pf_sample_set_t *set, pf_pdf_gaussian_t *pdf);
+
 // Compute the CEP statistics (mean and variance).
 void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var);
 
@@ -32,6 +32,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 //#include <gsl/gsl_rng.h>
 //#include <gsl/gsl_randist.h>
 
@@ -40,6 +41,91 @@
 // Random number generator seed value
 static unsigned int pf_pdf_seed;
 
+// Samples generated at a time by pf_pdf_gaussian_sample_n()
+#define PF_PDF_CHUNK 64
+
+// Per-thread generator, see pf_rng_set_current()
+static pthread_key_t pf_rng_key;
+static pthread_once_t pf_rng_key_once = PTHREAD_ONCE_INIT;
+
+
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+static void pf_rng_key_alloc(void)
+{
+  pthread_key_create(&pf_rng_key, NULL);
+}
+
+
+// Seed a generator.  The seed is scrambled (splitmix64), so that nearby
+// seeds give unrelated sequences.
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed)
+{
+  uint64_t z;
+
+  z = seed + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  rng->state = z ? z : 1;
+  return;
+}
+
+
+// Draw a uniformly distributed value in [0, 1) (xorshift64*)
+double pf_rng_uniform(pf_rng_t *rng)
+{
+  uint64_t x;
+
+  x = rng->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  rng->state = x;
+  return ((x * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Set the generator used by the calling thread
+void pf_rng_set_current(pf_rng_t *rng)
+{
+  pthread_once(&pf_rng_key_once, pf_rng_key_alloc);
+  pthread_setspecific(pf_rng_key, rng);
+  return;
+}
+
+
+// Get the generator used by the calling thread
+pf_rng_t *pf_rng_get_current(void)
+{
+  pthread_once(&pf_rng_key_once, pf_rng_key_alloc);
+  return (pf_rng_t*) pthread_getspecific(pf_rng_key);
+}
+
+
+// Draw a uniformly distributed value in [0, 1) from the given generator,
+// or from the global state
+static double pf_ran_uniform_from(pf_rng_t *rng)
+{
+  if (rng != NULL)
+    return pf_rng_uniform(rng);
+#if defined (WIN32)
+  // TODO: this isn't quite the same behaviour: drand48 returns uniformly-distributed values
+  return (double) rand() / (double) RAND_MAX;
+#else
+  return drand48();
+#endif
+}
+
+
+// Draw a uniformly distributed value in [0, 1)
+double pf_ran_uniform(void)
+{
+  return pf_ran_uniform_from(pf_rng_get_current());
+}
+
 
 /**************************************************************************
  * Gaussian
@@ -133,6 +219,36 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
   return x;
 }
 
+// Generate [n] samples from the pdf
+void pf_pdf_gaussian_sample_n(pf_pdf_gaussian_t *pdf, int n,
+                              double *x, double *y, double *a)
+{
+  int i, k, m;
+  double r[3][PF_PDF_CHUNK];
+  const pf_matrix_t *cr;
+
+  cr = &pdf->cr;
+
+  for (k = 0; k < n; k += PF_PDF_CHUNK)
+  {
+    m = n - k < PF_PDF_CHUNK ? n - k : PF_PDF_CHUNK;
+
+    // Generate the random vectors
+    pf_ran_gaussian_n(pdf->cd.v[0], m, r[0]);
+    pf_ran_gaussian_n(pdf->cd.v[1], m, r[1]);
+    pf_ran_gaussian_n(pdf->cd.v[2], m, r[2]);
+
+    for (i = 0; i < m; i++)
+    {
+      x[k + i] = pdf->x.v[0] + cr->m[0][0] * r[0][i] + cr->m[0][1] * r[1][i] + cr->m[0][2] * r[2][i];
+      y[k + i] = pdf->x.v[1] + cr->m[1][0] * r[0][i] + cr->m[1][1] * r[1][i] + cr->m[1][2] * r[2][i];
+      a[k + i] = pdf->x.v[2] + cr->m[2][0] * r[0][i] + cr->m[2][1] * r[1][i] + cr->m[2][2] * r[2][i];
+    }
+  }
+  return;
+}
+
+
 // Draw randomly from a zero-mean Gaussian distribution, with standard
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
@@ -143,19 +259,9 @@ double pf_ran_gaussian(double sigma)
 
   do
   {
-#if defined (WIN32)
-    // TODO: this isn't quite the same behaviour: drand48 returns uniformly-distributed values
-    do { r = (double) rand() / (double) RAND_MAX; } while (r==0.0);
-#else
-    do { r = drand48(); } while (r==0.0);
-#endif
+    do { r = pf_ran_uniform(); } while (r==0.0);
     x1 = 2.0 * r - 1.0;
-#if defined (WIN32)
-    // TODO: this isn't quite the same behaviour: drand48 returns uniformly-distributed values
-    do { r = (double) rand() / (double) RAND_MAX; } while (r==0.0);
-#else
-    do { r = drand48(); } while (r==0.0);
-#endif
+    do { r = pf_ran_uniform(); } while (r==0.0);
     x2 = 2.0 * r - 1.0;
     w = x1*x1 + x2*x2;
   } while(w > 1.0 || w==0.0);
@@ -163,6 +269,35 @@ double pf_ran_gaussian(double sigma)
   return(sigma * x2 * sqrt(-2.0*log(w)/w));
 }
 
+
+// Draw [n] values from a zero-mean Gaussian distribution
+void pf_ran_gaussian_n(double sigma, int n, double *values)
+{
+  int i;
+  double x1, x2, w, r, f;
+  pf_rng_t *rng;
+
+  rng = pf_rng_get_current();
+
+  for (i = 0; i < n; i += 2)
+  {
+    do
+    {
+      do { r = pf_ran_uniform_from(rng); } while (r==0.0);
+      x1 = 2.0 * r - 1.0;
+      do { r = pf_ran_uniform_from(rng); } while (r==0.0);
+      x2 = 2.0 * r - 1.0;
+      w = x1*x1 + x2*x2;
+    } while(w > 1.0 || w==0.0);
+
+    f = sigma * sqrt(-2.0*log(w)/w);
+    values[i] = f * x2;
+    if (i + 1 < n)
+      values[i + 1] = f * x1;
+  }
+  return;
+}
+
 #if 0
 
 /**************************************************************************
@@ -31,6 +31,10 @@
 #ifndef PF_PDF_H
 #define PF_PDF_H
 
+#if !defined (WIN32)
+  #include <stdint.h>
+#endif
+
 #include "pf_vector.h"
 
 //#include <gsl/gsl_rng.h>
@@ -40,6 +44,38 @@
 extern "C" {
 #endif
 
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+// Random number generator state.  Each thread working on a sample set
+// draws from its own generator, so that results do not depend on the
+// order in which threads run.
+typedef struct
+{
+  uint64_t state;
+
+} pf_rng_t;
+
+
+// Seed a generator
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed);
+
+// Draw a uniformly distributed value in [0, 1)
+double pf_rng_uniform(pf_rng_t *rng);
+
+// Set the generator used by the calling thread for pf_ran_gaussian() and
+// pf_pdf_gaussian_sample(); with NULL the global drand48() state is used.
+void pf_rng_set_current(pf_rng_t *rng);
+
+// Get the generator used by the calling thread, if any
+pf_rng_t *pf_rng_get_current(void);
+
+// Draw a uniformly distributed value in [0, 1) from the calling thread's
+// generator
+double pf_ran_uniform(void);
+
+
 /**************************************************************************
  * Gaussian
  *************************************************************************/
@@ -78,9 +114,17 @@ void pf_pdf_gaussian_free(pf_pdf_gaussian_t *pdf);
 //   http://www.taygeta.com/random/gaussian.html
 double pf_ran_gaussian(double sigma);
 
+// Draw [n] values from a zero-mean Gaussian distribution.  Both values
+// produced by each round of the Box-Muller transformation are used.
+void pf_ran_gaussian_n(double sigma, int n, double *values);
+
 // Generate a sample from the the pdf.
 pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf);
 
+// Generate [n] samples from the pdf, as separate component arrays
+void pf_pdf_gaussian_sample_n(pf_pdf_gaussian_t *pdf, int n,
+                              double *x, double *y, double *a);
+
 
 #if 0
 
@@ -0,0 +1,206 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey    
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+
+/**************************************************************************
+ * Desc: Worker pool for sample set updates.
+ * CVS: $Id$
+ *************************************************************************/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "pf_pool.h"
+
+
+// Worker thread information
+typedef struct
+{
+  pf_pool_t *pool;
+  int index;
+  pthread_t thread;
+
+} pf_pool_worker_t;
+
+
+struct _pf_pool_t
+{
+  int thread_count;
+  pf_pool_worker_t *workers;
+
+  pthread_mutex_t lock;
+  pthread_cond_t start_cond, done_cond;
+
+  // Current job; a new job is signalled by bumping the generation
+  unsigned long generation;
+  pf_pool_fn_t fn;
+  void *arg;
+  int block_count;
+
+  // Workers still running the current job
+  int pending;
+
+  int quit;
+};
+
+
+// Run this thread's share of the blocks
+static void pf_pool_work(pf_pool_t *pool, int index, pf_pool_fn_t fn,
+                         void *arg, int block_count)
+{
+  int block;
+
+  for (block = index; block < block_count; block += pool->thread_count)
+    (*fn) (arg, block);
+  return;
+}
+
+
+static void *pf_pool_main(void *arg)
+{
+  pf_pool_worker_t *worker;
+  pf_pool_t *pool;
+  unsigned long seen;
+  pf_pool_fn_t fn;
+  void *fn_arg;
+  int block_count;
+
+  worker = (pf_pool_worker_t*) arg;
+  pool = worker->pool;
+
+  // Jobs are counted from the creation of the pool, so that a job
+  // started before this thread gets going is not missed
+  seen = 0;
+  pthread_mutex_lock(&pool->lock);
+  while (1)
+  {
+    while (pool->generation == seen && !pool->quit)
+      pthread_cond_wait(&pool->start_cond, &pool->lock);
+    if (pool->quit)
+      break;
+    seen = pool->generation;
+    fn = pool->fn;
+    fn_arg = pool->arg;
+    block_count = pool->block_count;
+    pthread_mutex_unlock(&pool->lock);
+
+    pf_pool_work(pool, worker->index, fn, fn_arg, block_count);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0)
+      pthread_cond_signal(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+
+// Create a pool
+pf_pool_t *pf_pool_alloc(int thread_count)
+{
+  int i;
+  pf_pool_t *pool;
+
+  if (thread_count < 1)
+    thread_count = 1;
+
+  pool = calloc(1, sizeof(pf_pool_t));
+  pool->thread_count = thread_count;
+  pool->workers = calloc(thread_count, sizeof(pf_pool_worker_t));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  // Worker 0 is the calling thread
+  for (i = 1; i < thread_count; i++)
+  {
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+    if (pthread_create(&pool->workers[i].thread, NULL,
+                       pf_pool_main, pool->workers + i) != 0)
+    {
+      pool->thread_count = i;
+      pf_pool_free(pool);
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+
+// Free the pool
+void pf_pool_free(pf_pool_t *pool)
+{
+  int i;
+
+  if (pool == NULL)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->start_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 1; i < pool->thread_count; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->start_cond);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool);
+  return;
+}
+
+
+// Run a job on all threads
+void pf_pool_run(pf_pool_t *pool, pf_pool_fn_t fn, void *arg, int block_count)
+{
+  int block;
+
+  if (pool == NULL || pool->thread_count == 1 || block_count <= 1)
+  {
+    for (block = 0; block < block_count; block++)
+      (*fn) (arg, block);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->block_count = block_count;
+  pool->pending = pool->thread_count - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  pf_pool_work(pool, 0, fn, arg, block_count);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->pending > 0)
+    pthread_cond_wait(&pool->done_cond, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+  return;
+}
@@ -0,0 +1,61 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey    
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+
+/**************************************************************************
+ * Desc: Worker pool for sample set updates.
+ * CVS: $Id$
+ *************************************************************************/
+
+#ifndef PF_POOL_H
+#define PF_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Function run for each block of work
+typedef void (*pf_pool_fn_t) (void *arg, int block);
+
+// A fixed set of worker threads
+typedef struct _pf_pool_t pf_pool_t;
+
+
+// Create a pool with the given number of threads, counting the calling
+// thread.  Returns NULL if the threads cannot be started.
+pf_pool_t *pf_pool_alloc(int thread_count);
+
+// Stop the workers and free the pool
+void pf_pool_free(pf_pool_t *pool);
+
+// Run [fn] on blocks 0 to [block_count] - 1 and wait for them to finish.
+// Thread t of T runs blocks t, t + T, ...; the caller is thread 0.  A
+// NULL pool runs every block in the calling thread.
+void pf_pool_run(pf_pool_t *pool, pf_pool_fn_t fn, void *arg, int block_count);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
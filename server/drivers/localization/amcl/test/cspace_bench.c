@@ -0,0 +1,158 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: Map cspace benchmark.  Times map_update_cspace() on a synthetic
+ *       warehouse map (racking, walls and scattered clutter at 5 cm)
+ *       against the neighbourhood search it replaced, and checks that
+ *       the two give the same distances.
+ * Usage: cspace_bench [size [max_occ_dist [reference]]]
+ *        The map is size x size cells.  The neighbourhood search takes
+ *        minutes on large maps, so by default it is only run up to 2000
+ *        cells across; pass 1 or 0 for reference to force it on or off.
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../map/map.h"
+
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// Build a warehouse: outer walls, rows of racking with cross aisles, and
+// some random clutter
+static map_t *make_map(int size)
+{
+  map_t *map;
+  int i, j, n;
+
+  map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = size;
+  map->size_y = size;
+  map->cells = calloc((size_t) size * size, sizeof(map_cell_t));
+
+  srand(1);
+  for (j = 0; j < size; j++)
+  {
+    for (i = 0; i < size; i++)
+    {
+      n = 0;
+      n |= (i < 4 || j < 4 || i >= size - 4 || j >= size - 4);
+      // 1.2 m racks every 4 m, with a 3 m cross aisle every 30 m
+      n |= (j % 80 >= 40 && j % 80 < 64 && i % 600 >= 60);
+      n |= (rand() % 2000 == 0);
+      map->cells[MAP_INDEX(map, i, j)].occ_state = n ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+
+// The neighbourhood search that map_update_cspace() used to do
+static void reference_cspace(map_t *map, double max_occ_dist, double *dist)
+{
+  int i, j, ni, nj, s;
+  double d;
+
+  s = (int) ceil(max_occ_dist / map->scale);
+  for (i = 0; i < map->size_x * map->size_y; i++)
+    dist[i] = max_occ_dist;
+
+  for (j = 0; j < map->size_y; j++)
+  {
+    for (i = 0; i < map->size_x; i++)
+    {
+      if (map->cells[MAP_INDEX(map, i, j)].occ_state != +1)
+        continue;
+      dist[MAP_INDEX(map, i, j)] = 0;
+      for (nj = -s; nj <= +s; nj++)
+      {
+        for (ni = -s; ni <= +s; ni++)
+        {
+          if (!MAP_VALID(map, i + ni, j + nj))
+            continue;
+          d = map->scale * sqrt(ni * ni + nj * nj);
+          if (d < dist[MAP_INDEX(map, i + ni, j + nj)])
+            dist[MAP_INDEX(map, i + ni, j + nj)] = d;
+        }
+      }
+    }
+  }
+  return;
+}
+
+
+int main(int argc, char **argv)
+{
+  int i, size, occupied, reference, mismatches;
+  double max_occ_dist, start, t_edt, t_ref;
+  map_t *map;
+  double *dist;
+
+  size = argc > 1 ? atoi(argv[1]) : 4000;
+  max_occ_dist = argc > 2 ? atof(argv[2]) : 2.0;
+  reference = argc > 3 ? atoi(argv[3]) : (size <= 2000);
+
+  map = make_map(size);
+  occupied = 0;
+  for (i = 0; i < size * size; i++)
+    occupied += (map->cells[i].occ_state == +1);
+  printf("map %dx%d cells at %.3f m, %.1f%% occupied, max_occ_dist %.2f m\n",
+         size, size, map->scale, 100.0 * occupied / ((double) size * size),
+         max_occ_dist);
+
+  start = now();
+  map_update_cspace(map, max_occ_dist);
+  t_edt = now() - start;
+  printf("distance transform  %10.3f s\n", t_edt);
+
+  if (reference)
+  {
+    dist = malloc((size_t) size * size * sizeof(double));
+    start = now();
+    reference_cspace(map, max_occ_dist, dist);
+    t_ref = now() - start;
+    printf("neighbourhood scan  %10.3f s\n", t_ref);
+
+    mismatches = 0;
+    for (i = 0; i < size * size; i++)
+      mismatches += (map->cells[i].occ_dist != dist[i]);
+    printf("speedup %.1fx, %d mismatched cells\n", t_ref / t_edt, mismatches);
+    free(dist);
+    if (mismatches)
+      return 1;
+  }
+
+  map_free(map);
+  return 0;
+}
@@ -0,0 +1,468 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: Laser sensor model benchmark.  Replays a dataset of odometry and
+ *       laser scans through the particle filter with each laser model
+ *       (beam with ray casting, beam with the range table, likelihood
+ *       field) and reports sensor updates per second and the pose error
+ *       of the best cluster.
+ *
+ *       The dataset is either simulated on a built-in map, or read from a
+ *       writelog file with position2d and laser data.  For a log, the
+ *       position2d poses are used both as odometry and as ground truth,
+ *       which is only meaningful for simulated robots or corrected logs.
+ *
+ * Usage: laser_model_bench [particles [map.pnm scale logfile]]
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../pf/pf.h"
+#include "../pf/pf_pdf.h"
+#include "../map/map.h"
+#include "../models/laser.h"
+
+// Beams used per scan
+#define BENCH_MAX_BEAMS 30
+
+// Leading steps excluded from the error statistics
+#define BENCH_SETTLE_STEPS 10
+
+// A single step of the dataset
+typedef struct
+{
+  pf_vector_t odom, truth;
+  int range_count;
+  double range_max;
+  double (*ranges)[2];
+} step_t;
+
+typedef struct
+{
+  int step_count;
+  step_t *steps;
+} dataset_t;
+
+typedef struct
+{
+  laser_model_t *model;
+  step_t *step;
+} sensor_data_t;
+
+typedef struct
+{
+  pf_vector_t delta;
+} action_data_t;
+
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static step_t *add_step(dataset_t *data)
+{
+  step_t *step;
+
+  data->steps = realloc(data->steps, (data->step_count + 1) * sizeof(step_t));
+  step = data->steps + data->step_count++;
+  memset(step, 0, sizeof(step_t));
+  return step;
+}
+
+
+// Build a 16 x 12 m test map with rooms and some clutter, so that the
+// pose is observable.
+static map_t *make_map(void)
+{
+  map_t *map;
+  int i, j, n;
+  double x, y;
+
+  map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = 320;
+  map->size_y = 240;
+  map->cells = calloc(map->size_x * map->size_y, sizeof(map_cell_t));
+
+  for (j = 0; j < map->size_y; j++)
+  {
+    for (i = 0; i < map->size_x; i++)
+    {
+      x = MAP_WXGX(map, i);
+      y = MAP_WYGY(map, j);
+      n = 0;
+
+      // Outer walls
+      n |= (fabs(x) > 7.8 || fabs(y) > 5.8);
+      // Dividing wall with two doors
+      n |= (fabs(x - 1.0) < 0.1 && !(fabs(y - 3.0) < 0.6) && !(fabs(y + 2.5) < 0.6));
+      // Part wall in the left room
+      n |= (fabs(y - 1.0) < 0.1 && x < -3.0);
+      // Pillars and boxes
+      n |= (hypot(x + 4.0, y + 3.0) < 0.3);
+      n |= (hypot(x - 4.5, y - 2.0) < 0.4);
+      n |= (fabs(x - 5.0) < 0.5 && fabs(y + 3.5) < 0.3);
+      n |= (fabs(x + 1.5) < 0.2 && fabs(y - 4.0) < 0.8);
+
+      map->cells[MAP_INDEX(map, i, j)].occ_state = n ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+
+// Simulate a robot driving a loop through both rooms, with noisy
+// odometry and noisy 181-beam scans.
+static void make_dataset(map_t *map, dataset_t *data)
+{
+  // Waypoints of the loop
+  static const double path[][2] = {{-5.5, -1.5}, {-1.5, -1.5}, {-0.5, -2.5},
+                                   {3.0, -2.5}, {6.0, -1.0}, {6.0, 3.5},
+                                   {2.5, 3.0}, {-0.5, 3.0}, {-5.5, 3.0},
+                                   {-5.5, -1.5}};
+  int i, k, w, steps;
+  double dx, dy, len;
+  pf_vector_t truth, odom, prev, delta;
+  step_t *step;
+
+  srand48(1);
+
+  odom = pf_vector_zero();
+  prev = pf_vector_zero();
+  for (w = 0; w + 1 < (int) (sizeof(path) / sizeof(path[0])); w++)
+  {
+    dx = path[w + 1][0] - path[w][0];
+    dy = path[w + 1][1] - path[w][1];
+    len = hypot(dx, dy);
+    steps = (int) ceil(len / 0.1);
+    for (k = 0; k < steps; k++)
+    {
+      truth.v[0] = path[w][0] + dx * k / steps;
+      truth.v[1] = path[w][1] + dy * k / steps;
+      truth.v[2] = atan2(dy, dx);
+
+      // Integrate noisy odometry
+      if (data->step_count == 0)
+        odom = truth;
+      else
+      {
+        delta = pf_vector_coord_sub(truth, prev);
+        delta.v[0] += pf_ran_gaussian(0.01 + 0.05 * fabs(delta.v[0]));
+        delta.v[1] += pf_ran_gaussian(0.01);
+        delta.v[2] += pf_ran_gaussian(0.005 + 0.05 * fabs(delta.v[2]));
+        odom = pf_vector_coord_add(delta, odom);
+      }
+      prev = truth;
+
+      step = add_step(data);
+      step->truth = truth;
+      step->odom = odom;
+      step->range_count = 181;
+      step->range_max = 8.0;
+      step->ranges = malloc(step->range_count * sizeof(step->ranges[0]));
+      for (i = 0; i < step->range_count; i++)
+      {
+        step->ranges[i][1] = -M_PI / 2 + i * M_PI / 180;
+        step->ranges[i][0] = map_calc_range(map, truth.v[0], truth.v[1],
+                                            truth.v[2] + step->ranges[i][1], 8.0);
+        if (step->ranges[i][0] < 8.0)
+          step->ranges[i][0] += pf_ran_gaussian(0.02);
+        if (drand48() < 0.02)
+          step->ranges[i][0] = drand48() * 8.0;
+      }
+    }
+  }
+  return;
+}
+
+
+// Read position2d and laser data from a writelog file.  Each scan is
+// paired with the latest position2d pose.
+static int read_dataset(const char *filename, dataset_t *data)
+{
+  FILE *file;
+  char line[65536], iface[64];
+  char *tok;
+  int i, type, subtype, count, have_pose;
+  double minangle, res, maxrange;
+  pf_vector_t pose;
+  step_t *step;
+
+  if ((file = fopen(filename, "r")) == NULL)
+  {
+    perror(filename);
+    return -1;
+  }
+
+  have_pose = 0;
+  pose = pf_vector_zero();
+  while (fgets(line, sizeof(line), file))
+  {
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%*f %*u %*u %63s %*u %d %d", iface, &type, &subtype) != 3)
+      continue;
+    if (type != 1 || subtype != 1)
+      continue;
+
+    // Skip the header fields
+    tok = strtok(line, " \t\n");
+    for (i = 0; tok && i < 6; i++)
+      tok = strtok(NULL, " \t\n");
+    if (!tok)
+      continue;
+
+    if (strcmp(iface, "position2d") == 0)
+    {
+      for (i = 0; i < 3 && (tok = strtok(NULL, " \t\n")); i++)
+        pose.v[i] = atof(tok);
+      have_pose = (i == 3);
+    }
+    else if (strcmp(iface, "laser") == 0 && have_pose)
+    {
+      // id min_angle max_angle resolution max_range count (range intensity)*
+      if (!(tok = strtok(NULL, " \t\n")) || !(tok = strtok(NULL, " \t\n")))
+        continue;
+      minangle = atof(tok);
+      if (!(tok = strtok(NULL, " \t\n")) || !(tok = strtok(NULL, " \t\n")))
+        continue;
+      res = atof(tok);
+      if (!(tok = strtok(NULL, " \t\n")))
+        continue;
+      maxrange = atof(tok);
+      if (!(tok = strtok(NULL, " \t\n")) || (count = atoi(tok)) <= 0)
+        continue;
+
+      step = add_step(data);
+      step->truth = pose;
+      step->odom = pose;
+      step->range_max = maxrange;
+      step->ranges = malloc(count * sizeof(step->ranges[0]));
+      for (i = 0; i < count && (tok = strtok(NULL, " \t\n")); i++)
+      {
+        step->ranges[i][0] = atof(tok);
+        step->ranges[i][1] = minangle + i * res;
+        strtok(NULL, " \t\n");
+      }
+      step->range_count = i;
+    }
+  }
+  fclose(file);
+
+  if (data->step_count == 0)
+  {
+    fprintf(stderr, "%s: no position2d and laser data found\n", filename);
+    return -1;
+  }
+  return 0;
+}
+
+
+static void action_model(action_data_t *data, pf_sample_set_t *set)
+{
+  int i;
+  pf_vector_t delta;
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    delta = data->delta;
+    delta.v[0] += pf_ran_gaussian(0.02 + 0.1 * fabs(data->delta.v[0]));
+    delta.v[1] += pf_ran_gaussian(0.02 + 0.1 * fabs(data->delta.v[1]));
+    delta.v[2] += pf_ran_gaussian(0.01 + 0.1 * fabs(data->delta.v[2]));
+    pf_sample_put_pose(set, i, pf_vector_coord_add(delta, pf_sample_get_pose(set, i)));
+  }
+  return;
+}
+
+
+static double sensor_model(sensor_data_t *data, pf_sample_set_t *set)
+{
+  return laser_model_update(data->model, data->step->range_count,
+                            data->step->range_max, data->step->ranges, set);
+}
+
+
+// Best estimate: the mean of the heaviest cluster
+static pf_vector_t estimate(pf_t *pf)
+{
+  int i;
+  double weight, best;
+  pf_vector_t mean, result;
+  pf_matrix_t cov;
+
+  best = -1;
+  result = pf_vector_zero();
+  for (i = 0; pf_get_cluster_stats(pf, i, &weight, &mean, &cov); i++)
+  {
+    if (weight > best)
+    {
+      best = weight;
+      result = mean;
+    }
+  }
+  return result;
+}
+
+
+static void run(const char *name, laser_model_t *model, dataset_t *data, int particles)
+{
+  int i, n;
+  double start, elapsed, err_xy, err_a, max_xy;
+  pf_t *pf;
+  pf_matrix_t cov;
+  pf_vector_t est;
+  action_data_t action;
+  sensor_data_t sensor;
+
+  srand48(2);
+  pf = pf_alloc(particles, particles);
+  cov = pf_matrix_zero();
+  cov.m[0][0] = 0.2 * 0.2;
+  cov.m[1][1] = 0.2 * 0.2;
+  cov.m[2][2] = (10 * M_PI / 180) * (10 * M_PI / 180);
+  pf_init(pf, data->steps[0].truth, cov);
+
+  sensor.model = model;
+  elapsed = 0;
+  err_xy = err_a = max_xy = 0;
+  n = 0;
+  for (i = 0; i < data->step_count; i++)
+  {
+    if (i > 0)
+    {
+      action.delta = pf_vector_coord_sub(data->steps[i].odom, data->steps[i - 1].odom);
+      pf_update_action(pf, (pf_action_model_fn_t) action_model, &action);
+    }
+
+    sensor.step = data->steps + i;
+    start = now();
+    pf_update_sensor(pf, (pf_sensor_model_fn_t) sensor_model, &sensor);
+    elapsed += now() - start;
+
+    pf_update_resample(pf);
+
+    if (i >= BENCH_SETTLE_STEPS)
+    {
+      est = estimate(pf);
+      est = pf_vector_sub(est, data->steps[i].truth);
+      err_xy += hypot(est.v[0], est.v[1]);
+      err_a += fabs(atan2(sin(est.v[2]), cos(est.v[2])));
+      if (hypot(est.v[0], est.v[1]) > max_xy)
+        max_xy = hypot(est.v[0], est.v[1]);
+      n++;
+    }
+  }
+  pf_free(pf);
+
+  printf("%-18s %10.1f %10.3f %10.3f %10.3f %10.2f\n", name,
+         data->step_count / elapsed, elapsed * 1e3 / data->step_count,
+         n ? err_xy / n : 0, max_xy, n ? err_a / n * 180 / M_PI : 0);
+  return;
+}
+
+
+int main(int argc, char **argv)
+{
+  int i, particles;
+  double start, build_time, load_time;
+  char cache[256];
+  map_t *map;
+  dataset_t data;
+  map_range_table_t *table, *cached;
+  laser_model_t *beam, *table_beam, *field;
+
+  particles = argc > 1 ? atoi(argv[1]) : 1000;
+  memset(&data, 0, sizeof(data));
+
+  if (argc > 4)
+  {
+    map = map_alloc();
+    if (map_load_occ(map, argv[2], atof(argv[3]), 0) != 0)
+      return 1;
+    if (read_dataset(argv[4], &data) != 0)
+      return 1;
+  }
+  else
+  {
+    map = make_map();
+    make_dataset(map, &data);
+  }
+
+  printf("map %dx%d cells at %.3f m, %d steps, %d particles, %d beams\n",
+         map->size_x, map->size_y, map->scale, data.step_count,
+         particles, BENCH_MAX_BEAMS);
+
+  // Range table, built once and then loaded from the cache file
+  snprintf(cache, sizeof(cache), "laser_model_bench.%d.rt", (int) getpid());
+  start = now();
+  table = map_range_table_alloc(map, 360, data.steps[0].range_max + 1.0, cache);
+  build_time = now() - start;
+  start = now();
+  cached = map_range_table_alloc(map, 360, data.steps[0].range_max + 1.0, cache);
+  load_time = now() - start;
+  remove(cache);
+  if (!table || !cached || !cached->mapped ||
+      memcmp(table->ranges, cached->ranges, (size_t) table->size_x * table->size_y *
+             table->num_angles * sizeof(uint16_t)) != 0)
+  {
+    fprintf(stderr, "range table cache mismatch\n");
+    return 1;
+  }
+  map_range_table_free(cached);
+  printf("range table: %.1f MB, built in %.2f s, mapped from cache in %.4f s\n",
+         table->mem_size / (1024.0 * 1024.0), build_time, load_time);
+
+  start = now();
+  map_update_cspace(map, 2.0);
+  printf("cspace distances: %.2f s\n", now() - start);
+
+  beam = laser_model_alloc(map, LASER_MODEL_BEAM, BENCH_MAX_BEAMS, 0.1, 0.1);
+  table_beam = laser_model_alloc(map, LASER_MODEL_BEAM, BENCH_MAX_BEAMS, 0.1, 0.1);
+  table_beam->range_table = table;
+  field = laser_model_alloc(map, LASER_MODEL_LIKELIHOOD_FIELD, BENCH_MAX_BEAMS, 0.1, 0.1);
+
+  printf("%-18s %10s %10s %10s %10s %10s\n", "model", "updates/s", "ms/update",
+         "err (m)", "max (m)", "err (deg)");
+  run("beam", beam, &data, particles);
+  run("beam (table)", table_beam, &data, particles);
+  run("likelihood_field", field, &data, particles);
+
+  laser_model_free(beam);
+  laser_model_free(table_beam);
+  laser_model_free(field);
+  map_range_table_free(table);
+  for (i = 0; i < data.step_count; i++)
+    free(data.steps[i].ranges);
+  free(data.steps);
+  map_free(map);
+  return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: Particle filter update benchmark.  Runs synthetic odometry,
+ *       likelihood field and resampling updates at 1k, 10k and 100k
+ *       particles and reports the time of each.  The odometry update is
+ *       timed both with the batched motion model and with the former
+ *       one-sample-at-a-time loop, for comparison.
+ * Usage: pf_bench [threads]
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../pf/pf.h"
+#include "../pf/pf_pdf.h"
+#include "../map/map.h"
+#include "../models/laser.h"
+
+// Beams in the synthetic scan, and beams used by the model
+#define BENCH_RANGE_COUNT 361
+#define BENCH_MAX_BEAMS 60
+
+typedef struct
+{
+  laser_model_t *model;
+  double range_max;
+  double (*ranges)[2];
+} sensor_data_t;
+
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// Build a 16 x 12 m room with a few obstacles
+static map_t *make_map(void)
+{
+  map_t *map;
+  int i, j, n;
+  double x, y;
+
+  map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = 320;
+  map->size_y = 240;
+  map->cells = calloc(map->size_x * map->size_y, sizeof(map_cell_t));
+
+  for (j = 0; j < map->size_y; j++)
+  {
+    for (i = 0; i < map->size_x; i++)
+    {
+      x = MAP_WXGX(map, i);
+      y = MAP_WYGY(map, j);
+      n = 0;
+      n |= (fabs(x) > 7.8 || fabs(y) > 5.8);
+      n |= (fabs(x - 1.0) < 0.1 && fabs(y - 3.0) > 0.6);
+      n |= (hypot(x + 4.0, y + 3.0) < 0.3);
+      n |= (fabs(x - 5.0) < 0.5 && fabs(y + 3.5) < 0.3);
+      map->cells[MAP_INDEX(map, i, j)].occ_state = n ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+
+// The motion model as it was before the batched form: one draw and one
+// coordinate transform per sample
+static void reference_action_model(pf_pdf_gaussian_t *pdf, pf_sample_set_t *set)
+{
+  int i;
+  pf_vector_t z;
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    z = pf_pdf_gaussian_sample(pdf);
+    pf_sample_put_pose(set, i, pf_vector_coord_add(z, pf_sample_get_pose(set, i)));
+  }
+  return;
+}
+
+
+static void action_model(pf_pdf_gaussian_t *pdf, pf_sample_set_t *set)
+{
+  pf_sample_set_move(set, pdf);
+  return;
+}
+
+
+static double sensor_model(sensor_data_t *data, pf_sample_set_t *set)
+{
+  return laser_model_update(data->model, BENCH_RANGE_COUNT, data->range_max,
+                            data->ranges, set);
+}
+
+
+static void run(int particles, int threads, pf_pdf_gaussian_t *pdf, sensor_data_t *sensor)
+{
+  int i, reps;
+  double t_ref, t_action, t_sensor, t_resample, start;
+  pf_t *pf;
+  pf_matrix_t cov;
+
+  reps = 50000 / particles + 2;
+
+  pf = pf_alloc(particles, particles);
+  pf_set_threads(pf, threads);
+  cov = pf_matrix_zero();
+  cov.m[0][0] = 0.5 * 0.5;
+  cov.m[1][1] = 0.5 * 0.5;
+  cov.m[2][2] = 0.3 * 0.3;
+  pf_init(pf, pf_vector_zero(), cov);
+
+  t_ref = t_action = t_sensor = t_resample = 0;
+  for (i = 0; i < reps; i++)
+  {
+    start = now();
+    pf_update_action(pf, (pf_action_model_fn_t) reference_action_model, pdf);
+    t_ref += now() - start;
+
+    start = now();
+    pf_update_action(pf, (pf_action_model_fn_t) action_model, pdf);
+    t_action += now() - start;
+
+    start = now();
+    pf_update_sensor(pf, (pf_sensor_model_fn_t) sensor_model, sensor);
+    t_sensor += now() - start;
+
+    start = now();
+    pf_update_resample(pf);
+    t_resample += now() - start;
+  }
+  pf_free(pf);
+
+  printf("%9d %12.3f %12.3f %12.3f %12.3f\n", particles,
+         t_ref * 1e3 / reps, t_action * 1e3 / reps,
+         t_sensor * 1e3 / reps, t_resample * 1e3 / reps);
+  return;
+}
+
+
+int main(int argc, char **argv)
+{
+  int i, threads;
+  int sizes[] = {1000, 10000, 100000};
+  map_t *map;
+  pf_vector_t delta;
+  pf_matrix_t cov;
+  pf_pdf_gaussian_t *pdf;
+  sensor_data_t sensor;
+
+  threads = argc > 1 ? atoi(argv[1]) : 1;
+
+  map = make_map();
+  map_update_cspace(map, 2.0);
+
+  // A scan from the middle of the map
+  sensor.range_max = 8.0;
+  sensor.ranges = calloc(BENCH_RANGE_COUNT, sizeof(sensor.ranges[0]));
+  for (i = 0; i < BENCH_RANGE_COUNT; i++)
+  {
+    sensor.ranges[i][1] = (i - BENCH_RANGE_COUNT / 2) * M_PI / (BENCH_RANGE_COUNT - 1);
+    sensor.ranges[i][0] = map_calc_range(map, 0.0, 0.0, sensor.ranges[i][1],
+                                         sensor.range_max);
+  }
+  sensor.model = laser_model_alloc(map, LASER_MODEL_LIKELIHOOD_FIELD,
+                                   BENCH_MAX_BEAMS, 0.2 * 0.2, 0.5);
+
+  // A small step forward, and its noise
+  delta = pf_vector_zero();
+  delta.v[0] = 0.05;
+  delta.v[2] = 0.01;
+  cov = pf_matrix_zero();
+  cov.m[0][0] = 0.01 * 0.01;
+  cov.m[1][1] = 0.01 * 0.01;
+  cov.m[2][2] = 0.005 * 0.005;
+  pdf = pf_pdf_gaussian_alloc(delta, cov);
+
+  printf("%d thread(s), %d of %d beams, times in ms per update\n",
+         threads, BENCH_MAX_BEAMS, BENCH_RANGE_COUNT);
+  printf("particles  action(ref)       action       sensor     resample\n");
+  for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++)
+    run(sizes[i], threads, pdf, &sensor);
+
+  pf_pdf_gaussian_free(pdf);
+  laser_model_free(sensor.model);
+  free(sensor.ranges);
+  map_free(map);
+  return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: Particle filter threading tests.  Runs the filter on a synthetic
+ *       problem and checks that the results depend only on the seed, not
+ *       on the number of threads.
+ * Usage: pf_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../pf/pf.h"
+#include "../pf/pf_pdf.h"
+#include "../pf/pf_pool.h"
+#include <libplayercommon/test/test.h>
+
+// Final state of a run
+typedef struct
+{
+  int sample_count;
+  double *samples;
+  int cluster_count;
+  pf_cluster_t *clusters;
+} result_t;
+
+
+// Move every sample by the step, with noise
+static void action_model(pf_vector_t *step, pf_sample_set_t *set)
+{
+  int i;
+  pf_vector_t delta;
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    delta = *step;
+    delta.v[0] += pf_ran_gaussian(0.05);
+    delta.v[1] += pf_ran_gaussian(0.05);
+    delta.v[2] += pf_ran_gaussian(0.02);
+    pf_sample_put_pose(set, i, pf_vector_coord_add(delta, pf_sample_get_pose(set, i)));
+  }
+}
+
+
+// Weight the samples by their distance to the true pose
+static double sensor_model(pf_vector_t *truth, pf_sample_set_t *set)
+{
+  int i;
+  double d, total;
+
+  total = 0;
+  for (i = 0; i < set->sample_count; i++)
+  {
+    d = hypot(set->x[i] - truth->v[0], set->y[i] - truth->v[1]);
+    set->weight[i] *= exp(-d * d / (2 * 0.3 * 0.3));
+    total += set->weight[i];
+  }
+  return total;
+}
+
+
+static void run(result_t *result, uint64_t seed, int threads)
+{
+  int i, n;
+  pf_t *pf;
+  pf_vector_t truth, step;
+  pf_matrix_t cov;
+  pf_sample_set_t *set;
+
+  pf = pf_alloc(500, 5000);
+  pf_set_seed(pf, seed);
+  pf_set_threads(pf, threads);
+
+  truth = pf_vector_zero();
+  cov = pf_matrix_zero();
+  cov.m[0][0] = cov.m[1][1] = 4.0;
+  cov.m[2][2] = 1.0;
+  pf_init(pf, truth, cov);
+
+  step.v[0] = 0.2;
+  step.v[1] = 0.0;
+  step.v[2] = 0.05;
+  for (i = 0; i < 20; i++)
+  {
+    truth = pf_vector_coord_add(step, truth);
+    pf_update_action(pf, (pf_action_model_fn_t) action_model, &step);
+    pf_update_sensor(pf, (pf_sensor_model_fn_t) sensor_model, &truth);
+    pf_update_resample(pf);
+  }
+
+  set = pf->sets + pf->current_set;
+  result->sample_count = set->sample_count;
+  n = set->sample_count;
+  result->samples = malloc(4 * n * sizeof(double));
+  memcpy(result->samples + 0 * n, set->x, n * sizeof(double));
+  memcpy(result->samples + 1 * n, set->y, n * sizeof(double));
+  memcpy(result->samples + 2 * n, set->theta, n * sizeof(double));
+  memcpy(result->samples + 3 * n, set->weight, n * sizeof(double));
+  result->cluster_count = set->cluster_count;
+  result->clusters = malloc(set->cluster_count * sizeof(pf_cluster_t));
+  memcpy(result->clusters, set->clusters, set->cluster_count * sizeof(pf_cluster_t));
+
+  pf_free(pf);
+}
+
+
+static int same(result_t *a, result_t *b)
+{
+  return a->sample_count == b->sample_count &&
+    memcmp(a->samples, b->samples, 4 * a->sample_count * sizeof(double)) == 0 &&
+    a->cluster_count == b->cluster_count &&
+    memcmp(a->clusters, b->clusters, a->cluster_count * sizeof(pf_cluster_t)) == 0;
+}
+
+
+static void release(result_t *result)
+{
+  free(result->samples);
+  free(result->clusters);
+}
+
+
+static void count_block(int *counts, int block)
+{
+  counts[block]++;
+}
+
+
+int main(int argc, char **argv)
+{
+  int i, ok;
+  int counts[37];
+  pf_pool_t *pool;
+  pf_sample_set_t *set;
+  result_t a, b, c, d;
+
+  TEST("pool runs every block once");
+  {
+    ok = 1;
+    pool = pf_pool_alloc(4);
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < 100; i++)
+      pf_pool_run(pool, (pf_pool_fn_t) count_block, counts, 37);
+    pf_pool_run(pool, (pf_pool_fn_t) count_block, counts, 2);
+    for (i = 0; i < 37; i++)
+      ok = ok && counts[i] == 100 + (i < 2);
+    pf_pool_free(pool);
+    check(ok);
+  }
+
+  TEST("sample arrays are aligned");
+  {
+    pf_t *pf;
+    pf = pf_alloc(10, 1000);
+    set = pf->sets + 1;
+    check(((size_t) set->x | (size_t) set->y |
+           (size_t) set->theta | (size_t) set->weight) % PF_SAMPLE_ALIGN == 0);
+    pf_free(pf);
+  }
+
+  TEST("batched motion matches pf_vector_coord_add");
+  {
+    pf_t *pf;
+    pf_vector_t pose, delta, expect;
+    double dx[301], dy[301], da[301];
+
+    ok = 1;
+    pf = pf_alloc(10, 301);
+    set = pf->sets + 0;
+    for (i = 0; i < set->sample_count; i++)
+    {
+      pose.v[0] = i * 0.1 - 5;
+      pose.v[1] = 3 - i * 0.07;
+      pose.v[2] = fmod(i * 0.37, 2 * M_PI) - M_PI;
+      pf_sample_put_pose(set, i, pose);
+      dx[i] = sin(i * 1.3);
+      dy[i] = cos(i * 0.9);
+      da[i] = (i % 7 - 3) * 1.7;
+    }
+    pf_sample_set_coord_add(set, dx, dy, da);
+    for (i = 0; i < set->sample_count; i++)
+    {
+      pose.v[0] = i * 0.1 - 5;
+      pose.v[1] = 3 - i * 0.07;
+      pose.v[2] = fmod(i * 0.37, 2 * M_PI) - M_PI;
+      delta.v[0] = dx[i];
+      delta.v[1] = dy[i];
+      delta.v[2] = da[i];
+      expect = pf_vector_coord_add(delta, pose);
+      pose = pf_sample_get_pose(set, i);
+      ok = ok && fabs(pose.v[0] - expect.v[0]) < 1e-12 &&
+        fabs(pose.v[1] - expect.v[1]) < 1e-12 &&
+        fabs(pose.v[2] - expect.v[2]) < 1e-12 &&
+        pose.v[2] > -M_PI && pose.v[2] <= M_PI;
+    }
+    pf_free(pf);
+    check(ok);
+  }
+
+  run(&a, 42, 1);
+
+  TEST("same seed, same results");
+  run(&b, 42, 1);
+  check(same(&a, &b));
+  release(&b);
+
+  TEST("same results with 4 threads");
+  run(&b, 42, 4);
+  check(same(&a, &b));
+
+  TEST("same results with 3 threads");
+  run(&c, 42, 3);
+  check(same(&a, &c));
+
+  TEST("different seed, different results");
+  run(&d, 43, 4);
+  check(!same(&a, &d));
+
+  TEST("filter converges");
+  check(a.cluster_count >= 1 && a.sample_count < 5000);
+
+  release(&a);
+  release(&b);
+  release(&c);
+  release(&d);
+
+  return test_result();
+}
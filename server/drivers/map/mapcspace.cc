@@ -93,6 +93,9 @@ driver
 */
 /** @} */
 
+#include <math.h>
+#include <libplayercommon/edt.h>
+
 #include "maptransform.h"
 
 typedef enum
@@ -162,19 +165,23 @@ MapCspace::~MapCspace()
 }
 
 
-// convolve the map with a circular robot to produce the cspace
+// convolve the map with a circular robot to produce the cspace.  A cell
+// becomes occupied if it is within the radius of an occupied cell, and
+// otherwise unknown if it is within the radius of an unknown cell; the
+// distances come from an exact distance transform of each.
 int
 MapCspace::Transform()
 {
-  unsigned int i,j;
-  int di,dj;
+  unsigned int i, n;
   int r;
-  char state;
+  uint8_t *occ, *grow;
+  uint32_t *occ_dist2, *grow_dist2;
 
   // allocate the transformed map
   new_map = source_map;
-  new_data = new char[new_map.width * new_map.height];
-  memcpy(new_data,source_data,new_map.width * new_map.height);
+  n = new_map.width * new_map.height;
+  new_data = new int8_t[n];
+  memcpy(new_data,source_data,n);
 
   PLAYER_MSG1(5,"MapCspace creating C-space for circular robot with radius %.3fm:",
          this->robot_radius);
@@ -184,37 +191,44 @@ MapCspace::Transform()
   r = (int)rint(this->robot_radius / source_map.scale);
   PLAYER_MSG1(5,"Robot Radius in map Cells: %d",r);
 
-  for(j=0; j < this->source_map.height; j++)
+  occ = new uint8_t[n];
+  grow = new uint8_t[n];
+  occ_dist2 = new uint32_t[n];
+  grow_dist2 = new uint32_t[n];
+
+  // grow both occupied and unknown regions
+  for(i=0; i < n; i++)
+  {
+    occ[i] = this->source_data[i] > 0;
+    grow[i] = this->source_data[i] >= 0;
+  }
+
+  if(player_edt(occ, new_map.width, new_map.height, 0, occ_dist2) != 0 ||
+     player_edt(grow, new_map.width, new_map.height, 0, grow_dist2) != 0)
   {
-    for(i=0; i < this->source_map.width; i++)
-    {
-      state = this->source_data[MAP_IDX(source_map,i,j)];
-
-      // grow both occupied and unknown regions
-      if(state >= 0)
-      {
-        for(dj = -r; dj <= r; dj++)
-        {
-          for(di = -r; di <= r; di++)
-          {
-            // stay within the radius
-            if((int)rint(sqrt(static_cast<double>(di*di + dj*dj))) > r)
-              continue;
-
-            // make sure we stay on the map
-            if(!MAP_VALID(new_map,i+di,j+dj))
-              continue;
-
-            // don't change occupied to uknown
-            if(this->new_data[MAP_IDX(new_map,i+di,j+dj)] < state)
-            {
-              this->new_data[MAP_IDX(new_map,i+di,j+dj)] = state;
-            }
-          }
-        }
-      }
-    }
+    PLAYER_ERROR("unable to allocate the distance transform");
+    delete [] occ;
+    delete [] grow;
+    delete [] occ_dist2;
+    delete [] grow_dist2;
+    return(-1);
   }
+
+  // stay within the radius; don't change occupied to unknown
+  for(i=0; i < n; i++)
+  {
+    if(occ_dist2[i] != PLAYER_EDT_NONE &&
+       (int)rint(sqrt(static_cast<double>(occ_dist2[i]))) <= r)
+      this->new_data[i] = 1;
+    else if(grow_dist2[i] != PLAYER_EDT_NONE &&
+            (int)rint(sqrt(static_cast<double>(grow_dist2[i]))) <= r &&
+            this->new_data[i] < 0)
+      this->new_data[i] = 0;
+  }
+
+  delete [] occ;
+  delete [] grow;
+  delete [] occ_dist2;
+  delete [] grow_dist2;
   return(0);
 }
-
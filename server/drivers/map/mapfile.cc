@@ -44,7 +44,9 @@ than 0.1, the cell is free; otherwise it is unknown.  In other words,
 between are unknown.
 
 Note that @ref interface_map devices produce no data; the map is
-delivered via a sequence of configuration requests.
+delivered via a sequence of configuration requests.  Drivers in the same
+server (e.g., @ref driver_amcl, @ref driver_wavefront) are handed the
+loaded grid directly instead; see MapGrid.
 
 @par Compile-time dependencies
 
@@ -128,7 +130,8 @@ class MapFile : public Driver
     int negate;
     int size_x, size_y;
     player_pose2d_t origin;
-    char* mapdata;
+    // The loaded map, shared with other drivers
+    MapGrid* grid;
 
     // Handle map info request
     void HandleGetMapInfo(void *client, void *request, int len);
@@ -142,6 +145,9 @@ class MapFile : public Driver
     int Setup();
     int Shutdown();
 
+    // Share the loaded map
+    MapGrid* GetMapGrid(player_devaddr_t addr);
+
     // MessageHandler
     int ProcessMessage(QueuePointer & resp_queue,
 		       player_msghdr * hdr,
@@ -190,7 +196,7 @@ MapFile::MapFile(ConfigFile* cf, int section, const char* file,
                  double res, int neg, player_pose2d_t o)
   : Driver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN, PLAYER_MAP_CODE)
 {
-  this->mapdata = NULL;
+  this->grid = NULL;
   this->size_x = this->size_y = 0;
   this->filename = file;
   this->resolution = res;
@@ -214,6 +220,8 @@ MapFile::Setup()
   double occ;
   int color_sum;
   double color_avg;
+  int8_t* mapdata;
+  player_map_info_t info;
 
   // Initialize glib
   g_type_init();
@@ -231,9 +239,7 @@ MapFile::Setup()
   this->size_x = gdk_pixbuf_get_width(pixbuf);
   this->size_y = gdk_pixbuf_get_height(pixbuf);
 
-  this->mapdata = (char*)malloc(sizeof(char) *
-                                       this->size_x * this->size_y);
-  assert(this->mapdata);
+  mapdata = new int8_t[this->size_x * this->size_y];
 
   rowstride = gdk_pixbuf_get_rowstride(pixbuf);
   bps = gdk_pixbuf_get_bits_per_sample(pixbuf)/8;
@@ -257,16 +263,33 @@ MapFile::Setup()
         occ = (255 - color_avg) / 255.0;
 
       if(occ > 0.95)
-        this->mapdata[MAP_IDX(this,i,this->size_y - j - 1)] = +1;
+        mapdata[MAP_IDX(this,i,this->size_y - j - 1)] = +1;
       else if(occ < 0.1)
-        this->mapdata[MAP_IDX(this,i,this->size_y - j - 1)] = -1;
+        mapdata[MAP_IDX(this,i,this->size_y - j - 1)] = -1;
       else
-        this->mapdata[MAP_IDX(this,i,this->size_y - j - 1)] = 0;
+        mapdata[MAP_IDX(this,i,this->size_y - j - 1)] = 0;
     }
   }
 
   gdk_pixbuf_unref(pixbuf);
 
+  info.scale = this->resolution;
+  info.width = this->size_x;
+  info.height = this->size_y;
+  // Did the user specify an origin?
+  if(this->origin.px == FLT_MAX)
+  {
+    info.origin.px = -(this->size_x / 2.0) * this->resolution;
+    info.origin.py = -(this->size_y / 2.0) * this->resolution;
+    info.origin.pa = 0.0;
+  }
+  else
+    info.origin = this->origin;
+
+  this->Lock();
+  this->grid = new MapGrid(info, mapdata);
+  this->Unlock();
+
   puts("Done.");
   printf("MapFile read a %d X %d map, at %.3f m/pix\n",
          this->size_x, this->size_y, this->resolution);
@@ -276,10 +299,26 @@ MapFile::Setup()
 int
 MapFile::Shutdown()
 {
-  free(this->mapdata);
+  // Drivers we have shared the map with keep their references
+  this->Lock();
+  this->grid->Unref();
+  this->grid = NULL;
+  this->Unlock();
   return(0);
 }
 
+MapGrid*
+MapFile::GetMapGrid(player_devaddr_t addr)
+{
+  MapGrid* ret = NULL;
+
+  this->Lock();
+  if(this->grid)
+    ret = this->grid->Ref();
+  this->Unlock();
+  return(ret);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Process an incoming message
 int MapFile::ProcessMessage(QueuePointer & resp_queue,
@@ -293,20 +332,7 @@ int MapFile::ProcessMessage(QueuePointer & resp_queue,
   if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ, PLAYER_MAP_REQ_GET_INFO,
                            this->device_addr))
   {
-    player_map_info_t info;
-    info.scale = this->resolution;
-    info.width = this->size_x;
-    info.height = this->size_y;
-    // Did the user specify an origin?
-    if(this->origin.px == FLT_MAX)
-    {
-      info.origin.px = -(this->size_x / 2.0) * this->resolution;
-      info.origin.py = -(this->size_y / 2.0) * this->resolution;
-      info.origin.pa = 0.0;
-    }
-    else
-      info.origin = this->origin;
-
+    player_map_info_t info = this->grid->info;
     this->Publish(this->device_addr, resp_queue,
                   PLAYER_MSGTYPE_RESP_ACK,
                   PLAYER_MAP_REQ_GET_INFO,
@@ -346,7 +372,7 @@ int MapFile::ProcessMessage(QueuePointer & resp_queue,
       for(i = 0; i < si; i++)
       {
         if(MAP_VALID(this, i + oi, j + oj))
-          mapresp->data[i + j * si] = this->mapdata[MAP_IDX(this, i+oi, j+oj)];
+          mapresp->data[i + j * si] = this->grid->cells[MAP_IDX(this, i+oi, j+oj)];
         else
         {
           PLAYER_WARN2("requested cell (%d,%d) is offmap", i+oi, j+oj);
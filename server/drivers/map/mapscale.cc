@@ -200,7 +200,7 @@ MapScale::Transform()
   new_map_pixels = gdk_pixbuf_get_pixels(new_pixbuf);
   new_rowstride = gdk_pixbuf_get_rowstride(new_pixbuf);
 
-  this->new_data = new char[this->new_map.width * this->new_map.height];
+  this->new_data = new int8_t[this->new_map.width * this->new_map.height];
   assert(new_data);
   // fill in the map from the scaled image
   for(j=0; j<this->new_map.height; j++)
@@ -43,7 +43,9 @@ MapTransform::MapTransform(ConfigFile* cf, int section)
     return;  	
   }
 	
-  this->source_data = this->new_data = NULL;
+  this->source = this->grid = NULL;
+  this->source_data = NULL;
+  this->new_data = NULL;
 }
 
 MapTransform::~MapTransform()
@@ -56,16 +58,26 @@ MapTransform::Setup()
   if(this->GetMap() < 0)
     return(-1);
   if(this->Transform() < 0)
+  {
+    delete [] this->new_data;
+    this->new_data = NULL;
+    this->source->Unref();
+    this->source = NULL;
     return(-1);
+  }
+
+  this->source->Unref();
+  this->source = NULL;
+  this->source_data = NULL;
 
-  delete [] source_data;
-  source_data = NULL;
+  this->Lock();
+  this->grid = new MapGrid(this->new_map, this->new_data);
+  this->Unlock();
 
   return(0);
 }
 
 // get the map from the underlying map device
-// TODO: should Unsubscribe from the map on error returns in the function
 int
 MapTransform::GetMap()
 {
@@ -83,103 +95,19 @@ MapTransform::GetMap()
     return -1;
   }
 
-  // first, get the map info
-  Message* msg;
-  if(!(msg = mapdev->Request(this->InQueue,
-                             PLAYER_MSGTYPE_REQ,
-                             PLAYER_MAP_REQ_GET_INFO,
-                             NULL, 0, NULL, false)))
-  {
-    PLAYER_ERROR("failed to get map info");
-    return(-1);
-  }
-
-  // copy in the map info
-  source_map = *(player_map_info_t*)msg->GetPayload();
-  
-  delete msg;
-
-  // allocate space for map cells
-  this->source_data = new char[this->source_map.width * this->source_map.height];
-  assert(this->source_data);
-
-  if(!(msg = mapdev->Request(this->InQueue,
-                             PLAYER_MSGTYPE_REQ,
-                             PLAYER_MAP_REQ_GET_INFO,
-                             NULL, 0, NULL, false)))
-  {
-    PLAYER_ERROR("failed to get map info");
-    return(-1);
-  }
-
-  // now, get the map data
-  player_map_data_t* data_req;
-  unsigned int i,j;
-  unsigned int oi,oj;
-  unsigned int sx,sy;
-  unsigned int si,sj;
-
-  data_req = (player_map_data_t*)malloc(sizeof(player_map_data_t));
-  assert(data_req);
-
-  // Tile size, limit to sensible default of about 640x640
-  sy = sx = 640;
-  oi=oj=0;
-  while((oi < this->source_map.width) && (oj < this->source_map.height))
-  {
-    si = MIN(sx, this->source_map.width - oi);
-    sj = MIN(sy, this->source_map.height - oj);
-
-    data_req->col = oi;
-    data_req->row = oj;
-    data_req->width = si;
-    data_req->height = sj;
-    data_req->data_count = 0;
-
-    if(!(msg = mapdev->Request(this->InQueue,
-                               PLAYER_MSGTYPE_REQ,
-                               PLAYER_MAP_REQ_GET_DATA,
-                               (void*)data_req,0,NULL,false)))
-    {
-      PLAYER_ERROR("failed to get map info");
-      free(data_req);
-      delete [] source_data;
-      source_data=NULL;
-      return(-1);
-    }
-
-    player_map_data_t* mapcells = (player_map_data_t*)msg->GetPayload();
-
-    // copy the map data
-    for(j=0;j<sj;j++)
-    {
-      for(i=0;i<si;i++)
-      {
-        source_data[MAP_IDX(source_map,oi+i,oj+j)] = 
-                mapcells->data[j*si + i];
-//        mapdata[MAP_IDX(source_map,oi+i,oj+j)].occ_dist = 0;
-      }
-    }
-
-    delete msg;
-
-    oi += si;
-    if(oi >= this->source_map.width)
-    {
-      oi = 0;
-      oj += sj;
-    }
-  }
-
-  free(data_req);
+  // Share the map if the map driver is in this server, else fetch it
+  this->source = MapGrid::Fetch(mapdev, this->InQueue);
 
   // we're done with the map device now
   if(mapdev->Unsubscribe(this->InQueue) != 0)
     PLAYER_WARN("unable to unsubscribe from map device");
 
+  if(!this->source)
+    return(-1);
+  this->source_map = this->source->info;
+  this->source_data = this->source->cells;
 
-  puts("Done.");
-  PLAYER_MSG3(4,"MapScale read a %d X %d map, at %.3f m/pix\n",
+  PLAYER_MSG3(4,"MapTransform read a %d X %d map, at %.3f m/pix\n",
          this->source_map.width, this->source_map.height, this->source_map.scale);
   return(0);
 }
@@ -187,11 +115,27 @@ MapTransform::GetMap()
 int
 MapTransform::Shutdown()
 {
-  delete [] this->new_data;
-  new_data = NULL;
+  // The grid and its cells live on in drivers we have shared it with
+  this->Lock();
+  this->grid->Unref();
+  this->grid = NULL;
+  this->new_data = NULL;
+  this->Unlock();
   return(0);
 }
 
+MapGrid*
+MapTransform::GetMapGrid(player_devaddr_t addr)
+{
+  MapGrid* ret = NULL;
+
+  this->Lock();
+  if(this->grid)
+    ret = this->grid->Ref();
+  this->Unlock();
+  return(ret);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Process an incoming message
 int MapTransform::ProcessMessage(QueuePointer &resp_queue, player_msghdr * hdr, void * data)
@@ -46,10 +46,13 @@ class MapTransform : public Driver
   protected:
     player_map_info_t source_map;
     player_devaddr_t source_map_addr;
-    char* source_data;
+    MapGrid* source;
+    const int8_t* source_data;
 
 	player_map_info_t new_map;
-    char* new_data;
+    int8_t* new_data;
+    // The transformed map, shared with other drivers
+    MapGrid* grid;
 
     // get the map from the underlying map device
     int GetMap();
@@ -67,6 +70,9 @@ class MapTransform : public Driver
                                      
     int Setup();
     int Shutdown();
+
+    // Share the transformed map
+    MapGrid* GetMapGrid(player_devaddr_t addr);
 };
 
 #endif
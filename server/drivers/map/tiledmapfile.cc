@@ -0,0 +1,318 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2004  Brian Gerkey gerkey@stanford.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * $Id$
+ *
+ * A driver to serve an occupancy grid map from a tiled map file.
+ */
+
+/** @ingroup drivers */
+/** @{ */
+/** @defgroup driver_tiledmapfile tiledmapfile
+ * @brief Serve large grid maps from tiled map files
+
+The tiledmapfile driver serves an occupancy grid map from a tiled map
+file, as written by the @ref util_playertiledmap utility from the same
+image and resolution that the @ref driver_mapfile driver takes.
+
+Unlike @ref driver_mapfile, nothing is decoded at startup: the file is
+mapped into memory and each PLAYER_MAP_REQ_GET_DATA request is answered
+by copying straight from the tiles it covers, so only the parts of the
+map that are asked for are ever read from disk, and all the drivers and
+processes on a machine that use the same file share its pages.
+
+The file also holds a pyramid of coarser copies of the map, each at half
+the resolution of the one before.  Each level can be provided as a map
+device of its own, so that a client that only needs a coarse map (say,
+for a global planner or for display) does not have to fetch the full
+one.
+
+@par Compile-time dependencies
+
+- none
+
+@par Provides
+
+- @ref interface_map : one for each level served.  The key "levelN"
+  selects level N (0 is full resolution); a map interface with no key
+  serves level 0.
+
+@par Requires
+
+- None
+
+@par Configuration requests
+
+- PLAYER_MAP_REQ_GET_INFO
+- PLAYER_MAP_REQ_GET_DATA
+
+@par Configuration file options
+
+- filename (string)
+  - Default: NULL
+  - The tiled map file to read.
+
+@par Example
+
+@verbatim
+driver
+(
+  name "tiledmapfile"
+  provides ["map:0" "level3:::map:1"]
+  filename "campus.tmap"
+)
+@endverbatim
+
+*/
+/** @} */
+
+#include <sys/types.h> // required by Darwin
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayercommon/tiledmap.h>
+
+class TiledMapFile : public Driver
+{
+  private:
+    const char* filename;
+    player_tiledmap_t* map;
+
+    // The map interfaces we provide, and the level each serves
+    int level_count;
+    player_devaddr_t level_addrs[PLAYER_TILEDMAP_MAX_LEVELS];
+    int levels[PLAYER_TILEDMAP_MAX_LEVELS];
+
+    // Handle map info request
+    void HandleGetMapInfo(QueuePointer & resp_queue, int level);
+    // Handle map data request
+    void HandleGetMapData(QueuePointer & resp_queue,
+                          player_map_data_t* mapreq, int level);
+
+  public:
+    TiledMapFile(ConfigFile* cf, int section);
+    ~TiledMapFile();
+    int Setup();
+    int Shutdown();
+
+    // MessageHandler
+    int ProcessMessage(QueuePointer & resp_queue,
+                       player_msghdr * hdr,
+                       void * data);
+};
+
+Driver*
+TiledMapFile_Init(ConfigFile* cf, int section)
+{
+  return((Driver*)(new TiledMapFile(cf, section)));
+}
+
+// a driver registration function
+void
+tiledmapfile_Register(DriverTable* table)
+{
+  table->AddDriver("tiledmapfile", TiledMapFile_Init);
+}
+
+
+// this one has no data or commands, just configs
+TiledMapFile::TiledMapFile(ConfigFile* cf, int section)
+  : Driver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN)
+{
+  char key[16];
+  player_devaddr_t addr;
+
+  this->map = NULL;
+  this->level_count = 0;
+
+  if(!(this->filename = cf->ReadFilename(section,"filename", NULL)))
+  {
+    PLAYER_ERROR("must specify map filename");
+    this->SetError(-1);
+    return;
+  }
+
+  for(int i = 0; i < PLAYER_TILEDMAP_MAX_LEVELS; i++)
+  {
+    snprintf(key, sizeof(key), "level%d", i);
+    if(cf->ReadDeviceAddr(&addr, section, "provides",
+                          PLAYER_MAP_CODE, -1, key) != 0)
+      continue;
+    this->level_addrs[this->level_count] = addr;
+    this->levels[this->level_count++] = i;
+  }
+
+  // A map with no key is the full resolution map
+  if(this->level_count == 0)
+  {
+    if(cf->ReadDeviceAddr(&addr, section, "provides",
+                          PLAYER_MAP_CODE, -1, NULL) != 0)
+    {
+      PLAYER_ERROR("must provide at least one map interface");
+      this->SetError(-1);
+      return;
+    }
+    this->level_addrs[this->level_count] = addr;
+    this->levels[this->level_count++] = 0;
+  }
+
+  for(int i = 0; i < this->level_count; i++)
+  {
+    if(this->AddInterface(this->level_addrs[i]) != 0)
+    {
+      this->SetError(-1);
+      return;
+    }
+  }
+}
+
+TiledMapFile::~TiledMapFile()
+{
+}
+
+int
+TiledMapFile::Setup()
+{
+  if(!(this->map = player_tiledmap_open(this->filename)))
+    return(-1);
+
+  for(int i = 0; i < this->level_count; i++)
+  {
+    if(this->levels[i] >= (int)this->map->level_count)
+    {
+      PLAYER_ERROR3("%s has %d levels; there is no level %d",
+                    this->filename, this->map->level_count, this->levels[i]);
+      player_tiledmap_close(this->map);
+      this->map = NULL;
+      return(-1);
+    }
+  }
+
+  printf("TiledMapFile mapped a %d X %d map, at %.3f m/pix, with %d levels\n",
+         this->map->levels[0].width, this->map->levels[0].height,
+         this->map->levels[0].scale, this->map->level_count);
+  return(0);
+}
+
+int
+TiledMapFile::Shutdown()
+{
+  player_tiledmap_close(this->map);
+  this->map = NULL;
+  return(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Process an incoming message
+int TiledMapFile::ProcessMessage(QueuePointer & resp_queue,
+                                 player_msghdr * hdr,
+                                 void * data)
+{
+  for(int i = 0; i < this->level_count; i++)
+  {
+    HANDLE_CAPABILITY_REQUEST (this->level_addrs[i], resp_queue, hdr, data, PLAYER_MSGTYPE_REQ, PLAYER_CAPABILITIES_REQ);
+    HANDLE_CAPABILITY_REQUEST (this->level_addrs[i], resp_queue, hdr, data, PLAYER_MSGTYPE_REQ, PLAYER_MAP_REQ_GET_INFO);
+    HANDLE_CAPABILITY_REQUEST (this->level_addrs[i], resp_queue, hdr, data, PLAYER_MSGTYPE_REQ, PLAYER_MAP_REQ_GET_DATA);
+
+    // Is it a request for map meta-data?
+    if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ, PLAYER_MAP_REQ_GET_INFO,
+                             this->level_addrs[i]))
+    {
+      this->HandleGetMapInfo(resp_queue, i);
+      return(0);
+    }
+    // Is it a request for a map tile?
+    else if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ,
+                                  PLAYER_MAP_REQ_GET_DATA,
+                                  this->level_addrs[i]))
+    {
+      this->HandleGetMapData(resp_queue, (player_map_data_t*)data, i);
+      return(0);
+    }
+  }
+  return(-1);
+}
+
+void
+TiledMapFile::HandleGetMapInfo(QueuePointer & resp_queue, int i)
+{
+  player_map_info_t info;
+  const player_tiledmap_level_t* level;
+
+  level = this->map->levels + this->levels[i];
+  info.scale = level->scale;
+  info.width = level->width;
+  info.height = level->height;
+  info.origin.px = this->map->origin[0];
+  info.origin.py = this->map->origin[1];
+  info.origin.pa = this->map->origin[2];
+
+  this->Publish(this->level_addrs[i], resp_queue,
+                PLAYER_MSGTYPE_RESP_ACK,
+                PLAYER_MAP_REQ_GET_INFO,
+                (void*)&info, sizeof(info), NULL);
+}
+
+void
+TiledMapFile::HandleGetMapData(QueuePointer & resp_queue,
+                               player_map_data_t* mapreq, int i)
+{
+  player_map_data_t mapresp;
+  const player_tiledmap_level_t* level;
+  uint32_t col, row, width, height;
+
+  // Clamp the request to the map
+  level = this->map->levels + this->levels[i];
+  col = mapreq->col < level->width ? mapreq->col : level->width;
+  row = mapreq->row < level->height ? mapreq->row : level->height;
+  width = mapreq->width < level->width - col ? mapreq->width : level->width - col;
+  height = mapreq->height < level->height - row ? mapreq->height : level->height - row;
+
+  // Refuse anything that would not fit in a reply
+  if(width > 0 && height > (PLAYER_MAX_PAYLOAD_SIZE - sizeof(mapresp)) / width)
+  {
+    PLAYER_WARN2("map data request for %ux%u cells is too big", width, height);
+    this->Publish(this->level_addrs[i], resp_queue,
+                  PLAYER_MSGTYPE_RESP_NACK,
+                  PLAYER_MAP_REQ_GET_DATA);
+    return;
+  }
+
+  // Construct reply
+  memset(&mapresp, 0, sizeof(mapresp));
+  mapresp.col = col;
+  mapresp.row = row;
+  mapresp.width = width;
+  mapresp.height = height;
+  mapresp.data_count = width * height;
+  mapresp.data = new int8_t [mapresp.data_count];
+  mapresp.data_range = 1;
+  player_tiledmap_read(this->map, this->levels[i],
+                       mapresp.col, mapresp.row,
+                       mapresp.width, mapresp.height, mapresp.data);
+
+  this->Publish(this->level_addrs[i], resp_queue,
+                PLAYER_MSGTYPE_RESP_ACK,
+                PLAYER_MAP_REQ_GET_DATA,
+                (void*)&mapresp);
+  delete [] mapresp.data;
+}
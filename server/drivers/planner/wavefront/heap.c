@@ -112,6 +112,13 @@ heap_extract_max(heap_t* h)
   return(max);
 }
 
+double
+heap_max_key(heap_t* h)
+{
+  assert(h->len > 0);
+  return(h->A[0]);
+}
+
 void
 heap_insert(heap_t* h, double key, void* data)
 {
@@ -52,6 +52,7 @@ heap_t* heap_alloc(int size, heap_free_elt_fn_t free_fn);
 void heap_free(heap_t* h);
 void heap_heapify(heap_t* h, int i);
 void* heap_extract_max(heap_t* h);
+double heap_max_key(heap_t* h);
 void heap_insert(heap_t* h, double key, void* data);
 void heap_dump(heap_t* h);
 int heap_valid(heap_t* h);
@@ -47,6 +47,7 @@
 
 #include <libplayercommon/playercommon.h>
 #include <libplayercommon/playercommon.h>
+#include <libplayercommon/edt.h>
 
 #include "plan.h"
 //#include "heap.h"
@@ -63,6 +64,7 @@
   #include <sys/time.h>
 #endif
 static double get_time(void);
+static void plan_mark_dirty(plan_t* plan, plan_cell_t* cell);
 
 #if 0
 void draw_cspace(plan_t* plan, const char* fname);
@@ -111,10 +113,13 @@ plan_set_obstacles(plan_t* plan, double* obs, size_t num)
 
   t0 = get_time();
 
-  // Start with static obstacle data
+  // Start with static obstacle data.  Cells that the last obstacles
+  // changed may change back.
   cell = plan->cells;
   for(j=0;j<plan->size_y*plan->size_x;j++,cell++)
   {
+    if(plan->dstar_valid && cell->occ_dist_dyn != cell->occ_dist)
+      plan_mark_dirty(plan, cell);
     cell->occ_state_dyn = cell->occ_state;
     cell->occ_dist_dyn = cell->occ_dist;
     cell->mark = 0;
@@ -138,6 +143,8 @@ plan_set_obstacles(plan_t* plan, double* obs, size_t num)
 
     cell->mark = 1;
     cell->occ_state_dyn = 1;
+    if(plan->dstar_valid && cell->occ_dist_dyn != 0.0)
+      plan_mark_dirty(plan, cell);
     cell->occ_dist_dyn = 0.0;
 
     p = plan->dist_kernel;
@@ -154,7 +161,11 @@ plan_set_obstacles(plan_t* plan, double* obs, size_t num)
           continue;
 
         if(*p < ncell->occ_dist_dyn)
+        {
+          if(plan->dstar_valid)
+            plan_mark_dirty(plan, ncell);
           ncell->occ_dist_dyn = *p;
+        }
       }
     }
   }
@@ -205,6 +216,7 @@ void plan_free(plan_t *plan)
     free(plan->cells);
   heap_free(plan->heap);
   free(plan->waypoints);
+  free(plan->dirty);
   if(plan->dist_kernel)
     free(plan->dist_kernel);
   free(plan);
@@ -283,6 +295,7 @@ void plan_init(plan_t *plan)
     }
   }
   plan->waypoint_count = 0;
+  plan->dstar_valid = 0;
 
   plan_compute_dist_kernel(plan);
 
@@ -307,6 +320,21 @@ void plan_reset(plan_t *plan)
     }
   }
   plan->waypoint_count = 0;
+  plan->dstar_valid = 0;
+}
+
+// Note a cell whose obstacle distance changed, for the next incremental plan
+static void
+plan_mark_dirty(plan_t* plan, plan_cell_t* cell)
+{
+  if(plan->dirty_count >= plan->dirty_size)
+  {
+    plan->dirty_size = plan->dirty_size ? 2 * plan->dirty_size : 1000;
+    plan->dirty = (plan_cell_t**)realloc(plan->dirty,
+                                         plan->dirty_size * sizeof(plan->dirty[0]));
+    assert(plan->dirty);
+  }
+  plan->dirty[plan->dirty_count++] = cell;
 }
 
 void
@@ -415,43 +443,62 @@ plan_set_bbox(plan_t* plan, double padding, double min_size,
   plan_set_bounds(plan, min_x, min_y, max_x, max_y);
 }
 
+// Compute the distance from each cell within the bounds to the nearest
+// occupied or unknown cell within the bounds, with an exact distance
+// transform.  The distances are those that the distance kernel would
+// give, in time linear in the number of cells.
 void
 plan_compute_cspace(plan_t* plan)
 {
-  int i, j;
-  int di, dj;
-  float* p;
-  plan_cell_t *cell, *ncell;
+  int i, j, w, h;
+  float d;
+  uint8_t* occ;
+  uint32_t* dist2;
+  plan_cell_t *cell;
 
   puts("Generating C-space....");
 
-  for (j = plan->min_y; j <= plan->max_y; j++)
+  plan->dstar_valid = 0;
+
+  w = plan->max_x - plan->min_x + 1;
+  h = plan->max_y - plan->min_y + 1;
+  if (w <= 0 || h <= 0)
+    return;
+
+  occ = (uint8_t*)malloc(sizeof(uint8_t) * w * h);
+  dist2 = (uint32_t*)malloc(sizeof(uint32_t) * w * h);
+  assert(occ && dist2);
+
+  for (j = 0; j < h; j++)
   {
-    cell = plan->cells + PLAN_INDEX(plan, 0, j);
-    for (i = plan->min_x; i <= plan->max_x; i++, cell++)
-    {
-      if (cell->occ_state < 0)
-        continue;
+    cell = plan->cells + PLAN_INDEX(plan, plan->min_x, plan->min_y + j);
+    for (i = 0; i < w; i++, cell++)
+      occ[i + j * w] = (cell->occ_state >= 0);
+  }
 
-      p = plan->dist_kernel;
-      for (dj = -plan->dist_kernel_width/2; 
-           dj <= plan->dist_kernel_width/2; 
-           dj++)
-      {
-        ncell = cell + -plan->dist_kernel_width/2 + dj*plan->size_x;
-        for (di = -plan->dist_kernel_width/2;
-             di <= plan->dist_kernel_width/2; 
-             di++, p++, ncell++)
-        {
-          if(!PLAN_VALID_BOUNDS(plan,i+di,j+dj))            
-            continue;
+  if (player_edt(occ, w, h, 0, dist2) != 0)
+  {
+    PLAYER_ERROR("unable to allocate the c-space distance transform");
+    free(occ);
+    free(dist2);
+    return;
+  }
 
-          if(*p < ncell->occ_dist)
-            ncell->occ_dist_dyn = ncell->occ_dist = *p;
-        }
-      }
+  for (j = 0; j < h; j++)
+  {
+    cell = plan->cells + PLAN_INDEX(plan, plan->min_x, plan->min_y + j);
+    for (i = 0; i < w; i++, cell++)
+    {
+      if (dist2[i + j * w] == PLAYER_EDT_NONE)
+        continue;
+      d = (float) (sqrt(dist2[i + j * w]) * plan->scale);
+      if (d < cell->occ_dist)
+        cell->occ_dist_dyn = cell->occ_dist = d;
     }
   }
+
+  free(occ);
+  free(dist2);
 }
 
 #if 0
@@ -57,6 +57,9 @@ typedef struct _plan_cell_t
   // Distance (cost) to the goal
   float plan_cost;
 
+  // One-step lookahead cost to the goal, for incremental planning
+  float plan_rhs;
+
   // Mark used in dynamic programming
   char mark;
   // Mark used in path hysterisis
@@ -118,6 +121,17 @@ typedef struct
   // Waypoints extracted from global path
   int waypoint_count, waypoint_size;
   plan_cell_t **waypoints;
+
+  // Incremental planning state; see plan_do_global_incremental().  The
+  // state is dropped by anything else that writes the plan costs.
+  int dstar_valid;
+  plan_cell_t *dstar_start, *dstar_goal;
+  double dstar_km;
+
+  // Cells whose obstacle distance may have changed since the last
+  // incremental plan
+  int dirty_count, dirty_size;
+  plan_cell_t **dirty;
 } plan_t;
 
 
@@ -162,6 +176,14 @@ int plan_do_global(plan_t *plan, double lx, double ly, double gx, double gy);
 
 int plan_do_local(plan_t *plan, double lx, double ly, double plan_halfwidth);
 
+// Plan over the whole grid with D* Lite, repairing the previous plan where
+// the goal is unchanged: only cells whose obstacle distance changed (see
+// plan_set_obstacles()) or that lie near the moved start are revisited.
+// The costs are those of plan_do_global(), less the local path hysteresis,
+// but exact; the search stops once the start is settled.
+int plan_do_global_incremental(plan_t *plan, double lx, double ly,
+                               double gx, double gy);
+
 // Generate a path to the goal
 void plan_update_waypoints(plan_t *plan, double px, double py);
 
@@ -50,6 +50,16 @@ plan_cell_t *plan_pop(plan_t *plan);
 int _plan_update_plan(plan_t *plan, double lx, double ly, double gx, double gy);
 int _plan_find_local_goal(plan_t *plan, double* gx, double* gy, double lx, double ly);
 
+// Incremental planning stuff
+static float _plan_step_cost(plan_t *plan, plan_cell_t *cell, float step);
+static double _plan_heuristic(plan_t *plan, plan_cell_t *a, plan_cell_t *b);
+static void _plan_dstar_push(plan_t *plan, plan_cell_t *cell);
+static void _plan_update_vertex(plan_t *plan, plan_cell_t *cell);
+static void _plan_lower_neighbours(plan_t *plan, plan_cell_t *cell);
+static void _plan_raise_neighbours(plan_t *plan, plan_cell_t *cell);
+static void _plan_dstar_init(plan_t *plan, plan_cell_t *start, plan_cell_t *goal);
+static int _plan_compute_shortest_path(plan_t *plan, int max_expansions);
+
 
 int
 plan_do_global(plan_t *plan, double lx, double ly, double gx, double gy)
@@ -167,6 +177,105 @@ plan_do_local(plan_t *plan, double lx, double ly, double plan_halfwidth)
 }
 
 
+int
+plan_do_global_incremental(plan_t *plan, double lx, double ly, double gx, double gy)
+{
+  int li, lj, gi, gj, i;
+  plan_cell_t *cell, *start, *goal, *old_start;
+
+  // Set bounds to look over the entire grid
+  plan_set_bounds(plan, 0, 0, plan->size_x - 1, plan->size_y - 1);
+
+  gi = PLAN_GXWX(plan, gx);
+  gj = PLAN_GYWY(plan, gy);
+  li = PLAN_GXWX(plan, lx);
+  lj = PLAN_GYWY(plan, ly);
+
+  if(!PLAN_VALID_BOUNDS(plan, gi, gj))
+  {
+    puts("goal out of bounds");
+    return(-1);
+  }
+
+  if(!PLAN_VALID_BOUNDS(plan, li, lj))
+  {
+    puts("start out of bounds");
+    return(-1);
+  }
+
+  start = plan->cells + PLAN_INDEX(plan, li, lj);
+  goal = plan->cells + PLAN_INDEX(plan, gi, gj);
+
+  if(!plan->dstar_valid || (goal != plan->dstar_goal))
+  {
+    // New goal, or someone else has been at the costs
+    _plan_dstar_init(plan, start, goal);
+  }
+  else
+  {
+    if(start != plan->dstar_start)
+    {
+      // Keys already in the queue are relative to the old start; rather
+      // than rekey them all, raise the keys of everything pushed from now
+      // on by the most the heuristic can have dropped.
+      old_start = plan->dstar_start;
+      plan->dstar_km += _plan_heuristic(plan, old_start, start);
+      plan->dstar_start = start;
+
+      // The old start loses its exemption from obstacles, and the new one
+      // gains it
+      _plan_update_vertex(plan, old_start);
+      _plan_update_vertex(plan, start);
+    }
+
+    // Step costs depend only on the cell stepped from, so a change in a
+    // cell's obstacle distance only changes its own lookahead cost
+    for(i=0;i<plan->dirty_count;i++)
+      _plan_update_vertex(plan, plan->dirty[i]);
+  }
+  plan->dirty_count = 0;
+
+  if(_plan_compute_shortest_path(plan, plan->size_x * plan->size_y / 10) < 0)
+  {
+    // The repair has spread over much of the map, as it does when the way
+    // to the goal is cut off and the costs creep up a step at a time; it
+    // is cheaper to start again
+    _plan_dstar_init(plan, start, goal);
+    _plan_compute_shortest_path(plan, -1);
+  }
+
+  plan->path_count = 0;
+  plan->waypoint_count = 0;
+  if(start->plan_cost >= PLAN_MAX_COST)
+  {
+    // no path
+    return(-1);
+  }
+
+  // Cache the path
+  for(cell = start; cell; cell = cell->plan_next)
+  {
+    if(plan->path_count >= plan->size_x * plan->size_y)
+    {
+      puts("incremental plan has a loop");
+      plan->dstar_valid = 0;
+      plan->path_count = 0;
+      return(-1);
+    }
+    if(plan->path_count >= plan->path_size)
+    {
+      plan->path_size *= 2;
+      plan->path = (plan_cell_t**)realloc(plan->path,
+                                          plan->path_size * sizeof(plan_cell_t*));
+      assert(plan->path);
+    }
+    plan->path[plan->path_count++] = cell;
+  }
+
+  return(0);
+}
+
+
 // Generate the plan
 int 
 _plan_update_plan(plan_t *plan, double lx, double ly, double gx, double gy)
@@ -362,6 +471,268 @@ _plan_find_local_goal(plan_t *plan, double* gx, double* gy,
   return(0);
 }
 
+// Cost of a step from the given cell to a neighbour, where step is the
+// length of the step; the same cost as _plan_update_plan() uses, except
+// that there is no local path hysteresis.  The robot is never blocked by
+// the cell it is in.
+static float
+_plan_step_cost(plan_t *plan, plan_cell_t *cell, float step)
+{
+  float occ_dist, cost;
+
+  if(cell == plan->dstar_start)
+    occ_dist = (float) plan->max_radius;
+  else
+    occ_dist = cell->occ_dist_dyn;
+
+  if(occ_dist < plan->abs_min_radius)
+    return((float) PLAN_MAX_COST);
+
+  cost = step;
+  if(occ_dist < plan->max_radius)
+    cost += (float) (plan->dist_penalty * (plan->max_radius - occ_dist));
+
+  return(cost);
+}
+
+// Lower bound on the cost between two cells: the octile distance
+static double
+_plan_heuristic(plan_t *plan, plan_cell_t *a, plan_cell_t *b)
+{
+  int di, dj;
+  double straight, diagonal;
+
+  di = abs(a->ci - b->ci);
+  dj = abs(a->cj - b->cj);
+
+  straight = plan->dist_kernel_3x3[1];
+  diagonal = plan->dist_kernel_3x3[0];
+  if(di < dj)
+    return(diagonal * di + straight * (dj - di));
+  else
+    return(diagonal * dj + straight * (di - dj));
+}
+
+// Queue an inconsistent cell.  The heap returns the max element, so the
+// key is negated; stale entries are left in the heap and skipped on pop.
+static void
+_plan_dstar_push(plan_t *plan, plan_cell_t *cell)
+{
+  double g;
+
+  g = cell->plan_cost < cell->plan_rhs ? cell->plan_cost : cell->plan_rhs;
+  heap_insert(plan->heap,
+              -(g + _plan_heuristic(plan, plan->dstar_start, cell) + plan->dstar_km),
+              cell);
+}
+
+// Recompute a cell's lookahead cost and next cell from its neighbours, and
+// queue it if it has become inconsistent
+static void
+_plan_update_vertex(plan_t *plan, plan_cell_t *cell)
+{
+  int oi, oj, di, dj, ni, nj;
+  float rhs, cost, *p;
+  plan_cell_t *ncell, *next;
+
+  if(cell != plan->dstar_goal)
+  {
+    oi = cell->ci;
+    oj = cell->cj;
+    rhs = (float) PLAN_MAX_COST;
+    next = NULL;
+
+    p = plan->dist_kernel_3x3;
+    for (dj = -1; dj <= +1; dj++)
+    {
+      for (di = -1; di <= +1; di++, p++)
+      {
+        if (!di && !dj)
+          continue;
+
+        ni = oi + di;
+        nj = oj + dj;
+
+        if (!PLAN_VALID_BOUNDS(plan, ni, nj))
+          continue;
+
+        ncell = plan->cells + PLAN_INDEX(plan, ni, nj);
+        if (ncell->plan_cost >= PLAN_MAX_COST)
+          continue;
+
+        cost = _plan_step_cost(plan, cell, *p);
+        if (cost >= PLAN_MAX_COST)
+          continue;
+        cost += ncell->plan_cost;
+        if (cost < rhs)
+        {
+          rhs = cost;
+          next = ncell;
+        }
+      }
+    }
+    cell->plan_rhs = rhs;
+    cell->plan_next = next;
+  }
+
+  if(cell->plan_rhs != cell->plan_cost)
+    _plan_dstar_push(plan, cell);
+}
+
+// A cell's cost has dropped: the cells that can step to it may now do
+// better by doing so
+static void
+_plan_lower_neighbours(plan_t *plan, plan_cell_t *cell)
+{
+  int di, dj, ni, nj;
+  float cost, *p;
+  plan_cell_t *ncell;
+
+  p = plan->dist_kernel_3x3;
+  for (dj = -1; dj <= +1; dj++)
+  {
+    for (di = -1; di <= +1; di++, p++)
+    {
+      if (!di && !dj)
+        continue;
+      ni = cell->ci + di;
+      nj = cell->cj + dj;
+      if (!PLAN_VALID_BOUNDS(plan, ni, nj))
+        continue;
+
+      ncell = plan->cells + PLAN_INDEX(plan, ni, nj);
+      if (ncell == plan->dstar_goal)
+        continue;
+
+      cost = _plan_step_cost(plan, ncell, *p);
+      if (cost >= PLAN_MAX_COST)
+        continue;
+      cost += cell->plan_cost;
+      if (cost < ncell->plan_rhs)
+      {
+        ncell->plan_rhs = cost;
+        ncell->plan_next = cell;
+        if (ncell->plan_rhs != ncell->plan_cost)
+          _plan_dstar_push(plan, ncell);
+      }
+    }
+  }
+}
+
+// A cell's cost has risen: the cells that were stepping to it must look
+// again
+static void
+_plan_raise_neighbours(plan_t *plan, plan_cell_t *cell)
+{
+  int di, dj, ni, nj;
+  plan_cell_t *ncell;
+
+  for (dj = -1; dj <= +1; dj++)
+  {
+    for (di = -1; di <= +1; di++)
+    {
+      if (!di && !dj)
+        continue;
+      ni = cell->ci + di;
+      nj = cell->cj + dj;
+      if (!PLAN_VALID_BOUNDS(plan, ni, nj))
+        continue;
+
+      ncell = plan->cells + PLAN_INDEX(plan, ni, nj);
+      if (ncell->plan_next == cell)
+        _plan_update_vertex(plan, ncell);
+    }
+  }
+}
+
+// Throw away the incremental state and start a search from scratch.
+// There is no local path to stick to.
+static void
+_plan_dstar_init(plan_t *plan, plan_cell_t *start, plan_cell_t *goal)
+{
+  int i;
+  plan_cell_t *cell;
+
+  cell = plan->cells;
+  for(i=0;i<plan->size_x*plan->size_y;i++,cell++)
+  {
+    cell->plan_cost = PLAN_MAX_COST;
+    cell->plan_rhs = PLAN_MAX_COST;
+    cell->plan_next = NULL;
+    cell->mark = 0;
+    cell->lpathmark = 0;
+  }
+  plan->lpath_count = 0;
+  heap_reset(plan->heap);
+
+  plan->dstar_start = start;
+  plan->dstar_goal = goal;
+  plan->dstar_km = 0;
+
+  goal->plan_rhs = 0;
+  _plan_dstar_push(plan, goal);
+  plan->dstar_valid = 1;
+}
+
+// Expand cells in key order until the start cell is consistent and no
+// queued cell could give it a lower cost.  Returns -1 if that takes more
+// than the given number of expansions (< 0 for no limit).
+static int
+_plan_compute_shortest_path(plan_t *plan, int max_expansions)
+{
+  int expansions;
+  double key, g;
+  plan_cell_t *cell, *start;
+
+  start = plan->dstar_start;
+  expansions = 0;
+
+  while(!heap_empty(plan->heap))
+  {
+    key = -heap_max_key(plan->heap);
+
+    // Where the heuristic is exact, as it is along an open straight run,
+    // the cells on the path tie with the start and must be settled as well;
+    // the slack also covers rounding in the float costs
+    g = start->plan_cost < start->plan_rhs ? start->plan_cost : start->plan_rhs;
+    if((start->plan_cost == start->plan_rhs) &&
+       (key > (g + plan->dstar_km) * (1 + 1e-6) + 1e-6))
+      break;
+
+    cell = (plan_cell_t*) heap_extract_max(plan->heap);
+
+    // Stale entry for a cell that has since been settled
+    if(cell->plan_cost == cell->plan_rhs)
+      continue;
+
+    // Entry keyed before the start last moved
+    g = cell->plan_cost < cell->plan_rhs ? cell->plan_cost : cell->plan_rhs;
+    if(key < g + _plan_heuristic(plan, start, cell) + plan->dstar_km)
+    {
+      _plan_dstar_push(plan, cell);
+      continue;
+    }
+
+    if((max_expansions >= 0) && (++expansions > max_expansions))
+      return(-1);
+
+    if(cell->plan_cost > cell->plan_rhs)
+    {
+      // Cost has dropped
+      cell->plan_cost = cell->plan_rhs;
+      _plan_lower_neighbours(plan, cell);
+    }
+    else
+    {
+      // Cost has risen: invalidate it and let the neighbours say what it is
+      cell->plan_cost = (float) PLAN_MAX_COST;
+      _plan_raise_neighbours(plan, cell);
+      _plan_update_vertex(plan, cell);
+    }
+  }
+  return(0);
+}
+
 // Push a plan location onto the queue
 void plan_push(plan_t *plan, plan_cell_t *cell)
 {
@@ -0,0 +1,239 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2003
+ *     Andrew Howard
+ *     Brian Gerkey
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/**************************************************************************
+ * Desc: Replanning benchmark.  Drives a robot across a synthetic office
+ *       map while people (rings of obstacle points) walk about, and at
+ *       each step times a full plan_do_global(), a D* Lite plan from
+ *       scratch and an incremental D* Lite repair.  Checks that the
+ *       repaired plan costs the same as the one from scratch.
+ * Usage: plan_bench [steps [size]]
+ *        The map is size x size cells at 5 cm.
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../plan.h"
+
+// People walking about, and the points that make up each
+#define BENCH_PEOPLE 8
+#define BENCH_PERSON_POINTS 16
+#define BENCH_PERSON_RADIUS 0.3
+
+// People are only seen within laser range of the robot, as in the driver
+#define BENCH_RANGE 6.0
+
+typedef struct
+{
+  double x, y, vx, vy;
+} person_t;
+
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// Build an office: outer walls, a grid of rooms with doorways, and some
+// pillars.  The robot is 0.25 m with a 0.25 m safety distance.
+static plan_t *make_plan(int size)
+{
+  plan_t *plan;
+  int i, j, n;
+
+  plan = plan_alloc(0.5, 0.5, 1.0, 1.0, 0.5);
+  plan->scale = 0.05;
+  plan->size_x = size;
+  plan->size_y = size;
+  plan->origin_x = 0.0;
+  plan->origin_y = 0.0;
+  plan->cells = (plan_cell_t*) calloc((size_t) size * size, sizeof(plan_cell_t));
+
+  for (j = 0; j < size; j++)
+  {
+    for (i = 0; i < size; i++)
+    {
+      n = 0;
+      n |= (i < 2 || j < 2 || i >= size - 2 || j >= size - 2);
+      // Walls every 5 m, with 2 m doorways off centre
+      n |= (i % 100 < 2 && j % 100 >= 20 && j % 100 < 60);
+      n |= (j % 100 < 2 && i % 100 >= 50);
+      // Pillars
+      n |= (i % 50 >= 24 && i % 50 < 28 && j % 50 >= 24 && j % 50 < 28);
+      plan->cells[PLAN_INDEX(plan, i, j)].occ_state = n ? +1 : -1;
+    }
+  }
+
+  plan_init(plan);
+  plan_compute_cspace(plan);
+  return plan;
+}
+
+
+// Move the people on, bouncing off the edges of the map, and write out
+// the outlines of those the robot can see.  Returns the number of points.
+static int move_people(person_t *people, double extent, double lx, double ly,
+                       double *obs)
+{
+  int i, k, n;
+  person_t *p;
+
+  n = 0;
+  for (i = 0; i < BENCH_PEOPLE; i++)
+  {
+    p = people + i;
+    p->x += p->vx;
+    p->y += p->vy;
+    if (p->x < 1.0 || p->x > extent - 1.0)
+      p->vx = -p->vx;
+    if (p->y < 1.0 || p->y > extent - 1.0)
+      p->vy = -p->vy;
+    if (hypot(p->x - lx, p->y - ly) > BENCH_RANGE)
+      continue;
+    for (k = 0; k < BENCH_PERSON_POINTS; k++, n++)
+    {
+      obs[2 * n + 0] = p->x + BENCH_PERSON_RADIUS * cos(2 * M_PI * k / BENCH_PERSON_POINTS);
+      obs[2 * n + 1] = p->y + BENCH_PERSON_RADIUS * sin(2 * M_PI * k / BENCH_PERSON_POINTS);
+    }
+  }
+  return n;
+}
+
+
+int main(int argc, char **argv)
+{
+  int i, k, n, steps, size, count, paths, mismatches;
+  double extent, lx, ly, gx, gy, start, t, tol;
+  double t_full, t_fresh, t_incr, max_full, max_fresh, max_incr;
+  double cost_full, cost_exact;
+  double obs[2 * BENCH_PEOPLE * BENCH_PERSON_POINTS];
+  person_t people[BENCH_PEOPLE];
+  plan_t *full, *fresh, *incr;
+  plan_cell_t *cell;
+
+  steps = argc > 1 ? atoi(argv[1]) : 200;
+  size = argc > 2 ? atoi(argv[2]) : 400;
+  extent = size * 0.05;
+
+  full = make_plan(size);
+  fresh = make_plan(size);
+  incr = make_plan(size);
+
+  srand(1);
+  for (i = 0; i < BENCH_PEOPLE; i++)
+  {
+    people[i].x = 2.0 + (extent - 4.0) * rand() / RAND_MAX;
+    people[i].y = 2.0 + (extent - 4.0) * rand() / RAND_MAX;
+    people[i].vx = 0.1 * (2.0 * rand() / RAND_MAX - 1.0);
+    people[i].vy = 0.1 * (2.0 * rand() / RAND_MAX - 1.0);
+  }
+
+  // Corner to corner, clear of the pillars
+  lx = ly = 2.5;
+  gx = gy = extent - 2.5;
+
+  printf("map %dx%d cells at %.2f m, %d people, %d steps\n",
+         size, size, full->scale, BENCH_PEOPLE, steps);
+
+  count = paths = mismatches = 0;
+  t_full = t_fresh = t_incr = 0;
+  max_full = max_fresh = max_incr = 0;
+  cost_full = cost_exact = 0;
+  for (i = 0; i < steps; i++)
+  {
+    n = move_people(people, extent, lx, ly, obs);
+    plan_set_obstacles(full, obs, n);
+    plan_set_obstacles(fresh, obs, n);
+    plan_set_obstacles(incr, obs, n);
+
+    start = now();
+    plan_do_global(full, lx, ly, gx, gy);
+    t = now() - start;
+    t_full += t;
+    max_full = t > max_full ? t : max_full;
+
+    start = now();
+    plan_reset(fresh);
+    plan_do_global_incremental(fresh, lx, ly, gx, gy);
+    t = now() - start;
+    t_fresh += t;
+    max_fresh = t > max_fresh ? t : max_fresh;
+
+    start = now();
+    plan_do_global_incremental(incr, lx, ly, gx, gy);
+    t = now() - start;
+    t_incr += t;
+    max_incr = t > max_incr ? t : max_incr;
+
+    // The repaired plan must be as good as the one from scratch
+    tol = fresh->path_count ? 1e-4 * fresh->path[0]->plan_cost : 0;
+    if ((incr->path_count == 0) != (fresh->path_count == 0) ||
+        (incr->path_count > 0 &&
+         fabs(incr->path[0]->plan_cost - fresh->path[0]->plan_cost) > tol))
+    {
+      printf("step %d: incremental cost %.4f, from scratch %.4f\n", i,
+             incr->path_count ? incr->path[0]->plan_cost : -1.0,
+             fresh->path_count ? fresh->path[0]->plan_cost : -1.0);
+      mismatches++;
+    }
+    if (full->path_count > 0 && fresh->path_count > 0)
+    {
+      paths++;
+      cost_full += full->path[0]->plan_cost;
+      cost_exact += fresh->path[0]->plan_cost;
+    }
+    count++;
+
+    // Follow the plan for a few cells
+    if (incr->path_count > 1)
+    {
+      k = incr->path_count > 3 ? 3 : incr->path_count - 1;
+      cell = incr->path[k];
+      lx = PLAN_WXGX(incr, cell->ci);
+      ly = PLAN_WYGY(incr, cell->cj);
+      if (cell == incr->path[incr->path_count - 1])
+        break;
+    }
+  }
+
+  printf("times in ms per plan      mean        max\n");
+  printf("plan_do_global      %10.3f %10.3f\n", t_full * 1e3 / count, max_full * 1e3);
+  printf("D* Lite, scratch    %10.3f %10.3f\n", t_fresh * 1e3 / count, max_fresh * 1e3);
+  printf("D* Lite, repair     %10.3f %10.3f\n", t_incr * 1e3 / count, max_incr * 1e3);
+  printf("%d steps, %d with a path, repair %.1fx faster than plan_do_global\n",
+         count, paths, t_full / t_incr);
+  printf("plan_do_global paths cost %.2f%% more than the shortest\n",
+         cost_exact > 0 ? 100.0 * (cost_full - cost_exact) / cost_exact : 0.0);
+  printf("%d mismatched costs\n", mismatches);
+
+  plan_free(full);
+  plan_free(fresh);
+  plan_free(incr);
+  return mismatches ? 1 : 0;
+}
@@ -153,6 +153,13 @@ thinks it has already achieved it.
 - update_rate (integer)
   - Default: 10
   - How many times a second the driver should attempt to run its main loop
+- incremental (integer)
+  - Default: 0
+  - If non-zero, replan over the whole map each time with an incremental
+    (D* Lite) planner instead of planning in a local window around the
+    robot.  Only the cells affected by new obstacles or by the robot's
+    motion are revisited, so replanning is usually as fast as a local
+    plan, and the path stays globally shortest.
 
 @par Example
 
@@ -312,6 +319,8 @@ class Wavefront : public ThreadedDriver
     int force_map_refresh;
     // Should we do velocity control, or position control?
     bool velocity_control;
+    // Do we repair the global plan incrementally instead of local planning?
+    bool incremental;
     // How many laser scans should we buffer?
     int scans_size;
     // How far out do we insert obstacles?
@@ -462,6 +471,7 @@ Wavefront::Wavefront( ConfigFile* cf, int section)
           cf->ReadInt(section, "add_rotational_waypoints", 1);
   this->force_map_refresh = cf->ReadInt(section, "force_map_refresh", 0);
   this->cycletime = 1.0 / cf->ReadFloat(section, "update_rate", 10.0);
+  this->incremental = cf->ReadInt(section, "incremental", 0);
 
   this->velocity_control = cf->ReadInt(section, "velocity_control", 0);
   if(this->velocity_control)
@@ -1092,8 +1102,27 @@ void Wavefront::Main()
 
       t0 = get_time();
 
+      if(this->incremental)
+      {
+        // Repair the global plan around whatever has changed
+        if(plan_do_global_incremental(this->plan, this->localize_x,
+                                      this->localize_y, this->target_x,
+                                      this->target_y) < 0)
+        {
+          if(!printed_warning)
+          {
+            puts("Wavefront: global plan failed");
+            printed_warning = true;
+          }
+        }
+        else
+        {
+          this->new_goal = false;
+          printed_warning = false;
+        }
+      }
       // compute costs to the new goal.  Try local plan first
-      if(new_goal ||
+      else if(new_goal ||
          (this->plan->path_count == 0) ||
          (plan_do_local(this->plan, this->localize_x,
                          this->localize_y, this->scan_maxrange) < 0))
@@ -1561,11 +1590,28 @@ Wavefront::SetupLocalize()
   return(0);
 }
 
-// Retrieve the map data in tiles, assuming that the map info is already
-// stored in this->plan.
+// Retrieve the map data, shared by the map driver if it is in this server,
+// else in tiles.
 int
 Wavefront::GetMap(bool threaded)
 {
+  MapGrid* grid;
+  plan_cell_t* cell;
+  int i;
+
+  if(!(grid = MapGrid::Fetch(this->mapdevice, this->InQueue, threaded)))
+  {
+    PLAYER_ERROR("failed to get map data");
+    return(-1);
+  }
+
+  // The map may have changed since we got its info
+  this->plan->scale = grid->info.scale;
+  this->plan->size_x = grid->info.width;
+  this->plan->size_y = grid->info.height;
+  this->plan->origin_x = grid->info.origin.px;
+  this->plan->origin_y = grid->info.origin.py;
+
   // allocate space for map cells
   this->plan->cells = (plan_cell_t*)realloc(this->plan->cells,
                                             (this->plan->size_x *
@@ -1576,65 +1622,17 @@ Wavefront::GetMap(bool threaded)
   // Reset the grid
   plan_reset(this->plan);
 
-  // now, get the map data
-  player_map_data_t data_req;
-  memset(&data_req,0,sizeof(player_map_data_t));
-  int i,j;
-  int oi,oj;
-  int sx,sy;
-  int si,sj;
-
-  // Grab 640x640 tiles
-  sy = sx = 640;
-  oi=oj=0;
-  while((oi < this->plan->size_x) && (oj < this->plan->size_y))
+  // copy the map data
+  for(i = 0; i < this->plan->size_x * this->plan->size_y; i++)
   {
-    si = MIN(sx, this->plan->size_x - oi);
-    sj = MIN(sy, this->plan->size_y - oj);
-
-    data_req.col = oi;
-    data_req.row = oj;
-    data_req.width = si;
-    data_req.height = sj;
-
-    Message* msg;
-    if(!(msg = this->mapdevice->Request(this->InQueue,
-                                        PLAYER_MSGTYPE_REQ,
-                                        PLAYER_MAP_REQ_GET_DATA,
-                                        (void*)&data_req,0,NULL,
-                                        threaded)))
-    {
-      PLAYER_ERROR("failed to get map data");
-      // dont free plan->cells this here as it is realloced above and free'd on shutdown
-      //free(this->plan->cells);
-      return(-1);
-    }
-
-    player_map_data_t* mapdata = (player_map_data_t*)msg->GetPayload();
-    plan_cell_t* cell;
-
-    // copy the map data
-    for(j=0;j<sj;j++)
-    {
-      for(i=0;i<si;i++)
-      {
-        cell = this->plan->cells + PLAN_INDEX(this->plan,oi+i,oj+j);
-        cell->occ_dist = this->plan->max_radius;
-        if((cell->occ_state = mapdata->data[j*si + i]) >= 0)
-          cell->occ_dist = 0;
-      }
-    }
-
-    delete msg;
-
-    oi += si;
-    if(oi >= this->plan->size_x)
-    {
-      oi = 0;
-      oj += sj;
-    }
+    cell = this->plan->cells + i;
+    cell->occ_dist = this->plan->max_radius;
+    if((cell->occ_state = grid->cells[i]) >= 0)
+      cell->occ_dist = 0;
   }
 
+  grid->Unref();
+
   plan_init(this->plan);
   plan_compute_cspace(this->plan);
   //draw_cspace(this->plan,"cspace.png");
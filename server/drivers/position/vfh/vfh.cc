@@ -1233,6 +1233,9 @@ VFH_Class::VFH_Class( ConfigFile* cf, int section)
 
   // read the synchronous flag from the cfg file: defaults to not synchronous
   this->synchronous_mode = cf->ReadInt(section, "synchronous", 0 ) != 0 ? true : false;
+  // in synchronous mode the server loop has to run us, and keep doing so
+  this->alwaysupdate = this->synchronous_mode;
+  this->InQueue->SetWakeWatcher(this->synchronous_mode ? fileWatcher : NULL);
 
   cell_size = cf->ReadLength(section, "cell_size", 0.1) * 1e3;
   window_diameter = cf->ReadInt(section, "window_diameter", 61);
@@ -56,8 +56,14 @@ PLAYER_RANGER_DATA_RANGESTAMPED) are published via this interface
     most recent pose to each scan (0).
 - max_scans (integer)
   - Default: 100
-  - Maximum number of scans to buffer while waiting for a second pose in order
-    to interpolate.
+  - Maximum number of scans to buffer while waiting for a pose later than the
+    scan in order to interpolate.  A scan that arrives after the poses either
+    side of it is stamped and published at once, without being buffered.
+- pose_history (integer)
+  - Default: 256
+  - Number of poses to keep for interpolating.  The history of poses is
+    shared with the other drivers in the server that stamp data with poses
+    from the same position device.
 - update_thresh ([length angle] tuple)
   - Default: [-1.0 -1.0]
   - Minimum change in pose (translation or rotation) required before
@@ -105,6 +111,7 @@ driver
 #include <math.h>
 #include <float.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <libplayercore/playercore.h>
@@ -115,6 +122,7 @@ driver
 #endif
 
 #define DEFAULT_MAXSCANS 100
+#define DEFAULT_POSEHISTORY 256
 
 // computes the signed minimum difference between the two angles.
 static double
@@ -151,6 +159,13 @@ class RangerPoseInterp : public Driver
 		       void * data);
   private:
 
+    // Publish a scan with its pose, if it passes the thresholds
+    void PublishScan(player_ranger_data_range_t* scan, double time,
+                     const player_pose2d_t & pose);
+
+    // Publish the buffered scans that now have poses either side of them
+    void FlushScans();
+
     // device bookkeeping
     player_devaddr_t ranger_addr;
     player_devaddr_t position_addr;
@@ -163,8 +178,10 @@ class RangerPoseInterp : public Driver
     int numscans;
     player_ranger_data_range_t* scans;
     double* scantimes;
-    player_position2d_data_t lastpose;
-    double lastposetime;
+    player_copy_fn_t copyfunc;
+    player_cleanup_fn_t cleanupfunc;
+    int posehistorysize;
+    PoseHistory* posehistory;
     player_pose3d_t lastpublishpose;
     double lastpublishposetime;
     double update_thresh[2];
@@ -208,6 +225,10 @@ RangerPoseInterp::RangerPoseInterp(ConfigFile* cf, int section)
 
   this->interpolate = cf->ReadInt(section, "interpolate", 1) != 0 ? true : false;
   this->maxnumscans = cf->ReadInt(section, "max_scans", DEFAULT_MAXSCANS);
+  this->posehistorysize = cf->ReadInt(section, "pose_history",
+                                      DEFAULT_POSEHISTORY);
+  this->posehistory = NULL;
+  this->numscans = 0;
   this->update_thresh[0] = cf->ReadTupleLength(section, "update_thresh",
                                                0, -1.0);
   this->update_thresh[1] = cf->ReadTupleAngle(section, "update_thresh",
@@ -221,14 +242,25 @@ RangerPoseInterp::RangerPoseInterp(ConfigFile* cf, int section)
   this->scantimes = (double*)calloc(this->maxnumscans, sizeof(double));
   assert(this->scantimes);
 
+  // Buffered scans are deep copies
+  this->copyfunc = playerxdr_get_copyfunc(PLAYER_RANGER_CODE,
+                                          PLAYER_MSGTYPE_DATA,
+                                          PLAYER_RANGER_DATA_RANGE);
+  this->cleanupfunc = playerxdr_get_cleanupfunc(PLAYER_RANGER_CODE,
+                                                PLAYER_MSGTYPE_DATA,
+                                                PLAYER_RANGER_DATA_RANGE);
+  if(!this->copyfunc || !this->cleanupfunc)
+  {
+    PLAYER_ERROR("Couldn't find functions to copy ranger data");
+    this->SetError(-1);
+    return;
+  }
+
   return;
 }
 
 RangerPoseInterp::~RangerPoseInterp()
 {
-  for (int i=0; i< maxnumscans; i++)
-    if (this->scans[i].ranges != NULL)
-      delete [] this->scans[i].ranges;
   free(this->scans);
   free(this->scantimes);
 }
@@ -266,8 +298,9 @@ int RangerPoseInterp::Setup()
     return(-1);
   }
 
+  this->posehistory = PoseHistory::Get(this->position_addr,
+                                       this->posehistorysize);
   this->numscans = 0;
-  this->lastposetime = -1;
   this->lastpublishposetime = -1;
 
   return(0);
@@ -281,10 +314,98 @@ int RangerPoseInterp::Shutdown()
 
   this->ranger_device->Unsubscribe(this->InQueue);
   this->position_device->Unsubscribe(this->InQueue);
+
+  for(int i=0;i<this->numscans;i++)
+    (*this->cleanupfunc)(&this->scans[i]);
+  this->numscans = 0;
+  if(this->posehistory)
+    this->posehistory->Unref();
+  this->posehistory = NULL;
   return(0);
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Publish a scan with its pose, if it passes the thresholds
+void
+RangerPoseInterp::PublishScan(player_ranger_data_range_t* scan, double time,
+                              const player_pose2d_t & pose)
+{
+  player_ranger_data_rangestamped_t scanpose;
+
+  memset(&scanpose, 0, sizeof(scanpose));
+  scanpose.geom.pose.px = pose.px;
+  scanpose.geom.pose.py = pose.py;
+  scanpose.geom.pose.pyaw = pose.pa;
+  scanpose.have_config = false;
+  scanpose.have_geom = true;
+  scanpose.geom.element_poses_count = 1;
+  scanpose.geom.element_poses = &(scanpose.geom.pose);
+  scanpose.geom.element_sizes_count = 0;
+
+  scanpose.data.ranges_count = scan->ranges_count;
+  scanpose.data.ranges = scan->ranges;
+
+  // Should we publish this scan?  Take account of all the various
+  // thresholds that the user can set.
+  if((this->send_all_scans) ||
+     (this->lastpublishposetime < 0.0) ||
+     ((this->update_thresh[0] >= 0.0) &&
+      (hypot(scanpose.geom.pose.px-this->lastpublishpose.px,
+             scanpose.geom.pose.py-this->lastpublishpose.py) >=
+       this->update_thresh[0])) ||
+     ((this->update_thresh[1] >= 0.0) &&
+      (fabs(angle_diff(scanpose.geom.pose.pyaw,this->lastpublishpose.pyaw)) >=
+       this->update_thresh[1])) ||
+     ((this->update_interval >= 0.0) &&
+      ((time - this->lastpublishposetime) >=
+       this->update_interval)))
+  {
+    this->Publish(this->device_addr,
+                  PLAYER_MSGTYPE_DATA, PLAYER_RANGER_DATA_RANGESTAMPED,
+                  (void*)&scanpose, sizeof(scanpose), &time);
+
+    this->lastpublishposetime = time;
+    this->lastpublishpose = scanpose.geom.pose;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Publish the buffered scans that now have poses either side of them
+void
+RangerPoseInterp::FlushScans()
+{
+  player_pose2d_t pose;
+  int i, result;
+
+  for(i=0;i<this->numscans;i++)
+  {
+    // A scan from before the oldest pose is stamped, as it always was,
+    // by extending the line through the two poses after it
+    result = this->posehistory->Lookup(this->scantimes[i], &pose);
+    if((result == POSEHISTORY_EARLIER) &&
+       (this->posehistory->Extrapolate(this->scantimes[i], &pose) !=
+        POSEHISTORY_OK))
+      break;
+    if((result == POSEHISTORY_LATER) || (result == POSEHISTORY_EMPTY))
+      break;
+    this->PublishScan(&this->scans[i], this->scantimes[i], pose);
+    (*this->cleanupfunc)(&this->scans[i]);
+  }
+
+  // Keep the rest, in order
+  if(i > 0 && i < this->numscans)
+  {
+    memmove(this->scans, this->scans + i,
+            (this->numscans - i) * sizeof(this->scans[0]));
+    memmove(this->scantimes, this->scantimes + i,
+            (this->numscans - i) * sizeof(this->scantimes[0]));
+  }
+  this->numscans -= i;
+}
+
+
 int
 RangerPoseInterp::ProcessMessage(QueuePointer & resp_queue,
                                 player_msghdr * hdr,
@@ -295,20 +416,24 @@ RangerPoseInterp::ProcessMessage(QueuePointer & resp_queue,
                            PLAYER_RANGER_DATA_RANGE,
                            this->ranger_addr))
   {
+    player_pose2d_t pose;
+    double posetime;
+    int result;
+
     // are we interpolating?
     if(!this->interpolate)
     {
       // make sure we've gotten at least one pose
-      if(this->lastposetime < 0)
+      if(this->posehistory->Latest(&posetime, &pose) != POSEHISTORY_OK)
         return(0);
 
       // Tag this scan with the last received pose and push it out
       player_ranger_data_rangestamped_t scanpose;
       scanpose.have_config = false;
       scanpose.have_geom = true;
-      scanpose.geom.pose.px = this->lastpose.pos.px;
-      scanpose.geom.pose.py = this->lastpose.pos.py;
-      scanpose.geom.pose.pyaw = this->lastpose.pos.pa;
+      scanpose.geom.pose.px = pose.px;
+      scanpose.geom.pose.py = pose.py;
+      scanpose.geom.pose.pyaw = pose.pa;
       scanpose.geom.element_poses_count = 0;
       scanpose.geom.element_sizes_count = 0;
       scanpose.data.ranges_count = ((player_ranger_data_range_t*)data)->ranges_count;
@@ -319,110 +444,45 @@ RangerPoseInterp::ProcessMessage(QueuePointer & resp_queue,
 		    (void*)&scanpose, sizeof(scanpose), &hdr->timestamp);
       return(0);
     }
+
+    // If we already have a pose after the scan, and no earlier scans are
+    // waiting, stamp it and push it out now
+    if(this->numscans == 0)
+      result = this->posehistory->Lookup(hdr->timestamp, &pose);
     else
+      result = POSEHISTORY_LATER;
+    if(result == POSEHISTORY_OK)
     {
-      // Buffer the scan to be pushed out later.
+      this->PublishScan((player_ranger_data_range_t*)data, hdr->timestamp,
+                        pose);
+      return(0);
+    }
 
-      // is there room?
-      if(this->numscans >= this->maxnumscans)
-      {
-        PLAYER_WARN1("exceeded maximum number of scans to buffer (%d)",
-                     this->maxnumscans);
-        return(0);
-      }
-      // store the scan and timestamp, make sure we deep copy the data
-	  player_copy_fn_t copyfunc;
-      if (!(copyfunc = playerxdr_get_copyfunc (PLAYER_RANGER_CODE, PLAYER_MSGTYPE_DATA, PLAYER_RANGER_DATA_RANGE)))
-      {
-        PLAYER_ERROR ("Couldn't fund copy function to copy ranger data");
-        return(-1);
-      }
-      if (this->scans[numscans].ranges != NULL) {
-	delete [] this->scans[numscans].ranges;
-	this->scans[numscans].ranges = NULL;
-      }
-      
-      this->scans[numscans].ranges = new double [ ((player_ranger_data_range_t*)data)->ranges_count ];
-
-      (*copyfunc) (&this->scans[this->numscans],data);
-      //this->scans[this->numscans] = *((player_ranger_data_t*)data);
-      this->scantimes[this->numscans] = hdr->timestamp;
-      this->numscans++;
+    // Otherwise buffer the scan to be pushed out later.
+
+    // is there room?
+    if(this->numscans >= this->maxnumscans)
+    {
+      PLAYER_WARN1("exceeded maximum number of scans to buffer (%d)",
+                   this->maxnumscans);
       return(0);
     }
+    // store the scan and timestamp, make sure we deep copy the data
+    (*this->copyfunc)(&this->scans[this->numscans], data);
+    this->scantimes[this->numscans] = hdr->timestamp;
+    this->numscans++;
+    return(0);
   }
   // Is it a new pose?
   else if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_DATA,
                                 PLAYER_POSITION2D_DATA_STATE,
                                 this->position_addr))
   {
-    player_position2d_data_t newpose = *((player_position2d_data_t*)data);
-    // Is it the first pose?
-    if(this->lastposetime < 0)
-    {
-      // Just store it.
-      this->lastpose = newpose;
-      this->lastposetime = hdr->timestamp;
-    }
-    else
-    {
-      // are we interpolating?
-      if(this->interpolate)
-      {
-        // Interpolate pose for all buffered scans and send them out
-        double t1 = hdr->timestamp - this->lastposetime;
-        for(int i=0;i<this->numscans;i++)
-        {
-          double t0 = this->scantimes[i] - this->lastposetime;
-          player_ranger_data_rangestamped_t scanpose;
-
-          scanpose.geom.pose.px = this->lastpose.pos.px + t0 *
-                  (newpose.pos.px - this->lastpose.pos.px) / t1;
-          scanpose.geom.pose.py = this->lastpose.pos.py + t0 *
-                  (newpose.pos.py - this->lastpose.pos.py) / t1;
-          scanpose.geom.pose.pyaw = NORMALIZE(this->lastpose.pos.pa + t0 *
-					      angle_diff(newpose.pos.pa,
-							 this->lastpose.pos.pa) / t1);
-	  scanpose.have_config = false;
-	  scanpose.have_geom = true;
-	  scanpose.geom.element_poses_count = 1;
-	  scanpose.geom.element_poses = &(scanpose.geom.pose);
-	  scanpose.geom.element_sizes_count = 0;
-	  
-	  scanpose.data.ranges_count = this->scans[i].ranges_count;
-	  scanpose.data.ranges = this->scans[i].ranges;
-
-	  //          scanpose.data = this->scans[i];
-
-          // Should we publish this scan?  Take account of all the various
-          // thresholds that the user can set.
-          if((this->send_all_scans) ||
-             (this->lastpublishposetime < 0.0) ||
-             ((this->update_thresh[0] >= 0.0) &&
-              (hypot(scanpose.geom.pose.px-this->lastpublishpose.px,
-                     scanpose.geom.pose.py-this->lastpublishpose.py) >=
-               this->update_thresh[0])) ||
-             ((this->update_thresh[1] >= 0.0) &&
-              (fabs(angle_diff(scanpose.geom.pose.pyaw,this->lastpublishpose.pyaw)) >=
-               this->update_thresh[1])) ||
-             ((this->update_interval >= 0.0) &&
-              ((this->scantimes[i] - this->lastpublishposetime) >=
-               this->update_interval)))
-          {
-	    this->Publish(this->device_addr,
-			  PLAYER_MSGTYPE_DATA, PLAYER_RANGER_DATA_RANGESTAMPED,
-			  (void*)&scanpose, sizeof(scanpose),
-			  this->scantimes + i);
-	    
-            this->lastpublishposetime = this->scantimes[i];
-            this->lastpublishpose = scanpose.geom.pose;
-          }
-        }
-        this->numscans = 0;
-      }
-      this->lastpose = newpose;
-      this->lastposetime = hdr->timestamp;
-    }
+    player_position2d_data_t* newpose = (player_position2d_data_t*)data;
+
+    this->posehistory->Push(hdr->timestamp, newpose->pos);
+    if(this->interpolate)
+      this->FlushScans();
     return(0);
   }
   // Forward any request to the ranger
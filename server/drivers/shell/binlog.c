@@ -0,0 +1,694 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Binary log files, for the writelog and readlog drivers.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+// Logs can be bigger than 2GB
+#define _FILE_OFFSET_BITS 64
+
+#include <config.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#if HAVE_Z
+  #include <zlib.h>
+#endif
+
+#include <libplayercommon/error.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayerinterface/playerxdr.h>
+
+#include "binlog.h"
+#include "logstore.h"
+
+#define BINLOG_VERSION 1
+
+#define BINLOG_BLOCK_HEADER 32
+#define BINLOG_INDEX_ENTRY 16
+
+// Largest message, header and body
+#define BINLOG_MAX_RECORD (PLAYERXDR_MSGHDR_SIZE + PLAYER_MAX_MESSAGE_SIZE)
+
+// Where each block starts, and when
+typedef struct
+{
+  double time;
+  uint64_t offset;
+} binlog_entry_t;
+
+struct binlog
+{
+  FILE *file;
+  int writing;
+  int flags;
+
+  // The block being filled or read: raw messages, and their compressed
+  // form
+  uint8_t *buf;
+  size_t buf_size, len;
+  uint8_t *zbuf;
+  size_t zbuf_size;
+
+  // Messages in the block being filled, and their times
+  int count;
+  double first_time, last_time;
+
+  // Block index
+  binlog_entry_t *index;
+  uint32_t index_count, index_size;
+
+  // Reading: the next block to load, where we are in the block loaded,
+  // and the time of the first message wanted after a seek
+  uint32_t next_block;
+  size_t pos;
+  double skip_before;
+
+  // Reading: the last decoded body, which is cleaned up on the next read
+  void *msg;
+  int have_msg;
+  player_msghdr_t msg_hdr;
+};
+
+
+// Make room for size bytes in a buffer
+static int binlog_reserve(uint8_t **buf, size_t *buf_size, size_t size)
+{
+  uint8_t *tmp;
+
+  if (size <= *buf_size)
+    return 0;
+  if (!(tmp = (uint8_t*) realloc(*buf, size)))
+  {
+    PLAYER_ERROR1("out of memory for a %lu byte log block",
+                  (unsigned long) size);
+    return -1;
+  }
+  *buf = tmp;
+  *buf_size = size;
+  return 0;
+}
+
+
+// Add a block to the index
+static int binlog_add_entry(binlog_t *log, double time, uint64_t offset)
+{
+  if (logstore_reserve((void**) &log->index, &log->index_size,
+                       log->index_count, sizeof(binlog_entry_t)) != 0)
+    return -1;
+  log->index[log->index_count].time = time;
+  log->index[log->index_count].offset = offset;
+  log->index_count++;
+  return 0;
+}
+
+
+static binlog_t *binlog_alloc(FILE *file, int writing)
+{
+  binlog_t *log;
+
+  if (!(log = (binlog_t*) calloc(1, sizeof(binlog_t))))
+    return NULL;
+  log->file = file;
+  log->writing = writing;
+  log->skip_before = -HUGE_VAL;
+  return log;
+}
+
+
+static void binlog_free(binlog_t *log)
+{
+  if (log->have_msg)
+    playerxdr_cleanup_message(log->msg, log->msg_hdr.addr.interf,
+                              log->msg_hdr.type, log->msg_hdr.subtype);
+  free(log->msg);
+  free(log->buf);
+  free(log->zbuf);
+  free(log->index);
+  free(log);
+  return;
+}
+
+
+int binlog_match_filename(const char *filename)
+{
+  size_t n, m;
+
+  n = strlen(filename);
+  m = strlen(BINLOG_EXTENSION);
+  return n >= m && strcmp(filename + n - m, BINLOG_EXTENSION) == 0;
+}
+
+
+binlog_t *binlog_create(const char *filename, int flags)
+{
+  FILE *file;
+
+  if (!(file = fopen(filename, "wb")))
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return NULL;
+  }
+  return binlog_create_stream(file, flags);
+}
+
+
+binlog_t *binlog_create_stream(FILE *file, int flags)
+{
+  binlog_t *log;
+
+#if !HAVE_Z
+  if (flags & BINLOG_COMPRESS)
+  {
+    PLAYER_WARN("no zlib support; writing an uncompressed log");
+    flags &= ~BINLOG_COMPRESS;
+  }
+#endif
+
+  if (!(log = binlog_alloc(file, 1)))
+  {
+    fclose(file);
+    return NULL;
+  }
+  log->flags = flags;
+
+  if (logstore_write_header(file, "PLBL", BINLOG_VERSION,
+                            (uint32_t) flags) != 0 ||
+      binlog_reserve(&log->buf, &log->buf_size, BINLOG_BLOCK_SIZE) != 0)
+  {
+    PLAYER_ERROR("unable to write log header");
+    fclose(file);
+    binlog_free(log);
+    return NULL;
+  }
+  return log;
+}
+
+
+int binlog_flush(binlog_t *log)
+{
+  uint8_t head[BINLOG_BLOCK_HEADER];
+  const uint8_t *data;
+  size_t size;
+  logstore_off_t offset;
+
+  if (!log->writing || log->count == 0)
+    return 0;
+
+  data = log->buf;
+  size = log->len;
+#if HAVE_Z
+  if (log->flags & BINLOG_COMPRESS)
+  {
+    uLongf zlen;
+
+    zlen = compressBound(log->len);
+    if (binlog_reserve(&log->zbuf, &log->zbuf_size, zlen) != 0)
+      return -1;
+    if (compress2(log->zbuf, &zlen, log->buf, log->len, Z_BEST_SPEED) != Z_OK)
+    {
+      PLAYER_ERROR("failed to compress log block");
+      return -1;
+    }
+    data = log->zbuf;
+    size = zlen;
+  }
+#endif
+
+  memcpy(head, "PLBK", 4);
+  logstore_put_u32(head + 4, (uint32_t) size);
+  logstore_put_u32(head + 8, (uint32_t) log->len);
+  logstore_put_u32(head + 12, (uint32_t) log->count);
+  logstore_put_double(head + 16, log->first_time);
+  logstore_put_double(head + 24, log->last_time);
+
+  // Push each block out to the disk as it is finished, so that a crash
+  // loses only the one being filled
+  offset = logstore_ftell(log->file);
+  if (offset < 0 ||
+      fwrite(head, sizeof(head), 1, log->file) != 1 ||
+      fwrite(data, size, 1, log->file) != 1 ||
+      fflush(log->file) != 0)
+  {
+    PLAYER_ERROR1("failed to write log block: %s", strerror(errno));
+    return -1;
+  }
+  if (binlog_add_entry(log, log->first_time, (uint64_t) offset) != 0)
+    return -1;
+
+  log->len = 0;
+  log->count = 0;
+  return 0;
+}
+
+
+// Encode a message into size bytes at buf.  Returns its length, -1 if it
+// does not fit, -2 if it cannot be encoded at all.
+static int binlog_encode(uint8_t *buf, size_t size,
+                         const player_msghdr_t *hdr, void *data)
+{
+  player_pack_fn_t packfunc;
+  player_msghdr_t h;
+  int len;
+
+  if (size < PLAYERXDR_MSGHDR_SIZE)
+    return -1;
+
+  len = 0;
+  if (data)
+  {
+    if (!(packfunc = playerxdr_get_packfunc(hdr->addr.interf,
+                                            hdr->type, hdr->subtype)))
+    {
+      PLAYER_WARN3("cannot log message to interface %u with type %u:%u",
+                   hdr->addr.interf, hdr->type, hdr->subtype);
+      return -2;
+    }
+    len = (*packfunc)(buf + PLAYERXDR_MSGHDR_SIZE,
+                      size - PLAYERXDR_MSGHDR_SIZE, data, PLAYERXDR_ENCODE);
+    if (len < 0)
+      return -1;
+  }
+
+  h = *hdr;
+  h.size = len;
+  if (player_msghdr_pack(buf, PLAYERXDR_MSGHDR_SIZE, &h, PLAYERXDR_ENCODE) < 0)
+    return -2;
+  return PLAYERXDR_MSGHDR_SIZE + len;
+}
+
+
+int binlog_write(binlog_t *log, const player_msghdr_t *hdr, void *data)
+{
+  int len;
+
+  if (!log->writing)
+    return -1;
+
+  // Start a new block when this one is full, or covers enough time
+  if (log->count > 0 &&
+      (log->len >= BINLOG_BLOCK_SIZE ||
+       hdr->timestamp - log->first_time >= BINLOG_BLOCK_SPAN))
+  {
+    if (binlog_flush(log) != 0)
+      return -1;
+  }
+
+  // Try to fit the message in the block.  If it does not fit, write out
+  // the block; if it does not fit in an empty block, make the block
+  // bigger.
+  while ((len = binlog_encode(log->buf + log->len, log->buf_size - log->len,
+                              hdr, data)) < 0)
+  {
+    if (len == -2)
+      return -1;
+    if (log->count > 0)
+    {
+      if (binlog_flush(log) != 0)
+        return -1;
+    }
+    else if (log->buf_size >= BINLOG_MAX_RECORD)
+    {
+      PLAYER_ERROR3("message to interface %u with type %u:%u is too big "
+                    "to log", hdr->addr.interf, hdr->type, hdr->subtype);
+      return -1;
+    }
+    else if (binlog_reserve(&log->buf, &log->buf_size,
+                            log->buf_size * 2 < BINLOG_MAX_RECORD ?
+                            log->buf_size * 2 : BINLOG_MAX_RECORD) != 0)
+      return -1;
+  }
+
+  if (log->count == 0)
+    log->first_time = hdr->timestamp;
+  log->last_time = hdr->timestamp;
+  log->len += len;
+  log->count++;
+  return 0;
+}
+
+
+// Write the index and trailer
+static int binlog_write_index(binlog_t *log)
+{
+  uint32_t i;
+  uint8_t buf[BINLOG_INDEX_ENTRY];
+  logstore_off_t offset;
+
+  offset = logstore_ftell(log->file);
+  if (offset < 0)
+    return -1;
+
+  if (logstore_write_index_head(log->file, "PLIX", log->index_count) != 0)
+    return -1;
+  for (i = 0; i < log->index_count; i++)
+  {
+    logstore_put_double(buf, log->index[i].time);
+    logstore_put_u64(buf + 8, log->index[i].offset);
+    if (fwrite(buf, BINLOG_INDEX_ENTRY, 1, log->file) != 1)
+      return -1;
+  }
+  return logstore_write_trailer(log->file, "PLEN", (uint64_t) offset,
+                                log->index_count);
+}
+
+
+int binlog_close(binlog_t *log)
+{
+  int ret;
+
+  ret = 0;
+  if (log->writing)
+  {
+    if (binlog_flush(log) != 0 || binlog_write_index(log) != 0)
+    {
+      PLAYER_ERROR1("failed to finish log: %s", strerror(errno));
+      ret = -1;
+    }
+  }
+  if (fclose(log->file) != 0)
+    ret = -1;
+  binlog_free(log);
+  return ret;
+}
+
+
+// Read some of the file
+static int binlog_fetch(void *file, uint64_t offset, void *buf, size_t size)
+{
+  binlog_t *log = (binlog_t*) file;
+
+  if (logstore_fseek(log->file, (logstore_off_t) offset, SEEK_SET) != 0 ||
+      fread(buf, size, 1, log->file) != 1)
+    return -1;
+  return 0;
+}
+
+
+// Read the index from the end of the file.  Returns -1 if there is none.
+static int binlog_read_index(binlog_t *log, uint64_t file_size)
+{
+  uint32_t i, count;
+  uint8_t buf[BINLOG_INDEX_ENTRY];
+  uint64_t offset;
+
+  if (logstore_find_index(binlog_fetch, log, file_size, "PLIX", "PLEN",
+                          BINLOG_INDEX_ENTRY, &offset, &count) != 0 ||
+      logstore_fseek(log->file, (logstore_off_t) offset, SEEK_SET) != 0)
+    return -1;
+
+  for (i = 0; i < count; i++)
+  {
+    if (fread(buf, BINLOG_INDEX_ENTRY, 1, log->file) != 1 ||
+        binlog_add_entry(log, logstore_get_double(buf),
+                         logstore_get_u64(buf + 8)) != 0)
+    {
+      log->index_count = 0;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+// Index a block found while rebuilding the index
+static int64_t binlog_scan_block(void *file, uint64_t offset,
+                                 const uint8_t *head, uint64_t file_size)
+{
+  binlog_t *log = (binlog_t*) file;
+  uint64_t size;
+
+  size = logstore_get_u32(head + 4);
+  if (offset + BINLOG_BLOCK_HEADER + size > file_size)
+    return 0;
+  if (binlog_add_entry(log, logstore_get_double(head + 16), offset) != 0)
+    return -1;
+  return (int64_t) (BINLOG_BLOCK_HEADER + size);
+}
+
+
+binlog_t *binlog_open(const char *filename)
+{
+  FILE *file;
+  binlog_t *log;
+  uint32_t flags;
+  logstore_off_t file_size;
+
+  if (!(file = fopen(filename, "rb")))
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return NULL;
+  }
+  if (!(log = binlog_alloc(file, 0)))
+  {
+    fclose(file);
+    return NULL;
+  }
+
+  if (logstore_read_header(file, filename, "binary log", "PLBL",
+                           BINLOG_VERSION, &flags) != 0)
+    goto fail;
+  log->flags = (int) flags;
+#if !HAVE_Z
+  if (log->flags & BINLOG_COMPRESS)
+  {
+    PLAYER_ERROR1("[%s] is compressed, and there is no zlib support",
+                  filename);
+    goto fail;
+  }
+#endif
+
+  if (!(log->msg = malloc(PLAYER_MAX_MESSAGE_SIZE)))
+  {
+    PLAYER_ERROR("out of memory for decoding log messages");
+    goto fail;
+  }
+
+  if (logstore_fseek(file, 0, SEEK_END) != 0 ||
+      (file_size = logstore_ftell(file)) < 0)
+    goto fail;
+  if (binlog_read_index(log, (uint64_t) file_size) != 0)
+  {
+    PLAYER_WARN1("[%s] has no index, probably because it was not closed "
+                 "properly; rebuilding it", filename);
+    if (logstore_scan(binlog_fetch, binlog_scan_block, log,
+                      (uint64_t) file_size, "PLBK", BINLOG_BLOCK_HEADER) != 0)
+      goto fail;
+  }
+  return log;
+
+fail:
+  fclose(file);
+  binlog_free(log);
+  return NULL;
+}
+
+
+// Load block n
+static int binlog_load_block(binlog_t *log, uint32_t n)
+{
+  uint8_t head[BINLOG_BLOCK_HEADER];
+  size_t size, len;
+
+  log->len = log->pos = 0;
+  if (logstore_fseek(log->file, (logstore_off_t) log->index[n].offset,
+                   SEEK_SET) != 0 ||
+      fread(head, sizeof(head), 1, log->file) != 1 ||
+      memcmp(head, "PLBK", 4) != 0)
+  {
+    PLAYER_ERROR1("bad block at offset %lu in log",
+                  (unsigned long) log->index[n].offset);
+    return -1;
+  }
+  size = logstore_get_u32(head + 4);
+  len = logstore_get_u32(head + 8);
+  if (binlog_reserve(&log->buf, &log->buf_size, len) != 0)
+    return -1;
+
+#if HAVE_Z
+  if (log->flags & BINLOG_COMPRESS)
+  {
+    uLongf zlen;
+
+    if (binlog_reserve(&log->zbuf, &log->zbuf_size, size) != 0)
+      return -1;
+    zlen = len;
+    if (fread(log->zbuf, size, 1, log->file) != 1 ||
+        uncompress(log->buf, &zlen, log->zbuf, size) != Z_OK || zlen != len)
+    {
+      PLAYER_ERROR1("bad compressed block at offset %lu in log",
+                    (unsigned long) log->index[n].offset);
+      return -1;
+    }
+  }
+  else
+#endif
+  {
+    if (size != len || fread(log->buf, len, 1, log->file) != 1)
+    {
+      PLAYER_ERROR1("short block at offset %lu in log",
+                    (unsigned long) log->index[n].offset);
+      return -1;
+    }
+  }
+
+  log->len = len;
+  log->next_block = n + 1;
+  return 0;
+}
+
+
+int binlog_read(binlog_t *log, player_msghdr_t *hdr, void **data)
+{
+  player_pack_fn_t packfunc;
+  size_t size;
+  int len;
+
+  if (log->writing)
+    return -1;
+
+  if (log->have_msg)
+  {
+    playerxdr_cleanup_message(log->msg, log->msg_hdr.addr.interf,
+                              log->msg_hdr.type, log->msg_hdr.subtype);
+    log->have_msg = 0;
+  }
+
+  while (1)
+  {
+    if (log->pos >= log->len)
+    {
+      if (log->next_block >= log->index_count)
+        return 1;
+      if (binlog_load_block(log, log->next_block) != 0)
+        return -1;
+      continue;
+    }
+
+    if (log->len - log->pos < PLAYERXDR_MSGHDR_SIZE ||
+        player_msghdr_pack(log->buf + log->pos, PLAYERXDR_MSGHDR_SIZE,
+                           hdr, PLAYERXDR_DECODE) < 0 ||
+        hdr->size > log->len - log->pos - PLAYERXDR_MSGHDR_SIZE)
+    {
+      PLAYER_ERROR("corrupt message in log");
+      return -1;
+    }
+    size = hdr->size;
+    log->pos += PLAYERXDR_MSGHDR_SIZE + size;
+
+    // Skip what comes before the time sought
+    if (hdr->timestamp < log->skip_before)
+      continue;
+
+    *data = NULL;
+    if (size > 0)
+    {
+      if (!(packfunc = playerxdr_get_packfunc(hdr->addr.interf,
+                                              hdr->type, hdr->subtype)))
+      {
+        PLAYER_WARN3("skipping logged message to interface %u with "
+                     "unsupported type %u:%u",
+                     hdr->addr.interf, hdr->type, hdr->subtype);
+        continue;
+      }
+      len = (*packfunc)(log->buf + log->pos - size, size, log->msg,
+                        PLAYERXDR_DECODE);
+      if (len < 0)
+      {
+        PLAYER_WARN3("decoding failed on logged message to interface %u "
+                     "with type %u:%u",
+                     hdr->addr.interf, hdr->type, hdr->subtype);
+        continue;
+      }
+      hdr->size = len;
+      *data = log->msg;
+      log->msg_hdr = *hdr;
+      log->have_msg = 1;
+    }
+
+    log->skip_before = -HUGE_VAL;
+    return 0;
+  }
+}
+
+
+int binlog_seek(binlog_t *log, double time)
+{
+  uint32_t lo, hi, mid;
+
+  if (log->writing)
+    return -1;
+
+  // Last block starting at or before the time, if any
+  lo = 0;
+  hi = log->index_count;
+  while (hi - lo > 1)
+  {
+    mid = (lo + hi) / 2;
+    if (log->index[mid].time <= time)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  log->len = log->pos = 0;
+  log->next_block = lo;
+  log->skip_before = time;
+  return 0;
+}
+
+
+int binlog_rewind(binlog_t *log)
+{
+  if (log->writing)
+    return -1;
+  log->len = log->pos = 0;
+  log->next_block = 0;
+  log->skip_before = -HUGE_VAL;
+  return 0;
+}
+
+
+int binlog_get_span(binlog_t *log, double *start, double *end)
+{
+  uint8_t head[BINLOG_BLOCK_HEADER];
+
+  if (log->writing || log->index_count == 0)
+    return -1;
+
+  // Blocks are always loaded with a seek, so this does not upset reading
+  if (logstore_fseek(log->file,
+                   (logstore_off_t) log->index[log->index_count - 1].offset,
+                   SEEK_SET) != 0 ||
+      fread(head, sizeof(head), 1, log->file) != 1)
+    return -1;
+  *start = log->index[0].time;
+  *end = logstore_get_double(head + 24);
+  return 0;
+}
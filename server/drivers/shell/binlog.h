@@ -0,0 +1,128 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Binary log files, for the writelog and readlog drivers.
+// CVS: $Id$
+//
+// Messages are stored as they go over the wire: the XDR-encoded message
+// header (PLAYERXDR_MSGHDR_SIZE bytes, holding the time, address, type,
+// subtype and body length) followed by the XDR-encoded body.  Nothing is
+// formatted or parsed as text, on the way in or out.
+//
+// Messages are gathered into blocks of at most BINLOG_BLOCK_SIZE bytes
+// or BINLOG_BLOCK_SPAN seconds, each of which may be compressed with
+// zlib.  When the log is closed an index of the blocks, with the time of
+// the first message in each, is written at the end, so a reader can seek
+// to any time by loading one block.  A log whose writer died has no
+// index; the reader then rebuilds it by walking the block headers, and
+// loses at most the block that was being filled.
+//
+// All numbers in the file are big-endian.  The layout is:
+//
+//   file header:  "PLBL", version, flags, 0                 (4 x 4 bytes)
+//   block:        "PLBK", stored length, raw length, count,
+//                 first time, last time                     (32 bytes)
+//                 stored length bytes of messages, compressed if the
+//                 file header flags say so
+//   ...
+//   index:        "PLIX", count, then for each block its
+//                 first time and file offset                (8 + 16n bytes)
+//   trailer:      index offset, block count, "PLEN"         (16 bytes)
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdio.h>
+
+#include <libplayerinterface/player.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// File name extension that selects the binary format
+#define BINLOG_EXTENSION ".plb"
+
+// Compress blocks with zlib (only if built with zlib)
+#define BINLOG_COMPRESS 0x01
+
+// Largest block of messages, before compression [bytes]; a message
+// bigger than this gets a block to itself
+#define BINLOG_BLOCK_SIZE (256 * 1024)
+
+// Longest span of time in a block [s], which bounds how much is read
+// past the target of a seek
+#define BINLOG_BLOCK_SPAN 1.0
+
+typedef struct binlog binlog_t;
+
+// Is filename a binary log, by its extension?  Returns 1 if it is.
+int binlog_match_filename(const char *filename);
+
+// Create a log for writing, with flags as above.  Returns NULL on error.
+binlog_t *binlog_create(const char *filename, int flags);
+
+// Create a log for writing on a stream opened for writing, which must be
+// able to tell its position.  The log takes the stream over, closing it
+// when it is closed (or on error).  Returns NULL on error.
+binlog_t *binlog_create_stream(FILE *file, int flags);
+
+// Open a log for reading.  Returns NULL on error.
+binlog_t *binlog_open(const char *filename);
+
+// Flush and close a log, writing the index if it was created for
+// writing.  Returns 0 on success, -1 on error (the log is closed
+// anyway).
+int binlog_close(binlog_t *log);
+
+// Append a message.  The body is encoded with the XDR pack function for
+// the message's interface, type and subtype; hdr->size is ignored.
+// Returns 0 on success, -1 on error.
+int binlog_write(binlog_t *log, const player_msghdr_t *hdr, void *data);
+
+// Write out the block being filled.  Returns 0 on success, -1 on error.
+int binlog_flush(binlog_t *log);
+
+// Read the next message.  On success fills in hdr, with hdr->size the
+// size of the decoded body, and points *data at the body (NULL if it is
+// empty).  The body belongs to the log and is good until the next call.
+// Returns 0 on success, 1 at the end of the log, -1 on error.
+int binlog_read(binlog_t *log, player_msghdr_t *hdr, void **data);
+
+// Move to the first message at or after time, or to the end of the log
+// if there is none.  Returns 0 on success, -1 on error.
+int binlog_seek(binlog_t *log, double time);
+
+// Move back to the first message.  Returns 0 on success, -1 on error.
+int binlog_rewind(binlog_t *log);
+
+// Time span of the log, from the index.  Returns 0 on success, -1 if the
+// log is empty.
+int binlog_get_span(binlog_t *log, double *start, double *end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Frame stores, which hold the camera frames of a text log.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+// Stores can be bigger than 2GB
+#define _FILE_OFFSET_BITS 64
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#if !defined (WIN32)
+  #include <sys/mman.h>
+#endif
+
+#include <libplayercommon/error.h>
+
+#include "framestore.h"
+#include "logstore.h"
+
+#define FRAMESTORE_VERSION 1
+
+#define FRAMESTORE_FRAME_HEADER 16
+#define FRAMESTORE_INDEX_ENTRY 8
+
+// Space a frame takes in the file, header and padding included
+#define FRAMESTORE_SPAN(size) \
+  (FRAMESTORE_FRAME_HEADER + \
+   (((uint64_t) (size) + FRAMESTORE_ALIGN - 1) & ~(uint64_t) (FRAMESTORE_ALIGN - 1)))
+
+struct framestore
+{
+  FILE *file;
+  int writing;
+
+  // Size of the file (as written so far, when writing)
+  uint64_t file_size;
+
+  // Where each frame starts
+  uint64_t *index;
+  uint32_t index_count, index_size;
+
+  // Reading: the whole file, if it could be mapped
+  const uint8_t *map;
+
+  // Reading, when it is not mapped: the last frame read
+  uint8_t *buf;
+  size_t buf_size;
+};
+
+
+// Add a frame to the index
+static int framestore_add_entry(framestore_t *store, uint64_t offset)
+{
+  if (logstore_reserve((void**) &store->index, &store->index_size,
+                       store->index_count, sizeof(uint64_t)) != 0)
+    return -1;
+  store->index[store->index_count++] = offset;
+  return 0;
+}
+
+
+static framestore_t *framestore_alloc(FILE *file, int writing)
+{
+  framestore_t *store;
+
+  if (!(store = (framestore_t*) calloc(1, sizeof(framestore_t))))
+    return NULL;
+  store->file = file;
+  store->writing = writing;
+  return store;
+}
+
+
+static void framestore_free(framestore_t *store)
+{
+#if !defined (WIN32)
+  if (store->map)
+    munmap((void*) store->map, (size_t) store->file_size);
+#endif
+  free(store->buf);
+  free(store->index);
+  free(store);
+  return;
+}
+
+
+int framestore_filename(const char *log_filename, char *filename,
+                        size_t size)
+{
+  size_t n;
+
+  n = strlen(log_filename);
+  if (n >= 3 && strcmp(log_filename + n - 3, ".gz") == 0)
+    n -= 3;
+  if (n + strlen(FRAMESTORE_EXTENSION) + 1 > size)
+    return -1;
+  memcpy(filename, log_filename, n);
+  strcpy(filename + n, FRAMESTORE_EXTENSION);
+  return 0;
+}
+
+
+framestore_t *framestore_create(const char *filename)
+{
+  FILE *file;
+
+  if (!(file = fopen(filename, "wb")))
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return NULL;
+  }
+  return framestore_create_stream(file);
+}
+
+
+framestore_t *framestore_create_stream(FILE *file)
+{
+  framestore_t *store;
+
+  if (!(store = framestore_alloc(file, 1)))
+  {
+    fclose(file);
+    return NULL;
+  }
+
+  if (logstore_write_header(file, "PLFS", FRAMESTORE_VERSION, 0) != 0)
+  {
+    PLAYER_ERROR("unable to write frame store header");
+    fclose(file);
+    framestore_free(store);
+    return NULL;
+  }
+  store->file_size = LOGSTORE_FILE_HEADER;
+  return store;
+}
+
+
+int framestore_write(framestore_t *store, const void *data, size_t size,
+                     uint32_t *frame)
+{
+  static const uint8_t pad[FRAMESTORE_ALIGN] = {0};
+  uint8_t head[FRAMESTORE_FRAME_HEADER];
+  size_t padding;
+
+  if (!store->writing || (uint64_t) size > 0xffffffffUL)
+    return -1;
+
+  memcpy(head, "PLFR", 4);
+  logstore_put_u32(head + 4, store->index_count);
+  logstore_put_u32(head + 8, (uint32_t) size);
+  logstore_put_u32(head + 12, 0);
+  padding = (size_t) (FRAMESTORE_SPAN(size) - FRAMESTORE_FRAME_HEADER - size);
+
+  if (fwrite(head, sizeof(head), 1, store->file) != 1 ||
+      (size > 0 && fwrite(data, size, 1, store->file) != 1) ||
+      (padding > 0 && fwrite(pad, padding, 1, store->file) != 1))
+    return -1;
+  if (framestore_add_entry(store, store->file_size) != 0)
+    return -1;
+
+  if (frame)
+    *frame = store->index_count - 1;
+  store->file_size += FRAMESTORE_SPAN(size);
+  return 0;
+}
+
+
+// Write the index and trailer.  The offset is counted rather than asked
+// of the stream, which may not be seekable.
+static int framestore_write_index(framestore_t *store)
+{
+  uint32_t i;
+  uint8_t buf[FRAMESTORE_INDEX_ENTRY];
+
+  if (logstore_write_index_head(store->file, "PLFX", store->index_count) != 0)
+    return -1;
+  for (i = 0; i < store->index_count; i++)
+  {
+    logstore_put_u64(buf, store->index[i]);
+    if (fwrite(buf, FRAMESTORE_INDEX_ENTRY, 1, store->file) != 1)
+      return -1;
+  }
+  return logstore_write_trailer(store->file, "PLFE", store->file_size,
+                                store->index_count);
+}
+
+
+int framestore_close(framestore_t *store)
+{
+  int ret;
+
+  ret = 0;
+  if (store->writing)
+  {
+    if (framestore_write_index(store) != 0)
+    {
+      PLAYER_ERROR1("failed to finish frame store: %s", strerror(errno));
+      ret = -1;
+    }
+  }
+  if (store->file && fclose(store->file) != 0)
+    ret = -1;
+  framestore_free(store);
+  return ret;
+}
+
+
+// Read some of the file, from the mapping if there is one
+static int framestore_fetch(void *file, uint64_t offset,
+                            void *buf, size_t size)
+{
+  framestore_t *store = (framestore_t*) file;
+
+  if (offset + size > store->file_size)
+    return -1;
+  if (store->map)
+  {
+    memcpy(buf, store->map + offset, size);
+    return 0;
+  }
+  if (logstore_fseek(store->file, (logstore_off_t) offset, SEEK_SET) != 0 ||
+      fread(buf, size, 1, store->file) != 1)
+    return -1;
+  return 0;
+}
+
+
+// Read the index from the end of the file.  Returns -1 if there is none.
+static int framestore_read_index(framestore_t *store)
+{
+  uint32_t i, count;
+  uint8_t buf[FRAMESTORE_INDEX_ENTRY];
+  uint64_t offset;
+
+  if (logstore_find_index(framestore_fetch, store, store->file_size,
+                          "PLFX", "PLFE", FRAMESTORE_INDEX_ENTRY,
+                          &offset, &count) != 0)
+    return -1;
+
+  for (i = 0; i < count; i++, offset += FRAMESTORE_INDEX_ENTRY)
+  {
+    if (framestore_fetch(store, offset, buf, FRAMESTORE_INDEX_ENTRY) != 0 ||
+        framestore_add_entry(store, logstore_get_u64(buf)) != 0)
+    {
+      store->index_count = 0;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+// Index a frame found while rebuilding the index
+static int64_t framestore_scan_frame(void *file, uint64_t offset,
+                                     const uint8_t *head, uint64_t file_size)
+{
+  framestore_t *store = (framestore_t*) file;
+  uint32_t len;
+
+  len = logstore_get_u32(head + 8);
+  // Frames come in order, and the last need not have its padding
+  if (logstore_get_u32(head + 4) != store->index_count ||
+      offset + FRAMESTORE_FRAME_HEADER + len > file_size)
+    return 0;
+  if (framestore_add_entry(store, offset) != 0)
+    return -1;
+  return (int64_t) FRAMESTORE_SPAN(len);
+}
+
+
+framestore_t *framestore_open(const char *filename)
+{
+  FILE *file;
+  framestore_t *store;
+  uint32_t flags;
+  logstore_off_t file_size;
+#if !defined (WIN32)
+  void *map;
+#endif
+
+  if (!(file = fopen(filename, "rb")))
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return NULL;
+  }
+  if (!(store = framestore_alloc(file, 0)))
+  {
+    fclose(file);
+    return NULL;
+  }
+
+  if (logstore_read_header(file, filename, "frame store", "PLFS",
+                           FRAMESTORE_VERSION, &flags) != 0)
+    goto fail;
+
+  if (logstore_fseek(file, 0, SEEK_END) != 0 ||
+      (file_size = logstore_ftell(file)) < 0)
+    goto fail;
+  store->file_size = (uint64_t) file_size;
+
+#if !defined (WIN32)
+  // Frames are read straight out of the mapping; if it cannot be mapped,
+  // each is read into a buffer instead
+  if ((uint64_t) (size_t) store->file_size == store->file_size)
+  {
+    map = mmap(NULL, (size_t) store->file_size, PROT_READ, MAP_SHARED,
+               fileno(file), 0);
+    if (map != MAP_FAILED)
+      store->map = (const uint8_t*) map;
+  }
+#endif
+
+  if (framestore_read_index(store) != 0)
+  {
+    PLAYER_WARN1("[%s] has no index, probably because it was not closed "
+                 "properly; rebuilding it", filename);
+    if (logstore_scan(framestore_fetch, framestore_scan_frame, store,
+                      store->file_size, "PLFR", FRAMESTORE_FRAME_HEADER) != 0)
+      goto fail;
+  }
+  return store;
+
+fail:
+  fclose(file);
+  framestore_free(store);
+  return NULL;
+}
+
+
+int framestore_read(framestore_t *store, uint32_t frame,
+                    const void **data, size_t *size)
+{
+  uint8_t head[FRAMESTORE_FRAME_HEADER];
+  uint64_t offset;
+  uint32_t len;
+
+  if (store->writing || frame >= store->index_count)
+    return -1;
+
+  offset = store->index[frame];
+  if (framestore_fetch(store, offset, head, sizeof(head)) != 0 ||
+      memcmp(head, "PLFR", 4) != 0 || logstore_get_u32(head + 4) != frame)
+    return -1;
+  len = logstore_get_u32(head + 8);
+  offset += FRAMESTORE_FRAME_HEADER;
+  if (offset + len > store->file_size)
+    return -1;
+
+  if (store->map)
+    *data = store->map + offset;
+  else
+  {
+    if (len > store->buf_size)
+    {
+      uint8_t *tmp;
+      if (!(tmp = (uint8_t*) realloc(store->buf, len)))
+        return -1;
+      store->buf = tmp;
+      store->buf_size = len;
+    }
+    if (len > 0 && framestore_fetch(store, offset, store->buf, len) != 0)
+      return -1;
+    *data = store->buf;
+  }
+  *size = len;
+  return 0;
+}
+
+
+uint32_t framestore_count(framestore_t *store)
+{
+  return store->index_count;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Frame stores, which hold the camera frames of a text log.
+// CVS: $Id$
+//
+// Writing images into a text log as hex doubles their size, and the
+// encoding and decoding is most of the work of logging and playing back
+// a camera.  Instead, writelog can append each frame, as it is, to a
+// frame store beside the log, and log just the frame's number; readlog
+// maps the store into memory and publishes frames straight out of it.
+//
+// Frames are numbered from 0 in the order they are written, and each is
+// a chunk with a header of its own, so a store is readable however far
+// its writer got.  When the store is closed an index of where each frame
+// starts is written at the end; a store whose writer died has none, and
+// the reader rebuilds it by walking the chunks.
+//
+// All numbers in the file are big-endian.  The layout is:
+//
+//   file header:  "PLFS", version, 0, 0                     (4 x 4 bytes)
+//   frame:        "PLFR", frame number, length, 0           (16 bytes)
+//                 length bytes of image, padded with zeros to a
+//                 multiple of FRAMESTORE_ALIGN
+//   ...
+//   index:        "PLFX", count, then the file offset of
+//                 each frame                                (8 + 8n bytes)
+//   trailer:      index offset, frame count, "PLFE"          (16 bytes)
+//
+// A store is used from one thread at a time.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAMESTORE_H
+#define FRAMESTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The frame store of a log is named after it, with this added (after
+// taking off any ".gz", so a log can be gzipped and still find its store)
+#define FRAMESTORE_EXTENSION ".frames"
+
+// Frames start on a multiple of this in the file [bytes]
+#define FRAMESTORE_ALIGN 16
+
+typedef struct framestore framestore_t;
+
+// Name of the frame store of a log.  Returns 0 on success, -1 if the
+// name does not fit.
+int framestore_filename(const char *log_filename, char *filename,
+                        size_t size);
+
+// Create a store for writing.  Returns NULL on error.
+framestore_t *framestore_create(const char *filename);
+
+// Create a store for writing on a stream opened for writing.  The store
+// takes the stream over, closing it when it is closed (or on error).
+// Returns NULL on error.
+framestore_t *framestore_create_stream(FILE *file);
+
+// Open a store for reading, mapped into memory if the system allows.
+// Returns NULL on error.
+framestore_t *framestore_open(const char *filename);
+
+// Flush and close a store, writing the index if it was created for
+// writing.  Returns 0 on success, -1 on error (the store is closed
+// anyway).
+int framestore_close(framestore_t *store);
+
+// Append a frame, and say what number it was given.  Returns 0 on
+// success, -1 on error.
+int framestore_write(framestore_t *store, const void *data, size_t size,
+                     uint32_t *frame);
+
+// Get a frame.  Points *data at it; if the store is mapped, that is in
+// the mapping, and good until the store is closed, and otherwise it
+// belongs to the store and is good until the next call.  Returns 0 on
+// success, -1 if there is no such frame.
+int framestore_read(framestore_t *store, uint32_t frame,
+                    const void **data, size_t *size);
+
+// Number of frames in the store
+uint32_t framestore_count(framestore_t *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Conversion of text logs to binary logs, using the readlog
+//       driver's parsers.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef LOGCONVERT_H
+#define LOGCONVERT_H
+
+// Convert the text log src to the binary log dst, with binlog flags as
+// in binlog.h.  If dst is NULL the log is parsed but nothing is written.
+// Expects the player globals and XDR function table to have been set
+// up.  Returns the number of messages converted, or -1 on error.
+int readlog_convert(const char *src, const char *dst, int flags);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: The file layout shared by binary logs and frame stores.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+// Files can be bigger than 2GB
+#define _FILE_OFFSET_BITS 64
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <libplayercommon/error.h>
+
+#include "logstore.h"
+
+
+void logstore_put_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t) (v >> 24);
+  p[1] = (uint8_t) (v >> 16);
+  p[2] = (uint8_t) (v >> 8);
+  p[3] = (uint8_t) v;
+  return;
+}
+
+
+uint32_t logstore_get_u32(const uint8_t *p)
+{
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+         ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+
+void logstore_put_u64(uint8_t *p, uint64_t v)
+{
+  logstore_put_u32(p, (uint32_t) (v >> 32));
+  logstore_put_u32(p + 4, (uint32_t) v);
+  return;
+}
+
+
+uint64_t logstore_get_u64(const uint8_t *p)
+{
+  return ((uint64_t) logstore_get_u32(p) << 32) | logstore_get_u32(p + 4);
+}
+
+
+void logstore_put_double(uint8_t *p, double v)
+{
+  uint64_t u;
+  memcpy(&u, &v, sizeof(u));
+  logstore_put_u64(p, u);
+  return;
+}
+
+
+double logstore_get_double(const uint8_t *p)
+{
+  uint64_t u;
+  double v;
+  u = logstore_get_u64(p);
+  memcpy(&v, &u, sizeof(v));
+  return v;
+}
+
+
+int logstore_reserve(void **index, uint32_t *size, uint32_t count,
+                     size_t entry_size)
+{
+  void *tmp;
+  uint32_t n;
+
+  if (count < *size)
+    return 0;
+  n = *size ? 2 * *size : 256;
+  if (n <= *size || !(tmp = realloc(*index, (size_t) n * entry_size)))
+  {
+    PLAYER_ERROR("out of memory for the log index");
+    return -1;
+  }
+  *index = tmp;
+  *size = n;
+  return 0;
+}
+
+
+int logstore_write_header(FILE *file, const char *tag, uint32_t version,
+                          uint32_t flags)
+{
+  uint8_t head[LOGSTORE_FILE_HEADER];
+
+  memcpy(head, tag, 4);
+  logstore_put_u32(head + 4, version);
+  logstore_put_u32(head + 8, flags);
+  logstore_put_u32(head + 12, 0);
+  return fwrite(head, sizeof(head), 1, file) == 1 ? 0 : -1;
+}
+
+
+int logstore_read_header(FILE *file, const char *filename, const char *kind,
+                         const char *tag, uint32_t version, uint32_t *flags)
+{
+  uint8_t head[LOGSTORE_FILE_HEADER];
+
+  if (fread(head, sizeof(head), 1, file) != 1 || memcmp(head, tag, 4) != 0)
+  {
+    PLAYER_ERROR2("[%s] is not a %s", filename, kind);
+    return -1;
+  }
+  if (logstore_get_u32(head + 4) != version)
+  {
+    PLAYER_ERROR3("[%s] is a version %u %s, which is not supported",
+                  filename, logstore_get_u32(head + 4), kind);
+    return -1;
+  }
+  *flags = logstore_get_u32(head + 8);
+  return 0;
+}
+
+
+int logstore_write_index_head(FILE *file, const char *tag, uint32_t count)
+{
+  uint8_t buf[LOGSTORE_INDEX_HEADER];
+
+  memcpy(buf, tag, 4);
+  logstore_put_u32(buf + 4, count);
+  return fwrite(buf, sizeof(buf), 1, file) == 1 ? 0 : -1;
+}
+
+
+int logstore_write_trailer(FILE *file, const char *tag,
+                           uint64_t index_offset, uint32_t count)
+{
+  uint8_t buf[LOGSTORE_TRAILER];
+
+  logstore_put_u64(buf, index_offset);
+  logstore_put_u32(buf + 8, count);
+  memcpy(buf + 12, tag, 4);
+  return fwrite(buf, sizeof(buf), 1, file) == 1 ? 0 : -1;
+}
+
+
+int logstore_find_index(logstore_fetch_t fetch, void *file,
+                        uint64_t file_size, const char *index_tag,
+                        const char *trailer_tag, size_t entry_size,
+                        uint64_t *offset, uint32_t *count)
+{
+  uint8_t buf[LOGSTORE_TRAILER];
+  uint64_t index_offset;
+  uint32_t n;
+
+  if (file_size < LOGSTORE_FILE_HEADER + LOGSTORE_INDEX_HEADER +
+      LOGSTORE_TRAILER)
+    return -1;
+  if ((*fetch)(file, file_size - LOGSTORE_TRAILER, buf, LOGSTORE_TRAILER) != 0 ||
+      memcmp(buf + 12, trailer_tag, 4) != 0)
+    return -1;
+
+  index_offset = logstore_get_u64(buf);
+  n = logstore_get_u32(buf + 8);
+  if (index_offset < LOGSTORE_FILE_HEADER ||
+      index_offset > file_size ||
+      index_offset + LOGSTORE_INDEX_HEADER + (uint64_t) n * entry_size +
+      LOGSTORE_TRAILER != file_size)
+    return -1;
+
+  if ((*fetch)(file, index_offset, buf, LOGSTORE_INDEX_HEADER) != 0 ||
+      memcmp(buf, index_tag, 4) != 0 || logstore_get_u32(buf + 4) != n)
+    return -1;
+
+  *offset = index_offset + LOGSTORE_INDEX_HEADER;
+  *count = n;
+  return 0;
+}
+
+
+int logstore_scan(logstore_fetch_t fetch, logstore_record_t record,
+                  void *file, uint64_t file_size, const char *tag,
+                  size_t head_size)
+{
+  uint8_t head[LOGSTORE_MAX_RECORD_HEADER];
+  uint64_t offset;
+  int64_t span;
+
+  offset = LOGSTORE_FILE_HEADER;
+  while (offset + head_size <= file_size)
+  {
+    if ((*fetch)(file, offset, head, head_size) != 0 ||
+        memcmp(head, tag, 4) != 0)
+      break;
+    span = (*record)(file, offset, head, file_size);
+    if (span < 0)
+      return -1;
+    if (span == 0)
+      break;
+    offset += (uint64_t) span;
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: The file layout shared by binary logs and frame stores.
+// CVS: $Id$
+//
+// Both are a file header, a run of records, each starting with a tag
+// and a header of its own, then an index of the records and a trailer
+// that says where the index is:
+//
+//   file header:  tag, version, flags, 0                    (4 x 4 bytes)
+//   record:       tag, ...
+//   ...
+//   index:        tag, count, then count entries            (8 + n bytes)
+//   trailer:      index offset, count, tag                  (16 bytes)
+//
+// Tags are four characters, and all numbers are big-endian.  A file
+// whose writer died has no index; it is rebuilt by walking the records.
+// This is internal to binlog.c and framestore.c.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined (WIN32)
+  #define logstore_fseek _fseeki64
+  #define logstore_ftell _ftelli64
+  typedef __int64 logstore_off_t;
+#else
+  #define logstore_fseek fseeko
+  #define logstore_ftell ftello
+  typedef off_t logstore_off_t;
+#endif
+
+#define LOGSTORE_FILE_HEADER 16
+#define LOGSTORE_INDEX_HEADER 8
+#define LOGSTORE_TRAILER 16
+
+// Largest record header that can be walked [bytes]
+#define LOGSTORE_MAX_RECORD_HEADER 32
+
+// Big-endian numbers
+void logstore_put_u32(uint8_t *p, uint32_t v);
+uint32_t logstore_get_u32(const uint8_t *p);
+void logstore_put_u64(uint8_t *p, uint64_t v);
+uint64_t logstore_get_u64(const uint8_t *p);
+void logstore_put_double(uint8_t *p, double v);
+double logstore_get_double(const uint8_t *p);
+
+// Read size bytes at offset in a file.  Returns 0 on success, -1 if they
+// are not all there.
+typedef int (*logstore_fetch_t)(void *file, uint64_t offset,
+                                void *buf, size_t size);
+
+// Look at a record found while walking a file, given its offset and
+// header.  Returns the space it takes in the file, 0 if it is not all
+// there, which ends the walk, or -1 on error.
+typedef int64_t (*logstore_record_t)(void *file, uint64_t offset,
+                                     const uint8_t *head,
+                                     uint64_t file_size);
+
+// Make room for one more entry, of entry_size bytes, in an index holding
+// count of size.  Returns 0 on success, -1 if out of memory.
+int logstore_reserve(void **index, uint32_t *size, uint32_t count,
+                     size_t entry_size);
+
+// Write the file header.  Returns 0 on success, -1 on error.
+int logstore_write_header(FILE *file, const char *tag, uint32_t version,
+                          uint32_t flags);
+
+// Read and check the file header, naming the file as a kind of file in
+// any error.  Returns 0 on success, with the flags, or -1.
+int logstore_read_header(FILE *file, const char *filename, const char *kind,
+                         const char *tag, uint32_t version, uint32_t *flags);
+
+// Write the head of the index, before its entries, and the trailer,
+// after them.  Returns 0 on success, -1 on error.
+int logstore_write_index_head(FILE *file, const char *tag, uint32_t count);
+int logstore_write_trailer(FILE *file, const char *tag,
+                           uint64_t index_offset, uint32_t count);
+
+// Find the index of a file from its trailer, checking that the index
+// head is there and that count entries of entry_size bytes fill the
+// space up to the trailer.  Returns 0 with the offset of the first entry
+// and the count, or -1 if there is no index.
+int logstore_find_index(logstore_fetch_t fetch, void *file,
+                        uint64_t file_size, const char *index_tag,
+                        const char *trailer_tag, size_t entry_size,
+                        uint64_t *offset, uint32_t *count);
+
+// Walk the records of a file without an index, from the end of the file
+// header, handing each to record().  Stops at the first whose header is
+// not all there or not tagged tag, or that record() says is not all
+// there.  Returns 0 on success, -1 if record() fails.
+int logstore_scan(logstore_fetch_t fetch, logstore_record_t record,
+                  void *file, uint64_t file_size, const char *tag,
+                  size_t head_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,562 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Log file writer thread, for the writelog driver.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+// fopencookie() and O_DIRECT
+#define _GNU_SOURCE
+// Logs can be bigger than 2GB
+#define _FILE_OFFSET_BITS 64
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercommon/error.h>
+
+#include "logwriter.h"
+
+#if LOGWRITER_AVAILABLE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// The write rate is measured over this long [s]
+#define LOGWRITER_RATE_SPAN 1.0
+
+struct logwriter
+{
+  int fd;
+  int flags;
+  double sync_interval;
+  FILE *stream;
+
+  // The ring.  Buffer head % count is being filled; buffers tail % count
+  // to (head - 1) % count are waiting to be written, with lens[] bytes
+  // in each.  Only the logging thread moves head and only the writer
+  // moves tail, both under the lock.
+  uint8_t **bufs;
+  size_t *lens;
+  size_t size;
+  int count;
+  volatile long head, tail;
+
+  // Logging thread: the buffer being filled, how full it is and since
+  // when, the bytes taken in all, where the record being written began
+  // and the largest record so far
+  uint8_t *cur;
+  size_t len;
+  double fill_time;
+  int64_t pos, record_start, record_max;
+  uint32_t records_written, records_dropped, stalls;
+  double stall_time;
+
+  // Writer thread: what has gone to the file, under the lock
+  int64_t bytes_written, rate_bytes;
+  double rate, rate_time, sync_time;
+  int error;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t work, space;
+  int quit;
+};
+
+
+static double logwriter_now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// Write all of a buffer, or fail
+static int logwriter_write_all(int fd, const uint8_t *data, size_t size)
+{
+  ssize_t n;
+
+  while (size > 0)
+  {
+    n = write(fd, data, size);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    data += n;
+    size -= (size_t) n;
+  }
+  return 0;
+}
+
+
+static int logwriter_sync(int fd)
+{
+#if HAVE_FDATASYNC
+  return fdatasync(fd);
+#else
+  return fsync(fd);
+#endif
+}
+
+
+// Writer thread: write out buffers as they are handed over, until told
+// to quit and there are none left
+static void *logwriter_main(void *arg)
+{
+  logwriter_t *w;
+  const uint8_t *data;
+  size_t len;
+  int ok, direct;
+  double t;
+
+  w = (logwriter_t*) arg;
+  direct = w->flags & LOGWRITER_DIRECT;
+
+  pthread_mutex_lock(&w->lock);
+  while (1)
+  {
+    while (w->tail == w->head && !w->quit)
+      pthread_cond_wait(&w->work, &w->lock);
+    if (w->tail == w->head)
+      break;
+    data = w->bufs[w->tail % w->count];
+    len = w->lens[w->tail % w->count];
+    pthread_mutex_unlock(&w->lock);
+
+#ifdef O_DIRECT
+    // Direct writes must be whole blocks; a part full buffer can only be
+    // the last one, so the rest of the file goes through the page cache
+    if (direct && len % LOGWRITER_ALIGN != 0)
+    {
+      fcntl(w->fd, F_SETFL, fcntl(w->fd, F_GETFL) & ~O_DIRECT);
+      direct = 0;
+    }
+#endif
+    ok = logwriter_write_all(w->fd, data, len) == 0;
+    t = logwriter_now();
+    if (ok && w->sync_interval > 0 && t - w->sync_time >= w->sync_interval)
+    {
+      ok = logwriter_sync(w->fd) == 0;
+      w->sync_time = t;
+    }
+    if (!ok && !w->error)
+      PLAYER_ERROR1("failed to write log: %s", strerror(errno));
+
+    pthread_mutex_lock(&w->lock);
+    if (ok)
+    {
+      w->bytes_written += len;
+      if (t - w->rate_time >= LOGWRITER_RATE_SPAN)
+      {
+        w->rate = (w->bytes_written - w->rate_bytes) / (t - w->rate_time);
+        w->rate_bytes = w->bytes_written;
+        w->rate_time = t;
+      }
+    }
+    else
+      w->error = 1;
+    w->tail++;
+    pthread_cond_signal(&w->space);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+
+// Hand the current buffer over and move to the next, waiting for it to
+// be written if need be
+static void logwriter_next(logwriter_t *w)
+{
+  double t;
+
+  pthread_mutex_lock(&w->lock);
+  w->lens[w->head % w->count] = w->len;
+  w->head++;
+  pthread_cond_signal(&w->work);
+  if (w->head - w->tail >= w->count)
+  {
+    t = logwriter_now();
+    while (w->head - w->tail >= w->count)
+      pthread_cond_wait(&w->space, &w->lock);
+    w->stall_time += logwriter_now() - t;
+    w->stalls++;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  w->cur = w->bufs[w->head % w->count];
+  w->len = 0;
+}
+
+
+// Is there a free buffer other than the one being filled?  Reading tail
+// without the lock may see it late, which errs on the side of none.
+static int logwriter_has_free(logwriter_t *w)
+{
+  return w->head - w->tail < w->count - 1;
+}
+
+
+// Copy data into the ring
+static void logwriter_put(logwriter_t *w, const char *data, size_t size)
+{
+  size_t n;
+
+  w->pos += size;
+  while (size > 0)
+  {
+    if (w->len == w->size)
+      logwriter_next(w);
+    if (w->len == 0)
+      w->fill_time = logwriter_now();
+    n = w->size - w->len;
+    if (n > size)
+      n = size;
+    memcpy(w->cur + w->len, data, n);
+    w->len += n;
+    data += n;
+    size -= n;
+  }
+}
+
+
+// The stream can only tell where it is, for ftell()
+static int64_t logwriter_seek(logwriter_t *w, int64_t offset, int whence)
+{
+  if ((whence == SEEK_CUR && offset == 0) ||
+      (whence == SEEK_SET && offset == w->pos))
+    return w->pos;
+  errno = ESPIPE;
+  return -1;
+}
+
+
+#if HAVE_FOPENCOOKIE
+
+static ssize_t logwriter_cookie_write(void *cookie, const char *data,
+                                      size_t size)
+{
+  logwriter_put((logwriter_t*) cookie, data, size);
+  return (ssize_t) size;
+}
+
+static int logwriter_cookie_seek(void *cookie, off64_t *offset, int whence)
+{
+  int64_t pos;
+
+  if ((pos = logwriter_seek((logwriter_t*) cookie, *offset, whence)) < 0)
+    return -1;
+  *offset = pos;
+  return 0;
+}
+
+static int logwriter_cookie_close(void *cookie)
+{
+  ((logwriter_t*) cookie)->stream = NULL;
+  return 0;
+}
+
+static FILE *logwriter_open_stream(logwriter_t *w)
+{
+  cookie_io_functions_t io;
+
+  io.read = NULL;
+  io.write = logwriter_cookie_write;
+  io.seek = logwriter_cookie_seek;
+  io.close = logwriter_cookie_close;
+  return fopencookie(w, "w", io);
+}
+
+#else
+
+static int logwriter_funopen_write(void *cookie, const char *data, int size)
+{
+  logwriter_put((logwriter_t*) cookie, data, (size_t) size);
+  return size;
+}
+
+static fpos_t logwriter_funopen_seek(void *cookie, fpos_t offset, int whence)
+{
+  return (fpos_t) logwriter_seek((logwriter_t*) cookie, offset, whence);
+}
+
+static int logwriter_funopen_close(void *cookie)
+{
+  ((logwriter_t*) cookie)->stream = NULL;
+  return 0;
+}
+
+static FILE *logwriter_open_stream(logwriter_t *w)
+{
+  return funopen(w, NULL, logwriter_funopen_write, logwriter_funopen_seek,
+                 logwriter_funopen_close);
+}
+
+#endif
+
+
+static void logwriter_free(logwriter_t *w)
+{
+  int i;
+
+  if (w->bufs)
+  {
+    for (i = 0; i < w->count; i++)
+      free(w->bufs[i]);
+  }
+  free(w->bufs);
+  free(w->lens);
+  if (w->fd >= 0)
+    close(w->fd);
+  pthread_cond_destroy(&w->space);
+  pthread_cond_destroy(&w->work);
+  pthread_mutex_destroy(&w->lock);
+  free(w);
+}
+
+
+logwriter_t *logwriter_create(const char *filename, size_t buffer_size,
+                              int buffer_count, double sync_interval,
+                              int flags)
+{
+  logwriter_t *w;
+  int i, mode;
+  void *buf;
+
+  if (buffer_count < 2 || buffer_size == 0)
+  {
+    PLAYER_ERROR("a log writer needs at least two buffers");
+    return NULL;
+  }
+
+  if (!(w = (logwriter_t*) calloc(1, sizeof(logwriter_t))))
+    return NULL;
+  w->fd = -1;
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->work, NULL);
+  pthread_cond_init(&w->space, NULL);
+  w->size = (buffer_size + LOGWRITER_ALIGN - 1) / LOGWRITER_ALIGN * LOGWRITER_ALIGN;
+  w->count = buffer_count;
+  w->sync_interval = sync_interval;
+  w->rate_time = w->sync_time = logwriter_now();
+
+  mode = O_WRONLY | O_CREAT | O_TRUNC;
+  if (flags & LOGWRITER_DIRECT)
+  {
+#ifdef O_DIRECT
+    w->fd = open(filename, mode | O_DIRECT, 0644);
+    if (w->fd >= 0)
+      w->flags |= LOGWRITER_DIRECT;
+    else if (errno == EINVAL)
+      PLAYER_WARN1("[%s] cannot be written directly; using the page cache",
+                   filename);
+#else
+    PLAYER_WARN("no direct I/O on this system; using the page cache");
+#endif
+  }
+  if (w->fd < 0)
+    w->fd = open(filename, mode, 0644);
+  if (w->fd < 0)
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    logwriter_free(w);
+    return NULL;
+  }
+
+  // Buffers are aligned for direct writes
+  w->bufs = (uint8_t**) calloc(w->count, sizeof(w->bufs[0]));
+  w->lens = (size_t*) calloc(w->count, sizeof(w->lens[0]));
+  if (!w->bufs || !w->lens)
+  {
+    logwriter_free(w);
+    return NULL;
+  }
+  for (i = 0; i < w->count; i++)
+  {
+    if (posix_memalign(&buf, LOGWRITER_ALIGN, w->size) != 0)
+    {
+      PLAYER_ERROR1("unable to allocate %d log buffers", w->count);
+      logwriter_free(w);
+      return NULL;
+    }
+    w->bufs[i] = (uint8_t*) buf;
+  }
+  w->cur = w->bufs[0];
+
+  if (!(w->stream = logwriter_open_stream(w)))
+  {
+    PLAYER_ERROR1("unable to open a stream onto [%s]", filename);
+    logwriter_free(w);
+    return NULL;
+  }
+  if (pthread_create(&w->thread, NULL, logwriter_main, w) != 0)
+  {
+    PLAYER_ERROR("unable to start the log writer thread");
+    fclose(w->stream);
+    logwriter_free(w);
+    return NULL;
+  }
+  return w;
+}
+
+
+FILE *logwriter_stream(logwriter_t *w)
+{
+  return w->stream;
+}
+
+
+int logwriter_begin(logwriter_t *w)
+{
+  if (!logwriter_has_free(w) &&
+      (int64_t) (w->size - w->len) < w->record_max)
+  {
+    w->records_dropped++;
+    return -1;
+  }
+  w->record_start = w->pos;
+  return 0;
+}
+
+
+void logwriter_flush(logwriter_t *w, double age)
+{
+  if (w->stream)
+    fflush(w->stream);
+
+  // Direct writes wait for whole buffers, and handing a buffer over when
+  // none is free would wait as well
+  if (w->len > 0 && !(w->flags & LOGWRITER_DIRECT) &&
+      logwriter_has_free(w) && logwriter_now() - w->fill_time >= age)
+    logwriter_next(w);
+}
+
+
+void logwriter_end(logwriter_t *w)
+{
+  if (w->stream)
+    fflush(w->stream);
+  if (w->pos - w->record_start > w->record_max)
+    w->record_max = w->pos - w->record_start;
+  w->records_written++;
+  logwriter_flush(w, LOGWRITER_FLUSH_AGE);
+}
+
+
+void logwriter_get_stats(logwriter_t *w, logwriter_stats_t *stats)
+{
+  double t;
+
+  pthread_mutex_lock(&w->lock);
+  stats->bytes_written = w->bytes_written;
+  // An idle writer has not measured its rate lately
+  t = logwriter_now();
+  if (t - w->rate_time >= 2 * LOGWRITER_RATE_SPAN)
+    stats->rate = (w->bytes_written - w->rate_bytes) / (t - w->rate_time);
+  else
+    stats->rate = w->rate;
+  stats->backlog = (double) (w->head - w->tail) / w->count;
+  stats->error = w->error;
+  pthread_mutex_unlock(&w->lock);
+
+  stats->records_written = w->records_written;
+  stats->records_dropped = w->records_dropped;
+  stats->stall_time = w->stall_time;
+  stats->stalls = w->stalls;
+}
+
+
+int logwriter_close(logwriter_t *w)
+{
+  int ret;
+
+  if (w->stream)
+    fclose(w->stream);
+  if (w->len > 0)
+    logwriter_next(w);
+
+  pthread_mutex_lock(&w->lock);
+  w->quit = 1;
+  pthread_cond_signal(&w->work);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->thread, NULL);
+
+  ret = w->error ? -1 : 0;
+  if (w->sync_interval > 0 && logwriter_sync(w->fd) != 0)
+    ret = -1;
+  if (close(w->fd) != 0)
+    ret = -1;
+  w->fd = -1;
+  logwriter_free(w);
+  return ret;
+}
+
+#else
+
+logwriter_t *logwriter_create(const char *filename, size_t buffer_size,
+                              int buffer_count, double sync_interval,
+                              int flags)
+{
+  PLAYER_ERROR("no log writer thread on this system");
+  return NULL;
+}
+
+FILE *logwriter_stream(logwriter_t *w)
+{
+  return NULL;
+}
+
+int logwriter_begin(logwriter_t *w)
+{
+  return -1;
+}
+
+void logwriter_end(logwriter_t *w)
+{
+}
+
+void logwriter_flush(logwriter_t *w, double age)
+{
+}
+
+void logwriter_get_stats(logwriter_t *w, logwriter_stats_t *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+int logwriter_close(logwriter_t *w)
+{
+  return -1;
+}
+
+#endif
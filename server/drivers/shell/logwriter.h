@@ -0,0 +1,129 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Log file writer thread, for the writelog driver.
+// CVS: $Id$
+//
+// Writing a log from the thread that formats it means that a slow disk
+// stalls the thread, and the messages it should be taking off its queue
+// pile up and are dropped.  A log writer instead gathers records in a
+// ring of large buffers and writes each buffer from its own thread once
+// it is full, in one aligned write.
+//
+// Filling the current buffer takes no lock: it belongs to the thread
+// logging until it is handed over, and a lock is taken only to hand over
+// a buffer and to sleep.  When a record is begun with no buffer free
+// other than the one being filled, the writer is a whole ring behind; if
+// the record might not fit in what is left of the buffer (it is judged
+// by the largest record so far) it is dropped, and counted, instead of
+// waiting.  A record that fills more buffers than are free waits for the
+// writer, and that time is counted.  Buffers that hold data for more than
+// LOGWRITER_FLUSH_AGE seconds are handed over part full, so a slow log
+// still reaches the disk.
+//
+// Records are written to a stdio stream onto the writer, so anything that
+// writes to a FILE* can write through it.  That needs fopencookie() or
+// funopen(); LOGWRITER_AVAILABLE says if either is there.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (HAVE_FOPENCOOKIE || HAVE_FUNOPEN) && !defined (WIN32)
+  #define LOGWRITER_AVAILABLE 1
+#else
+  #define LOGWRITER_AVAILABLE 0
+#endif
+
+// Open the file with O_DIRECT, bypassing the page cache.  Buffers are
+// then handed over only when full, or when the log is closed.
+#define LOGWRITER_DIRECT 0x01
+
+// Buffer sizes are rounded up to a multiple of this [bytes]
+#define LOGWRITER_ALIGN 4096
+
+// Buffers holding data this long are written part full [s]
+#define LOGWRITER_FLUSH_AGE 1.0
+
+typedef struct logwriter logwriter_t;
+
+typedef struct
+{
+  // Bytes written to the file
+  int64_t bytes_written;
+  // Write rate over about the last second [bytes/s]
+  double rate;
+  // Records ended, and records dropped at their beginning
+  uint32_t records_written, records_dropped;
+  // Fraction of the buffers waiting to be written
+  double backlog;
+  // Time spent waiting for a free buffer [s], and how many times
+  double stall_time;
+  uint32_t stalls;
+  // Set once a write to the file has failed
+  int error;
+} logwriter_stats_t;
+
+// Create (or truncate) a file and start a thread writing to it, with
+// buffer_count buffers of buffer_size bytes.  If sync_interval is more
+// than 0, the file is also synced to the disk at most that often [s].
+// Flags are as above.  Returns NULL on error.
+logwriter_t *logwriter_create(const char *filename, size_t buffer_size,
+                              int buffer_count, double sync_interval,
+                              int flags);
+
+// The stdio stream onto the writer.  It may be passed to fclose(), but
+// closing the writer closes it anyway.
+FILE *logwriter_stream(logwriter_t *writer);
+
+// Begin a record.  Returns 0 if it should be written, or -1 if the
+// writer is too far behind, in which case the record counts as dropped.
+int logwriter_begin(logwriter_t *writer);
+
+// End a record written to the stream: flush the stream into the current
+// buffer, and hand the buffer over if it is older than
+// LOGWRITER_FLUSH_AGE.
+void logwriter_end(logwriter_t *writer);
+
+// Hand the current buffer over if it holds data older than age [s]
+void logwriter_flush(logwriter_t *writer, double age);
+
+// Get the statistics, from the thread logging
+void logwriter_get_stats(logwriter_t *writer, logwriter_stats_t *stats);
+
+// Write out everything, stop the thread and close the file.  Returns 0
+// on success, or -1 if anything failed to be written.
+int logwriter_close(logwriter_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
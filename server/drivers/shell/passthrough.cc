@@ -251,6 +251,8 @@ PassThrough::PassThrough(ConfigFile* cf, int section) :
 			section), RemotePort("remote_port", -1, false, this, cf, section),
 			Connect("connect", 1, false, this, cf, section)
 {
+	// Update() also polls the queues of our remote connections
+	alwaysupdate = true;
 	int device_count = cf->GetTupleCount(section, "provides");
 	if (device_count != cf->GetTupleCount(section, "requires"))
 	{
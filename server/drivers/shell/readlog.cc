@@ -44,10 +44,42 @@ id's specified in the provides field must match those stored in the
 log file (i.e., data logged as "position2d:0" must also be read back as
 "position2d:0").
 
+Log files whose names end in ".plb" are binary logs, as written by
+@ref driver_writelog.  These hold the messages as they were published,
+so they can be replayed much faster than text logs, and for any
+interface; requests are answered with the replies stored in the log.
+Text logs can be converted with @ref util_playerlogconvert.
+
+Several logs can be played back together, for instance when each sensor
+was logged to a file of its own: give a list of files.  Each is read and
+parsed on a thread of its own, a little ahead of playback, and their
+messages are played in the order they were logged across all of them
+(messages logged at the same time in two logs are played in the order
+the logs are listed).  Binary, text and gzipped text logs can be mixed.
+
+Camera images in a text log may be kept in a frame store beside it (the
+log's name, less any ".gz", with ".frames" added), as written by
+@ref driver_writelog with camera_store_images set.  The store is mapped
+into memory, and images are published straight out of it.
+
 For help in controlling playback, try @ref util_playervcr.
 Note that you must declare a @ref interface_log device to allow
 playback control.
 
+Playback can jump to any time in the log, with a
+PLAYER_LOG_REQ_SET_READ_TIME request.  Binary logs carry their own index
+for this.  Text logs are indexed the first time a client jumps, which
+means reading the whole log once; the index is kept beside the log (in
+the log's name with ".idx" added) and used from then on, until the log
+changes.  Jumping in a gzipped text log means decompressing it up to
+the new time, so it is much slower.
+
+Messages are published at the times they were logged, scaled by the
+playback speed.  With a speed of 0, they are published as fast as the
+subscribed clients take them: the driver holds back while any client's
+queue is more than half full, or still holds a message that the next would
+replace.
+
 @par Compile-time dependencies
 
 - none
@@ -91,15 +123,22 @@ The driver also provides an interface for controlling the playback:
 - PLAYER_LOG_SET_READ_STATE_REQ
 - PLAYER_LOG_GET_STATE_REQ
 - PLAYER_LOG_SET_READ_REWIND_REQ
+- PLAYER_LOG_SET_READ_TIME_REQ
+- PLAYER_LOG_SET_READ_SPEED_REQ
 
 @par Configuration file options
 
-- filename (filename)
+- filename (filename or tuple of filenames)
   - Default: NULL
-  - The log file to play back.
+  - The log file to play back: a text log, or a binary log if the name
+    ends in ".plb".  Give a tuple of files to play them back together.
+- read_ahead (integer)
+  - Default: 64
+  - Most messages read ahead in each file.
 - speed (float)
   - Default: 1.0
-  - Playback speed; 1.0 is real-time
+  - Playback speed; 1.0 is real-time, and 0 as fast as the clients take
+    the data
 - autoplay (integer)
   - Default: 1
   - Begin playing back log data when first client subscribes
@@ -122,6 +161,14 @@ driver
   provides ["position2d:0" "laser:0" "log:0"]
   speed 2.0
 )
+
+# Play back a laser and odometry logged to separate files
+driver
+(
+  name "readlog"
+  filename ["laser.plb" "odometry.log.gz"]
+  provides ["position2d:0" "laser:0" "log:0"]
+)
 @endverbatim
 
 @author Andrew Howard, Radu Bogdan Rusu, Rich Mattes
@@ -152,12 +199,140 @@ driver
   #include <zlib.h>
 #endif
 
+#include "binlog.h"
 #include "encode.h"
+#include "framestore.h"
+#include "logconvert.h"
+#include "readlog_index.h"
 #include "readlog_time.h"
 
 #if defined (WIN32)
+  #include <direct.h> // For _getcwd()
   #define strdup _strdup
+  #define snprintf _snprintf
+  #define getcwd _getcwd
+  #define readlog_fseek _fseeki64
+#else
+  #define readlog_fseek fseeko
+#endif
+
+// Playback is paced on a clock that is not set back and forth with the
+// time of day, where there is one
+#if HAVE_CLOCK_NANOSLEEP
+  #define READLOG_CLOCK CLOCK_MONOTONIC
+#else
+  #define READLOG_CLOCK CLOCK_REALTIME
+#endif
+
+// Most tokens on a line of a text log
+#define READLOG_MAX_TOKENS 4096
+
+// Longest to wait for requests at a time [s]; waiting for requests is
+// not exact, so the last part of a wait is slept out instead
+#define READLOG_MAX_WAIT 0.1
+#define READLOG_SLEEP 0.002
+
+// Furthest playback may fall behind the log (because the clients or the
+// disk are slow) before it gives up catching up [s]
+#define READLOG_MAX_LAG 1.0
+
+// How full a client's queue may get at speed 0, as a fraction of its
+// length, and how often to look again when it is fuller [s]
+#define READLOG_MAX_BACKLOG 0.5
+#define READLOG_MIN_POLL 0.0001
+
+// Messages read ahead in each log, by default
+#define READLOG_READ_AHEAD 64
+
+// What a reader thread is asked to do
+#define READLOG_REWIND 1
+#define READLOG_SEEK 2
+
+// A message read ahead from a log
+typedef struct
+{
+  // Time it was logged, which the logs are merged by
+  double time;
+
+  // Device it is for (the index into the provides list), and the message
+  // as it is to be published
+  int provide;
+  player_msghdr_t hdr;
+  void *data;
+
+  // Replies in text logs are kept as text, to be parsed as they are
+  // played; they set the driver up, rather than being published
+  const char *filename;
+  int linenum;
+  int token_count;
+  char **tokens;
+} readlog_record_t;
+
+class ReadLog;
+
+// A log being played back, and the thread reading ahead in it
+typedef struct
+{
+  // Position in the list of files, which orders messages logged at the
+  // same time
+  int id;
+  const char *filename;
+  ReadLog *driver;
+
+  FILE *file;
+#if HAVE_Z
+  gzFile gzfile;
 #endif
+  binlog_t *binlog;
+
+  // Index of a text log, loaded on the first seek
+  readlog_index_t *index;
+
+  // Frame store of a text log, opened when the first frame is read
+  framestore_t *frames;
+  bool frames_tried;
+
+  // Input buffer and position in a text log, and its format
+  size_t line_size;
+  char *line;
+  int linenum;
+  char *format;
+
+  // Lines logged before this time are skipped after a seek in a text log
+  bool skipping;
+  double skip_time;
+
+  // The message being parsed by the reader thread
+  int provide;
+  double time;
+
+  // Messages read ahead (a ring); these and the fields below are
+  // guarded by the driver's queue mutex
+  readlog_record_t *queue;
+  int queue_head, queue_count;
+  bool in_heap;
+  bool eof;
+
+  // Rewind or seek for the reader to do, and whether it worked
+  int command;
+  double command_time;
+  int command_result;
+  bool quit;
+
+  // The reader waits on this for room, or for something to do
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool running;
+} readlog_file_t;
+
+// The file each reader thread reads
+static pthread_key_t readlog_file_key;
+static pthread_once_t readlog_file_key_once = PTHREAD_ONCE_INIT;
+
+static void readlog_make_file_key()
+{
+  pthread_key_create(&readlog_file_key, NULL);
+}
 
 
 #if 0
@@ -188,6 +363,21 @@ class ReadLog: public ThreadedDriver
   public: virtual int ProcessMessage(QueuePointer & resp_queue,
                                      player_msghdr_t * hdr,
                                      void * data);
+
+  // Convert the text log to a binary log, instead of playing it back;
+  // if dst is NULL, just parse it
+  public: int Convert(const char *dst, int flags);
+
+  // Messages are written to the binary log while converting
+  public: using Driver::Publish;
+  public: virtual void Publish(QueuePointer &queue,
+                               player_msghdr_t* hdr,
+                               void* src,
+                               bool copy = true);
+  public: virtual void Publish(player_msghdr_t* hdr,
+                               void* src,
+                               bool copy = true);
+
   // Process log interface configuration requests
   private: int ProcessLogConfig(QueuePointer & resp_queue,
                                 player_msghdr_t * hdr,
@@ -233,6 +423,62 @@ class ReadLog: public ThreadedDriver
                                 player_msghdr_t * hdr,
                                 void * data);
 
+  // Answer a request with a reply from a binary log
+  private: int ProcessLoggedReply(QueuePointer & resp_queue,
+                                  player_msghdr_t * hdr);
+
+  // Open and close one of the logs
+  private: int OpenFile(readlog_file_t *f);
+  private: void CloseFile(readlog_file_t *f);
+
+  // Read and tokenize the next line of a text log
+  private: int ReadLine(readlog_file_t *f, int *token_count, char **tokens);
+
+  // Move back to the start of a log
+  private: int Rewind(readlog_file_t *f);
+
+  // Move to the first message logged at or after time
+  private: int Seek(readlog_file_t *f, double time);
+
+  // Reader threads, which read ahead in each log
+  private: static void *ReaderMain(void *arg);
+  private: void ReadAhead(readlog_file_t *f);
+
+  // Add a message to the messages read ahead in a log, waiting for room
+  private: void Enqueue(readlog_file_t *f, readlog_record_t *record);
+
+  // Take the next message in time order from all the logs.  Returns 0
+  // with a message, 1 at the end of every log, and -1 if the logs have
+  // not been read far enough yet to tell.
+  private: int NextRecord(bool replies_first, readlog_record_t *record);
+
+  // Have the reader threads rewind or seek, and wait until they have
+  private: int Command(int command, double time);
+
+  // Free a message read ahead
+  private: void FreeRecord(readlog_record_t *record);
+
+  // Name of the log being parsed, for error messages
+  private: const char *LogFilename();
+
+  // Frame store of the log being parsed, or NULL if it has none
+  private: framestore_t *FrameStore();
+
+  // Wait until it is time to publish a message logged at log_time,
+  // handling requests meanwhile.  Returns false if playback was moved
+  // while waiting, and the message should be dropped.
+  private: bool Pace(double log_time);
+
+  // At speed 0, wait until the clients of a device have room for a
+  // message
+  private: void WaitForClients(int provide, uint8_t type, uint8_t subtype);
+
+  // Publish a message read from a log (taking the data)
+  private: void PublishRecord(int provide, player_msghdr_t *hdr, void *data);
+
+  // Write a converted message to the binary log
+  private: void WriteConverted(player_msghdr_t *hdr, void *data);
+
   // Parse the header info
   private: int ParseHeader(int linenum, int token_count, char **tokens,
                            player_devaddr_t *id, double *dtime,
@@ -383,12 +629,36 @@ class ReadLog: public ThreadedDriver
   // The log interface (at most one of these)
   private: player_devaddr_t log_id;
 
-  // File to read data from
-  private: const char *filename;
-  private: FILE *file;
-#if HAVE_Z
-  private: gzFile gzfile;
-#endif
+  // Files to read data from
+  private: int file_count;
+  private: readlog_file_t *files;
+
+  // Messages read ahead in each file, up to this many, and the files with
+  // one ready, in a heap by the time of the first
+  private: int read_ahead;
+  private: pthread_mutex_t queue_mutex;
+  private: pthread_cond_t queue_cond;
+  private: readlog_file_t **heap;
+  private: int heap_count;
+
+  // The message being played, and the file of the reply being parsed
+  private: readlog_record_t record;
+  private: const char *parse_filename;
+
+  // Converting?  If so, messages go to this binary log (if any) rather
+  // than being published
+  private: bool converting;
+  private: binlog_t *convert_log;
+  private: int convert_count, convert_errors;
+
+  // Replies in a binary log, for answering requests with
+  private: typedef struct {
+    int provide;
+    uint8_t subtype;
+    void* data;
+  } logged_reply_t;
+  private: int reply_count;
+  private: logged_reply_t replies[1024];
 
   // localize particles
   private: player_localize_get_particles_t particles;
@@ -396,22 +666,27 @@ class ReadLog: public ThreadedDriver
   private: player_devaddr_t localize_addr;
 
 
-  // Input buffer
-  private: size_t line_size;
-  private: char *line;
-
-  // File format
-  private: char *format;
-
-  // Playback speed (1 = real time, 2 = twice real time)
+  // Playback speed (1 = real time, 2 = twice real time, 0 = as fast as
+  // the clients go)
   private: double speed;
 
+  // Playback is paced from this point: the message logged at
+  // pace_log_time was due at pace_wall_time.  It is set again whenever
+  // playback stops, moves or changes speed.
+  private: bool pace_reset;
+  private: double pace_wall_time, pace_log_time;
+  private: double last_log_time;
+
   // Playback enabled?
   public: bool enable;
 
   // Has a client requested that we rewind?
   public: bool rewind_requested;
 
+  // Has a client requested that we jump to a time?
+  public: bool seek_requested;
+  private: double seek_time;
+
   // Should we auto-rewind?  This is set in the log devie in the .cfg
   // file, and defaults to false
   public: bool autorewind;
@@ -449,13 +724,40 @@ ReadLog::ReadLog(ConfigFile* cf, int section)
   int i,j;
   player_devaddr_t id;
 
-  this->filename = cf->ReadFilename(section, "filename", NULL);
-  if(!this->filename)
+  pthread_once(&readlog_file_key_once, readlog_make_file_key);
+  pthread_mutex_init(&this->queue_mutex, NULL);
+  pthread_cond_init(&this->queue_cond, NULL);
+  this->files = NULL;
+  this->heap = NULL;
+  this->heap_count = 0;
+
+  // Get the list of files to read; they are played back together
+  this->file_count = cf->GetTupleCount(section, "filename");
+  if(this->file_count < 1)
   {
+    this->file_count = 0;
     PLAYER_ERROR("must specify a log file to read from");
     this->SetError(-1);
     return;
   }
+  this->files = (readlog_file_t*) calloc(this->file_count,
+                                         sizeof(readlog_file_t));
+  this->heap = (readlog_file_t**) calloc(this->file_count,
+                                         sizeof(readlog_file_t*));
+  assert(this->files && this->heap);
+  for (i = 0; i < this->file_count; i++)
+  {
+    this->files[i].id = i;
+    this->files[i].driver = this;
+    this->files[i].filename = cf->ReadTupleFilename(section, "filename", i,
+                                                    NULL);
+    pthread_cond_init(&this->files[i].cond, NULL);
+  }
+  this->parse_filename = this->files[0].filename;
+
+  this->read_ahead = cf->ReadInt(section, "read_ahead", READLOG_READ_AHEAD);
+  if(this->read_ahead < 1)
+    this->read_ahead = 1;
   this->speed = cf->ReadFloat(section, "speed", 1.0);
 
   this->provide_count = 0;
@@ -464,8 +766,8 @@ ReadLog::ReadLog(ConfigFile* cf, int section)
 
   particles_set = false;
 
-  // Get a list of devices to provide
-  for (i = 0; i < 1024; i++)
+  // Get a list of devices to provide (there are none when converting)
+  for (i = 0; i < 1024 && i < cf->GetTupleCount(section, "provides"); i++)
   {
     // TODO: fix the indexing here
     if (cf->ReadDeviceAddr(&id, section, "provides", -1, i, NULL) != 0)
@@ -522,11 +824,11 @@ ReadLog::ReadLog(ConfigFile* cf, int section)
   this->autorewind = cf->ReadInt(section, "autorewind", 0) != 0 ? true : false;
 
   // Initialize other stuff
-  this->format = strdup("unknown");
-  this->file = NULL;
-#if HAVE_Z
-  this->gzfile = NULL;
-#endif
+  this->converting = false;
+  this->convert_log = NULL;
+  this->convert_count = 0;
+  this->convert_errors = 0;
+  this->reply_count = 0;
 
   // Set up the global time object.  We're just shoving our own in over the
   // pre-existing WallclockTime object.  Not pretty but it works.
@@ -552,6 +854,13 @@ ReadLog::~ReadLog()
     }
   }
 
+  for(int i=0;i<this->file_count;i++)
+    pthread_cond_destroy(&this->files[i].cond);
+  free(this->files);
+  free(this->heap);
+  pthread_cond_destroy(&this->queue_cond);
+  pthread_mutex_destroy(&this->queue_mutex);
+
   return;
 }
 
@@ -560,321 +869,1289 @@ ReadLog::~ReadLog()
 // Initialize driver
 int ReadLog::MainSetup()
 {
+  int i;
+  readlog_file_t *f;
+
   // Reset the time
   ReadLogTime_time.tv_sec = 0;
   ReadLogTime_time.tv_usec = 0;
   ReadLogTime_timeDouble = 0.0;
 
-  // Open the file (possibly compressed)
-  if (strlen(this->filename) >= 3 &&
+  // Rewind not requested by default
+  this->rewind_requested = false;
+  this->seek_requested = false;
+  this->pace_reset = true;
+  this->last_log_time = -1.0;
+  this->heap_count = 0;
+  memset(&this->record, 0, sizeof(this->record));
+
+  for (i = 0; i < this->file_count; i++)
+  {
+    if (this->OpenFile(this->files + i) != 0)
+    {
+      this->MainQuit();
+      return -1;
+    }
+  }
+
+  // Start reading ahead in each file
+  for (i = 0; i < this->file_count; i++)
+  {
+    f = this->files + i;
+    f->queue = (readlog_record_t*) calloc(this->read_ahead,
+                                          sizeof(readlog_record_t));
+    assert(f->queue);
+    f->queue_head = 0;
+    f->queue_count = 0;
+    f->in_heap = false;
+    f->eof = false;
+    f->command = 0;
+    f->quit = false;
+    if (pthread_create(&f->thread, NULL, &ReadLog::ReaderMain, f) != 0)
+    {
+      PLAYER_ERROR1("unable to start reading [%s]", f->filename);
+      this->MainQuit();
+      return -1;
+    }
+    f->running = true;
+  }
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Finalize the driver
+void ReadLog::MainQuit()
+{
+  int i, j;
+  readlog_file_t *f;
+
+  // Stop the readers
+  pthread_mutex_lock(&this->queue_mutex);
+  for (i = 0; i < this->file_count; i++)
+  {
+    this->files[i].quit = true;
+    pthread_cond_signal(&this->files[i].cond);
+  }
+  pthread_mutex_unlock(&this->queue_mutex);
+
+  for (i = 0; i < this->file_count; i++)
+  {
+    f = this->files + i;
+    if (f->running)
+    {
+      pthread_join(f->thread, NULL);
+      f->running = false;
+    }
+    for (j = 0; j < f->queue_count; j++)
+      this->FreeRecord(f->queue + (f->queue_head + j) % this->read_ahead);
+    f->queue_count = 0;
+    free(f->queue);
+    f->queue = NULL;
+    this->CloseFile(f);
+  }
+  this->heap_count = 0;
+  this->FreeRecord(&this->record);
+
+  // Free allocated mem
+  for (i = 0; i < this->reply_count; i++)
+  {
+    if (this->replies[i].data)
+      playerxdr_free_message(this->replies[i].data,
+                             this->provide_ids[this->replies[i].provide].interf,
+                             PLAYER_MSGTYPE_RESP_ACK,
+                             this->replies[i].subtype);
+  }
+  this->reply_count = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Open a log
+int ReadLog::OpenFile(readlog_file_t *f)
+{
+  // Open the file (possibly compressed, or binary)
+  if (binlog_match_filename(f->filename))
+  {
+    if (!(f->binlog = binlog_open(f->filename)))
+      return -1;
+  }
+  else if (strlen(f->filename) >= 3 &&
 #if defined (WIN32)
-      _strnicmp(this->filename + strlen(this->filename) - 3, ".gz", 3) == 0)
+      _strnicmp(f->filename + strlen(f->filename) - 3, ".gz", 3) == 0)
 #else
-      strcasecmp(this->filename + strlen(this->filename) - 3, ".gz") == 0)
+      strcasecmp(f->filename + strlen(f->filename) - 3, ".gz") == 0)
 #endif
   {
 #if HAVE_Z
-    this->gzfile = gzopen(this->filename, "r");
+    f->gzfile = gzopen(f->filename, "r");
 #else
     PLAYER_ERROR("no support for reading compressed log files");
     return -1;
 #endif
   }
   else
-    this->file = fopen(this->filename, "r");
+    f->file = fopen(f->filename, "r");
 
-  /** @todo Fix support for reading gzipped files */
-  if (this->file == NULL)
+#if HAVE_Z
+  if (f->file == NULL && f->gzfile == NULL && f->binlog == NULL)
+#else
+  if (f->file == NULL && f->binlog == NULL)
+#endif
   {
-    PLAYER_ERROR2("unable to open [%s]: %s\n", this->filename, strerror(errno));
+    PLAYER_ERROR2("unable to open [%s]: %s\n", f->filename, strerror(errno));
     return -1;
   }
 
-  // Rewind not requested by default
-  this->rewind_requested = false;
+  f->linenum = 0;
+  f->skipping = false;
+  f->format = strdup("unknown");
+
+  // Make some space for parsing data from the file.  This size is not
+  // an exact upper bound; it's just my best guess.
+  f->line_size = PLAYER_MAX_MESSAGE_SIZE;
+  f->line = (char*) malloc(f->line_size);
+  assert(f->line);
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Close a log
+void ReadLog::CloseFile(readlog_file_t *f)
+{
+  free(f->line);
+  f->line = NULL;
+  free(f->format);
+  f->format = NULL;
+
+#if HAVE_Z
+  if (f->gzfile)
+  {
+    gzclose(f->gzfile);
+    f->gzfile = NULL;
+  }
+#endif
+  if(f->file)
+  {
+    fclose(f->file);
+    f->file = NULL;
+  }
+  if(f->binlog)
+  {
+    binlog_close(f->binlog);
+    f->binlog = NULL;
+  }
+  if(f->index)
+  {
+    readlog_index_free(f->index);
+    f->index = NULL;
+  }
+  if(f->frames)
+  {
+    framestore_close(f->frames);
+    f->frames = NULL;
+  }
+  f->frames_tried = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Driver thread.  The reader threads read and parse the logs; this one
+// merges what they read by time, and publishes it when it is due.
+void ReadLog::Main()
+{
+  int ret;
+  bool have_record;
+  readlog_record_t *record;
+  bool reading_configs;
+
+  record = &this->record;
+  have_record = false;
+
+  // First thing, we'll read all the configs from the front of the files
+  reading_configs = true;
+
+  while (true)
+  {
+    pthread_testcancel();
+
+    // Process requests
+    if(!reading_configs)
+      ProcessMessages();
+
+    // If we're not supposed to playback data, wait for a request and loop
+    if(!this->enable && !reading_configs)
+    {
+      this->pace_reset = true;
+      this->Wait(READLOG_MAX_WAIT);
+      continue;
+    }
+
+    // If a client has requested that we jump to a time, then do so
+    if(!reading_configs && this->seek_requested)
+    {
+      this->seek_requested = false;
+      this->rewind_requested = false;
+      this->FreeRecord(record);
+      have_record = false;
+      if(this->Command(READLOG_SEEK, this->seek_time) != 0)
+        PLAYER_WARN1("unable to jump to time %.3f in the log", this->seek_time);
+      else
+        PLAYER_MSG1(2, "jumped to time %.3f in the log", this->seek_time);
+      this->pace_reset = true;
+      this->last_log_time = -1.0;
+      continue;
+    }
+
+    // If a client has requested that we rewind, then do so; if it does
+    // not work, the readers say so, and we keep going
+    if(!reading_configs && this->rewind_requested)
+    {
+      this->FreeRecord(record);
+      have_record = false;
+
+      // back up to the beginning of the files
+      if(this->Command(READLOG_REWIND, 0) == 0)
+      {
+        this->pace_reset = true;
+        this->last_log_time = -1.0;
+
+        // reset the time
+        ReadLogTime_time.tv_sec = 0;
+        ReadLogTime_time.tv_usec = 0;
+        ReadLogTime_timeDouble = 0.0;
+
+#if 0
+        // reset time-of-last-write in all clients
+        //
+        // FIXME: It's not really thread-safe to call this here, because it
+        //        writes to a bunch of fields that are also being read and/or
+        //        written in the server thread.  But I'll be damned if I'm
+        //        going to add a mutex just for this.
+        clientmanager->ResetClientTimestamps();
+#endif
+
+        // reset the flag
+        this->rewind_requested = false;
+
+        PLAYER_MSG0(2, "logfile rewound");
+        continue;
+      }
+    }
+
+    if(!have_record)
+    {
+      // Take the next message from the files, in time order
+      ret = this->NextRecord(reading_configs, record);
+
+      // Not read yet; handle requests meanwhile
+      if (ret < 0)
+        continue;
+
+      if (ret > 0)
+      {
+        // Files are done, so just loop forever, unless we're on
+        // auto-rewind, or until a client requests rewind.
+        reading_configs = false;
+
+        // deactivate driver so clients subscribing to the log interface will notice
+        if(!this->autorewind && !this->rewind_requested &&
+           !this->seek_requested)
+          this->enable=false;
+
+        while(!this->autorewind && !this->rewind_requested &&
+              !this->seek_requested)
+        {
+          usleep(100000);
+          pthread_testcancel();
+
+          // Process requests
+          this->ProcessMessages();
+
+          ReadLogTime_timeDouble += 0.1;
+          ReadLogTime_time.tv_sec = (time_t)floor(ReadLogTime_timeDouble);
+          ReadLogTime_time.tv_sec = (time_t)fmod(ReadLogTime_timeDouble,1.0);
+        }
+
+        // request a rewind and start again, unless a client wants to be
+        // somewhere else
+        if(!this->seek_requested)
+          this->rewind_requested = true;
+        continue;
+      }
+      have_record = true;
+
+      if(reading_configs && record->hdr.type != PLAYER_MSGTYPE_RESP_ACK)
+      {
+        // not a config; we'll play it next time through, once playback
+        // is enabled
+        reading_configs = false;
+        continue;
+      }
+    }
+    have_record = false;
+
+    // Set the global timestamp
+    ::ReadLogTime_timeDouble = record->time;
+    ::ReadLogTime_time.tv_sec = (time_t)floor(record->time);
+    ::ReadLogTime_time.tv_usec = (time_t)fmod(record->time,1.0);
+
+    // Wait until it's time to publish this message
+    if(!reading_configs)
+    {
+      if(!this->Pace(record->time))
+      {
+        this->FreeRecord(record);
+        continue;
+      }
+      this->last_log_time = record->time;
+      if (this->speed <= 0)
+        this->WaitForClients(record->provide,
+                             record->hdr.type, record->hdr.subtype);
+    }
+
+    // Replies in text logs are parsed now; everything else was parsed
+    // as it was read
+    if (record->tokens)
+    {
+      this->parse_filename = record->filename;
+      this->ParseData(this->provide_ids[record->provide],
+                      record->hdr.type, record->hdr.subtype,
+                      record->linenum, record->token_count, record->tokens,
+                      record->time);
+      this->FreeRecord(record);
+    }
+    else
+    {
+      this->PublishRecord(record->provide, &record->hdr, record->data);
+      record->data = NULL;
+    }
+  }
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Reader thread
+void *ReadLog::ReaderMain(void *arg)
+{
+  readlog_file_t *f;
+
+  f = (readlog_file_t*) arg;
+  pthread_setspecific(readlog_file_key, f);
+  f->driver->ReadAhead(f);
+  return(NULL);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Read ahead in a log, until told to quit.  Messages are parsed here;
+// what the parsers publish goes onto the file's queue (see Publish()).
+void ReadLog::ReadAhead(readlog_file_t *f)
+{
+  int i, ret, command, token_count, len;
+  double time;
+  char *tokens[READLOG_MAX_TOKENS];
+  char *text;
+  player_msghdr_t hdr;
+  void *data;
+  player_devaddr_t header_id;
+  unsigned short type, subtype;
+  readlog_record_t record;
+
+  while (true)
+  {
+    // Wait while there is nothing to do
+    pthread_mutex_lock(&this->queue_mutex);
+    while (f->eof && !f->command && !f->quit)
+      pthread_cond_wait(&f->cond, &this->queue_mutex);
+    if (f->quit)
+    {
+      pthread_mutex_unlock(&this->queue_mutex);
+      break;
+    }
+    command = f->command;
+    time = f->command_time;
+    pthread_mutex_unlock(&this->queue_mutex);
+
+    // Rewind or seek, as the driver thread asked
+    if (command)
+    {
+      if (command == READLOG_REWIND)
+        ret = this->Rewind(f);
+      else
+        ret = this->Seek(f, time);
+      pthread_mutex_lock(&this->queue_mutex);
+      f->command_result = ret;
+      f->command = 0;
+      f->eof = false;
+      pthread_cond_signal(&this->queue_cond);
+      pthread_mutex_unlock(&this->queue_mutex);
+      continue;
+    }
+
+    // Read the next message from the file
+    if (f->binlog)
+      ret = (binlog_read(f->binlog, &hdr, &data) != 0);
+    else
+      ret = this->ReadLine(f, &token_count, tokens);
+    if (ret != 0)
+    {
+      PLAYER_MSG1(1, "reached end of log file %s", f->filename);
+      pthread_mutex_lock(&this->queue_mutex);
+      f->eof = true;
+      pthread_cond_signal(&this->queue_cond);
+      pthread_mutex_unlock(&this->queue_mutex);
+      continue;
+    }
+
+    // Parse out the header info
+    if (f->binlog)
+    {
+      header_id = hdr.addr;
+      time = hdr.timestamp;
+      type = hdr.type;
+      subtype = hdr.subtype;
+    }
+    else if (this->ParseHeader(f->linenum, token_count, tokens,
+                               &header_id, &time, &type, &subtype) != 0)
+      continue;
+
+    // After a jump in a text log, skip to the time
+    if(f->skipping)
+    {
+      if(time < f->skip_time)
+        continue;
+      f->skipping = false;
+    }
+
+    // Look for a matching read interface; data will be output on
+    // the corresponding provides interface.
+    for (i = 0; i < this->provide_count; i++)
+    {
+      if(Device::MatchDeviceAddress(header_id, this->provide_ids[i]))
+        break;
+    }
+    if(i >= this->provide_count)
+    {
+      PLAYER_MSG6(2, "unhandled message from %d:%d:%d:%d %d:%d\n",
+                  header_id.host,
+                  header_id.robot,
+                  header_id.interf,
+                  header_id.index,
+                  type, subtype);
+      continue;
+    }
+    f->provide = i;
+    f->time = time;
+
+    if (f->binlog)
+    {
+      // Binary logs hold messages as they are published
+      hdr.addr = this->provide_ids[i];
+      this->Publish(&hdr, data, true);
+    }
+    else if (type == PLAYER_MSGTYPE_RESP_ACK)
+    {
+      // Keep a copy of the tokens, behind the list of them
+      len = 0;
+      for (i = 0; i < token_count; i++)
+        len += strlen(tokens[i]) + 1;
+      memset(&record, 0, sizeof(record));
+      record.time = time;
+      record.provide = f->provide;
+      record.hdr.addr = this->provide_ids[f->provide];
+      record.hdr.type = type;
+      record.hdr.subtype = subtype;
+      record.hdr.timestamp = time;
+      record.filename = f->filename;
+      record.linenum = f->linenum;
+      record.token_count = token_count;
+      record.tokens = (char**) malloc(token_count * sizeof(char*) + len);
+      assert(record.tokens);
+      text = (char*) (record.tokens + token_count);
+      for (i = 0; i < token_count; i++)
+      {
+        record.tokens[i] = text;
+        strcpy(text, tokens[i]);
+        text += strlen(tokens[i]) + 1;
+      }
+      this->Enqueue(f, &record);
+    }
+    else
+      this->ParseData(this->provide_ids[f->provide], type, subtype,
+                      f->linenum, token_count, tokens, time);
+  }
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Add a message to those read ahead in a log, once there is room.  It is
+// dropped if the log is to be rewound or moved meanwhile.
+void ReadLog::Enqueue(readlog_file_t *f, readlog_record_t *record)
+{
+  pthread_mutex_lock(&this->queue_mutex);
+  while (f->queue_count == this->read_ahead && !f->command && !f->quit)
+    pthread_cond_wait(&f->cond, &this->queue_mutex);
+  if (f->command || f->quit)
+  {
+    pthread_mutex_unlock(&this->queue_mutex);
+    this->FreeRecord(record);
+    return;
+  }
+  f->queue[(f->queue_head + f->queue_count) % this->read_ahead] = *record;
+  if (f->queue_count++ == 0)
+    pthread_cond_signal(&this->queue_cond);
+  pthread_mutex_unlock(&this->queue_mutex);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Whether the next message read in one log comes before that in another
+static bool readlog_before(const readlog_file_t *a, const readlog_file_t *b)
+{
+  double ta, tb;
+
+  ta = a->queue[a->queue_head].time;
+  tb = b->queue[b->queue_head].time;
+  return(ta < tb || (ta == tb && a->id < b->id));
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Add a log to the heap of logs with a message ready
+static void readlog_heap_push(readlog_file_t **heap, int *count,
+                              readlog_file_t *f)
+{
+  int i, parent;
+
+  for (i = (*count)++; i > 0; i = parent)
+  {
+    parent = (i - 1) / 2;
+    if (!readlog_before(f, heap[parent]))
+      break;
+    heap[i] = heap[parent];
+  }
+  heap[i] = f;
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Take the log with the earliest message ready off the heap
+static readlog_file_t *readlog_heap_pop(readlog_file_t **heap, int *count)
+{
+  int i, child;
+  readlog_file_t *top, *last;
+
+  top = heap[0];
+  last = heap[--(*count)];
+  for (i = 0; (child = 2 * i + 1) < *count; i = child)
+  {
+    if (child + 1 < *count && readlog_before(heap[child + 1], heap[child]))
+      child++;
+    if (!readlog_before(heap[child], last))
+      break;
+    heap[i] = heap[child];
+  }
+  if (*count > 0)
+    heap[i] = last;
+  return(top);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Take the next message in time order from all the logs.  The first
+// message in each log must be known to tell which is next, so this waits
+// for each reader to get one (or to reach the end), up to a limit, so
+// that requests are not held up.  Replies at the start of the logs are
+// taken before anything else, as they set the driver up.
+int ReadLog::NextRecord(bool replies_first, readlog_record_t *record)
+{
+  int i, ret, state;
+  bool ready;
+  double t;
+  struct timespec deadline;
+  readlog_file_t *f, *g;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  t = deadline.tv_sec + deadline.tv_nsec * 1e-9 + READLOG_MAX_WAIT;
+  deadline.tv_sec = (time_t) floor(t);
+  deadline.tv_nsec = (long) ((t - floor(t)) * 1e9);
+
+  // Being cancelled while waiting would leave the mutex locked
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+  pthread_mutex_lock(&this->queue_mutex);
+
+  f = NULL;
+  while (true)
+  {
+    ready = true;
+    for (i = 0; i < this->file_count && !f; i++)
+    {
+      g = this->files + i;
+      if (g->in_heap)
+        continue;
+      if (g->queue_count == 0)
+      {
+        if (!g->eof)
+          ready = false;
+        continue;
+      }
+      if (replies_first &&
+          g->queue[g->queue_head].hdr.type == PLAYER_MSGTYPE_RESP_ACK)
+        f = g;
+      else
+      {
+        readlog_heap_push(this->heap, &this->heap_count, g);
+        g->in_heap = true;
+      }
+    }
+    if (f)
+      break;
+    if (ready)
+    {
+      if (this->heap_count > 0)
+      {
+        f = readlog_heap_pop(this->heap, &this->heap_count);
+        f->in_heap = false;
+      }
+      break;
+    }
+    if (pthread_cond_timedwait(&this->queue_cond, &this->queue_mutex,
+                               &deadline) == ETIMEDOUT)
+      break;
+  }
+
+  if (f)
+  {
+    *record = f->queue[f->queue_head];
+    f->queue_head = (f->queue_head + 1) % this->read_ahead;
+    f->queue_count--;
+    pthread_cond_signal(&f->cond);
+    ret = 0;
+  }
+  else
+    ret = ready ? 1 : -1;
+
+  pthread_mutex_unlock(&this->queue_mutex);
+  pthread_setcancelstate(state, NULL);
+  return(ret);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Have every reader rewind or seek, dropping what it has read ahead, and
+// wait until they have.  Returns -1 if any of them could not.
+int ReadLog::Command(int command, double time)
+{
+  int i, j, ret, state;
+  readlog_file_t *f;
+
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+  pthread_mutex_lock(&this->queue_mutex);
+
+  this->heap_count = 0;
+  for (i = 0; i < this->file_count; i++)
+  {
+    f = this->files + i;
+    for (j = 0; j < f->queue_count; j++)
+      this->FreeRecord(f->queue + (f->queue_head + j) % this->read_ahead);
+    f->queue_count = 0;
+    f->in_heap = false;
+    f->command = command;
+    f->command_time = time;
+    pthread_cond_signal(&f->cond);
+  }
+
+  ret = 0;
+  for (i = 0; i < this->file_count; i++)
+  {
+    f = this->files + i;
+    while (f->command)
+      pthread_cond_wait(&this->queue_cond, &this->queue_mutex);
+    if (f->command_result != 0)
+      ret = -1;
+  }
+
+  pthread_mutex_unlock(&this->queue_mutex);
+  pthread_setcancelstate(state, NULL);
+  return(ret);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Free a message read ahead
+void ReadLog::FreeRecord(readlog_record_t *record)
+{
+  if (record->data)
+    playerxdr_free_message(record->data, record->hdr.addr.interf,
+                           record->hdr.type, record->hdr.subtype);
+  record->data = NULL;
+  free(record->tokens);
+  record->tokens = NULL;
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Name of the log the message being parsed is from
+const char *ReadLog::LogFilename()
+{
+  readlog_file_t *f;
+
+  if ((f = (readlog_file_t*) pthread_getspecific(readlog_file_key)))
+    return(f->filename);
+  return(this->parse_filename);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Frame store of the log being parsed, or NULL if it has none
+framestore_t *ReadLog::FrameStore()
+{
+  readlog_file_t *f;
+  char filename[1024];
+
+  // Logs are converted one at a time, without reader threads
+  if (!(f = (readlog_file_t*) pthread_getspecific(readlog_file_key)))
+    f = this->files;
+
+  if (!f->frames && !f->frames_tried)
+  {
+    f->frames_tried = true;
+    if (framestore_filename(f->filename, filename, sizeof(filename)) == 0)
+      f->frames = framestore_open(filename);
+  }
+  return(f->frames);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Read the next line of a text log and split it into tokens, skipping
+// comments.  Returns 0 on success, 1 at the end of the file.
+int ReadLog::ReadLine(readlog_file_t *f, int *token_count, char **tokens)
+{
+  int i, len, ret;
+  char *line;
+
+  line = f->line;
+  while (true)
+  {
+    // Read a line from the file; note that gzgets is really slow
+    // compared to fgets (on uncompressed files), so use the latter.
+#if HAVE_Z
+    if (f->gzfile)
+      ret = (gzgets(f->gzfile, line, f->line_size) == NULL);
+    else
+      ret = (fgets(line, f->line_size, f->file) == NULL);
+#else
+    ret = (fgets(line, f->line_size, f->file) == NULL);
+#endif
+    if (ret != 0)
+      return 1;
+
+    // Possible buffer overflow, so bail
+    assert(strlen(line) < f->line_size);
+
+    f->linenum += 1;
+
+    // Tokenize the line using whitespace separators
+    *token_count = 0;
+    len = strlen(line);
+    for (i = 0; i < len; i++)
+    {
+      if (isspace(line[i]))
+        line[i] = 0;
+      else if (i == 0 || line[i - 1] == 0)
+      {
+        assert(*token_count < READLOG_MAX_TOKENS);
+        tokens[(*token_count)++] = line + i;
+      }
+    }
+
+    if (*token_count >= 1)
+    {
+      // Discard comments
+      if (strcmp(tokens[0], "#") == 0)
+        continue;
+
+      // Parse meta-data
+      if (strcmp(tokens[0], "##") == 0)
+      {
+        if (*token_count == 4)
+        {
+          free(f->format);
+          f->format = strdup(tokens[3]);
+        }
+        continue;
+      }
+    }
+    return 0;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Time on the clock that playback is paced with [s]
+static double readlog_clock()
+{
+  struct timespec ts;
+
+  clock_gettime(READLOG_CLOCK, &ts);
+  return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Sleep until a time on the pacing clock
+static void readlog_sleep_until(double due)
+{
+#if HAVE_CLOCK_NANOSLEEP
+  struct timespec ts;
 
-  // Make some space for parsing data from the file.  This size is not
-  // an exact upper bound; it's just my best guess.
-  this->line_size = PLAYER_MAX_MESSAGE_SIZE;
-  this->line = (char*) malloc(this->line_size);
-  assert(this->line);
+  ts.tv_sec = (time_t) floor(due);
+  ts.tv_nsec = (long) ((due - floor(due)) * 1e9);
+  clock_nanosleep(READLOG_CLOCK, TIMER_ABSTIME, &ts, NULL);
+#else
+  double now;
 
-  return 0;
+  now = readlog_clock();
+  if(due > now)
+    usleep((int) ((due - now) * 1e6));
+#endif
+  return;
 }
 
 
 ////////////////////////////////////////////////////////////////////////////
-// Finalize the driver
-void ReadLog::MainQuit()
+// Move back to the start of a log
+int ReadLog::Rewind(readlog_file_t *f)
 {
-  // Free allocated mem
-  free(this->line);
+  int ret;
 
-  // Close the file
+  if (f->binlog)
+    ret = binlog_rewind(f->binlog);
 #if HAVE_Z
-  if (this->gzfile)
-  {
-    gzclose(this->gzfile);
-    this->gzfile = NULL;
-  }
+  else if (f->gzfile)
+    ret = gzseek(f->gzfile,0,SEEK_SET);
 #endif
-  if(this->file)
+  else
+    ret = fseek(f->file,0,SEEK_SET);
+
+  if(ret < 0)
   {
-    fclose(this->file);
-    this->file = NULL;
+    PLAYER_WARN2("while rewinding %s, gzseek()/fseek() failed: %s",
+                 f->filename, strerror(errno));
+    return(-1);
   }
+  f->linenum = 0;
+  f->skipping = false;
+  return(0);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////
-// Driver thread
-void ReadLog::Main()
+// Move to the first message logged at or after time.  Binary logs have
+// their own index; text logs have one built for them.
+int ReadLog::Seek(readlog_file_t *f, double time)
 {
-  int ret;
-  int i, len, linenum;
-  bool use_stored_tokens;
-  int token_count=0;
-  char *tokens[4096];
-  player_devaddr_t header_id, provide_id;
-  struct timeval tv;
-  double last_wall_time, curr_wall_time;
-  double curr_log_time, last_log_time;
-  unsigned short type, subtype;
-  bool reading_configs;
+  int64_t offset;
+  int line, ret;
 
-  linenum = 0;
+  if (f->binlog)
+    return(binlog_seek(f->binlog, time));
 
-  last_wall_time = -1.0;
-  last_log_time = -1.0;
+  if (!f->index && !(f->index = readlog_index_load(f->filename)))
+    return(-1);
+  if (readlog_index_find(f->index, time, &offset, &line) != 0)
+    return(-1);
 
-  // First thing, we'll read all the configs from the front of the file
-  reading_configs = true;
-  use_stored_tokens = false;
+#if HAVE_Z
+  if (f->gzfile)
+    ret = (gzseek(f->gzfile, (z_off_t) offset, SEEK_SET) < 0);
+  else
+    ret = readlog_fseek(f->file, offset, SEEK_SET);
+#else
+  ret = readlog_fseek(f->file, offset, SEEK_SET);
+#endif
+  if (ret != 0)
+    return(-1);
+
+  // The index only gets close; the lines up to the time are skipped
+  f->linenum = line - 1;
+  f->skipping = true;
+  f->skip_time = time;
+  return(0);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Wait until it is time to publish a message.  Each message is due at a
+// fixed time after the point playback is paced from, rather than after
+// the one before, so waits do not add up to drift.  Requests are handled
+// while waiting; the last moments are slept out on the clock, to be on
+// time.
+bool ReadLog::Pace(double log_time)
+{
+  double now, due, wait;
 
   while (true)
   {
-    pthread_testcancel();
+    now = readlog_clock();
 
-    // Process requests
-    if(!reading_configs)
-      ProcessMessages();
+    // As fast as the clients go: WaitForClients() holds us back
+    if (this->speed <= 0)
+    {
+      this->pace_reset = true;
+      return(true);
+    }
 
-    // If we're not supposed to playback data, sleep and loop
-    if(!this->enable && !reading_configs)
+    // Carry on from the last message published, if there was one
+    if (this->pace_reset)
+    {
+      this->pace_reset = false;
+      this->pace_wall_time = now;
+      this->pace_log_time =
+        (this->last_log_time >= 0) ? this->last_log_time : log_time;
+    }
+
+    due = this->pace_wall_time + (log_time - this->pace_log_time) / this->speed;
+
+    // Too far behind to catch up; carry on from here
+    if (now - due > READLOG_MAX_LAG)
     {
-      usleep(10000);
+      this->pace_wall_time = now;
+      this->pace_log_time = log_time;
+      return(true);
+    }
+    if (now >= due)
+      return(true);
+
+    if (due - now <= READLOG_SLEEP)
+    {
+      readlog_sleep_until(due);
       continue;
     }
 
-    // If a client has requested that we rewind, then do so
-    if(!reading_configs && this->rewind_requested)
+    wait = due - now - READLOG_SLEEP;
+    if (wait > READLOG_MAX_WAIT)
+      wait = READLOG_MAX_WAIT;
+    this->Wait(wait);
+    this->ProcessMessages();
+
+    // Paused: hold on to this message until playback starts again
+    while (!this->enable && !this->rewind_requested && !this->seek_requested)
     {
-      // back up to the beginning of the file
-#if HAVE_Z
-      if (this->gzfile)
-        ret = gzseek(this->gzfile,0,SEEK_SET);
-      else
-        ret = fseek(this->file,0,SEEK_SET);
-#else
-      ret = fseek(this->file,0,SEEK_SET);
-#endif
+      this->pace_reset = true;
+      this->Wait(READLOG_MAX_WAIT);
+      this->ProcessMessages();
+    }
+    if (this->rewind_requested || this->seek_requested)
+      return(false);
+  }
+}
 
-      if(ret < 0)
-      {
-        // oh well, warn the user and keep going
-        PLAYER_WARN1("while rewinding logfile, gzseek()/fseek() failed: %s",
-                     strerror(errno));
-      }
-      else
-      {
-        linenum = 0;
 
-        // reset the time
-        ReadLogTime_time.tv_sec = 0;
-        ReadLogTime_time.tv_usec = 0;
-        ReadLogTime_timeDouble = 0.0;
+////////////////////////////////////////////////////////////////////////////
+// At speed 0, wait until every client of a device has room in its queue
+// for a message, without it replacing one they have not taken yet.
+// Clients do not say when they take data, so look again, less and less
+// often; requests wake us sooner.
+void ReadLog::WaitForClients(int provide, uint8_t type, uint8_t subtype)
+{
+  Device *dev;
+  double poll;
 
-#if 0
-        // reset time-of-last-write in all clients
-        //
-        // FIXME: It's not really thread-safe to call this here, because it
-        //        writes to a bunch of fields that are also being read and/or
-        //        written in the server thread.  But I'll be damned if I'm
-        //        going to add a mutex just for this.
-        clientmanager->ResetClientTimestamps();
-#endif
+  if (!(dev = deviceTable->GetDevice(this->provide_ids[provide], false)))
+    return;
 
-        // reset the flag
-        this->rewind_requested = false;
+  poll = READLOG_MIN_POLL;
+  while (dev->GetBacklog(type, subtype) > READLOG_MAX_BACKLOG)
+  {
+    this->Wait(poll);
+    this->ProcessMessages();
+    if (poll < READLOG_SLEEP)
+      poll *= 2;
+    if (this->rewind_requested || this->seek_requested ||
+        !this->enable || this->speed > 0)
+      break;
+  }
+  return;
+}
 
-        PLAYER_MSG0(2, "logfile rewound");
-        continue;
-      }
-    }
 
-    if(!use_stored_tokens)
+////////////////////////////////////////////////////////////////////////////
+// Publish a message read from a log, taking its data.  Replies from
+// binary logs are kept, to answer requests with, as the text parsers keep
+// geometries; everything else is published as it was read.
+void ReadLog::PublishRecord(int provide, player_msghdr_t *hdr, void *data)
+{
+  int i;
+  player_devaddr_t id;
+
+  id = this->provide_ids[provide];
+  if (hdr->type != PLAYER_MSGTYPE_RESP_ACK)
+  {
+    this->Publish(hdr, data, false);
+    return;
+  }
+
+  for (i = 0; i < this->reply_count; i++)
+  {
+    if (this->replies[i].provide == provide &&
+        this->replies[i].subtype == hdr->subtype)
+      break;
+  }
+  if (i == this->reply_count)
+  {
+    if (i == (int) (sizeof(this->replies) / sizeof(this->replies[0])))
     {
-      // Read a line from the file; note that gzgets is really slow
-      // compared to fgets (on uncompressed files), so use the latter.
-#if HAVE_Z
-      if (this->gzfile)
-        ret = (gzgets(this->gzfile, this->line, this->line_size) == NULL);
-      else
-        ret = (fgets(this->line, this->line_size, (FILE*) this->file) == NULL);
-#else
-      ret = (fgets(this->line, this->line_size, (FILE*) this->file) == NULL);
-#endif
+      PLAYER_WARN("too many logged replies; ignoring the rest");
+      if (data)
+        playerxdr_free_message(data, id.interf, PLAYER_MSGTYPE_RESP_ACK,
+                               hdr->subtype);
+      return;
+    }
+    this->replies[i].provide = provide;
+    this->replies[i].subtype = hdr->subtype;
+    this->replies[i].data = NULL;
+    this->reply_count++;
+  }
+  else if (this->replies[i].data)
+  {
+    playerxdr_free_message(this->replies[i].data, id.interf,
+                           PLAYER_MSGTYPE_RESP_ACK, hdr->subtype);
+    this->replies[i].data = NULL;
+  }
 
-      if (ret != 0)
-      {
-        PLAYER_MSG1(1, "reached end of log file %s", this->filename);
-        // File is done, so just loop forever, unless we're on auto-rewind,
-        // or until a client requests rewind.
-        reading_configs = false;
+  this->replies[i].data = data;
+  return;
+}
 
-        // deactivate driver so clients subscribing to the log interface will notice
-        if(!this->autorewind && !this->rewind_requested)
-          this->enable=false;
 
-        while(!this->autorewind && !this->rewind_requested)
-        {
-          usleep(100000);
-          pthread_testcancel();
+////////////////////////////////////////////////////////////////////////////
+// Answer a request with the reply to it in a binary log, if there is one
+int ReadLog::ProcessLoggedReply(QueuePointer & resp_queue,
+                                player_msghdr_t * hdr)
+{
+  int i;
 
-          // Process requests
-          this->ProcessMessages();
+  for (i = 0; i < this->reply_count; i++)
+  {
+    if (this->replies[i].subtype == hdr->subtype &&
+        Device::MatchDeviceAddress(this->provide_ids[this->replies[i].provide],
+                                   hdr->addr))
+    {
+      this->Publish(this->provide_ids[this->replies[i].provide], resp_queue,
+                    PLAYER_MSGTYPE_RESP_ACK, hdr->subtype,
+                    this->replies[i].data, 0, NULL);
+      return(0);
+    }
+  }
+  return(-1);
+}
 
-          ReadLogTime_timeDouble += 0.1;
-          ReadLogTime_time.tv_sec = (time_t)floor(ReadLogTime_timeDouble);
-          ReadLogTime_time.tv_sec = (time_t)fmod(ReadLogTime_timeDouble,1.0);
-        }
 
-        // request a rewind and start again
-        this->rewind_requested = true;
-        continue;
-      }
+////////////////////////////////////////////////////////////////////////////
+// Publish a message, or write it to the binary log when converting, or
+// queue it when parsed by a reader thread
+void ReadLog::Publish(QueuePointer &queue,
+                      player_msghdr_t* hdr,
+                      void* src,
+                      bool copy)
+{
+  if (this->converting)
+    this->WriteConverted(hdr, src);
+  else
+    Driver::Publish(queue, hdr, src, copy);
+}
 
-      // Possible buffer overflow, so bail
-      assert(strlen(this->line) < this->line_size);
+void ReadLog::Publish(player_msghdr_t* hdr,
+                      void* src,
+                      bool copy)
+{
+  readlog_file_t *f;
+  readlog_record_t record;
 
-      linenum += 1;
+  if (this->converting)
+    this->WriteConverted(hdr, src);
+  else if ((f = (readlog_file_t*) pthread_getspecific(readlog_file_key)))
+  {
+    // Parsed by a reader thread: it is published in turn, from the
+    // driver thread
+    memset(&record, 0, sizeof(record));
+    record.time = f->time;
+    record.provide = f->provide;
+    record.hdr = *hdr;
+    if (src && copy)
+      record.data = playerxdr_clone_message(src, hdr->addr.interf,
+                                            hdr->type, hdr->subtype);
+    else
+      record.data = src;
+    this->Enqueue(f, &record);
+  }
+  else
+    Driver::Publish(hdr, src, copy);
+}
 
-      //printf("line %d\n", linenum);
-      //continue;
 
-      // Tokenize the line using whitespace separators
-      token_count = 0;
-      len = strlen(line);
-      for (i = 0; i < len; i++)
-      {
-        if (isspace(line[i]))
-          line[i] = 0;
-        else if (i == 0)
-        {
-          assert(token_count < (int) (sizeof(tokens) / sizeof(tokens[i])));
-          tokens[token_count++] = line + i;
-        }
-        else if (line[i - 1] == 0)
-        {
-          assert(token_count < (int) (sizeof(tokens) / sizeof(tokens[i])));
-          tokens[token_count++] = line + i;
-        }
-      }
+////////////////////////////////////////////////////////////////////////////
+// Write a converted message to the binary log
+void ReadLog::WriteConverted(player_msghdr_t *hdr, void *data)
+{
+  this->convert_count++;
+  if (this->convert_log && binlog_write(this->convert_log, hdr, data) != 0)
+    this->convert_errors++;
+}
 
-      if (token_count >= 1)
-      {
-        // Discard comments
-        if (strcmp(tokens[0], "#") == 0)
-          continue;
 
-        // Parse meta-data
-        if (strcmp(tokens[0], "##") == 0)
-        {
-          if (token_count == 4)
-          {
-            free(this->format);
-            this->format = strdup(tokens[3]);
-          }
-          continue;
-        }
-      }
-    }
-    else
-      use_stored_tokens = false;
+////////////////////////////////////////////////////////////////////////////
+// Convert the (first) text log to a binary log.  Every device in the log
+// is converted, whether or not it is in the provides list.  The text parsers
+// keep replies (geometries and the like) to answer requests with, rather
+// than publishing them, so for each reply the request is made, and the
+// answer written out.
+int ReadLog::Convert(const char *dst, int flags)
+{
+  int i, linenum, token_count;
+  char *tokens[READLOG_MAX_TOKENS];
+  player_devaddr_t header_id;
+  player_msghdr_t req;
+  double curr_log_time;
+  unsigned short type, subtype;
+  QueuePointer no_queue;
+  readlog_file_t *f;
 
-    // Parse out the header info
+  // This is done on this thread, without reading ahead
+  f = this->files;
+  if (binlog_match_filename(f->filename))
+  {
+    PLAYER_ERROR1("[%s] is already a binary log", f->filename);
+    return(-1);
+  }
+  if (this->OpenFile(f) != 0)
+    return(-1);
+  if (dst && !(this->convert_log = binlog_create(dst, flags)))
+  {
+    this->MainQuit();
+    return(-1);
+  }
+
+  this->converting = true;
+  this->convert_count = 0;
+  this->convert_errors = 0;
+  while (this->ReadLine(f, &token_count, tokens) == 0)
+  {
+    linenum = f->linenum;
     if (this->ParseHeader(linenum, token_count, tokens,
                           &header_id, &curr_log_time, &type, &subtype) != 0)
       continue;
 
-    if(reading_configs)
-    {
-      if(type != PLAYER_MSGTYPE_RESP_ACK)
-      {
-        // not a config
-        reading_configs = false;
-        // we'll reuse this tokenized string next time through, instead of
-        // reading a fresh line from the file
-        use_stored_tokens = true;
-        continue;
-      }
-    }
-
-    // Set the global timestamp
+    // Set the global timestamp, which replies are stamped with
     ::ReadLogTime_timeDouble = curr_log_time;
     ::ReadLogTime_time.tv_sec = (time_t)floor(curr_log_time);
     ::ReadLogTime_time.tv_usec = (time_t)fmod(curr_log_time,1.0);
 
-    gettimeofday(&tv,NULL);
-    curr_wall_time = tv.tv_sec + tv.tv_usec/1e6;
-    if(!reading_configs)
+    // Provide each new device, as the constructor does
+    for (i = 0; i < this->provide_count; i++)
     {
-      // Have we published at least one message from this log?
-      if(last_wall_time >= 0)
-      {
-        // Wait until it's time to publish this message
-        while((curr_wall_time - last_wall_time) <
-              ((curr_log_time - last_log_time) / this->speed))
-        {
-          gettimeofday(&tv,NULL);
-          curr_wall_time = tv.tv_sec + tv.tv_usec/1e6;
-          this->ProcessMessages();
-          usleep(1000);
-        }
-      }
-
-      last_wall_time = curr_wall_time;
-      last_log_time = curr_log_time;
+      if (Device::MatchDeviceAddress(header_id, this->provide_ids[i]))
+        break;
     }
-
-    // Look for a matching read interface; data will be output on
-    // the corresponding provides interface.
-    for (i = 0; i < this->provide_count; i++)
+    if (i == this->provide_count)
     {
-      provide_id = this->provide_ids[i];
-      if(Device::MatchDeviceAddress(header_id, provide_id))
+      if (i == (int) (sizeof(this->provide_ids) / sizeof(this->provide_ids[0])))
       {
-        this->ParseData(provide_id, type, subtype,
-                        linenum, token_count, tokens, curr_log_time);
-        break;
+        PLAYER_WARN2("too many devices; skipping line %s:%d",
+                     f->filename, linenum);
+        continue;
+      }
+      this->provide_ids[this->provide_count++] = header_id;
+      if (header_id.interf == PLAYER_SONAR_CODE)
+      {
+        this->provide_metadata[i] = calloc(sizeof(player_sonar_geom_t),1);
+        assert(this->provide_metadata[i]);
       }
+      if (header_id.interf == PLAYER_LOCALIZE_CODE)
+        this->localize_addr = header_id;
     }
-    if(i >= this->provide_count)
-    {
-      PLAYER_MSG6(2, "unhandled message from %d:%d:%d:%d %d:%d\n",
-                  header_id.host,
-                  header_id.robot,
-                  header_id.interf,
-                  header_id.index,
-                  type, subtype);
 
+    if (this->ParseData(header_id, type, subtype,
+                        linenum, token_count, tokens, curr_log_time) != 0)
+      continue;
+
+    if (type == PLAYER_MSGTYPE_RESP_ACK)
+    {
+      memset(&req, 0, sizeof(req));
+      req.addr = header_id;
+      req.type = PLAYER_MSGTYPE_REQ;
+      req.subtype = subtype;
+      req.timestamp = curr_log_time;
+      if (this->ProcessMessage(no_queue, &req, NULL) != 0)
+        PLAYER_WARN2("cannot convert the reply at %s:%d",
+                     f->filename, linenum);
     }
   }
+  this->converting = false;
 
-  return;
+  if (this->convert_log)
+  {
+    if (binlog_close(this->convert_log) != 0)
+      this->convert_errors++;
+    this->convert_log = NULL;
+  }
+  this->MainQuit();
+
+  PLAYER_MSG3(1, "converted %d messages from %s, with %d errors",
+              this->convert_count, f->filename, this->convert_errors);
+  return(this->convert_errors ? -1 : this->convert_count);
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+// Convert a text log to a binary log
+int readlog_convert(const char *src, const char *dst, int flags)
+{
+  ConfigFile cf;
+  ReadLog *reader;
+  char path[1024];
+  int ret;
+
+  // There is no config file for relative file names to be relative to,
+  // so make them absolute
+  if (src[0] == '/' || src[0] == '~')
+    snprintf(path, sizeof(path), "%s", src);
+  else if (getcwd(path, sizeof(path)) == NULL ||
+           strlen(path) + strlen(src) + 2 > sizeof(path))
+  {
+    PLAYER_ERROR1("file name [%s] is too long", src);
+    return(-1);
+  }
+  else
+  {
+    strcat(path, "/");
+    strcat(path, src);
+  }
+
+  // Fields inserted directly go in the global section
+  cf.InsertFieldValue(0, "filename", path);
+  reader = new ReadLog(&cf, -1);
+  if (reader->GetError() != 0)
+    ret = -1;
+  else
+    ret = reader->Convert(dst, flags);
+  delete reader;
+  return(ret);
+}
+
 
 ////////////////////////////////////////////////////////////////////////////
 // Process configuration requests
@@ -884,6 +2161,8 @@ int ReadLog::ProcessLogConfig(QueuePointer & resp_queue,
 {
   player_log_set_read_state_t* sreq;
   player_log_get_state_t greq;
+  player_log_set_read_time_t* treq;
+  player_log_set_read_speed_t* vreq;
 
   switch(hdr->subtype)
   {
@@ -932,6 +2211,42 @@ int ReadLog::ProcessLogConfig(QueuePointer & resp_queue,
                     PLAYER_LOG_REQ_SET_READ_REWIND);
       return(0);
 
+    case PLAYER_LOG_REQ_SET_READ_TIME:
+      if(hdr->size != sizeof(player_log_set_read_time_t))
+      {
+        PLAYER_WARN2("request wrong size (%d != %d)",
+                     hdr->size, sizeof(player_log_set_read_time_t));
+        return(-1);
+      }
+      treq = (player_log_set_read_time_t*)data;
+
+      // the main loop does the work, as for rewinding
+      this->seek_time = treq->time;
+      this->seek_requested = true;
+
+      this->Publish(this->log_id, resp_queue,
+                    PLAYER_MSGTYPE_RESP_ACK,
+                    PLAYER_LOG_REQ_SET_READ_TIME);
+      return(0);
+
+    case PLAYER_LOG_REQ_SET_READ_SPEED:
+      if(hdr->size != sizeof(player_log_set_read_speed_t))
+      {
+        PLAYER_WARN2("request wrong size (%d != %d)",
+                     hdr->size, sizeof(player_log_set_read_speed_t));
+        return(-1);
+      }
+      vreq = (player_log_set_read_speed_t*)data;
+      if(vreq->speed < 0)
+        return(-1);
+      this->speed = vreq->speed;
+      this->pace_reset = true;
+
+      this->Publish(this->log_id, resp_queue,
+                    PLAYER_MSGTYPE_RESP_ACK,
+                    PLAYER_LOG_REQ_SET_READ_SPEED);
+      return(0);
+
     default:
       return(-1);
   }
@@ -1268,6 +2583,11 @@ ReadLog::ProcessMessage(QueuePointer & resp_queue,
   {
     return(this->ProcessLogConfig(resp_queue, hdr, data));
   }
+  else if((hdr->type == PLAYER_MSGTYPE_REQ) &&
+          (this->ProcessLoggedReply(resp_queue, hdr) == 0))
+  {
+    return(0);
+  }
   else if((hdr->type == PLAYER_MSGTYPE_REQ) &&
           (hdr->addr.interf == PLAYER_FIDUCIAL_CODE))
   {
@@ -1350,7 +2670,7 @@ ReadLog::ParseHeader(int linenum, int token_count, char **tokens,
 
   if (token_count < 7)
   {
-    PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
 
@@ -1473,7 +2793,7 @@ int ReadLog::ParseBlobfinder(player_devaddr_t id,
 
   if (token_count < 10)
   {
-    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
 
@@ -1484,7 +2804,7 @@ int ReadLog::ParseBlobfinder(player_devaddr_t id,
 
   if (token_count < 10 + blob_count * 10)
   {
-    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
   player_blobfinder_blob_t *blob = new player_blobfinder_blob_t[blob_count];
@@ -1522,7 +2842,7 @@ int ReadLog::ParseCamera(player_devaddr_t id,
 
   if (token_count < 14)
   {
-    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
 
@@ -1533,6 +2853,38 @@ int ReadLog::ParseCamera(player_devaddr_t id,
   data.compression = atoi(tokens[11]);
   data.image_count = atoi(tokens[12]);
 
+  // The image is in the frame store, and is published from there
+  if (tokens[13][0] == '@')
+  {
+    framestore_t *frames;
+    const void *image;
+    size_t size;
+    long frame;
+
+    // The frame was dropped when it was logged
+    frame = atol(tokens[13] + 1);
+    if (frame < 0)
+      return 0;
+
+    if (!(frames = this->FrameStore()))
+    {
+      PLAYER_ERROR2("no frame store for the image at %s:%d",
+                    this->LogFilename(), linenum);
+      return -1;
+    }
+    if (framestore_read(frames, (uint32_t) frame, &image, &size) != 0 ||
+        size != data.image_count)
+    {
+      PLAYER_ERROR3("frame %ld is missing from the frame store, at %s:%d",
+                    frame, this->LogFilename(), linenum);
+      return -1;
+    }
+    data.image = (uint8_t*) image;
+    this->Publish(id, type, subtype, (void*) &data,
+                  sizeof(data) - sizeof(data.image) + size, &time);
+    return 0;
+  }
+
   // Check sizes
   src_size = strlen(tokens[13]);
   dst_size = ::DecodeHexSize(src_size);
@@ -1559,7 +2911,7 @@ int ReadLog::ParseFiducial(player_devaddr_t id,
 {
   if (token_count < 7)
   {
-    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
 
@@ -1606,7 +2958,7 @@ int ReadLog::ParseFiducial(player_devaddr_t id,
 
                     if (token_count < 17) {
                         PLAYER_ERROR2("incomplete line at %s:%d",
-                                this->filename, linenum);
+                                this->LogFilename(), linenum);
                         return -1;
                     }
                     player_fiducial_geom_t* geom;
@@ -1667,7 +3019,7 @@ int ReadLog::ParseGps(player_devaddr_t id,
 
   if (token_count < 19)
   {
-    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
 
@@ -1714,7 +3066,7 @@ int ReadLog::ParseJoystick(player_devaddr_t id,
 
   if (token_count < 14)
   {
-    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
     return -1;
   }
 
@@ -1753,7 +3105,7 @@ int ReadLog::ParseLaser(player_devaddr_t id,
             if (token_count < 13)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -1779,7 +3131,7 @@ int ReadLog::ParseLaser(player_devaddr_t id,
             if (count != (int)data.ranges_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               ret = -1;
             }
             else
@@ -1800,7 +3152,7 @@ int ReadLog::ParseLaser(player_devaddr_t id,
             if (token_count < 16)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -1829,7 +3181,7 @@ int ReadLog::ParseLaser(player_devaddr_t id,
             if (count != (int)data.scan.ranges_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               ret = -1;
             }
             else
@@ -1857,7 +3209,7 @@ int ReadLog::ParseLaser(player_devaddr_t id,
             if(token_count < 12)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -1924,7 +3276,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (token_count < 8)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -1942,7 +3294,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (count != (int)data.ranges_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               ret = -1;
             }
             else
@@ -1962,7 +3314,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (token_count < 10)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -1986,7 +3338,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (count != (int)data.data.ranges_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] data.data.ranges;
 	      return -1;
             }
@@ -1999,7 +3351,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (token_count < total_count+11)
 		  {
 		    PLAYER_ERROR2("incomplete line at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.ranges;
 		    return -1;
 		  }
@@ -2053,7 +3405,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (count != (int)data.geom.element_poses_count || total_count > token_count)
 		  {
 		    PLAYER_ERROR2("poses count mismatch at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.ranges;
 		    delete [] data.geom.element_poses;
 		    return -1;
@@ -2083,7 +3435,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (count != (int)data.geom.element_sizes_count || total_count > token_count)
 		  {
 		    PLAYER_ERROR2("sizes count mismatch at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.ranges;
 		    delete [] data.geom.element_poses;
 		    delete [] data.geom.element_sizes;
@@ -2099,7 +3451,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (token_count < total_count+7)
 		  {
 		    PLAYER_ERROR2("incomplete line at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.ranges;
 		    if (data.have_geom)
 		      {
@@ -2128,7 +3480,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 	    if (total_count != token_count)
 	      {
 		PLAYER_ERROR2("invalid line at %s:%d: number of tokens does not "
-			      "match count", filename, linenum);
+			      "match count", this->LogFilename(), linenum);
 		delete [] data.data.ranges;
 		if (data.have_geom)
 		  {
@@ -2157,7 +3509,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (token_count < 8)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2174,7 +3526,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (count != (int)data.intensities_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               ret = -1;
             }
             else
@@ -2194,7 +3546,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (token_count < 10)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2218,7 +3570,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if (count != (int)data.data.intensities_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] data.data.intensities;
 	      return -1;
             }
@@ -2231,7 +3583,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (token_count < total_count+11)
 		  {
 		    PLAYER_ERROR2("incomplete line at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.intensities;
 		    return -1;
 		  }
@@ -2285,7 +3637,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (count != (int)data.geom.element_poses_count || total_count > token_count)
 		  {
 		    PLAYER_ERROR2("poses count mismatch at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.intensities;
 		    delete [] data.geom.element_poses;
 		    return -1;
@@ -2315,7 +3667,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (count != (int)data.geom.element_sizes_count || total_count > token_count)
 		  {
 		    PLAYER_ERROR2("sizes count mismatch at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.intensities;
 		    delete [] data.geom.element_poses;
 		    delete [] data.geom.element_sizes;
@@ -2331,7 +3683,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 		if (token_count < total_count+7)
 		  {
 		    PLAYER_ERROR2("incomplete line at %s:%d",
-				  this->filename, linenum);
+				  this->LogFilename(), linenum);
 		    delete [] data.data.intensities;
 		    if (data.have_geom)
 		      {
@@ -2360,7 +3712,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
 	    if (total_count != token_count)
 	      {
 		PLAYER_ERROR2("invalid line at %s:%d: number of tokens does not "
-			      "match count", filename, linenum);
+			      "match count", this->LogFilename(), linenum);
 		delete [] data.data.intensities;
 		if (data.have_geom)
 		  {
@@ -2395,7 +3747,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if(token_count < 18)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2404,7 +3756,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if(token_count < 18+num_poses*6)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2413,7 +3765,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if(token_count < 18+num_poses*6+num_sizes*3)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2484,7 +3836,7 @@ int ReadLog::ParseRanger(player_devaddr_t id,
             if(token_count < 14)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2561,7 +3913,7 @@ int ReadLog::ParseLocalize(player_devaddr_t id,
             if (token_count < 10)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2590,7 +3942,7 @@ int ReadLog::ParseLocalize(player_devaddr_t id,
             if (count != (int)hypoths.hypoths_count)
             {
               PLAYER_ERROR2("hypoths count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] hypoths.hypoths;
               return -1;
 
@@ -2617,7 +3969,7 @@ int ReadLog::ParseLocalize(player_devaddr_t id,
             if(token_count < 12)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2641,7 +3993,7 @@ int ReadLog::ParseLocalize(player_devaddr_t id,
             if (count != (int)particles.particles_count)
             {
               PLAYER_ERROR2("particles count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 	    particles_set = true;
@@ -2679,7 +4031,7 @@ int ReadLog::ParseSonar(player_devaddr_t id,
             player_sonar_data_t data;
             if(token_count < 8)
             {
-              PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+              PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
               return -1;
             }
             data.ranges_count = atoi(tokens[7]);
@@ -2692,7 +4044,7 @@ int ReadLog::ParseSonar(player_devaddr_t id,
             if(count != (int)data.ranges_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] data.ranges;
               return -1;
             }
@@ -2706,7 +4058,7 @@ int ReadLog::ParseSonar(player_devaddr_t id,
             player_sonar_geom_t geom;
             if(token_count < 8)
             {
-              PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+              PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
               return -1;
             }
             geom.poses_count = atoi(tokens[7]);
@@ -2722,7 +4074,7 @@ int ReadLog::ParseSonar(player_devaddr_t id,
             if(count != (int)geom.poses_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] geom.poses;
               return -1;
             }
@@ -2742,7 +4094,7 @@ int ReadLog::ParseSonar(player_devaddr_t id,
           {
             if(token_count < 8)
             {
-              PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+              PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2765,7 +4117,7 @@ int ReadLog::ParseSonar(player_devaddr_t id,
             if(count != (int)geom->poses_count)
             {
               PLAYER_ERROR2("range count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               free(geom->poses);
               free(geom);
               return -1;
@@ -2817,7 +4169,7 @@ ReadLog::ParsePosition(player_devaddr_t id,
             player_position2d_data_t data;
             if(token_count < 14)
             {
-              PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+              PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
               return -1;
             }
             data.pos.px = atof(tokens[7]);
@@ -2843,7 +4195,7 @@ ReadLog::ParsePosition(player_devaddr_t id,
           {
             if(token_count < 12)
             {
-              PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+              PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2906,7 +4258,7 @@ int ReadLog::ParseOpaque(player_devaddr_t id,
             if (token_count < 8)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2923,7 +4275,7 @@ int ReadLog::ParseOpaque(player_devaddr_t id,
             if (count != (int)data.data_count)
             {
               PLAYER_ERROR2("data count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] data.data;
               return -1;
            }
@@ -2949,7 +4301,7 @@ int ReadLog::ParseOpaque(player_devaddr_t id,
             if (token_count < 8)
             {
               PLAYER_ERROR2("incomplete line at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -2965,7 +4317,7 @@ int ReadLog::ParseOpaque(player_devaddr_t id,
             if (count != (int)data.data_count)
             {
               PLAYER_ERROR2("data count mismatch at %s:%d",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               delete [] data.data;
               return -1;
            }
@@ -3008,7 +4360,7 @@ int ReadLog::ParseWifi(player_devaddr_t id,
           {
             if (token_count < 8)
             {
-              PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+              PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3070,7 +4422,7 @@ int ReadLog::ParseWSN(player_devaddr_t id,
                 {
                     if(token_count < 20)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.node_type      = atoi(tokens[7]);
@@ -3121,7 +4473,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_header_t data;
                     if(token_count < 11)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.id        = atoi(tokens[7]);
@@ -3137,7 +4489,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_rssi_t data;
                     if(token_count < 19)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.header.id        = atoi(tokens[7]);
@@ -3162,7 +4514,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_data_sensor_t data;
                     if(token_count < 13)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.header.id        = atoi(tokens[7]);
@@ -3184,7 +4536,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_data_sensor_t data;
                     if(token_count < 13)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
 			}
                     data.header.id        = atoi(tokens[7]);
@@ -3206,7 +4558,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_data_userdefined_t data;
                     if(token_count < 12)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.header.id        = atoi(tokens[7]);
@@ -3228,7 +4580,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_req_t data;
                     if(token_count < 13)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                         data.header.id        = atoi(tokens[7]);
@@ -3250,7 +4602,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_cmd_t data;
                     if(token_count < 13)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.header.id        = atoi(tokens[7]);
@@ -3280,7 +4632,7 @@ int ReadLog::ParseCoopObject(player_devaddr_t id,
 					player_coopobject_cmd_data_t data;
                     if(token_count < 16)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.node_id		= atoi(tokens[7]);
@@ -3329,7 +4681,7 @@ int ReadLog::ParseIMU (player_devaddr_t id,
                 {
                     if (token_count < 13)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
 		    player_imu_data_state_t data;
@@ -3350,7 +4702,7 @@ int ReadLog::ParseIMU (player_devaddr_t id,
 		{
                     if (token_count < 16)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
 		    player_imu_data_calib_t data;
@@ -3374,7 +4726,7 @@ int ReadLog::ParseIMU (player_devaddr_t id,
 		{
                     if (token_count < 20)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
 		    player_imu_data_quat_t data;
@@ -3402,7 +4754,7 @@ int ReadLog::ParseIMU (player_devaddr_t id,
 		{
                     if (token_count < 19)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
 		    player_imu_data_euler_t data;
@@ -3429,7 +4781,7 @@ int ReadLog::ParseIMU (player_devaddr_t id,
 		{
 			if (token_count < 22)
 			{
-				PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+				PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
 				return -1;
 			}
 			player_imu_data_fullstate_t data;
@@ -3486,7 +4838,7 @@ int ReadLog::ParsePointCloud3d (player_devaddr_t id,
 		    data.points_count = atoi (tokens[7]);
                     if (token_count < (int)(7+data.points_count))
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
                     data.points = new player_pointcloud3d_element[data.points_count];
@@ -3533,7 +4885,7 @@ int ReadLog::ParsePTZ (player_devaddr_t id,
                 {
                     if (token_count < 12)
                     {
-                        PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                        PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                         return -1;
                     }
 		    player_ptz_data_t data;
@@ -3577,7 +4929,7 @@ int ReadLog::ParseActarray (player_devaddr_t id,
             data.actuators = new player_actarray_actuator[data.actuators_count];
             if (token_count < (int)(7+data.actuators_count))
             {
-                PLAYER_ERROR2("invalid line at %s:%d", this->filename, linenum);
+                PLAYER_ERROR2("invalid line at %s:%d", this->LogFilename(), linenum);
                 return -1;
             }
             for (i = 0; i < data.actuators_count; i++)
@@ -3619,8 +4971,8 @@ int ReadLog::ParseAIO(player_devaddr_t id, unsigned short type,
             player_aio_data_t inputs;
 
             if (token_count < 8) {
-              PLAYER_ERROR2("invalid line at %s:%d: count missing", filename,
-                            linenum);
+              PLAYER_ERROR2("invalid line at %s:%d: count missing",
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3628,7 +4980,7 @@ int ReadLog::ParseAIO(player_devaddr_t id, unsigned short type,
 
             if (token_count - 8 != (int)inputs.voltages_count) {
               PLAYER_ERROR2("invalid line at %s:%d: number of tokens does not "
-                            "match count", filename, linenum);
+                            "match count", this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3645,12 +4997,12 @@ int ReadLog::ParseAIO(player_devaddr_t id, unsigned short type,
           }
         default:
           PLAYER_WARN3("cannot parse log of unknown aio data subtype '%d' at "
-                       "%s:%d", subtype, filename, linenum);
+                       "%s:%d", subtype, this->LogFilename(), linenum);
           return -1;
       }
       default:
         PLAYER_WARN3("cannot parse log unknown of aio message type '%d' at "
-                     "%s:%d", type, filename, linenum);
+                     "%s:%d", type, this->LogFilename(), linenum);
         return -1;
   }
 }
@@ -3668,8 +5020,8 @@ int ReadLog::ParseDIO(player_devaddr_t id, unsigned short type,
             player_dio_data_t inputs;
 
             if (token_count < 8) {
-              PLAYER_ERROR2("invalid line at %s:%d: count missing", filename,
-                            linenum);
+              PLAYER_ERROR2("invalid line at %s:%d: count missing",
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3678,13 +5030,13 @@ int ReadLog::ParseDIO(player_devaddr_t id, unsigned short type,
 
             if (token_count - 8 != static_cast<int>(inputs.count)) {
               PLAYER_ERROR2("invalid line at %s:%d: number of tokens does not "
-                            "match count", filename, linenum);
+                            "match count", this->LogFilename(), linenum);
               return -1;
             }
 
             if (inputs.count > 32 /* MAX_INPUTS */) {
               PLAYER_ERROR2("invalid line at %s:%d: too much data for buffer",
-                            filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3700,12 +5052,12 @@ int ReadLog::ParseDIO(player_devaddr_t id, unsigned short type,
           }
         default:
           PLAYER_WARN3("cannot parse log of unknown dio data subtype '%d' at "
-                       "%s:%d", subtype, filename, linenum);
+                       "%s:%d", subtype, this->LogFilename(), linenum);
           return -1;
       }
       default:
         PLAYER_WARN3("cannot parse log of unknown dio message type '%d' at "
-                     "%s:%d", type, filename, linenum);
+                     "%s:%d", type, this->LogFilename(), linenum);
         return -1;
   }
 }
@@ -3738,7 +5090,7 @@ int ReadLog::ParseRFID(player_devaddr_t id, unsigned short type,
 
             if (token_count < 8) {
               PLAYER_ERROR2("invalid line at %s:%d: count missing",
-                            this->filename, linenum);
+                            this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3746,7 +5098,7 @@ int ReadLog::ParseRFID(player_devaddr_t id, unsigned short type,
 
             if (token_count - 8 != 2 * static_cast<int>(rdata.tags_count)) {
               PLAYER_ERROR2("invalid line at %s:%d: number of tokens does not "
-                            "match count", this->filename, linenum);
+                            "match count", this->LogFilename(), linenum);
               return -1;
             }
 
@@ -3775,12 +5127,12 @@ int ReadLog::ParseRFID(player_devaddr_t id, unsigned short type,
           }
         default:
           PLAYER_WARN3("cannot parse log of unknown rfid data subtype '%d' at "
-                       "%s:%d", subtype, filename, linenum);
+                       "%s:%d", subtype, this->LogFilename(), linenum);
           return -1;
       }
       default:
         PLAYER_WARN3("cannot parse log of unknown rfid message type '%d' at "
-                     "%s:%d", type, filename, linenum);
+                     "%s:%d", type, this->LogFilename(), linenum);
         return -1;
   }
 }
@@ -3801,7 +5153,7 @@ int ReadLog::ParsePosition3d(player_devaddr_t id, unsigned short type,
 		  
 	  if (token_count < 20)
 	  {
-	    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+	    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
 	    return -1;
 	  }
 
@@ -3831,7 +5183,7 @@ int ReadLog::ParsePosition3d(player_devaddr_t id, unsigned short type,
 	  player_position3d_geom_t geom;
 	  if (token_count < 16)
 	  {
-	    PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+	    PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
 	    return -1;
 	  }
 	  geom.pose.px = atof(tokens[7]);
@@ -3856,7 +5208,7 @@ int ReadLog::ParsePosition3d(player_devaddr_t id, unsigned short type,
         player_position3d_geom_t geom;
         if (token_count < 16)
 	{
-	  PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+	  PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
 	  return -1;
 	}
 	geom.pose.px = atof(tokens[7]);
@@ -3889,7 +5241,7 @@ int ReadLog::ParsePower(player_devaddr_t id, unsigned short type,
       player_power_data_t data;
       if (token_count < 13)
       {
-	PLAYER_ERROR2("incomplete line at %s:%d", this->filename, linenum);
+	PLAYER_ERROR2("incomplete line at %s:%d", this->LogFilename(), linenum);
 	return -1;
       }
       data.volts = atof(tokens[7]);
@@ -0,0 +1,371 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Time index for text logs, for the readlog driver.
+// CVS: $Id$
+//
+///////////////////////////////////////////////////////////////////////////
+
+// Logs can be bigger than 2GB
+#define _FILE_OFFSET_BITS 64
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined (WIN32) || defined (__MINGW32__)
+  #include <strings.h>
+#endif
+
+#if HAVE_Z
+  #include <zlib.h>
+#endif
+
+#include <libplayercommon/error.h>
+
+#include "readlog_index.h"
+
+#if defined (WIN32)
+  #define readlog_index_ftell _ftelli64
+  #define snprintf _snprintf
+#else
+  #define readlog_index_ftell ftello
+#endif
+
+#define READLOG_INDEX_VERSION 1
+
+// Lines are read in pieces of this size; only the start of each matters
+#define READLOG_INDEX_CHUNK 4096
+
+// Where a line starts, and when it was logged
+typedef struct
+{
+  double time;
+  int64_t offset;
+  int linenum;
+} readlog_index_entry_t;
+
+struct readlog_index
+{
+  int count, size;
+  readlog_index_entry_t *entries;
+};
+
+
+// Add an entry
+static int readlog_index_add(readlog_index_t *index, double time,
+                             int64_t offset, int linenum)
+{
+  int size;
+  readlog_index_entry_t *entries;
+
+  if (index->count == index->size)
+  {
+    size = index->size ? 2 * index->size : 1024;
+    entries = (readlog_index_entry_t*)
+      realloc(index->entries, size * sizeof(entries[0]));
+    if (!entries)
+    {
+      PLAYER_ERROR("out of memory for the log index");
+      return -1;
+    }
+    index->entries = entries;
+    index->size = size;
+  }
+  index->entries[index->count].time = time;
+  index->entries[index->count].offset = offset;
+  index->entries[index->count].linenum = linenum;
+  index->count++;
+  return 0;
+}
+
+
+// Is the log gzipped, by its name?
+static int readlog_index_gzipped(const char *filename)
+{
+  size_t len;
+
+  len = strlen(filename);
+  if (len < 3)
+    return 0;
+#if defined (WIN32)
+  return _stricmp(filename + len - 3, ".gz") == 0;
+#else
+  return strcasecmp(filename + len - 3, ".gz") == 0;
+#endif
+}
+
+
+// Read the cached index, if it was made from the log as it is now.
+// Returns 0 on success, -1 if there is no usable cache.
+static int readlog_index_read_cache(readlog_index_t *index,
+                                    const char *cachename,
+                                    const struct stat *st)
+{
+  FILE *file;
+  int version, linenum;
+  long long size, mtime, offset;
+  double time;
+  char line[256];
+
+  if (!(file = fopen(cachename, "r")))
+    return -1;
+
+  if (!fgets(line, sizeof(line), file) ||
+      sscanf(line, "## readlog index %d", &version) != 1 ||
+      version != READLOG_INDEX_VERSION ||
+      !fgets(line, sizeof(line), file) ||
+      sscanf(line, "## log %lld %lld", &size, &mtime) != 2 ||
+      size != (long long) st->st_size || mtime != (long long) st->st_mtime)
+  {
+    fclose(file);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), file))
+  {
+    if (sscanf(line, "%lf %lld %d", &time, &offset, &linenum) != 3)
+    {
+      PLAYER_WARN1("[%s] is corrupt; rebuilding it", cachename);
+      index->count = 0;
+      fclose(file);
+      return -1;
+    }
+    if (readlog_index_add(index, time, offset, linenum) != 0)
+    {
+      fclose(file);
+      return -1;
+    }
+  }
+  fclose(file);
+  return 0;
+}
+
+
+// Write the index to the cache, via a temporary file so that a reader
+// never sees half of it.  Returns 0 on success, -1 on error.
+static int readlog_index_write_cache(readlog_index_t *index,
+                                     const char *cachename,
+                                     const struct stat *st)
+{
+  FILE *file;
+  int i, ret;
+  char tmpname[1024];
+
+  snprintf(tmpname, sizeof(tmpname), "%s.tmp", cachename);
+  if (!(file = fopen(tmpname, "w")))
+    return -1;
+
+  fprintf(file, "## readlog index %d\n", READLOG_INDEX_VERSION);
+  fprintf(file, "## log %lld %lld\n",
+          (long long) st->st_size, (long long) st->st_mtime);
+  for (i = 0; i < index->count; i++)
+    fprintf(file, "%.6f %lld %d\n", index->entries[i].time,
+            (long long) index->entries[i].offset, index->entries[i].linenum);
+
+  ret = ferror(file);
+  if (fclose(file) != 0 || ret != 0)
+  {
+    remove(tmpname);
+    return -1;
+  }
+#if defined (WIN32)
+  remove(cachename);
+#endif
+  if (rename(tmpname, cachename) != 0)
+  {
+    remove(tmpname);
+    return -1;
+  }
+  return 0;
+}
+
+
+// Build the index by reading the log.  Returns 0 on success, -1 on error.
+static int readlog_index_scan(readlog_index_t *index, const char *filename)
+{
+  FILE *file;
+#if HAVE_Z
+  gzFile gzfile;
+#endif
+  int linenum, at_start, len, ret, err;
+  int64_t offset;
+  double time, last_time;
+  char *end;
+  char chunk[READLOG_INDEX_CHUNK];
+
+  file = NULL;
+#if HAVE_Z
+  gzfile = NULL;
+  if (readlog_index_gzipped(filename))
+    gzfile = gzopen(filename, "r");
+  else
+#else
+  if (readlog_index_gzipped(filename))
+  {
+    PLAYER_ERROR("no support for reading compressed log files");
+    return -1;
+  }
+#endif
+    file = fopen(filename, "r");
+#if HAVE_Z
+  if (!file && !gzfile)
+#else
+  if (!file)
+#endif
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return -1;
+  }
+
+  linenum = 0;
+  at_start = 1;
+  last_time = 0;
+  err = 0;
+  while (1)
+  {
+#if HAVE_Z
+    if (gzfile)
+    {
+      offset = gztell(gzfile);
+      ret = (gzgets(gzfile, chunk, sizeof(chunk)) == NULL);
+    }
+    else
+#endif
+    {
+      offset = readlog_index_ftell(file);
+      ret = (fgets(chunk, sizeof(chunk), file) == NULL);
+    }
+    if (ret != 0)
+      break;
+
+    // Only the start of each line matters: the time it was logged
+    len = strlen(chunk);
+    if (at_start)
+    {
+      linenum++;
+      if (chunk[0] != '#')
+      {
+        time = strtod(chunk, &end);
+        if (end != chunk &&
+            (index->count == 0 || time >= last_time + READLOG_INDEX_SPAN))
+        {
+          if ((err = readlog_index_add(index, time, offset, linenum)) != 0)
+            break;
+          last_time = time;
+        }
+      }
+    }
+    at_start = (len > 0 && chunk[len - 1] == '\n');
+  }
+
+#if HAVE_Z
+  if (gzfile)
+    gzclose(gzfile);
+#endif
+  if (file)
+    fclose(file);
+  return err;
+}
+
+
+// Load the index of a text log
+readlog_index_t *readlog_index_load(const char *filename)
+{
+  readlog_index_t *index;
+  struct stat st;
+  char cachename[1024];
+
+  if (stat(filename, &st) != 0)
+  {
+    PLAYER_ERROR2("unable to open [%s]: %s", filename, strerror(errno));
+    return NULL;
+  }
+  if (strlen(filename) + strlen(READLOG_INDEX_EXTENSION) >= sizeof(cachename))
+  {
+    PLAYER_ERROR1("file name [%s] is too long", filename);
+    return NULL;
+  }
+  snprintf(cachename, sizeof(cachename), "%s%s",
+           filename, READLOG_INDEX_EXTENSION);
+
+  index = (readlog_index_t*) calloc(1, sizeof(readlog_index_t));
+  if (!index)
+    return NULL;
+
+  if (readlog_index_read_cache(index, cachename, &st) == 0)
+  {
+    PLAYER_MSG1(2, "read log index [%s]", cachename);
+    return index;
+  }
+
+  PLAYER_MSG1(1, "indexing [%s]", filename);
+  if (readlog_index_scan(index, filename) != 0)
+  {
+    readlog_index_free(index);
+    return NULL;
+  }
+  if (readlog_index_write_cache(index, cachename, &st) != 0)
+    PLAYER_WARN1("unable to save the log index in [%s]; it will be built "
+                 "again next time", cachename);
+  return index;
+}
+
+
+// Free an index
+void readlog_index_free(readlog_index_t *index)
+{
+  free(index->entries);
+  free(index);
+  return;
+}
+
+
+// Find where to start reading to reach a time
+int readlog_index_find(readlog_index_t *index, double time,
+                       int64_t *offset, int *linenum)
+{
+  int lo, hi, mid;
+
+  if (index->count == 0)
+    return -1;
+
+  // Last entry at or before the time
+  lo = 0;
+  hi = index->count - 1;
+  while (lo < hi)
+  {
+    mid = (lo + hi + 1) / 2;
+    if (index->entries[mid].time <= time)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  *offset = index->entries[lo].offset;
+  *linenum = index->entries[lo].linenum;
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Time index for text logs, for the readlog driver.
+// CVS: $Id$
+//
+// Text logs can only be read from the start, so to jump to a time the
+// index records where a line starts every READLOG_INDEX_SPAN seconds of
+// the log.  Building it means reading the whole log once, so it is kept
+// in a file beside the log (the log's name with READLOG_INDEX_EXTENSION
+// added), and built again only when the log changes.  The cache is a text
+// file:
+//
+//   ## readlog index <version>
+//   ## log <log size> <log modification time>
+//   <time> <offset> <line number>
+//   ...
+//
+// Offsets are into the uncompressed text, so they suit gzseek() on
+// gzipped logs as well as fseek() on plain ones.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef READLOG_INDEX_H
+#define READLOG_INDEX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Added to the name of the log to name the cached index
+#define READLOG_INDEX_EXTENSION ".idx"
+
+// Log time between index entries [s]
+#define READLOG_INDEX_SPAN 1.0
+
+typedef struct readlog_index readlog_index_t;
+
+// Load the index of a text log, from the cache if it matches the log,
+// or else by reading the log, in which case the cache is written (or
+// rewritten) if possible.  The log is gzipped if its name ends in ".gz".
+// Returns NULL on error.
+readlog_index_t *readlog_index_load(const char *filename);
+
+// Free an index
+void readlog_index_free(readlog_index_t *index);
+
+// Find where to start reading to reach the first line logged at or after
+// time: the offset and number of the last indexed line logged at or
+// before it, or of the first indexed line if there is none.  Lines before
+// the time still have to be skipped.  Returns 0 on success, -1 if the log
+// has no lines.
+int readlog_index_find(readlog_index_t *index, double time,
+                       int64_t *offset, int *linenum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
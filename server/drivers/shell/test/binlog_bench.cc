@@ -0,0 +1,430 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/***************************************************************************
+ * Desc: Log format benchmark.  Logs a run of 1081 beam laser scans and
+ *       odometry as text, the way writelog does, and as binary logs, and
+ *       times writing them and reading them back the way readlog does.
+ *       Checks that the binary logs hold what was written, that text
+ *       logs convert exactly, that seeks land on the right message, and
+ *       that a log whose writer died can still be read.
+ * Usage: binlog_bench [scans [directory]]
+ **************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+
+#include "../binlog.h"
+#include "../logconvert.h"
+
+#define BENCH_BEAMS 1081
+
+// Scans at 40Hz and odometry at 50Hz [ms]
+#define BENCH_SCAN_MS 25
+#define BENCH_ODOM_MS 20
+
+// Where the data seems to come from
+#define BENCH_HOST 16777343
+#define BENCH_ROBOT 6665
+
+static float ranges[BENCH_BEAMS];
+static uint8_t intensity[BENCH_BEAMS];
+static int failures;
+
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static long file_size(const char *filename)
+{
+  struct stat st;
+  if (stat(filename, &st) != 0)
+    return -1;
+  return (long) st.st_size;
+}
+
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+
+// One message of the run: the laser geometry, then scans and odometry in
+// time order
+typedef struct
+{
+  player_msghdr_t hdr;
+  player_laser_geom_t geom;
+  player_laser_data_t scan;
+  player_position2d_data_t odom;
+  void *data;
+} bench_msg_t;
+
+
+// Make message n of a run with the given number of scans.  Returns false
+// past the end of the run.
+static bool make(int n, int scans, bench_msg_t *msg)
+{
+  int i, k, s, o, t;
+
+  memset(&msg->hdr, 0, sizeof(msg->hdr));
+  msg->hdr.addr.host = BENCH_HOST;
+  msg->hdr.addr.robot = BENCH_ROBOT;
+  msg->hdr.timestamp = 1000.0;
+
+  if (n == 0)
+  {
+    msg->hdr.addr.interf = PLAYER_LASER_CODE;
+    msg->hdr.type = PLAYER_MSGTYPE_RESP_ACK;
+    msg->hdr.subtype = PLAYER_LASER_REQ_GET_GEOM;
+    memset(&msg->geom, 0, sizeof(msg->geom));
+    msg->geom.pose.px = 0.15;
+    msg->geom.pose.pyaw = 0.01;
+    msg->geom.size.sl = 0.1;
+    msg->geom.size.sw = 0.1;
+    msg->data = &msg->geom;
+    return true;
+  }
+
+  // Merge the scans (every BENCH_SCAN_MS) and odometry (every
+  // BENCH_ODOM_MS), odometry first when they coincide
+  s = o = 0;
+  for (k = 1; k < n; k++)
+  {
+    if (o * BENCH_ODOM_MS <= s * BENCH_SCAN_MS)
+      o++;
+    else
+      s++;
+  }
+  if (s >= scans)
+    return false;
+
+  if (o * BENCH_ODOM_MS <= s * BENCH_SCAN_MS)
+  {
+    t = o * BENCH_ODOM_MS;
+    msg->hdr.addr.interf = PLAYER_POSITION2D_CODE;
+    msg->hdr.type = PLAYER_MSGTYPE_DATA;
+    msg->hdr.subtype = PLAYER_POSITION2D_DATA_STATE;
+    memset(&msg->odom, 0, sizeof(msg->odom));
+    msg->odom.pos.px = o * 0.001;
+    msg->odom.pos.pa = 0.5;
+    msg->odom.vel.px = 0.05;
+    msg->data = &msg->odom;
+  }
+  else
+  {
+    t = s * BENCH_SCAN_MS;
+    msg->hdr.addr.interf = PLAYER_LASER_CODE;
+    msg->hdr.type = PLAYER_MSGTYPE_DATA;
+    msg->hdr.subtype = PLAYER_LASER_DATA_SCAN;
+    // Whole millimetres, which survive the text format
+    for (i = 0; i < BENCH_BEAMS; i++)
+    {
+      ranges[i] = (float) (((i * 7919 + s * 104729) % 30000) / 1000.0);
+      intensity[i] = (uint8_t) ((i + s) % 3);
+    }
+    memset(&msg->scan, 0, sizeof(msg->scan));
+    msg->scan.id = s;
+    msg->scan.min_angle = (float) (-3 * M_PI / 4);
+    msg->scan.max_angle = (float) (3 * M_PI / 4);
+    msg->scan.resolution = (float) (M_PI / 720);
+    msg->scan.max_range = 30;
+    msg->scan.ranges_count = BENCH_BEAMS;
+    msg->scan.ranges = ranges;
+    msg->scan.intensity_count = BENCH_BEAMS;
+    msg->scan.intensity = intensity;
+    msg->data = &msg->scan;
+  }
+  msg->hdr.timestamp += t / 1000.0;
+  return true;
+}
+
+
+// Write a message as writelog does in a text log
+static void write_text(FILE *file, const bench_msg_t *msg)
+{
+  unsigned int i;
+  const player_msghdr_t *hdr;
+
+  hdr = &msg->hdr;
+  fprintf(file, "%014.3f %u %u %s %02u %03u %03u ",
+          hdr->timestamp, hdr->addr.host, hdr->addr.robot,
+          interf_to_str(hdr->addr.interf), hdr->addr.index,
+          hdr->type, hdr->subtype);
+  if (msg->data == &msg->geom)
+    fprintf(file, "%+7.3f %+7.3f %7.3f %7.3f %7.3f",
+            msg->geom.pose.px, msg->geom.pose.py, msg->geom.pose.pyaw,
+            msg->geom.size.sl, msg->geom.size.sw);
+  else if (msg->data == &msg->odom)
+    fprintf(file, "%+07.3f %+07.3f %+04.3f %+07.3f %+07.3f %+07.3f %d",
+            msg->odom.pos.px, msg->odom.pos.py, msg->odom.pos.pa,
+            msg->odom.vel.px, msg->odom.vel.py, msg->odom.vel.pa,
+            msg->odom.stall);
+  else
+  {
+    fprintf(file, "%04d %+07.4f %+07.4f %+.8f %+07.4f %04d ",
+            msg->scan.id, msg->scan.min_angle, msg->scan.max_angle,
+            msg->scan.resolution, msg->scan.max_range,
+            msg->scan.ranges_count);
+    for (i = 0; i < msg->scan.ranges_count; i++)
+    {
+      fprintf(file, "%.3f ", msg->scan.ranges[i]);
+      fprintf(file, "%2d ", msg->scan.intensity[i]);
+    }
+  }
+  fprintf(file, "\n");
+  fflush(file);
+}
+
+
+// Is a message read back the one that was written?
+static bool same(const bench_msg_t *msg, const player_msghdr_t *hdr,
+                 void *data)
+{
+  const player_laser_data_t *scan;
+
+  if (hdr->type != msg->hdr.type || hdr->subtype != msg->hdr.subtype ||
+      hdr->addr.interf != msg->hdr.addr.interf ||
+      hdr->addr.host != msg->hdr.addr.host ||
+      hdr->addr.robot != msg->hdr.addr.robot ||
+      fabs(hdr->timestamp - msg->hdr.timestamp) > 1e-6)
+    return false;
+  if (msg->data == &msg->scan)
+  {
+    scan = (const player_laser_data_t*) data;
+    return scan->id == msg->scan.id &&
+           scan->ranges_count == BENCH_BEAMS &&
+           memcmp(scan->ranges, ranges, sizeof(ranges)) == 0 &&
+           memcmp(scan->intensity, intensity, sizeof(intensity)) == 0;
+  }
+  if (msg->data == &msg->odom)
+    return fabs(((player_position2d_data_t*) data)->pos.px -
+                msg->odom.pos.px) < 1e-6;
+  return fabs(((player_laser_geom_t*) data)->pose.px -
+              msg->geom.pose.px) < 1e-6;
+}
+
+
+// Read a binary log back, checking every message.  Returns the time
+// taken, or -1 on error.
+static double read_binary(const char *filename, int scans, int *count)
+{
+  binlog_t *log;
+  bench_msg_t msg;
+  player_msghdr_t hdr;
+  void *data;
+  double start;
+  int ret, bad;
+
+  start = now();
+  if (!(log = binlog_open(filename)))
+    return -1;
+  *count = bad = 0;
+  while ((ret = binlog_read(log, &hdr, &data)) == 0)
+  {
+    if (!make(*count, scans, &msg) || !same(&msg, &hdr, data))
+      bad++;
+    (*count)++;
+  }
+  binlog_close(log);
+  if (ret < 0 || bad)
+    return -1;
+  return now() - start;
+}
+
+
+// Write a binary log.  Returns the time taken, or -1 on error.
+static double write_binary(const char *filename, int flags, int scans,
+                           int *count)
+{
+  binlog_t *log;
+  bench_msg_t msg;
+  double start;
+
+  start = now();
+  if (!(log = binlog_create(filename, flags)))
+    return -1;
+  for (*count = 0; make(*count, scans, &msg); (*count)++)
+  {
+    if (binlog_write(log, &msg.hdr, msg.data) != 0)
+      return -1;
+  }
+  if (binlog_close(log) != 0)
+    return -1;
+  return now() - start;
+}
+
+
+static void report(const char *what, int count, double t, long size)
+{
+  printf("%-28s %10.0f %10.1f", what, count / t, size / t / 1e6);
+  if (size >= 0)
+    printf(" %10.1f", size / 1e6);
+  printf("\n");
+}
+
+
+// Seek to random times, and check that each lands on the first message
+// at or after the time
+static void seek(const char *filename, int scans, int seeks)
+{
+  binlog_t *log;
+  bench_msg_t msg;
+  player_msghdr_t hdr;
+  void *data;
+  double start, end, t, elapsed;
+  int i, n, bad;
+
+  if (!(log = binlog_open(filename)) ||
+      binlog_get_span(log, &start, &end) != 0)
+  {
+    check(false, "opening the log to seek");
+    return;
+  }
+
+  bad = 0;
+  elapsed = 0;
+  srand(1);
+  for (i = 0; i < seeks; i++)
+  {
+    t = start + (end - start) * rand() / RAND_MAX;
+    elapsed -= now();
+    if (binlog_seek(log, t) != 0 || binlog_read(log, &hdr, &data) != 0)
+    {
+      bad++;
+      continue;
+    }
+    elapsed += now();
+    for (n = 0; make(n, scans, &msg) && msg.hdr.timestamp < t - 1e-9; n++);
+    if (!same(&msg, &hdr, data))
+      bad++;
+  }
+  binlog_close(log);
+  printf("%d seeks, %.3f ms each\n", seeks, elapsed * 1e3 / seeks);
+  check(bad == 0, "seeking");
+}
+
+
+int main(int argc, char **argv)
+{
+  int n, count, scans;
+  const char *dir;
+  char text[1024], plain[1024], packed[1024], converted[1024];
+  char cmd[8192];
+  bench_msg_t msg;
+  FILE *file;
+  double t;
+
+  scans = argc > 1 ? atoi(argv[1]) : 2000;
+  dir = argc > 2 ? argv[2] : "/tmp";
+  snprintf(text, sizeof(text), "%s/binlog_bench.log", dir);
+  snprintf(plain, sizeof(plain), "%s/binlog_bench.plb", dir);
+  snprintf(packed, sizeof(packed), "%s/binlog_bench_z.plb", dir);
+  snprintf(converted, sizeof(converted), "%s/binlog_bench_text.plb", dir);
+
+  player_globals_init();
+  playerxdr_ftable_init();
+  itable_init();
+  ErrorInit(0, NULL);
+
+  printf("%d scans of %d beams, with odometry\n", scans, BENCH_BEAMS);
+  printf("                               msgs/s       MB/s         MB\n");
+
+  // Text, as writelog and readlog do it
+  t = now();
+  if (!(file = fopen(text, "w")))
+  {
+    perror(text);
+    return 1;
+  }
+  for (count = 0; make(count, scans, &msg); count++)
+    write_text(file, &msg);
+  fclose(file);
+  t = now() - t;
+  report("text write", count, t, file_size(text));
+
+  t = now();
+  n = readlog_convert(text, NULL, 0);
+  t = now() - t;
+  check(n == count, "parsing the text log");
+  report("text replay (parse)", n, t, file_size(text));
+
+  // Binary, plain and compressed
+  t = write_binary(plain, 0, scans, &n);
+  check(t >= 0 && n == count, "writing the binary log");
+  report("binary write", n, t, file_size(plain));
+  t = read_binary(plain, scans, &n);
+  check(t >= 0 && n == count, "reading the binary log");
+  report("binary replay (decode)", n, t, file_size(plain));
+
+  t = write_binary(packed, BINLOG_COMPRESS, scans, &n);
+  check(t >= 0 && n == count, "writing the compressed log");
+  report("compressed write", n, t, file_size(packed));
+  t = read_binary(packed, scans, &n);
+  check(t >= 0 && n == count, "reading the compressed log");
+  report("compressed replay (decode)", n, t, file_size(packed));
+
+  // Converted from text, which must match what was logged
+  t = now();
+  n = readlog_convert(text, converted, 0);
+  t = now() - t;
+  check(n == count, "converting the text log");
+  report("text to binary conversion", n, t, file_size(text));
+  t = read_binary(converted, scans, &n);
+  check(t >= 0 && n == count, "reading the converted log");
+
+  seek(plain, scans, 1000);
+  seek(packed, scans, 1000);
+
+  // A log whose writer died has no index, and maybe half a block
+  snprintf(cmd, sizeof(cmd), "head -c %ld %s > %s.cut && mv %s.cut %s",
+           file_size(plain) - 1000, plain, plain, plain, plain);
+  check(system(cmd) == 0, "cutting the binary log short");
+  t = read_binary(plain, scans, &n);
+  check(t >= 0 && n > count / 2 && n < count, "reading a cut log");
+
+  unlink(text);
+  unlink(plain);
+  unlink(packed);
+  unlink(converted);
+
+  printf("%d failures\n", failures);
+  player_globals_fini();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/***************************************************************************
+ * Desc: Frame store tests.  Writes frames of awkward sizes, reopens the
+ *       store and reads them back by number out of the mapping, and
+ *       checks that stores cut short are still read up to the cut.
+ * Usage: framestore_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libplayercommon/test/test.h>
+
+#include "../framestore.h"
+
+#define FILENAME "framestore_test.frames"
+
+// Frame sizes: empty, around the alignment, and about an image
+static const size_t sizes[] = {0, 1, 15, 16, 17, 1000, 640 * 480 * 3, 33};
+#define FRAME_COUNT ((int) (sizeof(sizes) / sizeof(sizes[0])))
+
+// The bytes of frame n
+static void fill(uint8_t *buf, int n, size_t size)
+{
+  size_t i;
+  for (i = 0; i < size; i++)
+    buf[i] = (uint8_t) (n * 31 + i * 7 + (i >> 8));
+}
+
+// Read every frame of the store and compare it with what was written,
+// for the first count frames
+static int check_frames(framestore_t *store, int count, uint8_t *expect)
+{
+  const void *data;
+  size_t size;
+  int n;
+
+  if ((int) framestore_count(store) != count)
+    return 0;
+  for (n = 0; n < count; n++)
+  {
+    fill(expect, n, sizes[n]);
+    if (framestore_read(store, n, &data, &size) != 0 || size != sizes[n] ||
+        memcmp(data, expect, size) != 0)
+      return 0;
+  }
+  return framestore_read(store, count, &data, &size) == -1;
+}
+
+static long file_size(const char *filename)
+{
+  FILE *file;
+  long size;
+
+  if (!(file = fopen(filename, "rb")))
+    return -1;
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+int main(int argc, char **argv)
+{
+  framestore_t *store;
+  uint8_t *buf;
+  const void *first, *data;
+  size_t size;
+  uint32_t frame;
+  char name[64];
+  long full;
+  int n, ok;
+  FILE *file;
+
+  buf = malloc(640 * 480 * 3);
+
+  TEST("name the store of a log");
+  check(framestore_filename("cam.log.gz", name, sizeof(name)) == 0 &&
+        strcmp(name, "cam.log" FRAMESTORE_EXTENSION) == 0 &&
+        framestore_filename("cam.log", name, 8) == -1);
+
+  TEST("write frames");
+  store = framestore_create(FILENAME);
+  ok = store != NULL;
+  for (n = 0; ok && n < FRAME_COUNT; n++)
+  {
+    fill(buf, n, sizes[n]);
+    ok = framestore_write(store, buf, sizes[n], &frame) == 0 &&
+      frame == (uint32_t) n;
+  }
+  check(ok && framestore_close(store) == 0);
+  full = file_size(FILENAME);
+
+  TEST("reopen and read the frames by number");
+  store = framestore_open(FILENAME);
+  check(store && check_frames(store, FRAME_COUNT, buf));
+
+  // Frames come out of the mapping, so each stays good while others are
+  // read, and starts on the alignment
+  TEST("frames are read out of the mapping");
+  ok = store && framestore_read(store, 6, &first, &size) == 0;
+  for (n = 0; ok && n < FRAME_COUNT; n++)
+    ok = framestore_read(store, n, &data, &size) == 0 &&
+      ((size_t) data) % FRAMESTORE_ALIGN == 0;
+  fill(buf, 6, sizes[6]);
+  check(ok && memcmp(first, buf, sizes[6]) == 0);
+  if (store)
+    framestore_close(store);
+
+  TEST("store with its trailer cut off is indexed again");
+  ok = truncate(FILENAME, full - 5) == 0;
+  store = framestore_open(FILENAME);
+  check(ok && store && check_frames(store, FRAME_COUNT, buf));
+  if (store)
+    framestore_close(store);
+
+  TEST("store with no index is read up to the last whole frame");
+  // The last frame is 33 bytes, padded to 48, after a 16 byte header
+  ok = truncate(FILENAME, full - 16 - 8 * FRAME_COUNT - 8 - 48 + 20) == 0;
+  store = framestore_open(FILENAME);
+  check(ok && store && check_frames(store, FRAME_COUNT - 1, buf));
+  if (store)
+    framestore_close(store);
+
+  TEST("other files are rejected");
+  file = fopen(FILENAME, "wb");
+  for (n = 0; n < 64; n++)
+    fputc('P', file);
+  fclose(file);
+  check(framestore_open(FILENAME) == NULL);
+
+  remove(FILENAME);
+  free(buf);
+
+  return test_result();
+}
@@ -0,0 +1,321 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/***************************************************************************
+ * Desc: Log writer benchmark.  Logs 1081 beam laser scans as text at a
+ *       fixed rate to a slow disk, simulated by a thread reading a FIFO
+ *       at a limited rate and stopping now and then (as SD cards do),
+ *       once writing each scan with fprintf() and fflush() the way
+ *       writelog used to, and once through the writer thread.  Reports
+ *       how late scans were written, which is how long they would have
+ *       waited in writelog's queue, and checks that every scan the sink
+ *       gets is whole, and that only dropped scans are missing.
+ * Usage: logwriter_bench [seconds [directory]]
+ **************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <config.h>
+#include <libplayercommon/playercommon.h>
+
+#include "../logwriter.h"
+
+#define BENCH_BEAMS 1081
+
+// Scans per second
+#define BENCH_RATE 200
+
+// Each scan: a sequence number, then the ranges, all fixed width
+#define BENCH_RECORD (9 + 7 * BENCH_BEAMS + 1)
+
+static int failures;
+
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+
+// The slow disk: reads rate bytes/s, stopping for stall seconds every
+// second
+typedef struct
+{
+  const char *fifo;
+  double rate, stall;
+  // Scans received whole, and any that were not
+  int received, broken, out_of_order;
+  long bytes;
+} sink_t;
+
+
+static void *sink_main(void *arg)
+{
+  sink_t *sink;
+  int fd, n, len, last;
+  char buf[16384], line[BENCH_RECORD];
+  double t, start, next_stall, stalled;
+
+  sink = (sink_t*) arg;
+  if ((fd = open(sink->fifo, O_RDONLY)) < 0)
+  {
+    perror(sink->fifo);
+    return NULL;
+  }
+
+  start = now();
+  next_stall = start + 1.0;
+  stalled = 0;
+  len = 0;
+  last = -1;
+  while (1)
+  {
+    t = now();
+    if (t >= next_stall)
+    {
+      usleep((useconds_t) (sink->stall * 1e6));
+      stalled += sink->stall;
+      next_stall += 1.0;
+      continue;
+    }
+    if (sink->bytes > sink->rate * (t - start - stalled))
+    {
+      usleep(1000);
+      continue;
+    }
+    if ((n = read(fd, buf, sizeof(buf))) <= 0)
+      break;
+    sink->bytes += n;
+
+    // Cut the stream into scans
+    for (int i = 0; i < n; i++)
+    {
+      if (len < BENCH_RECORD)
+        line[len] = buf[i];
+      len++;
+      if (buf[i] != '\n')
+        continue;
+      if (len == BENCH_RECORD && line[8] == ' ')
+      {
+        int seq = atoi(line);
+        if (seq <= last)
+          sink->out_of_order++;
+        last = seq;
+        sink->received++;
+      }
+      else
+        sink->broken++;
+      len = 0;
+    }
+  }
+  if (len != 0)
+    sink->broken++;
+  close(fd);
+  return NULL;
+}
+
+
+static void write_scan(FILE *file, int seq, const float *ranges)
+{
+  fprintf(file, "%08d ", seq);
+  for (int i = 0; i < BENCH_BEAMS; i++)
+    fprintf(file, "%6.3f ", ranges[i]);
+  fprintf(file, "\n");
+}
+
+
+// Log scans for a while, to a sink of the given speed, directly or
+// through a writer.  Returns the number of scans logged.
+static int run(const char *fifo, double seconds, double rate, double stall,
+               bool threaded)
+{
+  sink_t sink;
+  pthread_t thread;
+  FILE *file;
+  logwriter_t *writer;
+  logwriter_stats_t stats;
+  float ranges[BENCH_BEAMS];
+  int i, count, late;
+  double start, due, t, lag, worst, total;
+
+  memset(&sink, 0, sizeof(sink));
+  sink.fifo = fifo;
+  sink.rate = rate;
+  sink.stall = stall;
+  pthread_create(&thread, NULL, sink_main, &sink);
+
+  writer = NULL;
+  if (threaded)
+  {
+    writer = logwriter_create(fifo, 256 * 1024, 4, 0.0, 0);
+    file = writer ? logwriter_stream(writer) : NULL;
+  }
+  else
+    file = fopen(fifo, "w");
+  if (!file)
+  {
+    perror(fifo);
+    exit(1);
+  }
+
+  for (i = 0; i < BENCH_BEAMS; i++)
+    ranges[i] = 1.0 + (i % 100) * 0.05;
+
+  // Scans come in at a fixed rate; any written after the next is due
+  // would have waited in the queue
+  count = (int) (seconds * BENCH_RATE);
+  worst = total = 0;
+  late = 0;
+  start = now();
+  for (i = 0; i < count; i++)
+  {
+    due = start + (double) i / BENCH_RATE;
+    t = now();
+    if (t < due)
+      usleep((useconds_t) ((due - t) * 1e6));
+
+    if (writer)
+    {
+      if (logwriter_begin(writer) == 0)
+      {
+        write_scan(file, i, ranges);
+        logwriter_end(writer);
+      }
+    }
+    else
+    {
+      write_scan(file, i, ranges);
+      fflush(file);
+    }
+
+    lag = now() - due;
+    total += lag;
+    if (lag > worst)
+      worst = lag;
+    if (lag > 1.0 / BENCH_RATE)
+      late++;
+  }
+  t = now() - start;
+
+  memset(&stats, 0, sizeof(stats));
+  if (writer)
+  {
+    // Let the writer catch up, so it has counted everything; the buffer
+    // being filled can only be handed over once another is free
+    for (i = 0; i < 2; i++)
+    {
+      logwriter_flush(writer, 0);
+      do
+      {
+        usleep(10000);
+        logwriter_get_stats(writer, &stats);
+      } while (stats.backlog > 0);
+    }
+    check(logwriter_close(writer) == 0, "closing the writer");
+  }
+  else
+    fclose(file);
+  pthread_join(thread, NULL);
+
+  printf("%-8s %6.1f %8.2f %9.1f %9.1f %8d %8d %7d %9.1f\n",
+         threaded ? "thread" : "direct", rate / 1e6,
+         count / t, total / count * 1e3, worst * 1e3, late,
+         stats.records_dropped, stats.stalls, stats.stall_time * 1e3);
+
+  check(sink.broken == 0, "scans arrive whole");
+  check(sink.out_of_order == 0, "scans arrive in order");
+  check(sink.received + (int) stats.records_dropped == count,
+        "every scan not dropped arrives");
+  if (writer)
+  {
+    check(stats.records_written + stats.records_dropped == (uint32_t) count,
+          "the writer counts every scan");
+    check(stats.bytes_written == sink.bytes, "the writer counts every byte");
+  }
+  return count;
+}
+
+
+int main(int argc, char **argv)
+{
+  double seconds;
+  const char *dir;
+  char fifo[1024];
+
+  seconds = argc > 1 ? atof(argv[1]) : 4.0;
+  dir = argc > 2 ? argv[2] : "/tmp";
+  snprintf(fifo, sizeof(fifo), "%s/logwriter_bench.fifo", dir);
+
+  ErrorInit(0, NULL);
+
+  unlink(fifo);
+  if (mkfifo(fifo, 0600) != 0)
+  {
+    perror(fifo);
+    return 1;
+  }
+
+  printf("%d scans/s of %d beams (%.2f MB/s) to a disk that stops for "
+         "0.4 s every second\n", BENCH_RATE, BENCH_BEAMS,
+         BENCH_RATE * BENCH_RECORD / 1e6);
+  printf("writing   disk    scans/s   lag(ms)   max(ms)     late  dropped  "
+         "stalls  wait(ms)\n");
+  printf("          MB/s                mean\n");
+
+  // A disk that keeps up on average, but not while it is stopped
+  run(fifo, seconds, 4e6, 0.4, false);
+  run(fifo, seconds, 4e6, 0.4, true);
+
+  // A disk that cannot keep up at all
+  run(fifo, seconds, 1e6, 0.4, false);
+  run(fifo, seconds, 1e6, 0.4, true);
+
+  unlink(fifo);
+
+  if (failures)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
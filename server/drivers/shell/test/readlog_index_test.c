@@ -0,0 +1,266 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/***************************************************************************
+ * Desc: Text log index tests.  Writes text logs, plain and gzipped, seeks
+ *       into them through the index the way readlog does, and checks
+ *       that the cached index is thrown away once the log changes.
+ * Usage: readlog_index_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#if HAVE_Z
+  #include <zlib.h>
+#endif
+
+#include <libplayercommon/test/test.h>
+
+#include "../readlog_index.h"
+
+#define FILENAME "readlog_index_test.log"
+#define GZFILENAME "readlog_index_test.log.gz"
+#define CACHENAME FILENAME READLOG_INDEX_EXTENSION
+#define GZCACHENAME GZFILENAME READLOG_INDEX_EXTENSION
+
+// The test logs: a header, then a position2d message every 0.1 s from
+// start, numbered so that every line can be told apart
+#define LOG_COUNT 600
+
+static void write_log(const char *filename, double start)
+{
+  FILE *file;
+  int i;
+
+  file = fopen(filename, "w");
+  fprintf(file, "## Player version 3.1.0 \n");
+  fprintf(file, "## File version 0.3.0\n");
+  for (i = 0; i < LOG_COUNT; i++)
+    fprintf(file, "%.3f 16777343 6665 position2d 00 001 001 "
+            "%+08.3f +00.000 +0.000 +0.000 +0.000 +0.000 0\n",
+            start + 0.1 * i, (double) i);
+  fclose(file);
+}
+
+// Read a line from a log, plain or gzipped
+static int read_line(FILE *file, void *gzfile, char *line, int size)
+{
+#if HAVE_Z
+  if (gzfile)
+    return gzgets((gzFile) gzfile, line, size) != NULL;
+#endif
+  return fgets(line, size, file) != NULL;
+}
+
+// Seek to a time the way readlog does: to the indexed line, skipping the
+// lines before the time.  Returns the number of the line reached, with
+// its time and its message number, or -1.
+static int seek(readlog_index_t *index, FILE *file, void *gzfile,
+                double time, double *found, int *number)
+{
+  int64_t offset;
+  int linenum;
+  char line[256];
+  double t, x;
+
+  if (readlog_index_find(index, time, &offset, &linenum) != 0)
+    return -1;
+#if HAVE_Z
+  if (gzfile)
+  {
+    if (gzseek((gzFile) gzfile, (z_off_t) offset, SEEK_SET) < 0)
+      return -1;
+  }
+  else
+#endif
+  if (fseek(file, (long) offset, SEEK_SET) != 0)
+    return -1;
+
+  for (; read_line(file, gzfile, line, sizeof(line)); linenum++)
+  {
+    if (sscanf(line, "%lf %*s %*s %*s %*s %*s %*s %lf", &t, &x) != 2)
+      return -1;
+    if (t >= time - 1e-6)
+    {
+      *found = t;
+      *number = (int) x;
+      return linenum;
+    }
+  }
+  return -1;
+}
+
+// Seek to a spread of times in a log that starts at start
+static int check_seeks(readlog_index_t *index, FILE *file, void *gzfile,
+                       double start)
+{
+  int i, n, linenum;
+  double t, found;
+
+  for (i = 0; i < LOG_COUNT; i += 7)
+  {
+    t = start + 0.1 * i;
+    linenum = seek(index, file, gzfile, t, &found, &n);
+    // Two header lines, then the messages from line 3
+    if (linenum != i + 3 || n != i || found < t - 1e-6 || found > t + 1e-6)
+      return 0;
+  }
+
+  // Before the start and past the end
+  linenum = seek(index, file, gzfile, start - 5.0, &found, &n);
+  if (linenum != 3 || n != 0)
+    return 0;
+  return seek(index, file, gzfile, start + LOG_COUNT, &found, &n) == -1;
+}
+
+// Read the second line of the cache: the log's size and time
+static int cache_stamp(const char *cachename, long long *size,
+                       long long *mtime)
+{
+  FILE *file;
+  char line[256];
+  int ret;
+
+  if (!(file = fopen(cachename, "r")))
+    return -1;
+  ret = (fgets(line, sizeof(line), file) && fgets(line, sizeof(line), file) &&
+         sscanf(line, "## log %lld %lld", size, mtime) == 2) ? 0 : -1;
+  fclose(file);
+  return ret;
+}
+
+int main(int argc, char **argv)
+{
+  readlog_index_t *index;
+  FILE *file;
+  struct stat st;
+  struct utimbuf times;
+  long long size, mtime;
+  int ok;
+
+  remove(CACHENAME);
+  write_log(FILENAME, 100.0);
+
+  TEST("index a text log");
+  index = readlog_index_load(FILENAME);
+  check(index != NULL && stat(CACHENAME, &st) == 0);
+
+  TEST("seek into the log");
+  file = fopen(FILENAME, "r");
+  check(index && file && check_seeks(index, file, NULL, 100.0));
+  if (index)
+    readlog_index_free(index);
+
+  TEST("seek with the cached index");
+  index = readlog_index_load(FILENAME);
+  check(index && file && check_seeks(index, file, NULL, 100.0));
+  if (index)
+    readlog_index_free(index);
+  if (file)
+    fclose(file);
+
+  // A log of another size: the messages come later
+  TEST("stale index is rebuilt when the log's size changes");
+  write_log(FILENAME, 2000.0);
+  index = readlog_index_load(FILENAME);
+  file = fopen(FILENAME, "r");
+  stat(FILENAME, &st);
+  ok = index && file && check_seeks(index, file, NULL, 2000.0) &&
+    cache_stamp(CACHENAME, &size, &mtime) == 0 &&
+    size == (long long) st.st_size;
+  check(ok);
+  if (index)
+    readlog_index_free(index);
+  if (file)
+    fclose(file);
+
+  // A log of the same size, but written later: the index is only good if
+  // the log's time is checked too
+  TEST("stale index is rebuilt when the log's time changes");
+  write_log(FILENAME, 3000.0);
+  stat(FILENAME, &st);
+  times.actime = st.st_atime;
+  times.modtime = st.st_mtime + 10;
+  utime(FILENAME, &times);
+  index = readlog_index_load(FILENAME);
+  file = fopen(FILENAME, "r");
+  ok = index && file && check_seeks(index, file, NULL, 3000.0) &&
+    cache_stamp(CACHENAME, &size, &mtime) == 0 &&
+    mtime == (long long) times.modtime;
+  check(ok);
+  if (index)
+    readlog_index_free(index);
+  if (file)
+    fclose(file);
+
+  TEST("corrupt index is rebuilt");
+  file = fopen(CACHENAME, "a");
+  fprintf(file, "garbage\n");
+  fclose(file);
+  index = readlog_index_load(FILENAME);
+  file = fopen(FILENAME, "r");
+  check(index && file && check_seeks(index, file, NULL, 3000.0));
+  if (index)
+    readlog_index_free(index);
+  if (file)
+    fclose(file);
+
+#if HAVE_Z
+  {
+    gzFile gzfile;
+    char buf[4096];
+    size_t len;
+
+    // The same log, gzipped
+    remove(GZCACHENAME);
+    file = fopen(FILENAME, "r");
+    gzfile = gzopen(GZFILENAME, "w");
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+      gzwrite(gzfile, buf, len);
+    gzclose(gzfile);
+    fclose(file);
+
+    TEST("seek into a gzipped log");
+    index = readlog_index_load(GZFILENAME);
+    gzfile = gzopen(GZFILENAME, "r");
+    check(index && gzfile && check_seeks(index, NULL, gzfile, 3000.0));
+    if (index)
+      readlog_index_free(index);
+    if (gzfile)
+      gzclose(gzfile);
+    remove(GZFILENAME);
+    remove(GZCACHENAME);
+  }
+#endif
+
+  remove(FILENAME);
+  remove(CACHENAME);
+
+  return test_result();
+}
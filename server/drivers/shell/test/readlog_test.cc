@@ -0,0 +1,409 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/***************************************************************************
+ * Desc: Log replay tests.  Plays a text log, a gzipped text log and a
+ *       binary log back together through a readlog driver at speed 0,
+ *       and checks that their messages come out in time order, none
+ *       lost to a slow client, across seeks and rewinds, and that the
+ *       reader threads go away when the last client does.
+ * Usage: readlog_test
+ *        Exits with a non-zero status if any test fails.
+ **************************************************************************/
+
+#include <config.h>
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if HAVE_Z
+  #include <zlib.h>
+#endif
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+#include <libplayerinterface/interface_util.h>
+#include <libplayercommon/test/test.h>
+
+#include "../binlog.h"
+#include "../readlog_index.h"
+
+#define FILENAME "readlog_test.cfg"
+#define TEXTNAME "readlog_test_a.log"
+#if HAVE_Z
+  #define GZNAME "readlog_test_b.log.gz"
+#else
+  #define GZNAME "readlog_test_b.log"
+#endif
+#define BINNAME "readlog_test_c" BINLOG_EXTENSION
+
+// Where the data seems to come from
+#define TEST_HOST 16777343
+#define TEST_ROBOT 6665
+
+// The logs: one position2d device each, starting at START and a
+// message every STEP seconds.  The times are all eighths of a second,
+// which survive the text format, so that the logs share some of them.
+#define LOG_COUNT 3
+#define START 100.0
+static const double offset[LOG_COUNT] = {0.0, 0.125, 0.0};
+static const double step[LOG_COUNT] = {0.25, 0.375, 0.5};
+static const int count[LOG_COUNT] = {200, 133, 100};
+
+// A small client queue, so that the driver has to wait for it
+#define QUEUE_LEN 8
+
+// The driver under test, from readlog.cc
+Driver* ReadReadLog_Init(ConfigFile* cf, int section);
+
+static double log_time(int log, int n)
+{
+  return START + offset[log] + step[log] * n;
+}
+
+static player_devaddr_t position(int index)
+{
+  player_devaddr_t addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.host = TEST_HOST;
+  addr.robot = TEST_ROBOT;
+  addr.interf = PLAYER_POSITION2D_CODE;
+  addr.index = index;
+  return addr;
+}
+
+// Write log n as text, as writelog does; px is the message's number
+static void write_text(int log, const char *filename)
+{
+  char line[256];
+  int i, len;
+  FILE *file = NULL;
+#if HAVE_Z
+  gzFile gzfile = NULL;
+
+  if (strcmp(filename + strlen(filename) - 3, ".gz") == 0)
+    gzfile = gzopen(filename, "w");
+  else
+#endif
+    file = fopen(filename, "w");
+
+  for (i = -2; i < count[log]; i++)
+  {
+    if (i == -2)
+      len = snprintf(line, sizeof(line), "## Player version 3.1.0 \n");
+    else if (i == -1)
+      len = snprintf(line, sizeof(line), "## File version 0.3.0\n");
+    else
+      len = snprintf(line, sizeof(line),
+                     "%.3f %u %u position2d %02d 001 001 "
+                     "%+08.3f +00.000 +0.000 +0.000 +0.000 +0.000 0\n",
+                     log_time(log, i), TEST_HOST, TEST_ROBOT, log,
+                     (double) i);
+#if HAVE_Z
+    if (gzfile)
+      gzwrite(gzfile, line, len);
+    else
+#endif
+      fwrite(line, 1, len, file);
+  }
+#if HAVE_Z
+  if (gzfile)
+    gzclose(gzfile);
+  else
+#endif
+    fclose(file);
+}
+
+// Write log n as a binary log
+static void write_binary(int log, const char *filename)
+{
+  binlog_t *binlog;
+  player_msghdr_t hdr;
+  player_position2d_data_t data;
+  int i;
+
+  binlog = binlog_create(filename, 0);
+  for (i = 0; binlog && i < count[log]; i++)
+  {
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.addr = position(log);
+    hdr.type = PLAYER_MSGTYPE_DATA;
+    hdr.subtype = PLAYER_POSITION2D_DATA_STATE;
+    hdr.timestamp = log_time(log, i);
+    memset(&data, 0, sizeof(data));
+    data.pos.px = i;
+    binlog_write(binlog, &hdr, &data);
+  }
+  if (binlog)
+    binlog_close(binlog);
+}
+
+// The number of threads in this process
+static int thread_count()
+{
+  DIR *dir;
+  struct dirent *entry;
+  int n;
+
+  if (!(dir = opendir("/proc/self/task")))
+    return -1;
+  n = 0;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if (entry->d_name[0] != '.')
+      n++;
+  }
+  closedir(dir);
+  return n;
+}
+
+// Make a request of the log device.  Returns true if it was acked.
+static bool request(Device *log, uint8_t subtype, void *data)
+{
+  QueuePointer queue(false, PLAYER_MSGQUEUE_DEFAULT_MAXLEN);
+  Message *msg;
+  bool ok;
+
+  msg = log->TimedRequest(queue, PLAYER_MSGTYPE_REQ, subtype, data, 5.0,
+                          NULL, true);
+  ok = msg && msg->GetHeader()->type == PLAYER_MSGTYPE_RESP_ACK;
+  delete msg;
+  return ok;
+}
+
+static bool set_state(Device *log, int state)
+{
+  player_log_set_read_state_t req;
+  req.state = state;
+  return request(log, PLAYER_LOG_REQ_SET_READ_STATE, &req);
+}
+
+static bool set_time(Device *log, double time)
+{
+  player_log_set_read_time_t req;
+  memset(&req, 0, sizeof(req));
+  req.time = time;
+  return request(log, PLAYER_LOG_REQ_SET_READ_TIME, &req);
+}
+
+// Take what the driver publishes, slowly, until want messages have
+// come, or none for a second.  Checks that they are the messages of the
+// logs from time from, in time order, with ties in the order of the
+// logs.  Returns the number taken, or -1 if one was wrong.
+static int take(QueuePointer &queue, double from, int want)
+{
+  Message *msg;
+  player_msghdr_t *hdr;
+  player_position2d_data_t *data;
+  int next[LOG_COUNT];
+  int i, n, log, idle;
+  bool ok;
+
+  // The first message of each log at or after the time
+  for (i = 0; i < LOG_COUNT; i++)
+    for (next[i] = 0; next[i] < count[i] && log_time(i, next[i]) < from;
+         next[i]++);
+
+  ok = true;
+  for (n = 0, idle = 0; n < want && idle < 1000; )
+  {
+    if (!(msg = queue->Pop()))
+    {
+      usleep(1000);
+      idle++;
+      continue;
+    }
+    idle = 0;
+    hdr = msg->GetHeader();
+    data = (player_position2d_data_t*) msg->GetPayload();
+
+    // The next message should be the earliest left, from the first log
+    // that has it
+    for (log = -1, i = 0; i < LOG_COUNT; i++)
+    {
+      if (next[i] < count[i] &&
+          (log < 0 || log_time(i, next[i]) < log_time(log, next[log])))
+        log = i;
+    }
+    if (log < 0 || hdr->type != PLAYER_MSGTYPE_DATA ||
+        hdr->addr.index != (uint32_t) log ||
+        hdr->timestamp != log_time(log, next[log]) ||
+        data->pos.px != next[log])
+      ok = false;
+    if (log >= 0)
+      next[log]++;
+    delete msg;
+    n++;
+
+    // A slow client
+    if (n % 4 == 0)
+      usleep(2000);
+  }
+  return ok ? n : -1;
+}
+
+// How many messages the logs have at or after a time
+static int count_from(double from)
+{
+  int i, j, n;
+
+  for (n = 0, i = 0; i < LOG_COUNT; i++)
+    for (j = 0; j < count[i]; j++)
+      n += log_time(i, j) >= from;
+  return n;
+}
+
+// Take whatever is waiting, until nothing has come for a while
+static void drain(QueuePointer &queue)
+{
+  Message *msg;
+  int idle;
+
+  for (idle = 0; idle < 300; )
+  {
+    if ((msg = queue->Pop()) != NULL)
+    {
+      delete msg;
+      idle = 0;
+    }
+    else
+    {
+      usleep(1000);
+      idle++;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Driver *driver;
+  Device *devs[LOG_COUNT], *log;
+  player_devaddr_t log_addr;
+  int i, n, threads;
+  bool ok;
+
+  playerxdr_ftable_init();
+  itable_init();
+  ErrorInit(0, NULL);
+  player_globals_init();
+
+  write_text(0, TEXTNAME);
+  write_text(1, GZNAME);
+  write_binary(2, BINNAME);
+
+  FILE *file = fopen(FILENAME, "w");
+  fprintf(file,
+          "driver\n"
+          "(\n"
+          "  name \"readlog\"\n"
+          "  filename [\"%s\" \"%s\" \"%s\"]\n"
+          "  provides [\"position2d:0\" \"position2d:1\" \"position2d:2\""
+          " \"log:0\"]\n"
+          "  speed 0\n"
+          "  read_ahead 4\n"
+          ")\n", TEXTNAME, GZNAME, BINNAME);
+  fclose(file);
+
+  // Give up on a driver that hangs, rather than hang the tests
+  alarm(120);
+
+  ConfigFile cf(TEST_HOST, TEST_ROBOT);
+  TEST("load the configuration");
+  check(cf.Load(FILENAME));
+  remove(FILENAME);
+
+  driver = ReadReadLog_Init(&cf, 1);
+  TEST("make the driver");
+  check(driver->GetError() == 0);
+  if (driver->GetError() != 0)
+    return test_result();
+
+  memset(&log_addr, 0, sizeof(log_addr));
+  log_addr.host = TEST_HOST;
+  log_addr.robot = TEST_ROBOT;
+  log_addr.interf = PLAYER_LOG_CODE;
+  log = deviceTable->GetDevice(log_addr, false);
+
+  threads = thread_count();
+  QueuePointer queue(false, QUEUE_LEN);
+  for (i = 0; i < LOG_COUNT; i++)
+  {
+    devs[i] = deviceTable->GetDevice(position(i), false);
+    devs[i]->Subscribe(queue);
+  }
+
+  TEST("play the logs together, in time order, to a slow client");
+  n = take(queue, 0, count_from(0) + 1);
+  check(n == count_from(0));
+
+  TEST("rewind and play them again");
+  ok = request(log, PLAYER_LOG_REQ_SET_READ_REWIND, NULL) &&
+    set_state(log, 1);
+  n = take(queue, 0, count_from(0) + 1);
+  check(ok && n == count_from(0));
+
+  TEST("seek forward while playing");
+  ok = request(log, PLAYER_LOG_REQ_SET_READ_REWIND, NULL) &&
+    set_state(log, 1) && take(queue, 0, 50) == 50 && set_state(log, 0);
+  drain(queue);
+  ok = ok && set_time(log, START + 20.0) && set_state(log, 1);
+  n = take(queue, START + 20.0, count_from(0) + 1);
+  check(ok && n == count_from(START + 20.0));
+
+  TEST("seek back from the end, between messages");
+  ok = set_time(log, START + 10.1) && set_state(log, 1);
+  n = take(queue, START + 10.1, count_from(0) + 1);
+  check(ok && n == count_from(START + 10.1));
+
+  // Stop taking messages, so that the driver and the readers are all
+  // waiting, then go away
+  TEST("readers stop when the last client goes");
+  ok = request(log, PLAYER_LOG_REQ_SET_READ_REWIND, NULL) &&
+    set_state(log, 1) && take(queue, 0, 10) == 10;
+  usleep(200000);
+  ok = ok && thread_count() >= threads + 1 + LOG_COUNT;
+  for (i = 0; i < LOG_COUNT; i++)
+    devs[i]->Unsubscribe(queue);
+  for (i = 0; i < 500 && thread_count() > threads; i++)
+    usleep(10000);
+  check(ok && thread_count() == threads);
+  drain(queue);
+
+  TEST("play again after stopping");
+  for (i = 0; i < LOG_COUNT; i++)
+    devs[i]->Subscribe(queue);
+  n = take(queue, 0, count_from(0) + 1);
+  for (i = 0; i < LOG_COUNT; i++)
+    devs[i]->Unsubscribe(queue);
+  check(n == count_from(0));
+
+  remove(TEXTNAME);
+  remove(TEXTNAME READLOG_INDEX_EXTENSION);
+  remove(GZNAME);
+  remove(GZNAME READLOG_INDEX_EXTENSION);
+  remove(BINNAME);
+
+  return test_result();
+}
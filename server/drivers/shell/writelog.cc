@@ -96,6 +96,7 @@ The writelog driver can will log data from the following interfaces:
 - PLAYER_LOG_REQ_SET_WRITE_STATE
 - PLAYER_LOG_REQ_SET_STATE
 - PLAYER_LOG_REQ_SET_FILENAME
+- PLAYER_LOG_REQ_GET_WRITE_STATS (only with the writer thread)
 
 @par Configuration file options
 - log_directory (string)
@@ -133,6 +134,72 @@ The writelog driver can will log data from the following interfaces:
   - Save image data to external files within the log directory.
     The image files are named "(basename)(timestamp)_camera_II_NNNNNNN.pnm",
     where II is the device index and NNNNNNN is the frame number.
+    Text logs only.
+- camera_store_images (integer)
+  - Default: 0
+  - Write images to a frame store beside the log (see below) rather than
+    into the log as hex.  Text logs only.
+- camera_store_quality (float)
+  - Default: 0
+  - If more than 0, uncompressed 24-bit RGB images are compressed to JPEG,
+    at this quality (0 to 1), before they go into the frame store.  Needs
+    Player to be built with libjpeg.
+- compress (integer)
+  - Default: 0
+  - Compress binary logs with zlib, if Player was built with it.
+- writer_thread (integer)
+  - Default: 1
+  - Write the log from a separate thread (see below), if the system
+    allows it.  If 0, each message is written to the file as it comes in.
+- writer_buffer_size (integer)
+  - Default: 1048576
+  - Size of each of the writer thread's buffers [bytes].
+- writer_buffers (integer)
+  - Default: 8
+  - Number of buffers for the writer thread; at least 2.
+- writer_sync_interval (float)
+  - Default: 0
+  - If more than 0, make sure the log is on the disk (with fdatasync())
+    at most this often [s], so less is lost if the robot loses power.
+- writer_direct (integer)
+  - Default: 0
+  - Open the log with O_DIRECT, so it does not fill the page cache.
+    Buffers are then written only when full.
+
+@par Binary logs
+
+If the log file name ends in ".plb" (e.g., with extension ".plb"), the
+log is written in a binary format instead of text.  Each message is
+stored as it would be sent to a client, XDR-encoded, so there is no
+formatting to do and any interface can be logged.  Messages are stored
+in blocks, with an index of their times at the end of the file, so that
+@ref driver_readlog can seek through the log; the file is readable even
+if Player dies before closing it.  Text logs can be converted to binary
+logs with @ref util_playerlogconvert.
+
+@par Writer thread
+
+Rather than write each message to the file as it comes in, which on a
+slow disk (such as an SD card) holds the driver up until messages from
+the logged devices are dropped, messages are formatted into a ring of
+large buffers that a separate thread writes to the file, one buffer at a
+time.  If the disk falls so far behind that the buffers are all full,
+messages are dropped as they come in, rather than holding the driver up.
+Buffers are written within about a second, even if they are not full.
+The bytes written, write rate, messages dropped and time spent waiting
+for the disk can be had with a PLAYER_LOG_REQ_GET_WRITE_STATS request,
+and are printed when the log is closed.
+
+@par Frame stores
+
+With camera_store_images set, camera images are not written into a text
+log as hex, but appended as they are to a frame store: a file named
+after the log with ".frames" added.  The log gives just the number of
+each image in the store (see @ref player_driver_writelog_camera), so it
+is less than half the size.  @ref driver_readlog maps the store
+into memory and publishes the images straight out of it.  The store is
+written through a writer thread of its own; if it falls behind, images
+are dropped, and logged as such.
 @par Example
 
 @verbatim
@@ -171,7 +238,14 @@ driver
 
 #include <libplayercore/playercore.h>
 
+#include "binlog.h"
 #include "encode.h"
+#include "framestore.h"
+#include "logwriter.h"
+
+#if HAVE_JPEG
+  #include <libplayerjpeg/playerjpeg.h>
+#endif
 
 #if defined (WIN32)
   #define snprintf _snprintf
@@ -222,6 +296,10 @@ class WriteLog: public ThreadedDriver
   // Write localize particles to file
   private: void WriteLocalizeParticles();
 
+  // Write a message to the binary log
+  private: void WriteBinary(WriteLogDevice *device,
+                            player_msghdr_t* hdr, void *data);
+
   // Write data to file
   private: void Write(WriteLogDevice *device,
                       player_msghdr_t* hdr, void *data);
@@ -285,6 +363,10 @@ class WriteLog: public ThreadedDriver
   // Write camera data to file
   private: int WriteCamera(WriteLogDevice *device, player_msghdr_t* hdr, void *data);
 
+  // Write a camera frame to the frame store, and its format and number
+  // to file
+  private: void WriteCameraFrame(player_camera_data_t *camera_data);
+
   // Write fiducial data to file
   private: int WriteFiducial(player_msghdr_t* hdr, void *data);
 
@@ -311,6 +393,18 @@ class WriteLog: public ThreadedDriver
   private: char filename[1024];
   private: FILE *file;
 
+  // Binary log to write to, instead of file
+  private: binlog_t *binlog;
+  private: bool compress;
+
+  // Writer thread that file or binlog write through, if any
+  private: logwriter_t *writer;
+  private: bool use_writer;
+  private: int writer_buffer_size;
+  private: int writer_buffers;
+  private: double writer_sync_interval;
+  private: bool writer_direct;
+
   // Subscribed device list
   private: int device_count;
   private: WriteLogDevice devices[1024];
@@ -329,6 +423,20 @@ class WriteLog: public ThreadedDriver
   private: bool cameraLogImages;
   // Save camera frames to image files as well?
   private: bool cameraSaveImages;
+  // Save camera frames to a frame store beside the log, instead of into
+  // it?  And the JPEG quality to compress them at first, if any.
+  private: bool cameraStoreImages;
+  private: double cameraStoreQuality;
+
+  // Frame store for camera frames, and the writer thread it writes
+  // through, if any
+  private: char frames_filename[1024];
+  private: framestore_t *frames;
+  private: logwriter_t *frames_writer;
+
+  // Space for compressing frames
+  private: uint8_t *frames_jpeg;
+  private: size_t frames_jpeg_size;
 };
 
 
@@ -372,6 +480,12 @@ WriteLog::WriteLog(ConfigFile* cf, int section)
   char complete_filename[1024];
 
   this->file = NULL;
+  this->binlog = NULL;
+  this->writer = NULL;
+  this->frames = NULL;
+  this->frames_writer = NULL;
+  this->frames_jpeg = NULL;
+  this->frames_jpeg_size = 0;
 
   // Construct timestamp from date and time.  Note that we use
   // the system time, *not* the Player time.  I think that this is the
@@ -444,6 +558,35 @@ WriteLog::WriteLog(ConfigFile* cf, int section)
   // Camera specific settings
   this->cameraLogImages = cf->ReadInt(section, "camera_log_images", 1) != 0 ? true : false;
   this->cameraSaveImages = cf->ReadInt(section, "camera_save_images", 0) != 0 ? true : false;
+  this->cameraStoreImages = cf->ReadInt(section, "camera_store_images", 0) != 0 ? true : false;
+  this->cameraStoreQuality = cf->ReadFloat(section, "camera_store_quality", 0.0);
+#if !HAVE_JPEG
+  if (this->cameraStoreQuality > 0)
+  {
+    PLAYER_WARN("no JPEG support; camera frames are stored uncompressed");
+    this->cameraStoreQuality = 0;
+  }
+#endif
+
+  this->compress = cf->ReadInt(section, "compress", 0) != 0 ? true : false;
+
+  // Writer thread settings
+  this->use_writer = cf->ReadInt(section, "writer_thread", 1) != 0 ? true : false;
+  this->writer_buffer_size = cf->ReadInt(section, "writer_buffer_size", 1048576);
+  this->writer_buffers = cf->ReadInt(section, "writer_buffers", 8);
+  this->writer_sync_interval = cf->ReadFloat(section, "writer_sync_interval", 0.0);
+  this->writer_direct = cf->ReadInt(section, "writer_direct", 0) != 0 ? true : false;
+  if (this->use_writer && !LOGWRITER_AVAILABLE)
+  {
+    PLAYER_WARN("no writer thread on this system; writing logs directly");
+    this->use_writer = false;
+  }
+  if (this->writer_buffer_size <= 0 || this->writer_buffers < 2)
+  {
+    PLAYER_ERROR("writer_buffer_size must be positive and writer_buffers at least 2");
+    this->SetError(-1);
+    return;
+  }
 
   return;
 }
@@ -453,6 +596,7 @@ WriteLog::WriteLog(ConfigFile* cf, int section)
 // Destructor
 WriteLog::~WriteLog()
 {
+  free(this->frames_jpeg);
   return;
 }
 
@@ -523,14 +667,84 @@ WriteLog::OpenFile()
   mkdir(this->log_directory, 0755);
 #endif
 
+  // Start the writer thread, which the file or binary log then writes to
+  if(this->use_writer)
+  {
+    this->writer = logwriter_create(this->filename,
+                                    (size_t) this->writer_buffer_size,
+                                    this->writer_buffers,
+                                    this->writer_sync_interval,
+                                    this->writer_direct ? LOGWRITER_DIRECT : 0);
+    if(this->writer == NULL)
+      return(-1);
+  }
+
+  // Binary logs have no text header; just the geometries go in
+  if(binlog_match_filename(this->filename))
+  {
+    if(this->writer)
+      this->binlog = binlog_create_stream(logwriter_stream(this->writer),
+                                          this->compress ? BINLOG_COMPRESS : 0);
+    else
+      this->binlog = binlog_create(this->filename,
+                                   this->compress ? BINLOG_COMPRESS : 0);
+    if(this->binlog == NULL)
+    {
+      this->CloseFile();
+      return(-1);
+    }
+    this->WriteGeometries();
+    return(0);
+  }
+
   // Open the file
-  this->file = fopen(this->filename, "w+");
+  if(this->writer)
+    this->file = logwriter_stream(this->writer);
+  else
+    this->file = fopen(this->filename, "w+");
   if(this->file == NULL)
   {
     PLAYER_ERROR2("unable to open [%s]: %s\n", this->filename, strerror(errno));
     return(-1);
   }
 
+  // Open the frame store, if there is a camera to put in it
+  if(this->cameraStoreImages && this->cameraLogImages)
+  {
+    int i;
+
+    for (i = 0; i < this->device_count; i++)
+      if (this->devices[i].addr.interf == PLAYER_CAMERA_CODE)
+        break;
+    if(i < this->device_count)
+    {
+      if(framestore_filename(this->filename, this->frames_filename,
+                             sizeof(this->frames_filename)) != 0)
+      {
+        PLAYER_ERROR1("no room for the frame store name of [%s]", this->filename);
+        this->CloseFile();
+        return(-1);
+      }
+      if(this->use_writer)
+      {
+        this->frames_writer = logwriter_create(this->frames_filename,
+                                               (size_t) this->writer_buffer_size,
+                                               this->writer_buffers,
+                                               this->writer_sync_interval,
+                                               this->writer_direct ? LOGWRITER_DIRECT : 0);
+        if(this->frames_writer)
+          this->frames = framestore_create_stream(logwriter_stream(this->frames_writer));
+      }
+      else
+        this->frames = framestore_create(this->frames_filename);
+      if(this->frames == NULL)
+      {
+        this->CloseFile();
+        return(-1);
+      }
+    }
+  }
+
   // Write the file header
   fprintf(this->file, "## Player version %s \n", PLAYER_VERSION);
   fprintf(this->file, "## File version %s \n", "0.3.0");
@@ -724,6 +938,44 @@ WriteLog::CloseFile()
     fclose(this->file);
     this->file = NULL;
   }
+  if(this->binlog)
+  {
+    binlog_close(this->binlog);
+    this->binlog = NULL;
+  }
+  if(this->writer)
+  {
+    logwriter_stats_t stats;
+
+    logwriter_get_stats(this->writer, &stats);
+    if(logwriter_close(this->writer) != 0)
+      PLAYER_ERROR1("failed to write all of [%s]", this->filename);
+    this->writer = NULL;
+    PLAYER_MSG5(1, "wrote %u messages to [%s], dropped %u, waited %.3f s "
+                "for the disk %u times", stats.records_written,
+                this->filename, stats.records_dropped, stats.stall_time,
+                stats.stalls);
+  }
+  if(this->frames)
+  {
+    PLAYER_MSG2(1, "wrote %u frames to [%s]",
+                framestore_count(this->frames), this->frames_filename);
+    if(framestore_close(this->frames) != 0)
+      PLAYER_ERROR1("failed to finish [%s]", this->frames_filename);
+    this->frames = NULL;
+  }
+  if(this->frames_writer)
+  {
+    logwriter_stats_t stats;
+
+    logwriter_get_stats(this->frames_writer, &stats);
+    if(logwriter_close(this->frames_writer) != 0)
+      PLAYER_ERROR1("failed to write all of [%s]", this->frames_filename);
+    this->frames_writer = NULL;
+    PLAYER_MSG4(1, "dropped %u frames for [%s], waited %.3f s for the disk "
+                "%u times", stats.records_dropped, this->frames_filename,
+                stats.stall_time, stats.stalls);
+  }
 }
 
 int
@@ -772,6 +1024,47 @@ WriteLog::ProcessMessage(QueuePointer & resp_queue,
                   (void*)&greq, sizeof(greq), NULL);
     return(0);
   }
+  else if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ,
+                                PLAYER_LOG_REQ_GET_WRITE_STATS,
+                                this->device_addr))
+  {
+    player_log_write_stats_t sreq;
+    logwriter_stats_t stats;
+
+    // Only the writer thread keeps count
+    if(!this->writer)
+      return(-1);
+
+    logwriter_get_stats(this->writer, &stats);
+
+    // The frame store is written separately, and counts frames
+    if(this->frames_writer)
+    {
+      logwriter_stats_t frame_stats;
+
+      logwriter_get_stats(this->frames_writer, &frame_stats);
+      stats.bytes_written += frame_stats.bytes_written;
+      stats.rate += frame_stats.rate;
+      stats.records_dropped += frame_stats.records_dropped;
+      if(frame_stats.backlog > stats.backlog)
+        stats.backlog = frame_stats.backlog;
+      stats.stall_time += frame_stats.stall_time;
+    }
+
+    sreq.bytes_written = stats.bytes_written;
+    sreq.rate = stats.rate;
+    sreq.records_written = stats.records_written;
+    sreq.records_dropped = stats.records_dropped;
+    sreq.backlog = (float) stats.backlog;
+    sreq.stall_time = stats.stall_time;
+
+    this->Publish(this->device_addr,
+                  resp_queue,
+                  PLAYER_MSGTYPE_RESP_ACK,
+                  PLAYER_LOG_REQ_GET_WRITE_STATS,
+                  (void*)&sreq, sizeof(sreq), NULL);
+    return(0);
+  }
   else if(Message::MatchMessage(hdr, PLAYER_MSGTYPE_REQ,
                                 PLAYER_LOG_REQ_SET_FILENAME, this->device_addr))
   {
@@ -843,8 +1136,9 @@ WriteLog::Main(void)
   {
     pthread_testcancel();
 
-    // Wait on my queue
-    this->Wait();
+    // Wait on my queue, waking up now and then to get old data
+    // written out
+    this->Wait(LOGWRITER_FLUSH_AGE);
 
 
     if (write_particles_now){
@@ -854,6 +1148,11 @@ WriteLog::Main(void)
 
     // Process all new messages (calls ProcessMessage on each)
     this->ProcessMessages();
+
+    if(this->writer)
+      logwriter_flush(this->writer, LOGWRITER_FLUSH_AGE);
+    if(this->frames_writer)
+      logwriter_flush(this->frames_writer, LOGWRITER_FLUSH_AGE);
   }
 }
 
@@ -872,6 +1171,18 @@ void WriteLog::Write(WriteLogDevice *device,
   ::lookup_interface_code(device->addr.interf, &iface);
   //gethostname(host, sizeof(host));
 
+  // If the disk is too far behind, drop the message
+  if(this->writer && logwriter_begin(this->writer) != 0)
+    return;
+
+  if(this->binlog)
+  {
+    this->WriteBinary(device, hdr, data);
+    if(this->writer)
+      logwriter_end(this->writer);
+    return;
+  }
+
   // Write header info
   fprintf(this->file, "%014.3f %u %u %s %02u %03u %03u ",
           hdr->timestamp,
@@ -981,13 +1292,48 @@ void WriteLog::Write(WriteLogDevice *device,
   fprintf(this->file, "\n");
 
   // Flush the data (some drivers produce a lot of data; we dont want
-  // it to back up and slow us down later).
-  fflush(this->file);
+  // it to back up and slow us down later).  The writer thread takes
+  // care of that for itself.
+  if(this->writer)
+    logwriter_end(this->writer);
+  else
+    fflush(this->file);
 
   return;
 }
 
 
+////////////////////////////////////////////////////////////////////////////
+// Write a message to the binary log, as it is
+void WriteLog::WriteBinary(WriteLogDevice *device,
+                           player_msghdr_t* hdr,
+                           void *data)
+{
+  player_msghdr_t h;
+  player_camera_data_t image;
+
+  // Log under the address we subscribed to, as the text log does
+  h = *hdr;
+  h.addr = device->addr;
+
+  // Leave out the image if asked to
+  if(!this->cameraLogImages && data &&
+     h.addr.interf == PLAYER_CAMERA_CODE &&
+     h.type == PLAYER_MSGTYPE_DATA &&
+     h.subtype == PLAYER_CAMERA_DATA_STATE)
+  {
+    image = *(player_camera_data_t*)data;
+    image.image_count = 0;
+    image.image = NULL;
+    data = &image;
+  }
+
+  if(binlog_write(this->binlog, &h, data) != 0)
+    PLAYER_WARN2("not logging message to interface \"%s\" with subtype %d",
+                 ::lookup_interface_name(0, h.addr.interf), h.subtype);
+}
+
+
 void
 WriteLog::WriteLocalizeParticles()
 
@@ -2797,7 +3143,10 @@ The format for each @ref interface_camera message is:
   - depth (int): in bits per pixel
   - format (int): image format
   - compression (int): image compression
-  - (optional) image data, encoded as a string of ASCII hex values
+  - image_count (int): size of the image data [bytes]
+  - (optional) image data, encoded as a string of ASCII hex values; or,
+    if the images are in a frame store, "@" and the number of the image in
+    the store (-1 if it was dropped because the disk fell behind)
 */
 
 int WriteLog::WriteCamera(WriteLogDevice *device, player_msghdr_t* hdr, void *data)
@@ -2811,13 +3160,16 @@ int WriteLog::WriteCamera(WriteLogDevice *device, player_msghdr_t* hdr, void *da
                 case PLAYER_CAMERA_DATA_STATE:
                     camera_data = (player_camera_data_t *) data;
 
-                    // Image format
-                    fprintf(this->file, "%d %d %d %d %d %d " ,
-                            camera_data->width, camera_data->height,
-                            camera_data->bpp, camera_data->format,
-                            camera_data->compression, camera_data->image_count);
+                    // Image format, and where the image is
+                    if(this->frames)
+                      this->WriteCameraFrame(camera_data);
+                    else
+                      fprintf(this->file, "%d %d %d %d %d %d " ,
+                              camera_data->width, camera_data->height,
+                              camera_data->bpp, camera_data->format,
+                              camera_data->compression, camera_data->image_count);
 
-                    if(this->cameraLogImages)
+                    if(this->cameraLogImages && !this->frames)
                     {
                         char *str;
                         size_t src_size, dst_size;
@@ -2890,6 +3242,72 @@ int WriteLog::WriteCamera(WriteLogDevice *device, player_msghdr_t* hdr, void *da
     return -1;
 }
 
+void WriteLog::WriteCameraFrame(player_camera_data_t *camera_data)
+{
+  const uint8_t *image;
+  uint32_t size, compression, frame;
+  long n;
+
+  image = camera_data->image;
+  size = camera_data->image_count;
+  compression = camera_data->compression;
+
+#if HAVE_JPEG
+  // Compress uncompressed colour frames first, if asked to
+  if(this->cameraStoreQuality > 0 &&
+     camera_data->compression == PLAYER_CAMERA_COMPRESS_RAW &&
+     camera_data->format == PLAYER_CAMERA_FORMAT_RGB888 &&
+     camera_data->bpp == 24 &&
+     size == camera_data->width * camera_data->height * 3)
+  {
+    size_t jpeg_size;
+    int jpeg_count;
+
+    // libplayerjpeg cannot tell when the image does not fit, so leave
+    // room for one bigger than the frame; if it is, the frame is kept
+    jpeg_size = 2 * (size_t) size + 1024;
+    if(this->frames_jpeg_size < jpeg_size)
+    {
+      free(this->frames_jpeg);
+      this->frames_jpeg = (uint8_t*) malloc(jpeg_size);
+      this->frames_jpeg_size = this->frames_jpeg ? jpeg_size : 0;
+    }
+    if(this->frames_jpeg)
+    {
+      jpeg_count = jpeg_compress(reinterpret_cast<char *>(this->frames_jpeg),
+                                 reinterpret_cast<char *>(camera_data->image),
+                                 camera_data->width, camera_data->height,
+                                 (int) jpeg_size,
+                                 static_cast<int>(this->cameraStoreQuality * 100));
+      if(jpeg_count > 0 && (uint32_t) jpeg_count < size)
+      {
+        image = this->frames_jpeg;
+        size = (uint32_t) jpeg_count;
+        compression = PLAYER_CAMERA_COMPRESS_JPEG;
+      }
+    }
+  }
+#endif
+
+  // Frames the disk has fallen too far behind for are dropped, but the
+  // line is still logged
+  n = -1;
+  if(!this->frames_writer || logwriter_begin(this->frames_writer) == 0)
+  {
+    if(framestore_write(this->frames, image, size, &frame) == 0)
+      n = (long) frame;
+    else
+      PLAYER_ERROR1("failed to write frame to [%s]", this->frames_filename);
+    if(this->frames_writer)
+      logwriter_end(this->frames_writer);
+  }
+
+  fprintf(this->file, "%d %d %d %d %d %d @%ld",
+          camera_data->width, camera_data->height,
+          camera_data->bpp, camera_data->format,
+          compression, size, n);
+}
+
 /** @ingroup tutorial_datalog
  * @defgroup player_driver_writelog_fiducial Fiducial format
 
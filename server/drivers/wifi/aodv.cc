@@ -117,6 +117,8 @@ void aodv_Register(DriverTable *table)
 Aodv::Aodv( ConfigFile *cf, int section)
   : Driver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN, PLAYER_WIFI_CODE)
 {
+  // Update() polls the aodv route file
+  this->alwaysupdate = true;
   return;
 }
 
@@ -160,6 +160,8 @@ linuxwifi_Register(DriverTable *table)
 LinuxWiFi::LinuxWiFi( ConfigFile *cf, int section) :
   Driver(cf, section, true, PLAYER_MSGQUEUE_DEFAULT_MAXLEN, PLAYER_WIFI_CODE)
 {
+  // Update() polls /proc/net/wireless
+  alwaysupdate = true;
   info_fp = NULL;
 
   sfd = -1;
@@ -51,7 +51,7 @@ The situation is essentially the same when running a simulation.
 @section Usage
 
 @code
-player [-q] [-d <level>] [-p <port>] [-h] <cfgfile>
+player [-q] [-d <level>] [-p <port>] [-m <backend>] [-t <threads>] [-h] <cfgfile>
 @endcode
 Arguments:
 - -h : Give help info; also lists drivers that were compiled into the server.
@@ -63,6 +63,13 @@ more output.  Default: 1.
 any devices in the configuration file without an explicit port assignment.
 Default: 6665.
 - -l \<logfile\>: File to log messages to (default stdout only)
+- -m \<backend\>: Storage used for message queues, "list" (the default) or
+"pool" (preallocated, recycled message slots).  Drivers can override this
+with their queue_backend option.
+- -t \<threads\>: Serve TCP clients from this many I/O worker threads, each
+handling the reading, parsing and writing for its own share of the
+connections, so that a slow client only delays the others in its share.
+Default: 0 (clients are served by the main server loop).
 - \<cfgfile\> : The configuration file to read.
 
 @section Example
@@ -145,6 +152,7 @@ bool daemonize_self();
 PlayerTCP* ptcp;
 PlayerUDP* pudp;
 ConfigFile* cf;
+int tcp_workers = 0;
 
 int
 main(int argc, char** argv)
@@ -353,6 +361,13 @@ main(int argc, char** argv)
     exit(-1);
   }
 
+  if(ptcp->StartWorkers(tcp_workers) < 0)
+  {
+    PLAYER_ERROR("failed to start TCP I/O worker threads");
+    Cleanup();
+    exit(-1);
+  }
+
   // Go back through and relabel the devices for which ports got
   // auto-assigned during Listen().
   // TODO: currently this only works for port=0.  Should add support to
@@ -418,8 +433,11 @@ main(int argc, char** argv)
  
   while(!player_quit)
   {
-    // wait until something other than driver requested watches happens
-    int numready = fileWatcher->Wait(0.01); // run at a minimum of 100Hz for other drivers
+    // Wait until a socket is ready or a client or non-threaded driver queue
+    // receives a message.  Only drivers that poll in Update() need us to
+    // keep cycling, at a minimum of 100Hz.
+    double timeout = deviceTable->HaveAlwaysUpdateDrivers() ? 0.01 : 1.0;
+    int numready = fileWatcher->Wait(timeout);
     if (numready > 0)
     {
       if(ptcp->Accept(0) < 0)
@@ -533,6 +551,8 @@ PrintUsage()
   fprintf(stderr, "  -q             : quiet mode: minimizes the console output on startup.\n");
   fprintf(stderr, "  -l <logfile>   : log player output to the specified file\n");
   fprintf(stderr, "  -s             : fork to a daemon process as the current user.\n");
+  fprintf(stderr, "  -m <backend>   : message queue storage, list (default) or pool.\n");
+  fprintf(stderr, "  -t <threads>   : serve TCP clients from this many I/O threads. Default: 0\n");
   fprintf(stderr, "  <configfile>   : load the the indicated config file\n");
   fprintf(stderr, "\nThe following %d drivers were compiled into Player:\n\n    ",
           driverTable->Size());
@@ -557,7 +577,7 @@ ParseArgs(int* port, int* debuglevel, char** cfgfilename, int* gz_serverid,
           int argc, char** argv)
 {
   int ch;
-  const char* optflags = "d:p:l:hqs";
+  const char* optflags = "d:p:l:m:t:hqs";
 
   // Get letter options
   while((ch = getopt(argc, argv, optflags)) != -1)
@@ -579,6 +599,19 @@ ParseArgs(int* port, int* debuglevel, char** cfgfilename, int* gz_serverid,
       case 's':
         should_daemonize = true;
         break;
+      case 'm':
+        if(!strcmp(optarg, "pool"))
+          MessageQueue::SetDefaultBackend(PLAYER_MSGQUEUE_BACKEND_POOL);
+        else if(!strcmp(optarg, "list"))
+          MessageQueue::SetDefaultBackend(PLAYER_MSGQUEUE_BACKEND_LIST);
+        else
+          return(-1);
+        break;
+      case 't':
+        tcp_workers = atoi(optarg);
+        if(tcp_workers < 0)
+          return(-1);
+        break;
       case '?':
       case ':':
       case 'h':
@@ -0,0 +1,119 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/***************************************************************************
+ * Desc: Server loop latency benchmark.  Sends opaque commands carrying a
+ *       sequence number and times how long each takes to come back as data.
+ *       Run against a server started with latency_bench.cfg.
+ * Usage: latency_bench [host] [port] [samples]
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <libplayerc/playerc.h>
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int compare(const void * a, const void * b)
+{
+  double da = *(const double*)a, db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+int main(int argc, char ** argv)
+{
+  const char * host = argc > 1 ? argv[1] : "localhost";
+  int port = argc > 2 ? atoi(argv[2]) : 6665;
+  int samples = argc > 3 ? atoi(argv[3]) : 1000;
+  playerc_client_t * client;
+  playerc_opaque_t * opaque;
+  player_opaque_data_t cmd;
+  uint32_t seq, echoed;
+  double * latency;
+  double start, total = 0;
+  int i;
+
+  client = playerc_client_create(NULL, host, port);
+  if (playerc_client_connect(client) != 0)
+  {
+    fprintf(stderr, "error: %s\n", playerc_error_str());
+    return -1;
+  }
+  /* push mode, so replies are not held back until we ask for data */
+  if (playerc_client_datamode(client, PLAYER_DATAMODE_PUSH) != 0)
+  {
+    fprintf(stderr, "error: %s\n", playerc_error_str());
+    return -1;
+  }
+  opaque = playerc_opaque_create(client, 0);
+  if (playerc_opaque_subscribe(opaque, PLAYER_OPEN_MODE) != 0)
+  {
+    fprintf(stderr, "error: %s\n", playerc_error_str());
+    return -1;
+  }
+
+  latency = (double*)calloc(samples, sizeof(double));
+  cmd.data_count = sizeof(seq);
+  cmd.data = (uint8_t*)&seq;
+  for (i = 0; i < samples; i++)
+  {
+    seq = i;
+    start = now();
+    if (playerc_opaque_cmd(opaque, &cmd) != 0)
+    {
+      fprintf(stderr, "error: %s\n", playerc_error_str());
+      return -1;
+    }
+    do
+    {
+      if (!playerc_client_read(client))
+      {
+        fprintf(stderr, "error: %s\n", playerc_error_str());
+        return -1;
+      }
+      echoed = (uint32_t)-1;
+      if (opaque->data_count == sizeof(echoed))
+        memcpy(&echoed, opaque->data, sizeof(echoed));
+    } while (echoed != seq);
+    latency[i] = now() - start;
+    total += latency[i];
+  }
+
+  qsort(latency, samples, sizeof(double), compare);
+  printf("%d round trips: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+         samples, 1e3 * total / samples, 1e3 * latency[samples / 2],
+         1e3 * latency[(samples * 99) / 100], 1e3 * latency[samples - 1]);
+
+  free(latency);
+  playerc_opaque_unsubscribe(opaque);
+  playerc_opaque_destroy(opaque);
+  playerc_client_disconnect(client);
+  playerc_client_destroy(client);
+  return 0;
+}
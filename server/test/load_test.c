@@ -0,0 +1,195 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000
+ *     Brian Gerkey, Kasper Stoy, Richard Vaughan, & Andrew Howard
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+/***************************************************************************
+ * Desc: TCP transport load test.  Subscribes 1, 2, 4, ... clients to
+ *       ranger:0 and reports the aggregate message rate and the latency
+ *       from the data timestamp to its arrival at each client.  Optionally
+ *       adds clients that subscribe but never read.  Run against a server
+ *       started with load_test.cfg.
+ * Usage: load_test [host] [port] [max clients] [seconds per step] [stalled]
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/time.h>
+
+#include <libplayerc/playerc.h>
+
+typedef struct
+{
+  playerc_client_t * client;
+  playerc_ranger_t * ranger;
+  int count;
+  double latency;
+} load_client_t;
+
+static double * samples;
+static int num_samples, size_samples;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int compare(const void * a, const void * b)
+{
+  double da = *(const double*)a, db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+/* Called by libplayerc for every ranger message */
+static void on_data(void * arg)
+{
+  load_client_t * c = (load_client_t*)arg;
+  double latency = now() - c->ranger->info.datatime;
+  c->count++;
+  c->latency += latency;
+  if (num_samples == size_samples)
+  {
+    size_samples = size_samples ? 2 * size_samples : 4096;
+    samples = (double*)realloc(samples, size_samples * sizeof(double));
+  }
+  samples[num_samples++] = latency;
+}
+
+static int open_client(load_client_t * c, const char * host, int port)
+{
+  memset(c, 0, sizeof(*c));
+  c->client = playerc_client_create(NULL, host, port);
+  if (playerc_client_connect(c->client) != 0 ||
+      playerc_client_datamode(c->client, PLAYER_DATAMODE_PUSH) != 0)
+    return -1;
+  c->ranger = playerc_ranger_create(c->client, 0);
+  if (playerc_ranger_subscribe(c->ranger, PLAYER_OPEN_MODE) != 0)
+    return -1;
+  return 0;
+}
+
+static void close_client(load_client_t * c)
+{
+  playerc_ranger_unsubscribe(c->ranger);
+  playerc_ranger_destroy(c->ranger);
+  playerc_client_disconnect(c->client);
+  playerc_client_destroy(c->client);
+}
+
+int main(int argc, char ** argv)
+{
+  const char * host = argc > 1 ? argv[1] : "localhost";
+  int port = argc > 2 ? atoi(argv[2]) : 6665;
+  int max_clients = argc > 3 ? atoi(argv[3]) : 256;
+  double duration = argc > 4 ? atof(argv[4]) : 5.0;
+  int num_stalled = argc > 5 ? atoi(argv[5]) : 0;
+  load_client_t * clients, * stalled;
+  struct pollfd * ufds;
+  int n, i;
+
+  clients = (load_client_t*)calloc(max_clients, sizeof(load_client_t));
+  stalled = (load_client_t*)calloc(num_stalled ? num_stalled : 1, sizeof(load_client_t));
+  ufds = (struct pollfd*)calloc(max_clients, sizeof(struct pollfd));
+
+  for (i = 0; i < num_stalled; i++)
+  {
+    if (open_client(stalled + i, host, port) != 0)
+    {
+      fprintf(stderr, "error: %s\n", playerc_error_str());
+      return -1;
+    }
+  }
+
+  printf("%8s %12s %12s %12s %12s\n",
+         "clients", "msgs/s", "p50 ms", "p99 ms", "worst ms");
+  for (n = 1; n <= max_clients; n *= 2)
+  {
+    double start, elapsed, worst = 0;
+    int total = 0;
+
+    for (i = 0; i < n; i++)
+    {
+      if (open_client(clients + i, host, port) != 0)
+      {
+        fprintf(stderr, "error: %s\n", playerc_error_str());
+        return -1;
+      }
+      ufds[i].fd = clients[i].client->sock;
+      ufds[i].events = POLLIN;
+    }
+
+    /* let the subscriptions settle, then measure */
+    start = now();
+    while (now() - start < 0.5)
+    {
+      poll(ufds, n, 10);
+      for (i = 0; i < n; i++)
+        if (ufds[i].revents & POLLIN)
+          playerc_client_read_nonblock(clients[i].client);
+    }
+    for (i = 0; i < n; i++)
+      playerc_client_addcallback(clients[i].client, &clients[i].ranger->info,
+                                 on_data, clients + i);
+
+    num_samples = 0;
+    start = now();
+    while ((elapsed = now() - start) < duration)
+    {
+      if (poll(ufds, n, 10) <= 0)
+        continue;
+      for (i = 0; i < n; i++)
+      {
+        if ((ufds[i].revents & POLLIN) &&
+            playerc_client_read_nonblock(clients[i].client) < 0)
+        {
+          fprintf(stderr, "error: %s\n", playerc_error_str());
+          return -1;
+        }
+      }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      total += clients[i].count;
+      if (clients[i].count && clients[i].latency / clients[i].count > worst)
+        worst = clients[i].latency / clients[i].count;
+      playerc_client_delcallback(clients[i].client, &clients[i].ranger->info,
+                                 on_data, clients + i);
+      close_client(clients + i);
+    }
+    qsort(samples, num_samples, sizeof(double), compare);
+    printf("%8d %12.0f %12.3f %12.3f %12.3f\n", n, total / elapsed,
+           num_samples ? 1e3 * samples[num_samples / 2] : 0.0,
+           num_samples ? 1e3 * samples[(num_samples * 99) / 100] : 0.0,
+           1e3 * worst);
+    fflush(stdout);
+  }
+
+  for (i = 0; i < num_stalled; i++)
+    close_client(stalled + i);
+  free(samples);
+  free(ufds);
+  free(stalled);
+  free(clients);
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2005
+ *     Brian Gerkey
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/** @ingroup utils Utilities */
+/** @{ */
+/** @defgroup util_playerlogconvert playerlogconvert
+ * @brief Convert a text log into a binary log
+
+@par Synopsis
+
+playerlogconvert reads a text log, as written by the @ref
+driver_writelog driver, and writes it out as a binary log, which the
+@ref driver_readlog driver can replay much faster and seek through.
+The text is parsed exactly as @ref driver_readlog parses it, and every
+device in the log is converted.
+
+@par Usage
+
+@verbatim
+$ playerlogconvert [-z] <text log> [<binary log>]
+@endverbatim
+
+- -z : compress the binary log, if Player was built with zlib
+- binary log : the name must end in ".plb"; if it is left out, the text
+  log is just parsed, to check it
+
+@par Example
+
+@verbatim
+$ playerlogconvert -z mydata.log mydata.plb
+@endverbatim
+
+*/
+/** @} */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libplayercore/playercore.h>
+#include <libplayerinterface/functiontable.h>
+
+#include "binlog.h"
+#include "logconvert.h"
+
+#define USAGE "Usage: playerlogconvert [-z] <text log> [<binary log>]"
+
+int main(int argc, char **argv)
+{
+  int i, flags, count;
+  const char *src, *dst;
+
+  flags = 0;
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+  {
+    if (!strcmp(argv[i], "-z"))
+      flags |= BINLOG_COMPRESS;
+    else
+    {
+      puts(USAGE);
+      return -1;
+    }
+  }
+  if (argc - i < 1 || argc - i > 2)
+  {
+    puts(USAGE);
+    return -1;
+  }
+  src = argv[i];
+  dst = argc - i == 2 ? argv[i + 1] : NULL;
+  if (dst && !binlog_match_filename(dst))
+  {
+    fprintf(stderr, "binary log names must end in %s\n", BINLOG_EXTENSION);
+    return -1;
+  }
+
+  player_globals_init();
+  playerxdr_ftable_init();
+  itable_init();
+  ErrorInit(1, NULL);
+
+  if ((count = readlog_convert(src, dst, flags)) < 0)
+  {
+    fprintf(stderr, "failed to convert %s\n", src);
+    return -1;
+  }
+
+  if (dst)
+    printf("%s: %d messages -> %s\n", src, count, dst);
+  else
+    printf("%s: %d messages\n", src, count);
+
+  player_globals_fini();
+  return 0;
+}
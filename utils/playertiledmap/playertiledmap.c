@@ -0,0 +1,345 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2005
+ *     Brian Gerkey
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/** @ingroup utils Utilities */
+/** @{ */
+/** @defgroup util_playertiledmap playertiledmap
+ * @brief Convert a map image into a tiled map file
+
+@par Synopsis
+
+playertiledmap reads a map image, as used by the @ref driver_mapfile
+driver, and writes it out as a tiled map file for the @ref
+driver_tiledmapfile driver.  Pixels are classified exactly as
+@ref driver_mapfile does it.  Binary PGM and PPM images are always
+read; other formats are read if Player was built with GDK pixbuf.
+
+@par Usage
+
+@verbatim
+$ playertiledmap [-n] [-o <x> <y>] [-t <tile size>] <image> <resolution> <output>
+@endverbatim
+
+- -n : negate the image, as the "negate" option of @ref driver_mapfile
+- -o : the real-world position of the lower-left corner of the map [m];
+  by default the map is centred on the origin
+- -t : size of the side of a tile [cells], a multiple of 64; default 256
+- resolution : size of a pixel [m]
+
+@par Example
+
+@verbatim
+$ playertiledmap campus.png 0.05 campus.tmap
+@endverbatim
+
+*/
+/** @} */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <libplayercommon/tiledmap.h>
+
+#if defined (HAVE_GDKPIXBUF)
+  #include <gdk-pixbuf/gdk-pixbuf.h>
+#endif
+
+#define USAGE "Usage: playertiledmap [-n] [-o <x> <y>] [-t <tile size>] <image> <resolution> <output>"
+
+char* image;
+char* output;
+double resolution;
+double origin[3];
+int has_origin;
+int negate;
+int tile_size;
+
+int parse_args(int argc, char** argv);
+int read_image(const char* fname, int* width, int* height, int8_t** cells);
+
+int main(int argc, char **argv)
+{
+  int width, height;
+  int8_t* cells;
+
+  negate = 0;
+  has_origin = 0;
+  tile_size = PLAYER_TILEDMAP_DEFAULT_TILE_SIZE;
+  origin[0] = origin[1] = origin[2] = 0.0;
+
+  if(parse_args(argc,argv) < 0)
+  {
+    puts(USAGE);
+    exit(-1);
+  }
+
+  if(read_image(image, &width, &height, &cells) != 0)
+    return -1;
+
+  // Centre the map on the origin, as the mapfile driver does
+  if(!has_origin)
+  {
+    origin[0] = -width * resolution / 2.0;
+    origin[1] = -height * resolution / 2.0;
+  }
+
+  if(player_tiledmap_write(output, cells, width, height,
+                           resolution, origin, tile_size) != 0)
+  {
+    fprintf(stderr, "failed to write %s\n", output);
+    free(cells);
+    return -1;
+  }
+
+  printf("map: %d X %d @ %.3f origin: %f %f -> %s\n",
+         width, height, resolution, origin[0], origin[1], output);
+
+  free(cells);
+  return 0;
+}
+
+int
+parse_args(int argc, char** argv)
+{
+  int i;
+  int max = argc-3;
+
+  if(argc < 4)
+    return(-1);
+  image = argv[max];
+  resolution = atof(argv[max+1]);
+  output = argv[max+2];
+  if(resolution <= 0.0)
+    return(-1);
+
+  for(i=1;i<max;i++)
+  {
+    if(!strcmp(argv[i],"-n"))
+      negate = 1;
+    else if(!strcmp(argv[i],"-o"))
+    {
+      if(i+2 >= max)
+        return(-1);
+      origin[0] = atof(argv[++i]);
+      origin[1] = atof(argv[++i]);
+      has_origin = 1;
+    }
+    else if(!strcmp(argv[i],"-t"))
+    {
+      if(++i >= max)
+        return(-1);
+      tile_size = atoi(argv[i]);
+      if(tile_size <= 0 || tile_size % 64)
+        return(-1);
+    }
+    else
+      return(-1);
+  }
+  return(0);
+}
+
+// Classify a pixel from the average of its channels, as the mapfile
+// driver does
+static int8_t
+classify(double color_avg)
+{
+  double occ;
+
+  if(negate)
+    occ = color_avg / 255.0;
+  else
+    occ = (255 - color_avg) / 255.0;
+
+  if(occ > 0.95)
+    return +1;
+  else if(occ < 0.1)
+    return -1;
+  else
+    return 0;
+}
+
+// Read one number from a PNM header, skipping white space and comments
+static int
+pnm_int(FILE* fp)
+{
+  int c, n;
+
+  for(;;)
+  {
+    c = fgetc(fp);
+    if(c == '#')
+    {
+      while(c != '\n' && c != EOF)
+        c = fgetc(fp);
+    }
+    else if(c != ' ' && c != '\t' && c != '\r' && c != '\n')
+      break;
+  }
+  if(c < '0' || c > '9')
+    return -1;
+  n = 0;
+  while(c >= '0' && c <= '9')
+  {
+    n = n * 10 + (c - '0');
+    c = fgetc(fp);
+  }
+  // The single white space character after the header is dropped here
+  return n;
+}
+
+// Read a binary PGM or PPM image.  Returns 1 if the file is not one.
+static int
+read_pnm(const char* fname, int* width, int* height, int8_t** cells)
+{
+  FILE* fp;
+  unsigned char* row;
+  int i, j, k, n_channels, maxval, bps, color_sum;
+  char magic[2];
+
+  if(!(fp = fopen(fname, "rb")))
+  {
+    perror("fopen() failed");
+    return -1;
+  }
+  if(fread(magic, 1, 2, fp) != 2 || magic[0] != 'P' ||
+     (magic[1] != '5' && magic[1] != '6'))
+  {
+    fclose(fp);
+    return 1;
+  }
+  n_channels = magic[1] == '5' ? 1 : 3;
+  *width = pnm_int(fp);
+  *height = pnm_int(fp);
+  maxval = pnm_int(fp);
+  if(*width <= 0 || *height <= 0 || maxval <= 0 || maxval > 65535)
+  {
+    fprintf(stderr, "%s: bad PNM header\n", fname);
+    fclose(fp);
+    return -1;
+  }
+  bps = maxval > 255 ? 2 : 1;
+
+  row = (unsigned char*)malloc((size_t)*width * n_channels * bps);
+  *cells = (int8_t*)malloc((size_t)*width * *height);
+  if(!row || !*cells)
+  {
+    fprintf(stderr, "out of memory\n");
+    free(row);
+    free(*cells);
+    fclose(fp);
+    return -1;
+  }
+
+  // Rows are stored top first; row 0 of the map is the bottom
+  for(j = 0; j < *height; j++)
+  {
+    if(fread(row, (size_t)*width * n_channels * bps, 1, fp) != 1)
+    {
+      fprintf(stderr, "%s: image data is truncated\n", fname);
+      free(row);
+      free(*cells);
+      fclose(fp);
+      return -1;
+    }
+    for(i = 0; i < *width; i++)
+    {
+      color_sum = 0;
+      for(k = 0; k < n_channels; k++)
+      {
+        if(bps == 2)
+          color_sum += (row[(i*n_channels + k)*2] << 8) |
+                        row[(i*n_channels + k)*2 + 1];
+        else
+          color_sum += row[i*n_channels + k];
+      }
+      (*cells)[(*height - j - 1) * *width + i] =
+        classify(255.0 * color_sum / n_channels / maxval);
+    }
+  }
+
+  free(row);
+  fclose(fp);
+  return 0;
+}
+
+int
+read_image(const char* fname, int* width, int* height, int8_t** cells)
+{
+  int ret;
+#if defined (HAVE_GDKPIXBUF)
+  GdkPixbuf* pixbuf;
+  guchar* pixels;
+  guchar* p;
+  int rowstride, n_channels, bps;
+  GError* error = NULL;
+  int i,j,k;
+  int color_sum;
+#endif
+
+  if((ret = read_pnm(fname, width, height, cells)) <= 0)
+    return ret;
+
+#if defined (HAVE_GDKPIXBUF)
+  g_type_init();
+
+  if(!(pixbuf = gdk_pixbuf_new_from_file(fname, &error)))
+  {
+    fprintf(stderr, "failed to open image file %s\n", fname);
+    return -1;
+  }
+
+  *width = gdk_pixbuf_get_width(pixbuf);
+  *height = gdk_pixbuf_get_height(pixbuf);
+  if(!(*cells = (int8_t*)malloc((size_t)*width * *height)))
+  {
+    fprintf(stderr, "out of memory\n");
+    gdk_pixbuf_unref(pixbuf);
+    return -1;
+  }
+
+  rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+  bps = gdk_pixbuf_get_bits_per_sample(pixbuf)/8;
+  n_channels = gdk_pixbuf_get_n_channels(pixbuf);
+
+  pixels = gdk_pixbuf_get_pixels(pixbuf);
+  for(j = 0; j < *height; j++)
+  {
+    for (i = 0; i < *width; i++)
+    {
+      p = pixels + j*rowstride + i*n_channels*bps;
+      color_sum = 0;
+      for(k=0;k<n_channels;k++)
+        color_sum += *(p + (k * bps));
+      (*cells)[(*height - j - 1) * *width + i] =
+        classify(color_sum / (double)n_channels);
+    }
+  }
+
+  gdk_pixbuf_unref(pixbuf);
+  return 0;
+#else
+  fprintf(stderr, "%s is not a binary PGM or PPM image, and this build "
+          "cannot read other formats\n", fname);
+  return -1;
+#endif
+}